@@ -0,0 +1,241 @@
+//*****************************************************************************
+//
+// blend.c - Packed blend kernels for pixel and channel buffers
+//
+// The kernels in this module process buffers of 32 bit words that each hold
+// four 8 bit channels, such as the pixel frame buffer. Whole words are
+// processed at once instead of looping over every channel:
+//
+// - Multiplies split a word into its even and odd bytes, giving two 16 bit
+//   lanes per 32 bit register. An 8 bit channel times a weight of at most
+//   256 fits in 16 bits, so one multiply scales two channels without carry.
+// - Saturating addition and halving addition use the Cortex-M4 SIMD
+//   instructions UQADD8 and UHADD8 (__UQADD8/__UHADD8 in CMSIS), four
+//   channels per instruction.
+//
+// When the compiler does not target the DSP extension, portable C versions
+// of the SIMD instructions are used. They give bit-exact results, so the
+// kernels can be checked against a per channel reference on a host.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <stdint.h>
+#include "blend.h"
+
+//*****************************************************************************
+//
+// SIMD instructions used by the kernels
+//
+//*****************************************************************************
+#if defined(__CC_ARM) && defined(__TARGET_FEATURE_DSPMUL)
+
+#define BLEND_UQADD8(x, y) __uqadd8(x, y)
+#define BLEND_UHADD8(x, y) __uhadd8(x, y)
+#define BLEND_UXTB16(x)    __uxtb16(x)
+#define BLEND_ROR8(x)      __ror(x, 8)
+
+#elif defined(__ARM_FEATURE_DSP)
+
+#include <arm_acle.h>
+#define BLEND_UQADD8(x, y) __uqadd8(x, y)
+#define BLEND_UHADD8(x, y) __uhadd8(x, y)
+#define BLEND_UXTB16(x)    __uxtb16(x)
+#define BLEND_ROR8(x)      __ror(x, 8)
+
+#else
+
+#define BLEND_UQADD8(x, y) blend_uqadd8(x, y)
+#define BLEND_UHADD8(x, y) blend_uhadd8(x, y)
+#define BLEND_UXTB16(x)    ((x) & 0x00FF00FF)
+#define BLEND_ROR8(x)      (((x) >> 8) | ((x) << 24))
+
+//*****************************************************************************
+//
+//! Portable version of UQADD8. Adds each byte with unsigned saturation.
+//
+//*****************************************************************************
+static uint32_t blend_uqadd8(uint32_t x, uint32_t y)
+{
+	uint32_t result = 0;
+
+	for (uint32_t shift = 0; shift < 32; shift += 8)
+	{
+		uint32_t sum = ((x >> shift) & 0xFF) + ((y >> shift) & 0xFF);
+
+		if (sum > 0xFF)
+			sum = 0xFF;
+		result |= sum << shift;
+	}
+
+	return result;
+}
+
+//*****************************************************************************
+//
+//! Portable version of UHADD8. Adds each byte and halves the result.
+//
+//*****************************************************************************
+static uint32_t blend_uhadd8(uint32_t x, uint32_t y)
+{
+	// Sum without carries between bytes, plus the halved carries
+	return (x & y) + (((x ^ y) >> 1) & 0x7F7F7F7F);
+}
+
+#endif
+
+//*****************************************************************************
+//
+//! Multiplies the even and odd bytes of a word by a weight of at most 256 and
+//! returns the two 16 bit lane pairs, not yet shifted down
+//
+//*****************************************************************************
+#define BLEND_EVEN(x) BLEND_UXTB16(x)
+#define BLEND_ODD(x)  BLEND_UXTB16(BLEND_ROR8(x))
+#define BLEND_PACK(even, odd) ((((even) >> 8) & 0x00FF00FF) | ((odd) & 0xFF00FF00))
+
+//*****************************************************************************
+//
+//! Scales each channel of a buffer
+//!
+//! \param dst is the output buffer. It may be the same as src.
+//! \param src is the input buffer
+//! \param num_words is the number of words, four channels each
+//! \param scale is the scale factor from 0 to BLEND_WEIGHT_MAX
+//!
+//! Each channel is set to (channel * scale) >> 8.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void blend_scale(uint32_t *dst, const uint32_t *src, uint32_t num_words, uint32_t scale)
+{
+	if (scale > BLEND_WEIGHT_MAX)
+		scale = BLEND_WEIGHT_MAX;
+
+	for (uint32_t i = 0; i < num_words; i++)
+	{
+		uint32_t x = src[i];
+
+		dst[i] = BLEND_PACK(BLEND_EVEN(x) * scale, BLEND_ODD(x) * scale);
+	}
+}
+
+//*****************************************************************************
+//
+//! Crossfades between two buffers
+//!
+//! \param dst is the output buffer. It may be the same as a or b.
+//! \param a is the buffer selected by a weight of 0
+//! \param b is the buffer selected by a weight of BLEND_WEIGHT_MAX
+//! \param num_words is the number of words, four channels each
+//! \param weight is the weight of b from 0 to BLEND_WEIGHT_MAX
+//!
+//! Each channel is set to (a * (256 - weight) + b * weight) >> 8. The midpoint
+//! uses a halving add, which gives the same result.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void blend_crossfade(uint32_t *dst, const uint32_t *a, const uint32_t *b, uint32_t num_words, uint32_t weight)
+{
+	uint32_t inverse;
+
+	if (weight > BLEND_WEIGHT_MAX)
+		weight = BLEND_WEIGHT_MAX;
+	inverse = BLEND_WEIGHT_MAX - weight;
+
+	if (weight == BLEND_WEIGHT_MAX / 2)
+	{
+		for (uint32_t i = 0; i < num_words; i++)
+			dst[i] = BLEND_UHADD8(a[i], b[i]);
+		return;
+	}
+
+	for (uint32_t i = 0; i < num_words; i++)
+	{
+		uint32_t x = a[i];
+		uint32_t y = b[i];
+
+		dst[i] = BLEND_PACK(BLEND_EVEN(x) * inverse + BLEND_EVEN(y) * weight,
+			BLEND_ODD(x) * inverse + BLEND_ODD(y) * weight);
+	}
+}
+
+//*****************************************************************************
+//
+//! Adds a buffer on top of another with saturation
+//!
+//! \param dst is the buffer to add to
+//! \param src is the buffer to add
+//! \param num_words is the number of words, four channels each
+//! \param opacity scales src from 0 to BLEND_WEIGHT_MAX before adding
+//!
+//! Each channel is set to min(255, dst + ((src * opacity) >> 8)).
+//!
+//! \return None.
+//
+//*****************************************************************************
+void blend_add(uint32_t *dst, const uint32_t *src, uint32_t num_words, uint32_t opacity)
+{
+	if (opacity >= BLEND_WEIGHT_MAX)
+	{
+		for (uint32_t i = 0; i < num_words; i++)
+			dst[i] = BLEND_UQADD8(dst[i], src[i]);
+		return;
+	}
+
+	for (uint32_t i = 0; i < num_words; i++)
+	{
+		uint32_t x = src[i];
+
+		dst[i] = BLEND_UQADD8(dst[i],
+			BLEND_PACK(BLEND_EVEN(x) * opacity, BLEND_ODD(x) * opacity));
+	}
+}
+
+//*****************************************************************************
+//
+//! Applies a gamma (or any other) lookup table to each channel of a buffer
+//!
+//! \param dst is the output buffer. It may be the same as src.
+//! \param src is the input buffer
+//! \param num_words is the number of words, four channels each
+//! \param table maps each 8 bit input value to its output value
+//!
+//! \return None.
+//
+//*****************************************************************************
+void blend_gamma(uint32_t *dst, const uint32_t *src, uint32_t num_words, const uint8_t table[256])
+{
+	for (uint32_t i = 0; i < num_words; i++)
+	{
+		uint32_t x = src[i];
+
+		dst[i] = (uint32_t)table[x & 0xFF] |
+			((uint32_t)table[(x >> 8) & 0xFF] << 8) |
+			((uint32_t)table[(x >> 16) & 0xFF] << 16) |
+			((uint32_t)table[x >> 24] << 24);
+	}
+}
@@ -0,0 +1,46 @@
+//*****************************************************************************
+//
+// blend.h - Headers for the packed pixel blend kernels
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#ifndef BLEND_H
+#define BLEND_H
+
+#include <stdint.h>
+
+#define BLEND_WEIGHT_MAX 256 // Weight that selects the second operand fully
+
+//*****************************************************************************
+//
+// Public function prototypes.
+//
+//*****************************************************************************
+void blend_scale(uint32_t *dst, const uint32_t *src, uint32_t num_words, uint32_t scale);
+void blend_crossfade(uint32_t *dst, const uint32_t *a, const uint32_t *b, uint32_t num_words, uint32_t weight);
+void blend_add(uint32_t *dst, const uint32_t *src, uint32_t num_words, uint32_t opacity);
+void blend_gamma(uint32_t *dst, const uint32_t *src, uint32_t num_words, const uint8_t table[256]);
+
+#endif
@@ -46,6 +46,8 @@
 #include "common_aux.h"
 #include "log.h"
 #include "led.h"
+#include "irq.h"
+#include "timer_ext.h"
 #include "utils/uartstdio.h"
 
 //*****************************************************************************
@@ -73,6 +75,7 @@
 //*****************************************************************************
 void TIMER0A_Handler(void)
 {
+	irq_jitter_record(IRQ_JITTER_BUTTON);
 	
 	// Clear interrupt
 	TimerIntClear(TIMER0_BASE, TIMER_TIMA_TIMEOUT);
@@ -221,6 +224,7 @@ void button_init(void)
 	IntEnable(INT_TIMER0A);
 			
 	// Enable timer 
+	irq_jitter_timer_set(IRQ_JITTER_BUTTON, TIMER0_BASE, TIMER_A);
 	TimerEnable(TIMER0_BASE, TIMER_A);
 }
 
@@ -0,0 +1,316 @@
+//*****************************************************************************
+//
+// calib.c - Per device color calibration of the LED outputs
+//
+// The same brightness values give different colors on different boards, so
+// the composited brightness goes through a calibration before it reaches
+// the LEDs. The first CALIB_CHANNELS LEDs are mixed by a matrix, which can
+// correct the color of each LED with the others, then each channel gets a
+// gain and an offset. The offset is only added to channels that are lit so
+// black stays black.
+//
+// Coefficients and gains are Q8.8 fixed point. The gains are folded into the
+// matrix when the calibration changes, so applying it is one integer 
+// multiply-accumulate per matrix coefficient. It runs only when the
+// composited brightness changes, not on every fade step.
+//
+// The calibration is kept in the SETTINGS_BLOCK_CALIBRATION block.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "log.h"
+#include "settings.h"
+#include "calib.h"
+
+//*****************************************************************************
+//
+// Defines used to configure the calibration
+//
+//*****************************************************************************
+#define CALIB_VERSION          2    // Version of struct calib_data
+#define CALIB_MAX_COEFFICIENT  1024 // Largest matrix coefficient, 4.0
+#define CALIB_MAX_GAIN         1024 // Largest gain, 4.0
+#define CALIB_MAX_OFFSET       64   // Largest offset, in brightness levels
+#define CALIB_MAX_LEVEL        255  // Maximum brightness level
+
+//*****************************************************************************
+//
+// The calibration as saved in the settings. Rows and columns of the matrix
+// follow the LED index, so matrix[i][j] is the share of LED j's requested
+// brightness driven on LED i.
+//
+//*****************************************************************************
+struct calib_data
+{
+	int16_t matrix[CALIB_CHANNELS][CALIB_CHANNELS];
+	uint16_t gain[CALIB_CHANNELS];
+	int8_t offset[CALIB_CHANNELS];
+};
+
+static struct calib_data _calib __attribute__ ((aligned(4)));
+
+//
+// Matrix with the gains folded in, used when applying the calibration
+//
+static int32_t _mix[CALIB_CHANNELS][CALIB_CHANNELS];
+
+//*****************************************************************************
+//
+// Prototypes for private functions
+//
+//*****************************************************************************
+static void calib_row_update(uint32_t row);
+
+//*****************************************************************************
+//
+//! Initializes the calibration from the settings
+//!
+//! settings_init() must be called first. The identity calibration is used if
+//! no calibration was saved.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void calib_init(void)
+{
+	calib_reset();
+	
+	if (settings_load(SETTINGS_BLOCK_CALIBRATION, CALIB_VERSION, &_calib, sizeof(_calib)))
+	{
+		for (uint32_t row = 0; row < CALIB_CHANNELS; row++)
+			calib_row_update(row);
+		log_msg(LOG_SUB_SYSTEM_LED, LOG_LEVEL_DEBUG, "Loaded calibration");
+	}
+}
+
+//*****************************************************************************
+//
+//! Sets a coefficient of the color mixing matrix
+//!
+//! \param row is the LED driven
+//! \param column is the LED whose requested brightness is mixed in
+//! \param coefficient is the Q8.8 coefficient, where CALIB_UNITY is 1.0
+//!
+//! \return None.
+//
+//*****************************************************************************
+void calib_matrix_set(uint32_t row, uint32_t column, int32_t coefficient)
+{
+	if (row >= CALIB_CHANNELS || column >= CALIB_CHANNELS)
+		return;
+	
+	if (coefficient > CALIB_MAX_COEFFICIENT)
+		coefficient = CALIB_MAX_COEFFICIENT;
+	if (coefficient < -CALIB_MAX_COEFFICIENT)
+		coefficient = -CALIB_MAX_COEFFICIENT;
+	
+	_calib.matrix[row][column] = coefficient;
+	calib_row_update(row);
+}
+
+//*****************************************************************************
+//
+//! Gets a coefficient of the color mixing matrix
+//!
+//! \param row is the LED driven
+//! \param column is the LED whose requested brightness is mixed in
+//!
+//! \return the Q8.8 coefficient
+//
+//*****************************************************************************
+int32_t calib_matrix_get(uint32_t row, uint32_t column)
+{
+	if (row >= CALIB_CHANNELS || column >= CALIB_CHANNELS)
+		return 0;
+	
+	return _calib.matrix[row][column];
+}
+
+//*****************************************************************************
+//
+//! Sets the gain of a channel
+//!
+//! \param channel is the LED index
+//! \param gain is the Q8.8 gain, where CALIB_UNITY is 1.0
+//!
+//! \return None.
+//
+//*****************************************************************************
+void calib_gain_set(uint32_t channel, uint32_t gain)
+{
+	if (channel >= CALIB_CHANNELS)
+		return;
+	
+	if (gain > CALIB_MAX_GAIN)
+		gain = CALIB_MAX_GAIN;
+	
+	_calib.gain[channel] = gain;
+	calib_row_update(channel);
+}
+
+//*****************************************************************************
+//
+//! Gets the gain of a channel
+//!
+//! \param channel is the LED index
+//!
+//! \return the Q8.8 gain
+//
+//*****************************************************************************
+uint32_t calib_gain_get(uint32_t channel)
+{
+	if (channel >= CALIB_CHANNELS)
+		return 0;
+	
+	return _calib.gain[channel];
+}
+
+//*****************************************************************************
+//
+//! Sets the offset of a channel
+//!
+//! \param channel is the LED index
+//! \param offset is added to the brightness of the channel when it is lit
+//!
+//! \return None.
+//
+//*****************************************************************************
+void calib_offset_set(uint32_t channel, int32_t offset)
+{
+	if (channel >= CALIB_CHANNELS)
+		return;
+	
+	if (offset > CALIB_MAX_OFFSET)
+		offset = CALIB_MAX_OFFSET;
+	if (offset < -CALIB_MAX_OFFSET)
+		offset = -CALIB_MAX_OFFSET;
+	
+	_calib.offset[channel] = offset;
+}
+
+//*****************************************************************************
+//
+//! Gets the offset of a channel
+//!
+//! \param channel is the LED index
+//!
+//! \return the offset
+//
+//*****************************************************************************
+int32_t calib_offset_get(uint32_t channel)
+{
+	if (channel >= CALIB_CHANNELS)
+		return 0;
+	
+	return _calib.offset[channel];
+}
+
+//*****************************************************************************
+//
+//! Resets the calibration to the identity. The saved calibration is not 
+//! changed until calib_save() is called.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void calib_reset(void)
+{
+	for (uint32_t row = 0; row < CALIB_CHANNELS; row++)
+	{
+		for (uint32_t column = 0; column < CALIB_CHANNELS; column++)
+			_calib.matrix[row][column] = row == column ? CALIB_UNITY : 0;
+		_calib.gain[row] = CALIB_UNITY;
+		_calib.offset[row] = 0;
+		calib_row_update(row);
+	}
+}
+
+//*****************************************************************************
+//
+//! Saves the calibration to the settings
+//!
+//! \return true if the calibration was saved, false otherwise
+//
+//*****************************************************************************
+bool calib_save(void)
+{
+	return settings_save(SETTINGS_BLOCK_CALIBRATION, CALIB_VERSION, &_calib, sizeof(_calib));
+}
+
+//*****************************************************************************
+//
+//! Applies the calibration to a set of brightness levels
+//!
+//! \param in is the requested brightness of each LED
+//! \param out is set to the calibrated brightness of each LED. It must not be
+//! the same as in.
+//! \param num_channels is the number of LEDs
+//!
+//! LEDs past CALIB_CHANNELS are not calibrated.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void calib_apply(const uint8_t *in, uint8_t *out, uint32_t num_channels)
+{
+	uint32_t num_mixed = num_channels < CALIB_CHANNELS ? num_channels : CALIB_CHANNELS;
+	
+	for (uint32_t i = 0; i < num_mixed; i++)
+	{
+		int32_t level = 0;
+		
+		for (uint32_t j = 0; j < num_mixed; j++)
+			level += _mix[i][j] * in[j];
+		
+		// Round the Q8.8 result to a brightness level
+		level = (level + (CALIB_UNITY / 2)) >> 8;
+		if (level > 0)
+			level += _calib.offset[i];
+		
+		if (level < 0)
+			level = 0;
+		if (level > CALIB_MAX_LEVEL)
+			level = CALIB_MAX_LEVEL;
+		out[i] = level;
+	}
+	
+	for (uint32_t i = num_mixed; i < num_channels; i++)
+		out[i] = in[i];
+}
+
+//*****************************************************************************
+//
+//! Folds the gain of a channel into its row of the mixing matrix
+//!
+//! \param row is the channel to update
+//
+//*****************************************************************************
+static void calib_row_update(uint32_t row)
+{
+	for (uint32_t column = 0; column < CALIB_CHANNELS; column++)
+		_mix[row][column] = (_calib.matrix[row][column] * (int32_t)_calib.gain[row]) / CALIB_UNITY;
+}
@@ -0,0 +1,54 @@
+//*****************************************************************************
+//
+// calib.h - Headers for the LED color calibration
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#ifndef CALIB_H
+#define CALIB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CALIB_CHANNELS  3   // Channels mixed by the matrix, the RGB LEDs
+#define CALIB_UNITY     256 // Matrix coefficient or gain of 1.0 (Q8.8)
+
+//*****************************************************************************
+//
+// Public function prototypes.
+//
+//*****************************************************************************
+void calib_init(void);
+void calib_matrix_set(uint32_t row, uint32_t column, int32_t coefficient);
+int32_t calib_matrix_get(uint32_t row, uint32_t column);
+void calib_gain_set(uint32_t channel, uint32_t gain);
+uint32_t calib_gain_get(uint32_t channel);
+void calib_offset_set(uint32_t channel, int32_t offset);
+int32_t calib_offset_get(uint32_t channel);
+void calib_reset(void);
+bool calib_save(void);
+void calib_apply(const uint8_t *in, uint8_t *out, uint32_t num_channels);
+
+#endif
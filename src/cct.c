@@ -0,0 +1,266 @@
+//*****************************************************************************
+//
+// cct.c - Correlated color temperature engine for the warm/cool LED groups
+//
+// The lamp mixes a warm and a cool LED group. The color temperature of the
+// mix is close to linear in mired (1000000 / kelvin) with the share of light
+// from each group, so the table is computed in mired space. The total light
+// is kept constant across the range: it is limited to the output of the
+// dimmer group, so any mix can reach it.
+//
+// The table holds the brightness of each group at full intensity, in 1/256
+// steps, for color temperatures CCT_KELVIN_STEP apart. It is recomputed when
+// the lamp is calibrated. A request is a table lookup and one interpolation
+// between two points, followed by the intensity scale.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "log.h"
+#include "settings.h"
+#include "led.h"
+#include "cct.h"
+
+//*****************************************************************************
+//
+// Defines used to configure the CCT engine
+//
+//*****************************************************************************
+#define CCT_DEFAULT_WARM_KELVIN  2700 // Color temperature of the warm LED group
+#define CCT_DEFAULT_COOL_KELVIN  6500 // Color temperature of the cool LED group
+#define CCT_DEFAULT_LUMENS       100  // Relative light output of each group at
+                                      // 	full brightness
+#define CCT_MIRED(kelvin)        (1000000.0f / (kelvin))
+#define CCT_VERSION              1    // Version of struct cct_settings
+
+//*****************************************************************************
+//
+// Calibration of the LED groups saved in the EEPROM
+//
+//*****************************************************************************
+struct cct_settings
+{
+	uint32_t warm_kelvin;
+	uint32_t cool_kelvin;
+	uint32_t warm_lumens;
+	uint32_t cool_lumens;
+};
+
+//*****************************************************************************
+//
+// Brightness of each LED group at full intensity, in 1/256 steps
+//
+//*****************************************************************************
+static uint16_t _warm_table[CCT_TABLE_POINTS];
+static uint16_t _cool_table[CCT_TABLE_POINTS];
+
+static uint32_t _kelvin;
+static uint32_t _intensity;
+static struct cct_settings _settings;
+
+//*****************************************************************************
+//
+//! Initializes the CCT table from the saved calibration
+//!
+//! settings_init() must be called first. The default LED groups are used if
+//! no valid calibration was saved.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void cct_init(void)
+{
+	struct cct_settings saved;
+	
+	if (settings_load(SETTINGS_BLOCK_CCT, CCT_VERSION, &saved, sizeof(saved)) &&
+		cct_calibrate(saved.warm_kelvin, saved.cool_kelvin, saved.warm_lumens, saved.cool_lumens))
+	{
+		log_msg(LOG_SUB_SYSTEM_LED, LOG_LEVEL_DEBUG, "Loaded CCT calibration");
+	}
+	else
+	{
+		cct_calibrate(CCT_DEFAULT_WARM_KELVIN, CCT_DEFAULT_COOL_KELVIN,
+			CCT_DEFAULT_LUMENS, CCT_DEFAULT_LUMENS);
+	}
+	_kelvin = CCT_DEFAULT_WARM_KELVIN;
+	_intensity = 0;
+}
+
+//*****************************************************************************
+//
+//! Recomputes the CCT table for the measured LED groups
+//!
+//! \param warm_kelvin is the color temperature of the warm LED group
+//! \param cool_kelvin is the color temperature of the cool LED group
+//! \param warm_lumens is the light output of the warm group at full brightness
+//! \param cool_lumens is the light output of the cool group at full brightness
+//!
+//! The light outputs are relative to each other, so any unit can be used.
+//! The calibration is only kept over a reset once saved with cct_save().
+//!
+//! \return true if the table was recomputed, false if the values are invalid
+//
+//*****************************************************************************
+bool cct_calibrate(uint32_t warm_kelvin, uint32_t cool_kelvin, uint32_t warm_lumens, uint32_t cool_lumens)
+{
+	float warm_mired, cool_mired, lumens;
+
+	if (warm_kelvin == 0 || warm_kelvin >= cool_kelvin || warm_lumens == 0 ||
+		cool_lumens == 0)
+		return false;
+
+	warm_mired = CCT_MIRED(warm_kelvin);
+	cool_mired = CCT_MIRED(cool_kelvin);
+
+	// Light output that both groups can reach on their own
+	lumens = warm_lumens < cool_lumens ? warm_lumens : cool_lumens;
+
+	for (uint32_t i = 0; i < CCT_TABLE_POINTS; i++)
+	{
+		float mired = CCT_MIRED(CCT_MIN_KELVIN + i * CCT_KELVIN_STEP);
+		float cool_share = (warm_mired - mired) / (warm_mired - cool_mired);
+
+		if (cool_share < 0.0f)
+			cool_share = 0.0f;
+		if (cool_share > 1.0f)
+			cool_share = 1.0f;
+
+		_warm_table[i] = led_brightness_from_light(
+			(1.0f - cool_share) * lumens / warm_lumens * LED_MAX_LIGHT);
+		_cool_table[i] = led_brightness_from_light(
+			cool_share * lumens / cool_lumens * LED_MAX_LIGHT);
+	}
+
+	log_msg_value(LOG_SUB_SYSTEM_LED, LOG_LEVEL_DEBUG, "CCT warm kelvin", warm_kelvin);
+	log_msg_value(LOG_SUB_SYSTEM_LED, LOG_LEVEL_DEBUG, "CCT cool kelvin", cool_kelvin);
+
+	_settings.warm_kelvin = warm_kelvin;
+	_settings.cool_kelvin = cool_kelvin;
+	_settings.warm_lumens = warm_lumens;
+	_settings.cool_lumens = cool_lumens;
+
+	return true;
+}
+
+//*****************************************************************************
+//
+//! Saves the calibration of the LED groups to the settings
+//!
+//! \return true if the calibration was saved, false otherwise
+//
+//*****************************************************************************
+bool cct_save(void)
+{
+	return settings_save(SETTINGS_BLOCK_CCT, CCT_VERSION, &_settings, sizeof(_settings));
+}
+
+//*****************************************************************************
+//
+//! Gets the brightness of the LED groups for a color temperature
+//!
+//! \param kelvin is the color temperature. It is clamped to the range
+//! CCT_MIN_KELVIN to CCT_MAX_KELVIN.
+//! \param intensity is the intensity from 0 to CCT_MAX_INTENSITY
+//! \param warm is set to the brightness of the warm LED group
+//! \param cool is set to the brightness of the cool LED group
+//!
+//! \return None.
+//
+//*****************************************************************************
+void cct_brightness_get(uint32_t kelvin, uint32_t intensity, uint32_t *warm, uint32_t *cool)
+{
+	uint32_t index, offset;
+	int32_t warm_point, cool_point;
+
+	if (kelvin < CCT_MIN_KELVIN)
+		kelvin = CCT_MIN_KELVIN;
+	if (kelvin >= CCT_MAX_KELVIN)
+		kelvin = CCT_MAX_KELVIN - 1;
+	if (intensity > CCT_MAX_INTENSITY)
+		intensity = CCT_MAX_INTENSITY;
+
+	index = (kelvin - CCT_MIN_KELVIN) / CCT_KELVIN_STEP;
+	offset = (kelvin - CCT_MIN_KELVIN) % CCT_KELVIN_STEP;
+
+	warm_point = _warm_table[index];
+	warm_point += (((int32_t)_warm_table[index + 1] - warm_point) * (int32_t)offset) / CCT_KELVIN_STEP;
+	cool_point = _cool_table[index];
+	cool_point += (((int32_t)_cool_table[index + 1] - cool_point) * (int32_t)offset) / CCT_KELVIN_STEP;
+
+	// Map 0-255 onto 0-256 so full intensity does not dim, then drop the
+	// fraction bits of the table
+	intensity += intensity >> 7;
+	*warm = ((uint32_t)warm_point * intensity) >> 16;
+	*cool = ((uint32_t)cool_point * intensity) >> 16;
+}
+
+//*****************************************************************************
+//
+//! Fades the lamp to a color temperature and intensity
+//!
+//! \param kelvin is the color temperature
+//! \param intensity is the intensity from 0 to CCT_MAX_INTENSITY
+//!
+//! \return None.
+//
+//*****************************************************************************
+void cct_set(uint32_t kelvin, uint32_t intensity)
+{
+	uint32_t warm, cool;
+
+	cct_brightness_get(kelvin, intensity, &warm, &cool);
+	led_update_begin();
+	led_sw_brightness_set(CCT_WARM_LED, warm);
+	led_sw_brightness_set(CCT_COOL_LED, cool);
+	led_update_end();
+
+	_kelvin = kelvin;
+	_intensity = intensity;
+}
+
+//*****************************************************************************
+//
+//! Gets the color temperature last set
+//!
+//! \return the color temperature in kelvin
+//
+//*****************************************************************************
+uint32_t cct_kelvin_get(void)
+{
+	return _kelvin;
+}
+
+//*****************************************************************************
+//
+//! Gets the intensity last set
+//!
+//! \return the intensity from 0 to CCT_MAX_INTENSITY
+//
+//*****************************************************************************
+uint32_t cct_intensity_get(void)
+{
+	return _intensity;
+}
@@ -0,0 +1,66 @@
+//*****************************************************************************
+//
+// cct.h - Headers for the correlated color temperature engine
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#ifndef CCT_H
+#define CCT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "led.h"
+
+//
+// LEDs driving the warm and cool LED groups of the lamp
+//
+#define CCT_WARM_LED       LED_ONBOARD_BLUE
+#define CCT_COOL_LED       LED_ONBOARD_GREEN
+
+//
+// Range of color temperatures covered by the table, in kelvin. Temperatures
+// outside the range of the calibrated LED groups are clamped to the group.
+//
+#define CCT_MIN_KELVIN     1800
+#define CCT_MAX_KELVIN     6600
+#define CCT_KELVIN_STEP    150  // Kelvin between two table points
+#define CCT_TABLE_POINTS   ((CCT_MAX_KELVIN - CCT_MIN_KELVIN) / CCT_KELVIN_STEP + 1)
+
+#define CCT_MAX_INTENSITY  255
+
+//*****************************************************************************
+//
+// Public function prototypes.
+//
+//*****************************************************************************
+void cct_init(void);
+bool cct_calibrate(uint32_t warm_kelvin, uint32_t cool_kelvin, uint32_t warm_lumens, uint32_t cool_lumens);
+bool cct_save(void);
+void cct_brightness_get(uint32_t kelvin, uint32_t intensity, uint32_t *warm, uint32_t *cool);
+void cct_set(uint32_t kelvin, uint32_t intensity);
+uint32_t cct_kelvin_get(void);
+uint32_t cct_intensity_get(void);
+
+#endif
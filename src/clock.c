@@ -0,0 +1,353 @@
+//*****************************************************************************
+//
+// clock.c - Monotonic clock disciplined to the lamp bus time
+//
+// WTIMER0 runs as a free running 64 bit counter at the system clock. It
+// provides the local time of the lamp in us, which never jumps.
+//
+// The host broadcasts beacons on the lamp bus carrying the bus time at the
+// start of the beacon frame. Each beacon pairs a bus time with the local time
+// the frame started, as stamped by the receive interrupt. The bus time is
+// derived from the local time by the last pair and the rate of the bus clock
+// against the local clock. The rate is measured between beacons and filtered,
+// since the internal oscillator is only accurate to 1%. A beacon too far off
+// the prediction is taken as a late timestamp and dropped, unless several
+// follow in a row.
+//
+// The match interrupt of the counter raises an alarm at a bus time, so a
+// scheduled change starts on time rather than on the next fade step.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "inc/hw_types.h"
+#include "inc/hw_memmap.h"
+#include "inc/hw_ints.h"
+#include "inc/hw_timer.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/timer.h"
+#include "driverlib/interrupt.h"
+
+#include "clock.h"
+#include "log.h"
+
+//*****************************************************************************
+//
+// Module Configuration Defines
+//
+//*****************************************************************************
+#define CLOCK_TIMER_BASE     WTIMER0_BASE
+#define CLOCK_RATE_ONE       (1 << 24)     // Rate of a bus clock running at
+                                           //  the speed of the local clock
+#define CLOCK_RATE_LIMIT     (CLOCK_RATE_ONE / 32) // Largest rate error
+                                                   //  accepted, about 3%
+#define CLOCK_RATE_FILTER    4             // Weight of the previous rate
+                                           //  against a new measurement
+#define CLOCK_STEP_US        2000          // Error above which a beacon is
+                                           //  taken as an outlier
+#define CLOCK_MAX_OUTLIERS   3             // Outliers in a row before the
+                                           //  clock is set again
+#define CLOCK_HOLDOVER_US    10000000      // Time the clock stays in sync
+                                           //  without a beacon
+#define CLOCK_ALARM_MIN_US   20            // Alarms closer than this are
+                                           //  raised right away
+
+//*****************************************************************************
+//
+// Internal variables
+//
+//*****************************************************************************
+static uint32_t _ticks_per_us;
+
+// Last beacon. The bus time is _ref_sync at local time _ref_local.
+static uint32_t _ref_local;
+static uint32_t _ref_sync;
+static int32_t _rate;               // Bus us per local us, in 1/2^24 steps
+static uint32_t _num_beacons;       // Beacons accepted since the clock was set
+static uint32_t _num_outliers;      // Beacons dropped in a row
+static int32_t _offset;             // Error of the last beacon, in us
+
+static void (*_alarm_callback)(void);
+
+//*****************************************************************************
+//
+//! WTIMER0A interrupt handler. Raised by the counter match at the alarm time,
+//! or triggered by software for an alarm already due.
+//
+//*****************************************************************************
+void WTIMER0A_Handler(void)
+{
+	void (*callback)(void) = _alarm_callback;
+	
+	TimerIntDisable(CLOCK_TIMER_BASE, TIMER_TIMA_MATCH);
+	TimerIntClear(CLOCK_TIMER_BASE, TIMER_TIMA_MATCH);
+	_alarm_callback = 0;
+	
+	if (callback)
+		callback();
+}
+
+//*****************************************************************************
+//
+//! Initializes the clock
+//!
+//! This function starts WTIMER0 as a 64 bit counter. The bus time follows the
+//! local time until the first beacon is received.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void clock_init(void)
+{
+	SysCtlPeripheralEnable(SYSCTL_PERIPH_WTIMER0);
+	while (!SysCtlPeripheralReady(SYSCTL_PERIPH_WTIMER0)){};
+	
+	TimerConfigure(CLOCK_TIMER_BASE, TIMER_CFG_PERIODIC_UP);
+	TimerLoadSet64(CLOCK_TIMER_BASE, UINT64_MAX);
+	
+	// Allow the match interrupt, it is enabled when an alarm is set
+	HWREG(CLOCK_TIMER_BASE + TIMER_O_TAMR) |= TIMER_TAMR_TAMIE;
+	TimerIntClear(CLOCK_TIMER_BASE, TIMER_TIMA_MATCH);
+	IntEnable(INT_WTIMER0A);
+	TimerEnable(CLOCK_TIMER_BASE, TIMER_A);
+	
+	_ticks_per_us = SysCtlClockGet() / 1000000;
+	_ref_local = 0;
+	_ref_sync = 0;
+	_rate = CLOCK_RATE_ONE;
+	_num_beacons = 0;
+	_num_outliers = 0;
+	_offset = 0;
+	_alarm_callback = 0;
+}
+
+//*****************************************************************************
+//
+//! Gets the local time
+//!
+//! \return The time since clock_init() in us, wrapping every 71 minutes
+//
+//*****************************************************************************
+uint32_t clock_local_get(void)
+{
+	return TimerValueGet64(CLOCK_TIMER_BASE) / _ticks_per_us;
+}
+
+//*****************************************************************************
+//
+//! Gets the local time in ms, for times longer than clock_local_get() covers
+//!
+//! \return The time since clock_init() in ms, wrapping every 49 days
+//
+//*****************************************************************************
+uint32_t clock_local_ms_get(void)
+{
+	return TimerValueGet64(CLOCK_TIMER_BASE) / (_ticks_per_us * 1000);
+}
+
+//*****************************************************************************
+//
+//! Gets the bus time
+//!
+//! \return The bus time in us
+//
+//*****************************************************************************
+uint32_t clock_sync_get(void)
+{
+	return clock_sync_from_local(clock_local_get());
+}
+
+//*****************************************************************************
+//
+//! Converts a local time to the bus time
+//!
+//! \param local_us is the local time in us
+//!
+//! \return The bus time in us at local_us
+//
+//*****************************************************************************
+uint32_t clock_sync_from_local(uint32_t local_us)
+{
+	int32_t delta = local_us - _ref_local;
+	
+	return _ref_sync + (int32_t)(((int64_t)delta * _rate) >> 24);
+}
+
+//*****************************************************************************
+//
+//! Gets whether the clock follows the bus time
+//!
+//! \return true if two beacons were accepted and the last one was recent
+//! enough for the rate error to be small, false otherwise
+//
+//*****************************************************************************
+bool clock_synced(void)
+{
+	return _num_beacons >= 2 && clock_local_get() - _ref_local < CLOCK_HOLDOVER_US;
+}
+
+//*****************************************************************************
+//
+//! Disciplines the clock with a beacon
+//!
+//! \param sync_us is the bus time carried by the beacon
+//! \param local_us is the local time the beacon was received
+//!
+//! \return None.
+//
+//*****************************************************************************
+void clock_beacon(uint32_t sync_us, uint32_t local_us)
+{
+	int32_t error, rate;
+	uint32_t elapsed;
+	
+	error = sync_us - clock_sync_from_local(local_us);
+	elapsed = local_us - _ref_local;
+	
+	if (_num_beacons >= 2 && (error > CLOCK_STEP_US || error < -CLOCK_STEP_US) &&
+		++_num_outliers < CLOCK_MAX_OUTLIERS)
+	{
+		log_msg_value(LOG_SUB_SYSTEM_LAMPBUS, LOG_LEVEL_WARNING, "Beacon dropped, error", error);
+		return;
+	}
+	
+	// Measure the rate over the interval since the previous beacon
+	rate = _rate;
+	if (_num_beacons >= 1 && elapsed > 0 && elapsed < CLOCK_HOLDOVER_US)
+	{
+		int32_t measured = ((int64_t)(int32_t)(sync_us - _ref_sync) << 24) / elapsed;
+		
+		if (measured > CLOCK_RATE_ONE - CLOCK_RATE_LIMIT &&
+			measured < CLOCK_RATE_ONE + CLOCK_RATE_LIMIT)
+		{
+			if (_num_beacons == 1)
+				rate = measured;
+			else
+				rate += (measured - rate) / CLOCK_RATE_FILTER;
+		}
+	}
+	
+	// Too far off after several beacons: set the clock again
+	if (_num_outliers >= CLOCK_MAX_OUTLIERS)
+	{
+		log_msg_value(LOG_SUB_SYSTEM_LAMPBUS, LOG_LEVEL_WARNING, "Clock set again, error", error);
+		_num_beacons = 0;
+		rate = CLOCK_RATE_ONE;
+	}
+	
+	// The fade step reads the bus time
+	IntDisable(INT_TIMER1A);
+	_ref_local = local_us;
+	_ref_sync = sync_us;
+	_rate = rate;
+	IntEnable(INT_TIMER1A);
+	
+	_offset = error;
+	_num_outliers = 0;
+	if (_num_beacons < 2)
+		_num_beacons++;
+}
+
+//*****************************************************************************
+//
+//! Gets the error of the last beacon
+//!
+//! \return The bus time of the last beacon minus the bus time predicted by
+//! the clock for it, in us
+//
+//*****************************************************************************
+int32_t clock_offset_get(void)
+{
+	return _offset;
+}
+
+//*****************************************************************************
+//
+//! Gets the rate of the bus clock against the local clock
+//!
+//! \return The rate error in parts per million
+//
+//*****************************************************************************
+int32_t clock_rate_ppm_get(void)
+{
+	return ((int64_t)(_rate - CLOCK_RATE_ONE) * 1000000) >> 24;
+}
+
+//*****************************************************************************
+//
+//! Sets the alarm
+//!
+//! \param sync_us is the bus time of the alarm
+//! \param callback is called from the interrupt handler at the alarm time
+//!
+//! A single alarm is kept, so this replaces the previous one. An alarm in the
+//! past is raised right away.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void clock_alarm_set(uint32_t sync_us, void (*callback)(void))
+{
+	uint64_t now;
+	int32_t delay;
+	
+	IntDisable(INT_WTIMER0A);
+	
+	now = TimerValueGet64(CLOCK_TIMER_BASE);
+	delay = (int32_t)(sync_us - clock_sync_from_local(now / _ticks_per_us));
+	delay = ((int64_t)delay << 24) / _rate;
+	
+	_alarm_callback = callback;
+	TimerIntClear(CLOCK_TIMER_BASE, TIMER_TIMA_MATCH);
+	if (delay < CLOCK_ALARM_MIN_US)
+	{
+		// The match could be passed before it is set
+		IntTrigger(INT_WTIMER0A);
+	}
+	else
+	{
+		TimerMatchSet64(CLOCK_TIMER_BASE, now + (uint64_t)delay * _ticks_per_us);
+		TimerIntEnable(CLOCK_TIMER_BASE, TIMER_TIMA_MATCH);
+	}
+	
+	IntEnable(INT_WTIMER0A);
+}
+
+//*****************************************************************************
+//
+//! Cancels the alarm
+//!
+//! \return None.
+//
+//*****************************************************************************
+void clock_alarm_cancel(void)
+{
+	IntDisable(INT_WTIMER0A);
+	TimerIntDisable(CLOCK_TIMER_BASE, TIMER_TIMA_MATCH);
+	_alarm_callback = 0;
+	IntEnable(INT_WTIMER0A);
+}
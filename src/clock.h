@@ -0,0 +1,58 @@
+//*****************************************************************************
+//
+// clock.h - Headers for the monotonic clock and the lamp bus time
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//
+// Compares two times in us. Times wrap every 71 minutes, so only times less
+// than 35 minutes apart can be compared.
+//
+#define CLOCK_BEFORE(a, b) ((int32_t)((a) - (b)) < 0)
+
+//*****************************************************************************
+//
+// Public function prototypes.
+//
+//*****************************************************************************
+void clock_init(void);
+uint32_t clock_local_get(void);
+uint32_t clock_local_ms_get(void);
+uint32_t clock_sync_get(void);
+uint32_t clock_sync_from_local(uint32_t local_us);
+bool clock_synced(void);
+void clock_beacon(uint32_t sync_us, uint32_t local_us);
+int32_t clock_offset_get(void);
+int32_t clock_rate_ppm_get(void);
+void clock_alarm_set(uint32_t sync_us, void (*callback)(void));
+void clock_alarm_cancel(void);
+
+#endif
@@ -37,6 +37,23 @@
 #include "log.h"
 #include "tsl2591.h"
 #include "console.h"
+#include "dmx.h"
+#include "pixel.h"
+#include "timeline.h"
+#include "cct.h"
+#include "calib.h"
+#include "color.h"
+#include "pca9685.h"
+#include "lampbus.h"
+#include "clock.h"
+#include "telemetry.h"
+#include "irq.h"
+#include "lux_sampler.h"
+#include "lux_curve.h"
+#include "dimmer.h"
+#include "thermal.h"
+#include "energy.h"
+#include "schedule.h"
 #include "driverlib/pin_map.h"
 #include "inc/hw_gpio.h"
 #include "inc/hw_types.h"
@@ -47,6 +64,14 @@
 #include "driverlib/gpio.h"
 #include "driverlib/uart.h"
 
+//*****************************************************************************
+//
+// Defines used by the commands
+//
+//*****************************************************************************
+#define CMD_LUX_MAX_AGE_MS 1000 // Age of a lux sample shown without a new one
+#define CMD_LUX_TIMEOUT_MS 1000 // Time to wait for a new lux sample
+
 //*****************************************************************************
 //
 // Function Prototypes
@@ -62,6 +87,50 @@ void cmd_set_fade_time_interval(void);
 void cmd_set_lux_sensitivity(void);
 void cmd_lux_read(void);
 void cmd_led_update_hw(void);
+void cmd_dmx_on(void);
+void cmd_dmx_off(void);
+void cmd_set_dmx_address(void);
+void cmd_pixel_fill(void);
+void cmd_set_pixel_count(void);
+void cmd_pixel_status(void);
+void cmd_set_overlay(void);
+void cmd_overlay_off(void);
+void cmd_set_dimmer(void);
+void cmd_sequence_load(void);
+void cmd_sequence_play(void);
+void cmd_sequence_stop(void);
+void cmd_set_cct(void);
+void cmd_cct_calibrate(void);
+void cmd_calibration_upload(void);
+void cmd_calibration_read(void);
+void cmd_calibration_reset(void);
+void cmd_set_hsv(void);
+void cmd_set_hsl(void);
+void cmd_pca9685_status(void);
+void cmd_set_bus_address(void);
+void cmd_bus_status(void);
+void cmd_clock_status(void);
+void cmd_telemetry(void);
+void cmd_jitter(void);
+void cmd_set_lux_rate(void);
+void cmd_lux_rate_status(void);
+void cmd_lux_curve_upload(void);
+void cmd_lux_curve_read(void);
+void cmd_knob_on(void);
+void cmd_knob_off(void);
+void cmd_knob_status(void);
+void cmd_derate(void);
+void cmd_channel_power(void);
+void cmd_thermal_status(void);
+void cmd_energy_read(void);
+void cmd_time_set(void);
+void cmd_schedule_upload(void);
+void cmd_schedule_read(void);
+void cmd_schedule_on(void);
+void cmd_schedule_off(void);
+bool cmd_led_type_prompt(uint32_t *led_type);
+bool cmd_color_prompt(const char *level_name, uint32_t *hue, uint32_t *saturation, uint32_t *level, uint32_t *duration_ms);
+void cmd_values_prompt(const char *prompt, int32_t *values, uint32_t num_values);
 
 //*****************************************************************************
 //
@@ -90,6 +159,47 @@ static const struct cmdStruct cmdList[] =
 	{"sens", &cmd_set_lux_sensitivity, "Set lux sensitivity"},
 	{"lux", &cmd_lux_read, "Read lux sensor"},
 	{"uphw", &cmd_led_update_hw, "Update LED brightness"},
+	{"dmxon", &cmd_dmx_on, "Enable DMX512 input"},
+	{"dmxoff", &cmd_dmx_off, "Disable DMX512 input"},
+	{"dmxaddr", &cmd_set_dmx_address, "Set DMX512 start address"},
+	{"pixfill", &cmd_pixel_fill, "Set all strip pixels to a color"},
+	{"pixnum", &cmd_set_pixel_count, "Set number of strip pixels"},
+	{"pixstat", &cmd_pixel_status, "Display strip encoding statistics"},
+	{"overlay", &cmd_set_overlay, "Show an LED overlay over the current scene"},
+	{"overlayoff", &cmd_overlay_off, "Remove the LED overlay"},
+	{"dimmer", &cmd_set_dimmer, "Set the master dimmer level"},
+	{"seqload", &cmd_sequence_load, "Upload and play a keyframe sequence"},
+	{"seqplay", &cmd_sequence_play, "Play a built in sequence"},
+	{"seqstop", &cmd_sequence_stop, "Stop the playing sequence"},
+	{"cct", &cmd_set_cct, "Set the color temperature and intensity"},
+	{"cctcal", &cmd_cct_calibrate, "Calibrate and save the warm and cool LED groups"},
+	{"calupload", &cmd_calibration_upload, "Upload and save the LED color calibration"},
+	{"calread", &cmd_calibration_read, "Display the LED color calibration"},
+	{"calreset", &cmd_calibration_reset, "Reset and save the LED color calibration"},
+	{"hsv", &cmd_set_hsv, "Fade the RGB LEDs to an HSV color"},
+	{"hsl", &cmd_set_hsl, "Fade the RGB LEDs to an HSL color"},
+	{"pcastat", &cmd_pca9685_status, "Display PWM expander bus time"},
+	{"busaddr", &cmd_set_bus_address, "Set and save the lamp bus address and groups"},
+	{"busstat", &cmd_bus_status, "Display the lamp bus address and counters"},
+	{"sync", &cmd_clock_status, "Display the lamp bus clock sync"},
+	{"telem", &cmd_telemetry, "Start or stop streaming binary telemetry frames"},
+	{"jitter", &cmd_jitter, "Display and clear the interrupt jitter histograms"},
+	{"luxrate", &cmd_set_lux_rate, "Set the bounds of the lux sampling interval"},
+	{"luxstat", &cmd_lux_rate_status, "Display the lux sampling rate and counters"},
+	{"luxcurve", &cmd_lux_curve_upload, "Upload and save the lux response curve"},
+	{"luxcurveread", &cmd_lux_curve_read, "Display the lux response curve"},
+	{"knobon", &cmd_knob_on, "Let the dimmer knob set the master dimmer"},
+	{"knoboff", &cmd_knob_off, "Stop the dimmer knob from setting the master dimmer"},
+	{"knobstat", &cmd_knob_status, "Display the dimmer knob reading and counters"},
+	{"derate", &cmd_derate, "Set the thermal derating curve of the power budget"},
+	{"chanpower", &cmd_channel_power, "Set the power an LED draws at full duty"},
+	{"thermstat", &cmd_thermal_status, "Display the temperature, power budget and limit"},
+	{"energy", &cmd_energy_read, "Display the energy used in each of the last hours"},
+	{"timeset", &cmd_time_set, "Set the time of day kept by the RTC"},
+	{"schedule", &cmd_schedule_upload, "Upload the daily color temperature schedule"},
+	{"schedread", &cmd_schedule_read, "Display the time, the daily schedule and its target"},
+	{"schedon", &cmd_schedule_on, "Let the daily schedule set the color temperature"},
+	{"schedoff", &cmd_schedule_off, "Stop the daily schedule"},
 	{"help", &cmd_help, ""},
 	{"", 0, ""}
 };
@@ -221,30 +331,13 @@ void cmd_led_on(void)
 //*****************************************************************************
 void cmd_set_brightness(void)
 {
-	static const size_t numLeds = sizeof(ledList) / sizeof(ledList[1]); // TODO: Obsolete
-	
 	char buffer[UART_RX_BUFFER_SIZE];
   uint32_t led_type;
 	uint8_t led_brightness;
 	
 	// Get led type
-	UARTprintf("Enter LED type: ");
-	UARTgets(buffer, UART_RX_BUFFER_SIZE);
-	bool foundMatch = false;
-	for (size_t i = 0; i < numLeds; i++)
-	{
-		if (strcmp(ledList[i].name,buffer) == 0)
-		{
-			foundMatch = true;
-			led_type = ledList[i].type;
-		}			
-	}
-	
-	if (!foundMatch)
-	{
-		UARTprintf("Invalid LED type\n");
+	if (!cmd_led_type_prompt(&led_type))
 		return;
-	}
 	
 	// Get led brightness
 	UARTprintf("Enter LED brightness: ");
@@ -322,7 +415,8 @@ void cmd_set_lux_sensitivity(void)
 
 //*****************************************************************************
 //
-//! Command to read lux value
+//! Command to read lux value. A new sample is taken if the latest is older
+//! than CMD_LUX_MAX_AGE_MS.
 //! 
 //! \param None.
 //!
@@ -330,16 +424,34 @@ void cmd_set_lux_sensitivity(void)
 //*****************************************************************************
 void cmd_lux_read(void)
 {
-	char buffer[UART_RX_BUFFER_SIZE];
-	uint32_t lux = 0;
+	struct lux_cache_sample sample;
+	uint32_t count, start_ms, status;
 	
-	if (tsl2591_lux_get(&lux) == 0)
+	// The sampler owns the sensor. Ask it for a new sample if the latest is
+	// too old, rather than reading the sensor from here.
+	count = lux_cache_count_get();
+	status = lux_cache_get(&sample, CMD_LUX_MAX_AGE_MS);
+	if (status != LUX_CACHE_FRESH)
 	{
-		sprintf(buffer, "Lux: %d\n", lux);	
-	} else
+		led_lux_sample_request();
+		start_ms = clock_local_ms_get();
+		while (lux_cache_count_get() == count && 
+			clock_local_ms_get() - start_ms < CMD_LUX_TIMEOUT_MS){}
+		status = lux_cache_get(&sample, CMD_LUX_MAX_AGE_MS);
+	}
+	
+	if (status == LUX_CACHE_EMPTY)
 	{
-		UARTprintf("Enable to read lux sensor.\n");
+		UARTprintf("Unable to read lux sensor.\n");
+		return;
 	}
+	
+	UARTprintf("Lux: %d%s\n", sample.lux, sample.overflow ? " (saturated)" : "");
+	UARTprintf("Channels: %d %d\n", sample.ch0, sample.ch1);
+	UARTprintf("Gain mode: %d\n", sample.gain >> 4);
+	UARTprintf("Integration: %d ms\n", TSL2591_ATIME_MS(sample.atime));
+	UARTprintf("Age: %d ms%s\n", clock_local_ms_get() - sample.time_ms,
+		status == LUX_CACHE_STALE ? " (stale)" : "");
 }
 
 //*****************************************************************************
@@ -354,3 +466,1116 @@ void cmd_led_update_hw(void)
 {
 	led_update_hw_start();
 }
+
+//*****************************************************************************
+//
+//! Command to enable the DMX512 input
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_dmx_on(void)
+{
+	dmx_enable_set(true);
+}
+
+//*****************************************************************************
+//
+//! Command to disable the DMX512 input
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_dmx_off(void)
+{
+	dmx_enable_set(false);
+}
+
+//*****************************************************************************
+//
+//! Command to set the DMX512 start address
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_set_dmx_address(void)
+{
+	char buffer[UART_RX_BUFFER_SIZE];
+	uint32_t address;
+	
+	// Get start address
+	UARTprintf("Enter start address (1-%d): ", DMX_NUM_SLOTS);
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	address = strtol(buffer, NULL, 10);
+	
+	if (address < 1 || address > DMX_NUM_SLOTS)
+	{
+		UARTprintf("Invalid start address\n");
+		return;
+	}
+	
+	dmx_start_address_set(address);
+}
+
+//*****************************************************************************
+//
+//! Command to set all pixels of the LED strip to the same color
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_pixel_fill(void)
+{
+	char buffer[UART_RX_BUFFER_SIZE];
+	uint8_t r, g, b, w = 0;
+	
+	// Get color
+	UARTprintf("Enter red: ");
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	r = atoi(buffer);
+	UARTprintf("Enter green: ");
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	g = atoi(buffer);
+	UARTprintf("Enter blue: ");
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	b = atoi(buffer);
+#if PIXEL_CHANNELS == 4
+	UARTprintf("Enter white: ");
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	w = atoi(buffer);
+#endif
+	
+	pixel_fill(PIXEL_PACK(r, g, b, w));
+	pixel_show();
+}
+
+//*****************************************************************************
+//
+//! Command to set the number of pixels on the LED strip
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_set_pixel_count(void)
+{
+	char buffer[UART_RX_BUFFER_SIZE];
+	uint32_t num_pixels;
+	
+	// Get number of pixels
+	UARTprintf("Enter number of pixels (max %d): ", PIXEL_MAX_PIXELS);
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	num_pixels = strtol(buffer, NULL, 10);
+	
+	pixel_num_pixels_set(num_pixels);
+}
+
+//*****************************************************************************
+//
+//! Command to print the LED strip encoding statistics
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_pixel_status(void)
+{
+	uint32_t num_pixels = pixel_num_pixels_get();
+	uint32_t cycles = pixel_encode_cycles_get();
+	
+	UARTprintf("Pixels: %d\n", num_pixels);
+	UARTprintf("Encode cycles: %d (%d per pixel)\n", cycles, 
+		num_pixels ? cycles / num_pixels : 0);
+	UARTprintf("Over budget: %d\n", pixel_budget_overrun_count_get());
+}
+
+//*****************************************************************************
+//
+//! Prompts for an LED type and looks it up
+//! 
+//! \param led_type is set to the LED type entered
+//!
+//! \return true if a valid LED type was entered, false otherwise
+// 
+//*****************************************************************************
+bool cmd_led_type_prompt(uint32_t *led_type)
+{
+	static const size_t numLeds = sizeof(ledList) / sizeof(ledList[1]); // TODO: Obsolete
+	
+	char buffer[UART_RX_BUFFER_SIZE];
+	
+	UARTprintf("Enter LED type: ");
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	for (size_t i = 0; i < numLeds; i++)
+	{
+		if (strcmp(ledList[i].name,buffer) == 0)
+		{
+			*led_type = ledList[i].type;
+			return true;
+		}			
+	}
+	
+	UARTprintf("Invalid LED type\n");
+	return false;
+}
+
+//*****************************************************************************
+//
+//! Command to show an LED in the overlay layer. The overlay is mixed over the
+//! current scene without changing it.
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_set_overlay(void)
+{
+	char buffer[UART_RX_BUFFER_SIZE];
+	uint32_t led_type, brightness, opacity;
+	
+	if (!cmd_led_type_prompt(&led_type))
+		return;
+	
+	UARTprintf("Enter LED brightness: ");
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	brightness = strtol(buffer, NULL, 10);
+	
+	UARTprintf("Enter opacity (0-%d): ", LED_OPACITY_MAX);
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	opacity = strtol(buffer, NULL, 10);
+	
+	led_update_begin();
+	led_layer_brightness_set(LED_LAYER_OVERLAY, led_type, brightness);
+	led_layer_opacity_set(LED_LAYER_OVERLAY, opacity);
+	led_layer_enable_set(LED_LAYER_OVERLAY, true);
+	led_update_end();
+}
+
+//*****************************************************************************
+//
+//! Command to remove the overlay layer
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_overlay_off(void)
+{
+	led_layer_enable_set(LED_LAYER_OVERLAY, false);
+	led_update_hw_start();
+}
+
+//*****************************************************************************
+//
+//! Command to set the master dimmer level
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_set_dimmer(void)
+{
+	char buffer[UART_RX_BUFFER_SIZE];
+	uint32_t level;
+	
+	UARTprintf("Enter dimmer level (0-255): ");
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	level = strtol(buffer, NULL, 10);
+	
+	led_master_dimmer_set(level);
+}
+
+//*****************************************************************************
+//
+//! Command to upload a keyframe sequence and play it. Each key is entered on
+//! one line as its duration in ms, LED index, target brightness and easing.
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_sequence_load(void)
+{
+	static struct timeline_key keys[TIMELINE_MAX_KEYS];
+	
+	char buffer[UART_RX_BUFFER_SIZE];
+	char *next;
+	uint32_t num_keys, layer;
+	bool loop;
+	
+	UARTprintf("Enter layer (0-%d): ", LED_NUM_LAYERS - 1);
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	layer = strtol(buffer, NULL, 10);
+	
+	UARTprintf("Loop (0-1): ");
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	loop = strtol(buffer, NULL, 10) != 0;
+	
+	UARTprintf("Enter number of keys (max %d): ", TIMELINE_MAX_KEYS);
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	num_keys = strtol(buffer, NULL, 10);
+	
+	if (num_keys == 0 || num_keys > TIMELINE_MAX_KEYS)
+	{
+		UARTprintf("Invalid number of keys\n");
+		return;
+	}
+	
+	UARTprintf("Easing: 0 linear, 1 in, 2 out, 3 in-out, 4 step\n");
+	for (uint32_t i = 0; i < num_keys; i++)
+	{
+		UARTprintf("Key %d (ms led target easing): ", i);
+		UARTgets(buffer, UART_RX_BUFFER_SIZE);
+		keys[i].duration_ms = strtoul(buffer, &next, 10);
+		keys[i].led_type = strtol(next, &next, 10);
+		keys[i].target = strtol(next, &next, 10);
+		keys[i].easing = strtol(next, NULL, 10);
+		keys[i].reserved = 0;
+	}
+	
+	if (!timeline_load(keys, num_keys, layer, loop))
+		UARTprintf("Invalid sequence\n");
+}
+
+//*****************************************************************************
+//
+//! Command to play one of the built in sequences
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_sequence_play(void)
+{
+	char buffer[UART_RX_BUFFER_SIZE];
+	uint32_t sequence;
+	
+	UARTprintf("Enter sequence (0 sunrise, 1 pulse, 2 chase): ");
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	sequence = strtol(buffer, NULL, 10);
+	
+	if (!timeline_sequence_play(sequence))
+		UARTprintf("Invalid sequence\n");
+}
+
+//*****************************************************************************
+//
+//! Command to stop the playing sequence
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_sequence_stop(void)
+{
+	timeline_stop();
+}
+
+//*****************************************************************************
+//
+//! Command to set the color temperature and intensity of the lamp
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_set_cct(void)
+{
+	char buffer[UART_RX_BUFFER_SIZE];
+	uint32_t kelvin, intensity;
+	
+	UARTprintf("Enter color temperature (%d-%d K): ", CCT_MIN_KELVIN, CCT_MAX_KELVIN);
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	kelvin = strtol(buffer, NULL, 10);
+	
+	UARTprintf("Enter intensity (0-%d): ", CCT_MAX_INTENSITY);
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	intensity = strtol(buffer, NULL, 10);
+	
+	cct_set(kelvin, intensity);
+}
+
+//*****************************************************************************
+//
+//! Command to calibrate the color temperature and light output of the warm
+//! and cool LED groups. The calibration is saved.
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_cct_calibrate(void)
+{
+	char buffer[UART_RX_BUFFER_SIZE];
+	uint32_t warm_kelvin, cool_kelvin, warm_lumens, cool_lumens;
+	
+	UARTprintf("Enter warm LED color temperature (K): ");
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	warm_kelvin = strtol(buffer, NULL, 10);
+	
+	UARTprintf("Enter warm LED light output: ");
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	warm_lumens = strtol(buffer, NULL, 10);
+	
+	UARTprintf("Enter cool LED color temperature (K): ");
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	cool_kelvin = strtol(buffer, NULL, 10);
+	
+	UARTprintf("Enter cool LED light output: ");
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	cool_lumens = strtol(buffer, NULL, 10);
+	
+	if (!cct_calibrate(warm_kelvin, cool_kelvin, warm_lumens, cool_lumens))
+	{
+		UARTprintf("Invalid calibration\n");
+		return;
+	}
+	
+	if (!cct_save())
+		UARTprintf("Unable to save CCT calibration\n");
+}
+
+//*****************************************************************************
+//
+//! Prompts for a line of values separated by spaces
+//! 
+//! \param prompt is printed before reading the line
+//! \param values is set to the values entered. Missing values are set to 0.
+//! \param num_values is the number of values to read
+//!
+//! \return None.
+// 
+//*****************************************************************************
+void cmd_values_prompt(const char *prompt, int32_t *values, uint32_t num_values)
+{
+	char buffer[UART_RX_BUFFER_SIZE];
+	char *next = buffer;
+	
+	UARTprintf(prompt);
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	for (uint32_t i = 0; i < num_values; i++)
+		values[i] = strtol(next, &next, 10);
+}
+
+//*****************************************************************************
+//
+//! Command to upload the LED color calibration. The matrix coefficients and
+//! gains are entered in 1/256 steps, so 256 is 1.0. The calibration is saved
+//! once uploaded.
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_calibration_upload(void)
+{
+	int32_t values[CALIB_CHANNELS];
+	
+	UARTprintf("Enter %d values per line, in LED index order\n", CALIB_CHANNELS);
+	for (uint32_t row = 0; row < CALIB_CHANNELS; row++)
+	{
+		UARTprintf("Matrix row %d ", row);
+		cmd_values_prompt(": ", values, CALIB_CHANNELS);
+		for (uint32_t column = 0; column < CALIB_CHANNELS; column++)
+			calib_matrix_set(row, column, values[column]);
+	}
+	
+	cmd_values_prompt("Gains: ", values, CALIB_CHANNELS);
+	for (uint32_t i = 0; i < CALIB_CHANNELS; i++)
+		calib_gain_set(i, values[i] < 0 ? 0 : values[i]);
+	
+	cmd_values_prompt("Offsets: ", values, CALIB_CHANNELS);
+	for (uint32_t i = 0; i < CALIB_CHANNELS; i++)
+		calib_offset_set(i, values[i]);
+	
+	if (!calib_save())
+		UARTprintf("Unable to save calibration\n");
+	
+	led_output_update();
+}
+
+//*****************************************************************************
+//
+//! Command to print the LED color calibration in the format used by the
+//! upload command
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_calibration_read(void)
+{
+	for (uint32_t row = 0; row < CALIB_CHANNELS; row++)
+	{
+		UARTprintf("Matrix row %d:", row);
+		for (uint32_t column = 0; column < CALIB_CHANNELS; column++)
+			UARTprintf(" %d", calib_matrix_get(row, column));
+		UARTprintf("\n");
+	}
+	
+	UARTprintf("Gains:");
+	for (uint32_t i = 0; i < CALIB_CHANNELS; i++)
+		UARTprintf(" %d", calib_gain_get(i));
+	UARTprintf("\nOffsets:");
+	for (uint32_t i = 0; i < CALIB_CHANNELS; i++)
+		UARTprintf(" %d", calib_offset_get(i));
+	UARTprintf("\n");
+}
+
+//*****************************************************************************
+//
+//! Command to reset the LED color calibration to the identity
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_calibration_reset(void)
+{
+	calib_reset();
+	if (!calib_save())
+		UARTprintf("Unable to save calibration\n");
+	
+	led_output_update();
+}
+
+//*****************************************************************************
+//
+//! Prompts for a color as a hue, saturation and level, and a fade time
+//! 
+//! \param level_name is the name of the third component
+//! \param hue is set to the hue, from 0 to COLOR_HUE_MAX
+//! \param saturation is set to the saturation
+//! \param level is set to the third component
+//! \param duration_ms is set to the fade time
+//!
+//! \return true if a valid color was entered, false otherwise
+// 
+//*****************************************************************************
+bool cmd_color_prompt(const char *level_name, uint32_t *hue, uint32_t *saturation, uint32_t *level, uint32_t *duration_ms)
+{
+	char buffer[UART_RX_BUFFER_SIZE];
+	uint32_t degrees;
+	
+	UARTprintf("Enter hue (0-359): ");
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	degrees = strtol(buffer, NULL, 10);
+	
+	UARTprintf("Enter saturation (0-%d): ", COLOR_LEVEL_MAX);
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	*saturation = strtol(buffer, NULL, 10);
+	
+	UARTprintf("Enter %s (0-%d): ", level_name, COLOR_LEVEL_MAX);
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	*level = strtol(buffer, NULL, 10);
+	
+	UARTprintf("Enter fade time (ms): ");
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	*duration_ms = strtol(buffer, NULL, 10);
+	
+	if (degrees >= 360 || *saturation > COLOR_LEVEL_MAX || *level > COLOR_LEVEL_MAX)
+	{
+		UARTprintf("Invalid color\n");
+		return false;
+	}
+	
+	*hue = degrees * COLOR_HUE_MAX / 360;
+	return true;
+}
+
+//*****************************************************************************
+//
+//! Command to fade the RGB LEDs to an HSV color through hue space
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_set_hsv(void)
+{
+	uint32_t hue, saturation, value, duration_ms;
+	
+	if (!cmd_color_prompt("value", &hue, &saturation, &value, &duration_ms))
+		return;
+	
+	color_hsv_set(hue, saturation, value, duration_ms);
+}
+
+//*****************************************************************************
+//
+//! Command to fade the RGB LEDs to an HSL color through hue space
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_set_hsl(void)
+{
+	uint32_t hue, saturation, lightness, value, duration_ms;
+	
+	if (!cmd_color_prompt("lightness", &hue, &saturation, &lightness, &duration_ms))
+		return;
+	
+	color_hsl_to_hsv(saturation, lightness, &saturation, &value);
+	color_hsv_set(hue, saturation, value, duration_ms);
+}
+
+//*****************************************************************************
+//
+//! Command to print the bus time of the PCA9685 PWM expanders. A change of
+//! every channel is spread over several fade steps.
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_pca9685_status(void)
+{
+	uint32_t num_channels = pca9685_num_chips_get() * PCA9685_CHANNELS_PER_CHIP;
+	uint32_t estimate = pca9685_bus_time_estimate(num_channels);
+	
+	UARTprintf("Chips: %d\n", pca9685_num_chips_get());
+	UARTprintf("Last bus time: %d us\n", pca9685_bus_time_get());
+	UARTprintf("Max bus time: %d us\n", pca9685_max_bus_time_get());
+	if (estimate != 0)
+		UARTprintf("All %d channels: %d us\n", num_channels, estimate);
+}
+
+//*****************************************************************************
+//
+//! Command to set and save the lamp bus address and groups
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_set_bus_address(void)
+{
+	char buffer[UART_RX_BUFFER_SIZE];
+	uint32_t address, groups;
+	
+	// Get address
+	UARTprintf("Enter address (%d-%d, 0 for none): ", LAMPBUS_ADDR_MIN, LAMPBUS_ADDR_MAX);
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	address = strtol(buffer, NULL, 10);
+	
+	// Get group mask
+	UARTprintf("Enter group mask (0-255): ");
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	groups = strtol(buffer, NULL, 0);
+	
+	if (!lampbus_address_set(address, groups))
+		UARTprintf("Unable to set address\n");
+}
+
+//*****************************************************************************
+//
+//! Command to print the lamp bus address and counters
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_bus_status(void)
+{
+	struct lampbus_stats stats;
+	
+	lampbus_stats_get(&stats);
+	UARTprintf("Address: %d\n", lampbus_address_get());
+	UARTprintf("Groups: 0x%02x\n", lampbus_groups_get());
+	UARTprintf("Accepted: %d\n", stats.accepted);
+	UARTprintf("Ignored: %d\n", stats.ignored);
+	UARTprintf("CRC errors: %d\n", stats.crc_errors);
+	UARTprintf("Overflows: %d\n", stats.overflows);
+}
+
+//*****************************************************************************
+//
+//! Command to print the state of the lamp bus clock
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_clock_status(void)
+{
+	UARTprintf("Synced: %s\n", clock_synced() ? "yes" : "no");
+	UARTprintf("Bus time: %u us\n", clock_sync_get());
+	UARTprintf("Last offset: %d us\n", clock_offset_get());
+	UARTprintf("Rate: %d ppm\n", clock_rate_ppm_get());
+}
+
+//*****************************************************************************
+//
+//! Command to start or stop streaming telemetry frames. Stopping prints the
+//! number of frames sent and dropped.
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_telemetry(void)
+{
+	char buffer[UART_RX_BUFFER_SIZE];
+	uint32_t period_ms;
+	
+	UARTprintf("Enter period in ms (0 to stop): ");
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	period_ms = strtol(buffer, NULL, 10);
+	
+	if (period_ms == 0)
+	{
+		telemetry_stop();
+		UARTprintf("Sent: %d\n", telemetry_sent_count_get());
+		UARTprintf("Dropped: %d\n", telemetry_dropped_count_get());
+		return;
+	}
+	
+	telemetry_start(period_ms);
+}
+
+//*****************************************************************************
+//
+//! Command to print how late the periodic interrupt handlers ran since the
+//! last call, as a histogram per handler, and clear the histograms
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_jitter(void)
+{
+	struct irq_jitter jitter;
+	
+	for (uint32_t source = 0; source < IRQ_NUM_JITTER; source++)
+	{
+		irq_jitter_get(source, &jitter);
+		UARTprintf("%s: %d runs, max %d us late, %d triggered\n", irq_jitter_name_get(source),
+			jitter.count, jitter.max_us, jitter.triggered);
+		
+		for (uint32_t i = 0; i < IRQ_JITTER_BUCKETS; i++)
+		{
+			if (jitter.buckets[i] == 0)
+				continue;
+			
+			if (i == 0)
+				UARTprintf("  0 us: %d\n", jitter.buckets[i]);
+			else if (i == IRQ_JITTER_BUCKETS - 1)
+				UARTprintf("  >= %d us: %d\n", 1 << (i - 1), jitter.buckets[i]);
+			else
+				UARTprintf("  %d-%d us: %d\n", 1 << (i - 1), (1 << i) - 1, jitter.buckets[i]);
+		}
+	}
+	
+	irq_jitter_clear();
+}
+
+//*****************************************************************************
+//
+//! Command to set the bounds of the lux sampling interval
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_set_lux_rate(void)
+{
+	char buffer[UART_RX_BUFFER_SIZE];
+	uint32_t min_ms, max_ms;
+	
+	UARTprintf("Enter interval after a change in ms (%d-%d): ", LUX_SAMPLER_MIN_INTERVAL_MS, 
+		LUX_SAMPLER_MAX_INTERVAL_MS);
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	min_ms = strtol(buffer, NULL, 10);
+	
+	UARTprintf("Enter interval in stable light in ms (%d-%d): ", min_ms, LUX_SAMPLER_MAX_INTERVAL_MS);
+	UARTgets(buffer, UART_RX_BUFFER_SIZE);
+	max_ms = strtol(buffer, NULL, 10);
+	
+	if (!led_lux_rate_set(min_ms, max_ms))
+		UARTprintf("Invalid interval\n");
+}
+
+//*****************************************************************************
+//
+//! Command to print the lux sampling interval and counters
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_lux_rate_status(void)
+{
+	struct lux_sampler_stats stats;
+	uint32_t min_ms, max_ms;
+	
+	led_lux_rate_stats_get(&stats);
+	lux_sampler_bounds_get(&min_ms, &max_ms);
+	
+	UARTprintf("Bounds: %d-%d ms\n", min_ms, max_ms);
+	UARTprintf("Interval: %d ms\n", lux_sampler_interval_get());
+	UARTprintf("Integration: %d ms\n", TSL2591_ATIME_MS(lux_sampler_integration_get()));
+	UARTprintf("Samples: %d\n", stats.samples);
+	UARTprintf("Changes: %d\n", stats.changes);
+	UARTprintf("Overflows: %d\n", stats.overflows);
+	if (stats.elapsed_ms >= 1000)
+		UARTprintf("Samples per hour: %d\n", (uint32_t)((uint64_t)stats.samples * 3600000 / stats.elapsed_ms));
+}
+
+//*****************************************************************************
+//
+//! Command to upload the lux response curve. Each breakpoint is a lux and a
+//! brightness scale in 1/256 steps, so 256 is full brightness. The curve is
+//! saved once uploaded.
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_lux_curve_upload(void)
+{
+	struct lux_curve_point points[LUX_CURVE_MAX_POINTS];
+	int32_t values[2];
+	uint32_t num_points;
+	
+	cmd_values_prompt("Enter number of points: ", values, 1);
+	if (values[0] < 2 || values[0] > LUX_CURVE_MAX_POINTS)
+	{
+		UARTprintf("Number of points must be 2-%d\n", LUX_CURVE_MAX_POINTS);
+		return;
+	}
+	num_points = values[0];
+	
+	UARTprintf("Enter lux and scale per line, in increasing order of lux\n");
+	for (uint32_t i = 0; i < num_points; i++)
+	{
+		UARTprintf("Point %d ", i);
+		cmd_values_prompt(": ", values, 2);
+		if (values[0] < 0 || values[0] > LUX_CURVE_MAX_LUX)
+		{
+			UARTprintf("Lux must be 0-%d\n", LUX_CURVE_MAX_LUX);
+			return;
+		}
+		if (values[1] < 0 || values[1] > LUX_CURVE_MAX_SCALE)
+		{
+			UARTprintf("Scale must be 0-%d\n", LUX_CURVE_MAX_SCALE);
+			return;
+		}
+		if (i > 0 && (uint32_t)values[0] <= points[i - 1].lux)
+		{
+			UARTprintf("Lux must be above the lux of point %d\n", i - 1);
+			return;
+		}
+		points[i].lux = values[0];
+		points[i].scale = values[1];
+	}
+	
+	if (!led_lux_curve_set(points, num_points))
+	{
+		UARTprintf("Invalid curve\n");
+		return;
+	}
+	
+	if (!lux_curve_save())
+		UARTprintf("Unable to save lux curve\n");
+}
+
+//*****************************************************************************
+//
+//! Command to print the lux response curve in the format used by the upload
+//! command
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_lux_curve_read(void)
+{
+	struct lux_curve_point points[LUX_CURVE_MAX_POINTS];
+	uint32_t num_points = lux_curve_points_get(points);
+	
+	UARTprintf("Points: %d\n", num_points);
+	for (uint32_t i = 0; i < num_points; i++)
+		UARTprintf("Point %d: %d %d\n", i, points[i].lux, points[i].scale);
+}
+
+//*****************************************************************************
+//
+//! Command to let the dimmer knob set the master dimmer, and save it
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_knob_on(void)
+{
+	if (!dimmer_enable_set(true))
+		UARTprintf("Unable to save knob setting\n");
+}
+
+//*****************************************************************************
+//
+//! Command to stop the dimmer knob from setting the master dimmer, and save
+//! it
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_knob_off(void)
+{
+	if (!dimmer_enable_set(false))
+		UARTprintf("Unable to save knob setting\n");
+}
+
+//*****************************************************************************
+//
+//! Command to print the dimmer knob reading and counters
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_knob_status(void)
+{
+	UARTprintf("Enabled: %d\n", dimmer_enable_get());
+	UARTprintf("Reading: %d/%d\n", dimmer_raw_get(), DIMMER_MAX_RAW);
+	UARTprintf("Level: %d\n", dimmer_level_get());
+	UARTprintf("Interrupts: %d\n", dimmer_block_count_get());
+	UARTprintf("Levels set: %d\n", dimmer_update_count_get());
+}
+
+//*****************************************************************************
+//
+//! Command to set the thermal derating curve. The full power budget applies
+//! up to the knee temperature and falls in a straight line to the lowest
+//! budget at the max temperature.
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_derate(void)
+{
+	struct thermal_curve curve;
+	int32_t values[4];
+	
+	cmd_values_prompt("Enter knee C, max C, full mW, min mW: ", values, 4);
+	if (values[2] < 0 || values[3] < 0)
+	{
+		UARTprintf("Invalid curve\n");
+		return;
+	}
+	
+	curve.knee_c = values[0];
+	curve.max_c = values[1];
+	curve.full_mw = values[2];
+	curve.min_mw = values[3];
+	if (!thermal_curve_set(&curve))
+		UARTprintf("Invalid curve\n");
+}
+
+//*****************************************************************************
+//
+//! Command to set the power an LED draws at full duty, used to estimate the
+//! power of the lamp
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_channel_power(void)
+{
+	int32_t values[2];
+	
+	cmd_values_prompt("Enter LED and mW: ", values, 2);
+	if (values[0] < 0 || values[1] < 0 || !thermal_channel_mw_set(values[0], values[1]))
+		UARTprintf("Invalid LED or power\n");
+}
+
+//*****************************************************************************
+//
+//! Command to print the die temperature, the power budget and the limit
+//! applied to the LEDs
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_thermal_status(void)
+{
+	struct thermal_curve curve;
+	int32_t temp = thermal_temp_get();
+	
+	thermal_curve_get(&curve);
+	
+	UARTprintf("Temperature: %d.%d C\n", temp / 10, (temp < 0 ? -temp : temp) % 10);
+	UARTprintf("Curve: %d-%d C, %d-%d mW\n", curve.knee_c, curve.max_c, curve.full_mw, curve.min_mw);
+	UARTprintf("Budget: %d mW\n", thermal_budget_get());
+	UARTprintf("Power: %d mW\n", thermal_power_get());
+	UARTprintf("Scale: %d/%d\n", thermal_scale_get(), LED_OPACITY_MAX);
+	UARTprintf("Samples: %d\n", thermal_sample_count_get());
+}
+
+//*****************************************************************************
+//
+//! Command to print the energy log, oldest hour first, followed by the hour
+//! in progress
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_energy_read(void)
+{
+	struct energy_log log;
+	uint32_t first;
+	
+	energy_log_get(&log);
+	
+	UARTprintf("Hours: %d\n", log.hours);
+	UARTprintf("Total: %d Wh\n", (uint32_t)(log.total_mwh / 1000));
+	UARTprintf("Power: %d mW\n", energy_power_get());
+	
+	first = log.hours > ENERGY_NUM_BUCKETS ? log.hours - ENERGY_NUM_BUCKETS : 0;
+	for (uint32_t hour = first; hour < log.hours; hour++)
+		UARTprintf("Hour %d: %d mWh\n", hour, log.buckets[hour % ENERGY_NUM_BUCKETS]);
+	UARTprintf("Hour %d: %d mWh so far\n", log.hours, energy_hour_mwh_get());
+}
+
+//*****************************************************************************
+//
+//! Command to set the time of day kept by the RTC, used by the schedule
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_time_set(void)
+{
+	int32_t values[3];
+	
+	cmd_values_prompt("Enter hour, minute, second: ", values, 3);
+	if (values[0] < 0 || values[0] > 23 || values[1] < 0 || values[1] > 59 ||
+		values[2] < 0 || values[2] > 59)
+	{
+		UARTprintf("Invalid time\n");
+		return;
+	}
+	
+	schedule_time_set(values[0] * 3600 + values[1] * 60 + values[2]);
+}
+
+//*****************************************************************************
+//
+//! Command to upload the daily schedule. Each breakpoint is a time of day, a
+//! color temperature and an intensity. The lamp fades between breakpoints.
+//! The schedule is saved once uploaded.
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_schedule_upload(void)
+{
+	struct schedule_point points[SCHEDULE_MAX_POINTS];
+	int32_t values[4];
+	uint32_t num_points;
+	
+	cmd_values_prompt("Enter number of points: ", values, 1);
+	if (values[0] < 1 || values[0] > SCHEDULE_MAX_POINTS)
+	{
+		UARTprintf("Number of points must be 1-%d\n", SCHEDULE_MAX_POINTS);
+		return;
+	}
+	num_points = values[0];
+	
+	UARTprintf("Enter hour, minute, kelvin and intensity per line, in order of time\n");
+	for (uint32_t i = 0; i < num_points; i++)
+	{
+		UARTprintf("Point %d ", i);
+		cmd_values_prompt(": ", values, 4);
+		if (values[0] < 0 || values[0] > 23 || values[1] < 0 || values[1] > 59 ||
+			values[2] < 0 || values[2] > UINT16_MAX || values[3] < 0 || values[3] > CCT_MAX_INTENSITY)
+		{
+			UARTprintf("Invalid point\n");
+			return;
+		}
+		points[i].minute = values[0] * 60 + values[1];
+		points[i].kelvin = values[2];
+		points[i].intensity = values[3];
+		points[i].reserved = 0;
+	}
+	
+	if (!schedule_set(points, num_points))
+	{
+		UARTprintf("Invalid schedule\n");
+		return;
+	}
+	
+	if (!schedule_save())
+		UARTprintf("Unable to save schedule\n");
+}
+
+//*****************************************************************************
+//
+//! Command to print the time of day, the daily schedule in the format used
+//! by the upload command and its present target
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_schedule_read(void)
+{
+	struct schedule_point points[SCHEDULE_MAX_POINTS];
+	uint32_t num_points = schedule_points_get(points);
+	uint32_t seconds = schedule_time_get();
+	uint32_t kelvin, intensity;
+	
+	schedule_target_get(seconds / 60, &kelvin, &intensity);
+	
+	UARTprintf("Time: %02d:%02d:%02d\n", seconds / 3600, seconds / 60 % 60, seconds % 60);
+	UARTprintf("Enabled: %d\n", schedule_enable_get());
+	UARTprintf("Target: %d K, %d\n", kelvin, intensity);
+	UARTprintf("Targets set: %d\n", schedule_update_count_get());
+	UARTprintf("Points: %d\n", num_points);
+	for (uint32_t i = 0; i < num_points; i++)
+		UARTprintf("Point %d: %d %d %d %d\n", i, points[i].minute / 60, points[i].minute % 60,
+			points[i].kelvin, points[i].intensity);
+}
+
+//*****************************************************************************
+//
+//! Command to let the daily schedule set the color temperature and
+//! intensity. The setting is saved.
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_schedule_on(void)
+{
+	schedule_enable_set(true);
+	if (!schedule_save())
+		UARTprintf("Unable to save schedule\n");
+}
+
+//*****************************************************************************
+//
+//! Command to stop the daily schedule. The setting is saved.
+//! 
+//! \param None.
+//!
+// 
+//*****************************************************************************
+void cmd_schedule_off(void)
+{
+	schedule_enable_set(false);
+	if (!schedule_save())
+		UARTprintf("Unable to save schedule\n");
+}
@@ -0,0 +1,374 @@
+//*****************************************************************************
+//
+// color.c - HSV/HSL color conversion and hue fades for the RGB LEDs
+//
+// Colors are converted with integer math only. The hue circle is split into
+// six sextants of 256 steps, so the sextant and the position within it are
+// a shift and a mask. In each sextant one channel is at the maximum level,
+// one at the minimum and one ramps between them. A table selects which
+// channel gets which level instead of a branch per sextant.
+//
+// Fades between colors are interpolated in HSV space, taking the shorter
+// way around the hue circle, so the color stays saturated instead of
+// passing through grey as a per channel fade does. The fade is stepped from
+// the LED fade timer and writes the base layer.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "inc/hw_ints.h"
+#include "driverlib/interrupt.h"
+#include "led.h"
+#include "color.h"
+
+//*****************************************************************************
+//
+// Defines used to configure the color conversion
+//
+//*****************************************************************************
+#define COLOR_SEXTANT_SHIFT   8      // Hue bits within one sextant
+#define COLOR_SEXTANT_MASK    ((1 << COLOR_SEXTANT_SHIFT) - 1)
+#define COLOR_PROGRESS_MAX    0xFFFF // Progress through a fade when complete
+
+//
+// Levels a channel can take within a sextant
+//
+#define COLOR_MAX     0
+#define COLOR_RISING  1
+#define COLOR_FALLING 2
+#define COLOR_MIN     3
+
+//*****************************************************************************
+//
+// Level of the red, green and blue channels in each sextant, starting from
+// red at hue 0
+//
+//*****************************************************************************
+static const uint8_t _sextant_levels[6][3] =
+{
+	{COLOR_MAX, COLOR_RISING, COLOR_MIN},     // Red to yellow
+	{COLOR_FALLING, COLOR_MAX, COLOR_MIN},    // Yellow to green
+	{COLOR_MIN, COLOR_MAX, COLOR_RISING},     // Green to cyan
+	{COLOR_MIN, COLOR_FALLING, COLOR_MAX},    // Cyan to blue
+	{COLOR_RISING, COLOR_MIN, COLOR_MAX},     // Blue to magenta
+	{COLOR_MAX, COLOR_MIN, COLOR_FALLING},    // Magenta to red
+};
+
+//*****************************************************************************
+//
+// State of the hue fade. The start and target are HSV colors.
+//
+//*****************************************************************************
+struct color_hsv
+{
+	int32_t hue;
+	int32_t saturation;
+	int32_t value;
+};
+
+static struct color_hsv _start;
+static struct color_hsv _target;
+static int32_t _hue_change;    // Signed change of hue, the shorter way around
+static uint32_t _elapsed;      // Time into the fade, in ms
+static uint32_t _duration;     // Length of the fade, in ms
+static uint32_t _rate;         // Progress per ms, in 1/65536 steps
+static bool _fading;
+
+//*****************************************************************************
+//
+// Prototypes for private functions
+//
+//*****************************************************************************
+static void color_chroma_to_rgb(uint32_t hue, uint32_t max, uint32_t chroma, uint8_t rgb[3]);
+static uint32_t color_scale(uint32_t level, uint32_t scale);
+static void color_output(const struct color_hsv *color);
+static void color_fade_current(struct color_hsv *color);
+
+//*****************************************************************************
+//
+//! Converts an HSV color to RGB
+//!
+//! \param hue is the hue from 0 to COLOR_HUE_MAX. 0 is red, COLOR_HUE_MAX / 3
+//! is green and 2 * COLOR_HUE_MAX / 3 is blue.
+//! \param saturation is the saturation from 0 to COLOR_LEVEL_MAX
+//! \param value is the value from 0 to COLOR_LEVEL_MAX
+//! \param rgb is set to the red, green and blue levels
+//!
+//! \return None.
+//
+//*****************************************************************************
+void color_hsv_to_rgb(uint32_t hue, uint32_t saturation, uint32_t value, uint8_t rgb[3])
+{
+	if (saturation > COLOR_LEVEL_MAX)
+		saturation = COLOR_LEVEL_MAX;
+	if (value > COLOR_LEVEL_MAX)
+		value = COLOR_LEVEL_MAX;
+
+	color_chroma_to_rgb(hue, value, color_scale(value, saturation), rgb);
+}
+
+//*****************************************************************************
+//
+//! Converts an HSL color to RGB
+//!
+//! \param hue is the hue from 0 to COLOR_HUE_MAX
+//! \param saturation is the saturation from 0 to COLOR_LEVEL_MAX
+//! \param lightness is the lightness from 0 to COLOR_LEVEL_MAX
+//! \param rgb is set to the red, green and blue levels
+//!
+//! \return None.
+//
+//*****************************************************************************
+void color_hsl_to_rgb(uint32_t hue, uint32_t saturation, uint32_t lightness, uint8_t rgb[3])
+{
+	uint32_t value;
+
+	color_hsl_to_hsv(saturation, lightness, &saturation, &value);
+	color_hsv_to_rgb(hue, saturation, value, rgb);
+}
+
+//*****************************************************************************
+//
+//! Converts the saturation and lightness of an HSL color to the saturation
+//! and value of the same color in HSV. The hue is the same in both.
+//!
+//! \param saturation is the HSL saturation from 0 to COLOR_LEVEL_MAX
+//! \param lightness is the lightness from 0 to COLOR_LEVEL_MAX
+//! \param hsv_saturation is set to the HSV saturation
+//! \param value is set to the value
+//!
+//! \return None.
+//
+//*****************************************************************************
+void color_hsl_to_hsv(uint32_t saturation, uint32_t lightness, uint32_t *hsv_saturation, uint32_t *value)
+{
+	uint32_t headroom;
+
+	if (saturation > COLOR_LEVEL_MAX)
+		saturation = COLOR_LEVEL_MAX;
+	if (lightness > COLOR_LEVEL_MAX)
+		lightness = COLOR_LEVEL_MAX;
+
+	// The maximum level is above the lightness by the saturation times the
+	// distance to black or white, whichever is closer
+	headroom = lightness < COLOR_LEVEL_MAX - lightness ? lightness : COLOR_LEVEL_MAX - lightness;
+	*value = lightness + color_scale(headroom, saturation);
+	*hsv_saturation = *value ? (2 * COLOR_LEVEL_MAX * (*value - lightness) + *value / 2) / *value : 0;
+	if (*hsv_saturation > COLOR_LEVEL_MAX)
+		*hsv_saturation = COLOR_LEVEL_MAX;
+}
+
+//*****************************************************************************
+//
+//! Fades the RGB LEDs to an HSV color
+//!
+//! \param hue is the hue from 0 to COLOR_HUE_MAX
+//! \param saturation is the saturation from 0 to COLOR_LEVEL_MAX
+//! \param value is the value from 0 to COLOR_LEVEL_MAX
+//! \param duration_ms is the length of the fade. With 0, the color is set
+//! with the regular per channel fade.
+//!
+//! The fade starts from the last color set with this function.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void color_hsv_set(uint32_t hue, uint32_t saturation, uint32_t value, uint32_t duration_ms)
+{
+	IntDisable(INT_TIMER1A);
+
+	// Continue from the color shown if a fade is cut short
+	if (_fading)
+		color_fade_current(&_start);
+	else
+		_start = _target;
+
+	_target.hue = hue % COLOR_HUE_MAX;
+	_target.saturation = saturation > COLOR_LEVEL_MAX ? COLOR_LEVEL_MAX : saturation;
+	_target.value = value > COLOR_LEVEL_MAX ? COLOR_LEVEL_MAX : value;
+
+	// Take the shorter way around the hue circle. A grey end has no hue, so
+	// the hue of the other end is kept instead of sweeping the circle.
+	if (_start.saturation == 0 || _start.value == 0)
+		_start.hue = _target.hue;
+	if (_target.saturation == 0 || _target.value == 0)
+		_target.hue = _start.hue;
+	_hue_change = _target.hue - _start.hue;
+	if (_hue_change > COLOR_HUE_MAX / 2)
+		_hue_change -= COLOR_HUE_MAX;
+	if (_hue_change < -COLOR_HUE_MAX / 2)
+		_hue_change += COLOR_HUE_MAX;
+
+	_elapsed = 0;
+	_duration = duration_ms;
+	_rate = duration_ms ? (COLOR_PROGRESS_MAX << 16) / duration_ms : 0;
+	_fading = duration_ms != 0;
+
+	IntEnable(INT_TIMER1A);
+
+	led_update_begin();
+	if (!_fading)
+		color_output(&_target);
+	led_update_end();
+}
+
+//*****************************************************************************
+//
+//! Stops the hue fade, leaving the LEDs at the color shown
+//!
+//! \return None.
+//
+//*****************************************************************************
+void color_fade_stop(void)
+{
+	_fading = false;
+}
+
+//*****************************************************************************
+//
+//! Gets whether a hue fade is running
+//!
+//! \return true if a hue fade is running, false otherwise
+//
+//*****************************************************************************
+bool color_fade_active(void)
+{
+	return _fading;
+}
+
+//*****************************************************************************
+//
+//! Advances the hue fade and writes the new color to the base layer
+//!
+//! \param elapsed_ms is the time since the last tick
+//! \param led_mask gets the bits of the red, green and blue LEDs set, as
+//! 1 << led_type, when they are written
+//!
+//! This function is called from the LED fade timer. The caller commits the
+//! change afterwards, see led_update_hw_start().
+//!
+//! \return true if the fade is still running, false otherwise
+//
+//*****************************************************************************
+bool color_fade_tick(uint32_t elapsed_ms, uint32_t *led_mask)
+{
+	struct color_hsv color;
+
+	if (!_fading)
+		return false;
+
+	*led_mask |= (1u << LED_ONBOARD_RED) | (1u << LED_ONBOARD_GREEN) | (1u << LED_ONBOARD_BLUE);
+
+	_elapsed += elapsed_ms;
+	if (_elapsed >= _duration)
+	{
+		_fading = false;
+		color_output(&_target);
+		return false;
+	}
+
+	color_fade_current(&color);
+	color_output(&color);
+
+	return true;
+}
+
+//*****************************************************************************
+//
+//! Computes the color shown at the current time of the hue fade
+//!
+//! \param color is set to the current color
+//
+//*****************************************************************************
+static void color_fade_current(struct color_hsv *color)
+{
+	// elapsed * rate stays within 32 bits since elapsed is below the duration
+	int32_t progress = (_elapsed * _rate) >> 16;
+
+	color->hue = (_start.hue + ((_hue_change * progress) >> 16) + COLOR_HUE_MAX) % COLOR_HUE_MAX;
+	color->saturation = _start.saturation + (((_target.saturation - _start.saturation) * progress) >> 16);
+	color->value = _start.value + (((_target.value - _start.value) * progress) >> 16);
+}
+
+//*****************************************************************************
+//
+//! Converts a hue, maximum level and chroma to RGB
+//!
+//! \param hue is the hue from 0 to COLOR_HUE_MAX
+//! \param max is the level of the strongest channel
+//! \param chroma is the difference between the strongest and weakest channel
+//! \param rgb is set to the red, green and blue levels
+//
+//*****************************************************************************
+static void color_chroma_to_rgb(uint32_t hue, uint32_t max, uint32_t chroma, uint8_t rgb[3])
+{
+	uint8_t levels[4];
+	const uint8_t *sextant;
+	uint32_t ramp;
+
+	hue %= COLOR_HUE_MAX;
+	sextant = _sextant_levels[hue >> COLOR_SEXTANT_SHIFT];
+	ramp = (chroma * (hue & COLOR_SEXTANT_MASK) + (1 << (COLOR_SEXTANT_SHIFT - 1))) >> COLOR_SEXTANT_SHIFT;
+
+	levels[COLOR_MAX] = max;
+	levels[COLOR_MIN] = max - chroma;
+	levels[COLOR_RISING] = max - chroma + ramp;
+	levels[COLOR_FALLING] = max - ramp;
+
+	rgb[0] = levels[sextant[0]];
+	rgb[1] = levels[sextant[1]];
+	rgb[2] = levels[sextant[2]];
+}
+
+//*****************************************************************************
+//
+//! Scales a level by another, both from 0 to COLOR_LEVEL_MAX, with rounding
+//!
+//! \return level * scale / COLOR_LEVEL_MAX
+//
+//*****************************************************************************
+static uint32_t color_scale(uint32_t level, uint32_t scale)
+{
+	// Multiplying by 257 / 65536 divides by 255 for products up to 255 * 255
+	return (level * scale * 257 + 32768) >> 16;
+}
+
+//*****************************************************************************
+//
+//! Writes an HSV color to the RGB LEDs of the base layer
+//!
+//! \param color is the color to write
+//
+//*****************************************************************************
+static void color_output(const struct color_hsv *color)
+{
+	uint8_t rgb[3];
+
+	color_hsv_to_rgb(color->hue, color->saturation, color->value, rgb);
+	led_layer_brightness_set(LED_LAYER_BASE, LED_ONBOARD_RED, rgb[0]);
+	led_layer_brightness_set(LED_LAYER_BASE, LED_ONBOARD_GREEN, rgb[1]);
+	led_layer_brightness_set(LED_LAYER_BASE, LED_ONBOARD_BLUE, rgb[2]);
+}
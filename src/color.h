@@ -0,0 +1,52 @@
+//*****************************************************************************
+//
+// color.h - Headers for the HSV/HSL color conversion and hue fades
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#ifndef COLOR_H
+#define COLOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define COLOR_HUE_MAX    1536 // One full turn of hue, 256 steps per sextant
+#define COLOR_LEVEL_MAX  255  // Maximum saturation, value, lightness and
+                              //  channel level
+
+//*****************************************************************************
+//
+// Public function prototypes.
+//
+//*****************************************************************************
+void color_hsv_to_rgb(uint32_t hue, uint32_t saturation, uint32_t value, uint8_t rgb[3]);
+void color_hsl_to_rgb(uint32_t hue, uint32_t saturation, uint32_t lightness, uint8_t rgb[3]);
+void color_hsl_to_hsv(uint32_t saturation, uint32_t lightness, uint32_t *hsv_saturation, uint32_t *value);
+void color_hsv_set(uint32_t hue, uint32_t saturation, uint32_t value, uint32_t duration_ms);
+void color_fade_stop(void);
+bool color_fade_active(void);
+bool color_fade_tick(uint32_t elapsed_ms, uint32_t *led_mask);
+
+#endif
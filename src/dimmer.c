@@ -0,0 +1,484 @@
+//*****************************************************************************
+//
+// dimmer.c - Dimmer knob on an analog input
+//
+// A potentiometer on AIN0 (PE3) sets the master dimmer. TIMER2A triggers a
+// conversion of ADC0 sequencer 3 at DIMMER_SAMPLE_HZ, and the ADC averages
+// 64 conversions in hardware for each sample. The uDMA moves the samples
+// into the two halves of a ring in ping-pong mode, so the CPU is only
+// interrupted when a half is full, not for every sample.
+//
+// The handler averages the half, then holds the result until it moves
+// further than DIMMER_HYSTERESIS from the reading the level was last set
+// from. The master dimmer is only touched when that gives a new level, so a
+// knob at rest costs one short interrupt per half and does not restart the
+// fades.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "inc/hw_memmap.h"
+#include "inc/hw_ints.h"
+#include "inc/hw_adc.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/gpio.h"
+#include "driverlib/adc.h"
+#include "driverlib/timer.h"
+#include "driverlib/udma.h"
+#include "driverlib/interrupt.h"
+
+#include "dimmer.h"
+#include "led.h"
+#include "log.h"
+#include "settings.h"
+#include "udma_ext.h"
+
+//*****************************************************************************
+//
+// Module Configuration Defines
+//
+//*****************************************************************************
+#define DIMMER_ADC_BASE      ADC0_BASE        // ADC sampling the knob
+#define DIMMER_SEQUENCER     3                // Single step sequencer
+#define DIMMER_WATCH_SEQ     2                // Sequencer feeding the
+                                              // 	comparators while the knob
+                                              // 	is still
+#define DIMMER_TIMER_BASE    TIMER2_BASE      // Timer triggering the ADC
+#define DIMMER_UDMA_CHANNEL  UDMA_CH17_ADC0_3 // uDMA channel of the sequencer
+#define DIMMER_OVERSAMPLE    64               // Conversions averaged per sample
+#define DIMMER_SAMPLE_HZ     512              // Samples per second
+#define DIMMER_HALF_SAMPLES  32               // Samples per half of the ring,
+                                              // 	16 interrupts per second
+                                              // 	while the knob moves
+#define DIMMER_HYSTERESIS    24               // Change of the reading that
+                                              // 	sets a new level, 1.5 levels
+#define DIMMER_RAW_LOW       48               // Reading of the knob at its
+                                              // 	lowest position, level 0
+#define DIMMER_RAW_HIGH      4048             // Reading of the knob at its
+                                              // 	highest position, full level
+#define DIMMER_QUIET_HALVES  8                // Halves without a change before
+                                              // 	the comparators take over
+#define DIMMER_VERSION       1                // Version of the saved settings
+
+//*****************************************************************************
+//
+// Settings saved in the EEPROM
+//
+//*****************************************************************************
+struct dimmer_settings
+{
+	uint32_t enable;
+};
+
+//*****************************************************************************
+//
+// Internal variables
+//
+//*****************************************************************************
+static uint16_t _ring[2][DIMMER_HALF_SAMPLES]; // Halves filled by the uDMA
+static volatile uint32_t _raw;                 // Average of the last half
+static uint32_t _raw_held;                     // Reading the level was set from
+static bool _resync;                           // Set the level from the next
+                                               // 	reading
+static volatile uint32_t _level;               // Level last set
+static volatile uint32_t _block_count;         // Halves processed
+static volatile uint32_t _update_count;        // Levels set
+static uint32_t _quiet;                        // Halves since the knob moved
+static bool _watching;                         // Comparators watch the knob
+static struct dimmer_settings _settings;
+
+//*****************************************************************************
+//
+// Prototypes for private functions
+//
+//*****************************************************************************
+static void dimmer_half_arm(uint32_t select, uint32_t half);
+static void dimmer_half_process(const uint16_t *samples);
+static void dimmer_sampling_start(void);
+static void dimmer_watch_start(void);
+static void dimmer_stop(void);
+
+//*****************************************************************************
+//
+//! ADC0 sequencer 3 interrupt handler. The uDMA raises it once a half of the
+//! ring is full, and the comparators raise it when the knob leaves the band
+//! they watch.
+//!
+//! A half that the uDMA completed is in stop mode. It is processed and
+//! re-armed while the uDMA fills the other half. Once the knob has been
+//! still for DIMMER_QUIET_HALVES, the ring stops and the comparators watch
+//! the knob without interrupting until it moves.
+//
+//*****************************************************************************
+void ADC0SS3_Handler(void)
+{
+	uint32_t compare = ADCComparatorIntStatus(DIMMER_ADC_BASE);
+	
+	ADCIntClearEx(DIMMER_ADC_BASE, ADC_INT_SS3 | ADC_INT_DCON_SS3);
+	
+	if (compare != 0)
+	{
+		ADCComparatorIntClear(DIMMER_ADC_BASE, compare);
+		if (_watching)
+			dimmer_sampling_start();
+		return;
+	}
+	if (_watching)
+		return;
+	
+	if (uDMAChannelModeGet(DIMMER_UDMA_CHANNEL | UDMA_PRI_SELECT) == UDMA_MODE_STOP)
+	{
+		dimmer_half_process(_ring[0]);
+		dimmer_half_arm(UDMA_PRI_SELECT, 0);
+	}
+	if (uDMAChannelModeGet(DIMMER_UDMA_CHANNEL | UDMA_ALT_SELECT) == UDMA_MODE_STOP)
+	{
+		dimmer_half_process(_ring[1]);
+		dimmer_half_arm(UDMA_ALT_SELECT, 1);
+	}
+	
+	if (_quiet >= DIMMER_QUIET_HALVES)
+		dimmer_watch_start();
+}
+
+//*****************************************************************************
+//
+//! Initializes the dimmer knob
+//!
+//! This function configures ADC0 on AIN0 (PE3), TIMER2A and the uDMA
+//! channel filling the ring, and loads whether the knob is enabled from the
+//! settings. The knob is disabled unless it was enabled and saved. An enabled
+//! knob sets the master dimmer once its first reading is in. settings_init()
+//! must be called first.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void dimmer_init(void)
+{
+	//***************************************************************************
+	//
+	// Initialize ADC0 used to sample the knob
+	//
+	//***************************************************************************
+	SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOE);
+	while (!SysCtlPeripheralReady(SYSCTL_PERIPH_GPIOE)){};
+	SysCtlPeripheralEnable(SYSCTL_PERIPH_ADC0);
+	while (!SysCtlPeripheralReady(SYSCTL_PERIPH_ADC0)){};
+	
+	GPIOPinTypeADC(GPIO_PORTE_BASE, GPIO_PIN_3);
+	
+	ADCHardwareOversampleConfigure(DIMMER_ADC_BASE, DIMMER_OVERSAMPLE);
+	ADCSequenceDisable(DIMMER_ADC_BASE, DIMMER_SEQUENCER);
+	ADCSequenceConfigure(DIMMER_ADC_BASE, DIMMER_SEQUENCER, ADC_TRIGGER_TIMER, 0);
+	
+	// The end of the step requests the uDMA transfer of the sample
+	ADCSequenceStepConfigure(DIMMER_ADC_BASE, DIMMER_SEQUENCER, 0, 
+		ADC_CTL_CH0 | ADC_CTL_IE | ADC_CTL_END);
+	ADCSequenceDMAEnable(DIMMER_ADC_BASE, DIMMER_SEQUENCER);
+	
+	// While the knob is still, comparator 0 fires when the reading drops
+	// below the band around it and comparator 1 when it rises above. Their
+	// interrupts are sent on the line of sequencer 3.
+	ADCSequenceConfigure(DIMMER_ADC_BASE, DIMMER_WATCH_SEQ, ADC_TRIGGER_TIMER, 0);
+	ADCSequenceStepConfigure(DIMMER_ADC_BASE, DIMMER_WATCH_SEQ, 0, 
+		ADC_CTL_CH0 | ADC_CTL_CMP0);
+	ADCSequenceStepConfigure(DIMMER_ADC_BASE, DIMMER_WATCH_SEQ, 1, 
+		ADC_CTL_CH0 | ADC_CTL_CMP1 | ADC_CTL_END);
+	ADCComparatorConfigure(DIMMER_ADC_BASE, 0, ADC_COMP_TRIG_NONE | ADC_COMP_INT_LOW_ONCE);
+	ADCComparatorIntEnable(DIMMER_ADC_BASE, DIMMER_SEQUENCER);
+	
+	//***************************************************************************
+	//
+	// Initialize uDMA channel used to fill the ring
+	//
+	//***************************************************************************
+	udma_init();
+	
+	uDMAChannelAssign(DIMMER_UDMA_CHANNEL);
+	uDMAChannelAttributeDisable(DIMMER_UDMA_CHANNEL, UDMA_ATTR_ALTSELECT |
+		UDMA_ATTR_USEBURST | UDMA_ATTR_HIGH_PRIORITY | UDMA_ATTR_REQMASK);
+	uDMAChannelControlSet(DIMMER_UDMA_CHANNEL | UDMA_PRI_SELECT, UDMA_SIZE_16 |
+		UDMA_SRC_INC_NONE | UDMA_DST_INC_16 | UDMA_ARB_1);
+	uDMAChannelControlSet(DIMMER_UDMA_CHANNEL | UDMA_ALT_SELECT, UDMA_SIZE_16 |
+		UDMA_SRC_INC_NONE | UDMA_DST_INC_16 | UDMA_ARB_1);
+	
+	//***************************************************************************
+	//
+	// Initialize TIMER2A used to trigger the conversions
+	//
+	//***************************************************************************
+	SysCtlPeripheralEnable(SYSCTL_PERIPH_TIMER2);
+	while (!SysCtlPeripheralReady(SYSCTL_PERIPH_TIMER2)){};
+	
+	TimerConfigure(DIMMER_TIMER_BASE, TIMER_CFG_PERIODIC);
+	TimerLoadSet(DIMMER_TIMER_BASE, TIMER_A, SysCtlClockGet() / DIMMER_SAMPLE_HZ - 1);
+	TimerControlTrigger(DIMMER_TIMER_BASE, TIMER_A, true);
+	
+	//***************************************************************************
+	//
+	// Initialize module variables
+	//
+	//***************************************************************************
+	_raw = 0;
+	_raw_held = 0;
+	_resync = true;
+	_level = DIMMER_MAX_LEVEL;
+	_block_count = 0;
+	_update_count = 0;
+	_settings.enable = false;
+	if (settings_load(SETTINGS_BLOCK_DIMMER, DIMMER_VERSION, &_settings, sizeof(_settings)))
+		log_msg_value(LOG_SUB_SYSTEM_LED, LOG_LEVEL_DEBUG, "Loaded dimmer knob enable", _settings.enable);
+	
+	if (_settings.enable)
+	{
+		dimmer_sampling_start();
+		TimerEnable(DIMMER_TIMER_BASE, TIMER_A);
+	}
+	IntEnable(INT_ADC0SS3);
+}
+
+//*****************************************************************************
+//
+//! Enables or disables the knob and saves the setting. A disabled knob is
+//! not sampled and does not set the master dimmer.
+//!
+//! \param enable is true to let the knob set the master dimmer
+//!
+//! \return true if the setting was saved, false otherwise
+//
+//*****************************************************************************
+bool dimmer_enable_set(bool enable)
+{
+	IntDisable(INT_ADC0SS3);
+	TimerDisable(DIMMER_TIMER_BASE, TIMER_A);
+	dimmer_stop();
+	_settings.enable = enable;
+	if (enable)
+	{
+		// Set the level from the next reading
+		_resync = true;
+		dimmer_sampling_start();
+		TimerEnable(DIMMER_TIMER_BASE, TIMER_A);
+	}
+	IntEnable(INT_ADC0SS3);
+	
+	log_msg_value(LOG_SUB_SYSTEM_LED, LOG_LEVEL_DEBUG, "Dimmer knob enable", enable);
+	
+	return settings_save(SETTINGS_BLOCK_DIMMER, DIMMER_VERSION, &_settings, sizeof(_settings));
+}
+
+//*****************************************************************************
+//
+//! Gets whether the knob sets the master dimmer
+//!
+//! \return true if the knob is enabled
+//
+//*****************************************************************************
+bool dimmer_enable_get(void)
+{
+	return _settings.enable;
+}
+
+//*****************************************************************************
+//
+//! Gets the filtered reading of the knob. The reading is only updated while
+//! the knob is moving.
+//!
+//! \return the reading from 0 to DIMMER_MAX_RAW
+//
+//*****************************************************************************
+uint32_t dimmer_raw_get(void)
+{
+	return _raw;
+}
+
+//*****************************************************************************
+//
+//! Gets the level last set by the knob
+//!
+//! \return the level from 0 to DIMMER_MAX_LEVEL
+//
+//*****************************************************************************
+uint32_t dimmer_level_get(void)
+{
+	return _level;
+}
+
+//*****************************************************************************
+//
+//! Gets the number of ring halves processed, one per interrupt. No halves
+//! are processed while the knob is still or disabled.
+//!
+//! \return the number of halves
+//
+//*****************************************************************************
+uint32_t dimmer_block_count_get(void)
+{
+	return _block_count;
+}
+
+//*****************************************************************************
+//
+//! Gets the number of times the knob set the master dimmer
+//!
+//! \return the number of levels set
+//
+//*****************************************************************************
+uint32_t dimmer_update_count_get(void)
+{
+	return _update_count;
+}
+
+//*****************************************************************************
+//
+//! Points one half of the ping-pong transfer at its half of the ring
+//!
+//! \param select is UDMA_PRI_SELECT or UDMA_ALT_SELECT
+//! \param half is the half of the ring
+//
+//*****************************************************************************
+static void dimmer_half_arm(uint32_t select, uint32_t half)
+{
+	uDMAChannelTransferSet(DIMMER_UDMA_CHANNEL | select, UDMA_MODE_PINGPONG,
+		(void *)(DIMMER_ADC_BASE + ADC_O_SSFIFO3), _ring[half], DIMMER_HALF_SAMPLES);
+}
+
+//*****************************************************************************
+//
+//! Filters a half of the ring and sets the master dimmer if the knob moved
+//! by a visible step
+//!
+//! \param samples is the half of the ring
+//
+//*****************************************************************************
+static void dimmer_half_process(const uint16_t *samples)
+{
+	uint32_t sum = 0;
+	uint32_t raw, level;
+	
+	for (uint32_t i = 0; i < DIMMER_HALF_SAMPLES; i++)
+		sum += samples[i];
+	raw = sum / DIMMER_HALF_SAMPLES;
+	
+	_raw = raw;
+	_block_count++;
+	
+	// Deadband around the reading the level was set from
+	if (!_resync && 
+		(raw > _raw_held ? raw - _raw_held : _raw_held - raw) < DIMMER_HYSTERESIS)
+	{
+		_quiet++;
+		return;
+	}
+	_raw_held = raw;
+	_quiet = 0;
+	
+	// The ends of the knob travel snap to off and full
+	if (raw <= DIMMER_RAW_LOW)
+		level = 0;
+	else if (raw >= DIMMER_RAW_HIGH)
+		level = DIMMER_MAX_LEVEL;
+	else
+		level = ((raw - DIMMER_RAW_LOW) * DIMMER_MAX_LEVEL + 
+			(DIMMER_RAW_HIGH - DIMMER_RAW_LOW) / 2) / (DIMMER_RAW_HIGH - DIMMER_RAW_LOW);
+	
+	if (level == _level && !_resync)
+		return;
+	
+	_resync = false;
+	_level = level;
+	_update_count++;
+	led_master_dimmer_set(level);
+}
+
+//*****************************************************************************
+//
+//! Starts filling the ring, after the knob moved or was enabled. The caller
+//! must mask the ADC interrupt.
+//
+//*****************************************************************************
+static void dimmer_sampling_start(void)
+{
+	ADCSequenceDisable(DIMMER_ADC_BASE, DIMMER_WATCH_SEQ);
+	_watching = false;
+	_quiet = 0;
+	
+	dimmer_half_arm(UDMA_PRI_SELECT, 0);
+	dimmer_half_arm(UDMA_ALT_SELECT, 1);
+	uDMAChannelEnable(DIMMER_UDMA_CHANNEL);
+	ADCSequenceEnable(DIMMER_ADC_BASE, DIMMER_SEQUENCER);
+}
+
+//*****************************************************************************
+//
+//! Stops the ring and lets the comparators watch the band of readings that
+//! does not change the level. Called from the ADC interrupt.
+//
+//*****************************************************************************
+static void dimmer_watch_start(void)
+{
+	// Readings at least DIMMER_HYSTERESIS away from the held one set a level.
+	// Near the ends of the range, one side can not be left and is not watched.
+	uint32_t low = _raw_held >= DIMMER_HYSTERESIS ? _raw_held - DIMMER_HYSTERESIS + 1 : 0;
+	uint32_t high = _raw_held + DIMMER_HYSTERESIS;
+	
+	ADCSequenceDisable(DIMMER_ADC_BASE, DIMMER_SEQUENCER);
+	uDMAChannelDisable(DIMMER_UDMA_CHANNEL);
+	
+	ADCComparatorRegionSet(DIMMER_ADC_BASE, 0, low, DIMMER_MAX_RAW);
+	if (high <= DIMMER_MAX_RAW)
+	{
+		ADCComparatorRegionSet(DIMMER_ADC_BASE, 1, high, high);
+		ADCComparatorConfigure(DIMMER_ADC_BASE, 1, ADC_COMP_TRIG_NONE | ADC_COMP_INT_HIGH_ONCE);
+	}
+	else
+	{
+		ADCComparatorConfigure(DIMMER_ADC_BASE, 1, ADC_COMP_TRIG_NONE | ADC_COMP_INT_NONE);
+	}
+	ADCComparatorReset(DIMMER_ADC_BASE, 0, true, true);
+	ADCComparatorReset(DIMMER_ADC_BASE, 1, true, true);
+	ADCComparatorIntClear(DIMMER_ADC_BASE, 0x3);
+	
+	_watching = true;
+	ADCSequenceEnable(DIMMER_ADC_BASE, DIMMER_WATCH_SEQ);
+}
+
+//*****************************************************************************
+//
+//! Stops both the ring and the comparators. The caller must mask the ADC
+//! interrupt.
+//
+//*****************************************************************************
+static void dimmer_stop(void)
+{
+	ADCSequenceDisable(DIMMER_ADC_BASE, DIMMER_SEQUENCER);
+	ADCSequenceDisable(DIMMER_ADC_BASE, DIMMER_WATCH_SEQ);
+	uDMAChannelDisable(DIMMER_UDMA_CHANNEL);
+	ADCIntClearEx(DIMMER_ADC_BASE, ADC_INT_SS3 | ADC_INT_DCON_SS3);
+	ADCComparatorIntClear(DIMMER_ADC_BASE, 0x3);
+	_watching = false;
+}
@@ -0,0 +1,52 @@
+//*****************************************************************************
+//
+// dimmer.h - Headers for the dimmer knob
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#ifndef DIMMER_H
+#define DIMMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DIMMER_MAX_RAW   4095 // Largest filtered ADC reading
+#define DIMMER_MAX_LEVEL 255  // Level of the knob at full, the master
+                              // 	dimmer level that does not dim
+
+//*****************************************************************************
+//
+// Public function prototypes.
+//
+//*****************************************************************************
+void dimmer_init(void);
+bool dimmer_enable_set(bool enable);
+bool dimmer_enable_get(void);
+uint32_t dimmer_raw_get(void);
+uint32_t dimmer_level_get(void);
+uint32_t dimmer_block_count_get(void);
+uint32_t dimmer_update_count_get(void);
+
+#endif
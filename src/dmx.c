@@ -0,0 +1,338 @@
+//*****************************************************************************
+//
+// dmx.c - DMX512 receiver used to control the LEDs from a lighting console
+//
+// This module receives DMX512 (250 kbaud, 8N2) on UART1. The frames are
+// captured by the uDMA into a double buffer so the CPU is not interrupted for
+// every slot. The UART break interrupt marks the start of each new frame. At
+// that point the uDMA is pointed at the other buffer and the frame that was
+// just completed is applied to the LEDs, starting at the configured start
+// address. The LEDs are therefore updated once per frame (up to 44 Hz).
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "inc/hw_types.h"
+#include "inc/hw_memmap.h"
+#include "inc/hw_ints.h"
+#include "inc/hw_uart.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/pin_map.h"
+#include "driverlib/gpio.h"
+#include "driverlib/uart.h"
+#include "driverlib/udma.h"
+#include "driverlib/interrupt.h"
+
+#include "dmx.h"
+#include "led.h"
+#include "log.h"
+#include "udma_ext.h"
+
+//*****************************************************************************
+//
+// Module Configuration Defines
+//
+//*****************************************************************************
+#define DMX_UART_BASE     UART1_BASE        // UART used to receive DMX512
+#define DMX_BAUD_RATE     250000            // DMX512 baud rate
+#define DMX_UDMA_CHANNEL  UDMA_CH22_UART1RX // uDMA channel of the UART RX
+#define DMX_FRAME_SIZE    (DMX_NUM_SLOTS + 1) // Start code followed by the
+                                              //  data slots
+
+//*****************************************************************************
+//
+// Internal variables
+//
+//*****************************************************************************
+static uint8_t _frame[2][DMX_FRAME_SIZE]; // Double buffer for received frames
+static uint32_t _rx_buffer;               // Buffer currently filled by uDMA
+static uint32_t _start_address;           // First slot mapped to LED 0
+static volatile uint32_t _frame_count;    // Number of frames applied
+static bool _enable;                      // DMX input mode enable
+static bool _synced;                      // A break was seen since enabling
+
+//*****************************************************************************
+//
+// Prototypes for private functions
+//
+//*****************************************************************************
+static void dmx_rx_arm(void);
+static void dmx_frame_apply(const uint8_t *frame, uint32_t length);
+
+//*****************************************************************************
+//
+//! UART1 interrupt handler. Only the break error and the uDMA completion
+//! raise this interrupt, so it runs once per frame rather than once per slot.
+//!
+//! A break marks the end of the previous frame. The uDMA stops itself on the
+//! break character (UART_DMA_ERR_RXSTOP), so the number of captured bytes is
+//! read from the channel, the break character is drained from the FIFO, and
+//! the uDMA is re-armed on the other buffer before the next start code
+//! arrives. The completed buffer is then applied to the LEDs.
+//!
+//! The receiver can be enabled in the middle of a frame, so the bytes before
+//! the first break are a partial frame and are discarded.
+//
+//*****************************************************************************
+void UART1_Handler(void)
+{
+	uint32_t status, received, completed;
+
+	status = UARTIntStatus(DMX_UART_BASE, true);
+	UARTIntClear(DMX_UART_BASE, status);
+
+	if (!(status & UART_INT_BE))
+	{
+		// uDMA completion of a full frame. Wait for the next break.
+		return;
+	}
+
+	uDMAChannelDisable(DMX_UDMA_CHANNEL);
+	received = DMX_FRAME_SIZE - uDMAChannelSizeGet(DMX_UDMA_CHANNEL | UDMA_PRI_SELECT);
+
+	// Drain the break character along with any slot the uDMA did not move
+	while (UARTCharsAvail(DMX_UART_BASE))
+	{
+		int32_t data = UARTCharGetNonBlocking(DMX_UART_BASE);
+
+		if (!(data & UART_DR_BE) && received < DMX_FRAME_SIZE)
+			_frame[_rx_buffer][received++] = data & 0xFF;
+	}
+	UARTRxErrorClear(DMX_UART_BASE);
+
+	// Swap buffers and restart the capture
+	completed = _rx_buffer;
+	_rx_buffer ^= 1;
+	dmx_rx_arm();
+
+	if (!_synced)
+	{
+		_synced = true;
+		return;
+	}
+
+	dmx_frame_apply(_frame[completed], received);
+}
+
+//*****************************************************************************
+//
+//! Initializes the DMX512 receiver
+//!
+//! This function configures UART1 (PB0) for DMX512 and the uDMA channel used
+//! to capture the frames. The receiver stays disabled until
+//! dmx_enable_set() is called.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void dmx_init(void)
+{
+	//***************************************************************************
+	//
+	// Initialize UART1 used to receive DMX512
+	//
+	//***************************************************************************
+	SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOB);
+	while (!SysCtlPeripheralReady(SYSCTL_PERIPH_GPIOB)){};
+	SysCtlPeripheralEnable(SYSCTL_PERIPH_UART1);
+	while (!SysCtlPeripheralReady(SYSCTL_PERIPH_UART1)){};
+
+	GPIOPinConfigure(GPIO_PB0_U1RX);
+	GPIOPinTypeUART(GPIO_PORTB_BASE, GPIO_PIN_0);
+
+	UARTConfigSetExpClk(DMX_UART_BASE, SysCtlClockGet(), DMX_BAUD_RATE,
+		UART_CONFIG_WLEN_8 | UART_CONFIG_STOP_TWO | UART_CONFIG_PAR_NONE);
+	UARTFIFOEnable(DMX_UART_BASE);
+	UARTFIFOLevelSet(DMX_UART_BASE, UART_FIFO_TX4_8, UART_FIFO_RX4_8);
+
+	//***************************************************************************
+	//
+	// Initialize uDMA channel used to capture the frames
+	//
+	//***************************************************************************
+	udma_init();
+
+	uDMAChannelAssign(DMX_UDMA_CHANNEL);
+	uDMAChannelAttributeDisable(DMX_UDMA_CHANNEL, UDMA_ATTR_ALTSELECT |
+		UDMA_ATTR_USEBURST | UDMA_ATTR_HIGH_PRIORITY | UDMA_ATTR_REQMASK);
+	uDMAChannelControlSet(DMX_UDMA_CHANNEL | UDMA_PRI_SELECT, UDMA_SIZE_8 |
+		UDMA_SRC_INC_NONE | UDMA_DST_INC_8 | UDMA_ARB_4);
+
+	//***************************************************************************
+	//
+	// Initialize module variables
+	//
+	//***************************************************************************
+	_rx_buffer = 0;
+	_start_address = 1;
+	_frame_count = 0;
+	_enable = false;
+	_synced = false;
+}
+
+//*****************************************************************************
+//
+//! Enables or disables the DMX512 input mode
+//!
+//! \param enable selects whether to enable/disable the receiver
+//!
+//! While enabled, every received frame sets the brightness of the LEDs
+//! directly, without the fade effect.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void dmx_enable_set(bool enable)
+{
+	if (enable == _enable)
+		return;
+
+	if (enable)
+	{
+		_rx_buffer = 0;
+		_synced = false;
+		dmx_rx_arm();
+
+		UARTIntClear(DMX_UART_BASE, UART_INT_BE);
+		UARTIntEnable(DMX_UART_BASE, UART_INT_BE);
+		IntEnable(INT_UART1);
+		UARTEnable(DMX_UART_BASE);
+	}
+	else
+	{
+		IntDisable(INT_UART1);
+		UARTIntDisable(DMX_UART_BASE, UART_INT_BE);
+		UARTDMADisable(DMX_UART_BASE, UART_DMA_RX | UART_DMA_ERR_RXSTOP);
+		uDMAChannelDisable(DMX_UDMA_CHANNEL);
+		UARTDisable(DMX_UART_BASE);
+	}
+
+	_enable = enable;
+	log_msg_value(LOG_SUB_SYSTEM_DMX, LOG_LEVEL_DEBUG, "DMX enable", enable);
+}
+
+//*****************************************************************************
+//
+//! Gets the DMX512 input mode enable state
+//!
+//! \return true if the receiver is enabled, false otherwise
+//
+//*****************************************************************************
+bool dmx_enable_get(void)
+{
+	return _enable;
+}
+
+//*****************************************************************************
+//
+//! Sets the DMX512 start address
+//!
+//! \param address is the slot (1 to DMX_NUM_SLOTS) mapped to the first LED in
+//! LED_LIST. The following LEDs use the following slots.
+//!
+//! The address is left unchanged if it is out of range.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void dmx_start_address_set(uint32_t address)
+{
+	if (address < 1 || address > DMX_NUM_SLOTS)
+		return;
+
+	_start_address = address;
+	log_msg_value(LOG_SUB_SYSTEM_DMX, LOG_LEVEL_DEBUG, "Setting start address", address);
+}
+
+//*****************************************************************************
+//
+//! Gets the DMX512 start address
+//!
+//! \return The slot mapped to the first LED
+//
+//*****************************************************************************
+uint32_t dmx_start_address_get(void)
+{
+	return _start_address;
+}
+
+//*****************************************************************************
+//
+//! Gets the number of DMX512 frames applied to the LEDs
+//!
+//! \return Number of applied frames
+//
+//*****************************************************************************
+uint32_t dmx_frame_count_get(void)
+{
+	return _frame_count;
+}
+
+//*****************************************************************************
+//
+//! Points the uDMA channel at the receive buffer and starts the capture
+//
+//*****************************************************************************
+static void dmx_rx_arm(void)
+{
+	uDMAChannelTransferSet(DMX_UDMA_CHANNEL | UDMA_PRI_SELECT, UDMA_MODE_BASIC,
+		(void *)(DMX_UART_BASE + UART_O_DR), _frame[_rx_buffer], DMX_FRAME_SIZE);
+	uDMAChannelEnable(DMX_UDMA_CHANNEL);
+	UARTDMAEnable(DMX_UART_BASE, UART_DMA_RX | UART_DMA_ERR_RXSTOP);
+}
+
+//*****************************************************************************
+//
+//! Applies a received frame to the LEDs
+//!
+//! \param frame is the received frame, starting with the start code
+//! \param length is the number of bytes received, including the start code
+//!
+//! Frames with a start code other than DMX_START_CODE_NULL carry no dimmer
+//! data and are ignored.
+//
+//*****************************************************************************
+static void dmx_frame_apply(const uint8_t *frame, uint32_t length)
+{
+	uint32_t num_leds = led_num_leds_get();
+
+	if (length == 0 || frame[0] != DMX_START_CODE_NULL)
+		return;
+
+	for (uint32_t i = 0; i < num_leds; i++)
+	{
+		uint32_t slot = _start_address + i;
+
+		if (slot >= length)
+			break;
+
+		led_sw_brightness_immediate_set(i, frame[slot]);
+	}
+	led_update_hw_start();
+
+	_frame_count++;
+}
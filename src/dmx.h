@@ -0,0 +1,50 @@
+//*****************************************************************************
+//
+// dmx.h - Headers for using the DMX512 receiver functions
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#ifndef DMX_H
+#define DMX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DMX_NUM_SLOTS       512 // Number of data slots in a DMX512 frame
+#define DMX_START_CODE_NULL 0x00 // Start code of a dimmer data frame
+
+//*****************************************************************************
+//
+// Public function prototypes.
+//
+//*****************************************************************************
+void dmx_init(void);
+void dmx_enable_set(bool enable);
+bool dmx_enable_get(void);
+void dmx_start_address_set(uint32_t address);
+uint32_t dmx_start_address_get(void);
+uint32_t dmx_frame_count_get(void);
+
+#endif
@@ -0,0 +1,169 @@
+//*****************************************************************************
+//
+// ease.c - Velocity continuous fade segments
+//
+// A fade that gets a new target while it is still moving does not restart
+// from rest. The new segment is a cubic Hermite curve that starts at the
+// position and rate of change of the fade it replaces and comes to rest on
+// the new target, so a channel that has to turn around slows down, stops
+// and comes back instead of reversing in one step.
+//
+// The cubic is set up once when the segment starts, as its forward
+// differences. Each tick then takes three additions, whatever the shape of
+// the curve or the number of times the target changed. The length of a
+// segment is the number of steps of the regular fade for the same distance,
+// so the average rate of a fade does not change.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include "ease.h"
+
+//*****************************************************************************
+//
+// Module Configuration Defines
+//
+//*****************************************************************************
+#define EASE_ONE     4294967296.0f // Position of one brightness level
+#define EASE_SHIFT   32            // Fraction bits of the position
+#define EASE_HALF    (1LL << (EASE_SHIFT - 1))
+
+//*****************************************************************************
+//
+//! Starts a segment to a new target
+//!
+//! \param segment is the segment of the LED
+//! \param current is the brightness of the LED
+//! \param target is the brightness to come to rest on
+//! \param step is the brightness change per tick of the regular fade
+//!
+//! The segment continues from its position and rate of change if current is
+//! the brightness it last returned. Otherwise the LED was set by something
+//! else and the segment starts at rest from current.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void ease_retarget(struct ease_segment *segment, uint32_t current, uint32_t target, uint32_t step)
+{
+	float start, velocity, distance, ticks, a, b;
+	
+	if (segment->ticks == 0 || segment->output != current)
+	{
+		segment->position = (int64_t)current << EASE_SHIFT;
+		segment->delta1 = 0;
+	}
+	segment->target = target;
+	segment->output = current;
+	
+	if (segment->delta1 == 0 && current == target)
+	{
+		segment->ticks = 0;
+		return;
+	}
+	
+	if (step == 0)
+		step = 1;
+	
+	start = segment->position / EASE_ONE;
+	velocity = segment->delta1 / EASE_ONE;
+	distance = (float)target - start;
+	
+	ticks = ceilf(fabsf(distance) / step);
+	if (segment->delta1 != 0 && ticks < EASE_MIN_RETARGET_TICKS)
+		ticks = EASE_MIN_RETARGET_TICKS;
+	if (ticks < 1.0f)
+		ticks = 1.0f;
+	
+	// Hermite curve in ticks, p(t) = a t^3 + b t^2 + velocity t + start,
+	// with p(ticks) = target and p'(ticks) = 0
+	a = (velocity * ticks - 2.0f * distance) / (ticks * ticks * ticks);
+	b = (3.0f * distance - 2.0f * velocity * ticks) / (ticks * ticks);
+	
+	segment->delta1 = (int64_t)((a + b + velocity) * EASE_ONE);
+	segment->delta2 = (int64_t)((6.0f * a + 2.0f * b) * EASE_ONE);
+	segment->delta3 = (int64_t)(6.0f * a * EASE_ONE);
+	segment->ticks = (uint32_t)ticks;
+}
+
+//*****************************************************************************
+//
+//! Advances a segment by one tick
+//!
+//! \param segment is the segment of the LED
+//! \param max is the highest brightness returned
+//!
+//! The last tick lands on the target exactly.
+//!
+//! \return the brightness of the LED
+//
+//*****************************************************************************
+uint32_t ease_step(struct ease_segment *segment, uint32_t max)
+{
+	int64_t position;
+	
+	if (segment->ticks <= 1)
+	{
+		ease_stop(segment);
+		segment->output = segment->target;
+		return segment->target;
+	}
+	
+	segment->position += segment->delta1;
+	segment->delta1 += segment->delta2;
+	segment->delta2 += segment->delta3;
+	segment->ticks--;
+	
+	// The curve can overshoot while turning around
+	position = segment->position + EASE_HALF;
+	if (position < 0)
+		segment->output = 0;
+	else if ((position >> EASE_SHIFT) > max)
+		segment->output = max;
+	else
+		segment->output = position >> EASE_SHIFT;
+	
+	return segment->output;
+}
+
+//*****************************************************************************
+//
+//! Stops a segment at rest. The next retarget starts from the brightness of
+//! the LED.
+//!
+//! \param segment is the segment of the LED
+//!
+//! \return None.
+//
+//*****************************************************************************
+void ease_stop(struct ease_segment *segment)
+{
+	segment->ticks = 0;
+	segment->delta1 = 0;
+	segment->delta2 = 0;
+	segment->delta3 = 0;
+}
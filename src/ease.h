@@ -0,0 +1,65 @@
+//*****************************************************************************
+//
+// ease.h - Headers for the velocity continuous fade segments
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#ifndef EASE_H
+#define EASE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define EASE_MIN_RETARGET_TICKS 8 // Shortest segment that starts while moving
+
+//*****************************************************************************
+//
+// A fade segment of one LED. The brightness follows a cubic from the
+// position and rate of change it had when the segment started to the
+// target, where it comes to rest. Position and differences are in 1/2^32
+// brightness levels.
+//
+//*****************************************************************************
+struct ease_segment
+{
+	int64_t position;
+	int64_t delta1;  // Change of the position in the next tick
+	int64_t delta2;  // Change of delta1 in the next tick
+	int64_t delta3;  // Change of delta2, constant over the segment
+	uint32_t ticks;  // Ticks left, 0 once at rest
+	uint8_t target;
+	uint8_t output;  // Brightness returned by the last step
+};
+
+//*****************************************************************************
+//
+// Public function prototypes.
+//
+//*****************************************************************************
+void ease_retarget(struct ease_segment *segment, uint32_t current, uint32_t target, uint32_t step);
+uint32_t ease_step(struct ease_segment *segment, uint32_t max);
+void ease_stop(struct ease_segment *segment);
+
+#endif
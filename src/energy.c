@@ -0,0 +1,294 @@
+//*****************************************************************************
+//
+// energy.c - Energy accounting from the PWM duty of the LEDs
+//
+// The lamp has no power meter, so the energy is integrated from the duty
+// cycle each LED is driven at and the power it draws at full duty. The LED
+// driver reports each duty it writes. The total power only changes on those
+// writes, so a write adds the total power times the time since the previous
+// change, read from the local clock, and then updates the power of the LED.
+// Nothing is sampled between changes.
+//
+// The main loop also folds in the time since the last change once a minute,
+// which keeps the elapsed time within the range of the clock and picks up
+// changes to the power of the channels. At the end of each operating hour
+// the energy is moved into a bucket and the log is saved to the EEPROM. The
+// part of a mWh left over is carried into the next hour.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "driverlib/interrupt.h"
+
+#include "energy.h"
+#include "thermal.h"
+#include "clock.h"
+#include "led.h"
+#include "log.h"
+#include "settings.h"
+
+//*****************************************************************************
+//
+// Module Configuration Defines
+//
+//*****************************************************************************
+#define ENERGY_VERSION      1               // Version of struct energy_log
+#define ENERGY_FLUSH_MS     60000           // Time between folds from the main loop
+#define ENERGY_HOUR_MS      3600000         // Length of a bucket
+#define ENERGY_MWUS_PER_MWH 3600000000ULL  // mW us in a mWh
+
+//*****************************************************************************
+//
+// Internal variables
+//
+//*****************************************************************************
+static struct energy_log _log;
+static uint16_t _duty[LED_NUM_LEDS];          // Duty of each LED, 1/65536
+static uint32_t _led_power[LED_NUM_LEDS];     // Power of each LED, mW
+static uint32_t _power;                       // Power of all LEDs, mW
+static uint32_t _last_us;                     // Time of the last fold
+static uint64_t _energy;                      // Energy of this hour, mW us
+static uint32_t _flush_ms;                    // Time of the next fold
+static uint32_t _hour_ms;                     // Time the hour ends
+
+//*****************************************************************************
+//
+// Prototypes for private functions
+//
+//*****************************************************************************
+static void energy_fold(void);
+static void energy_power_refresh(void);
+static void energy_hour_close(void);
+
+//*****************************************************************************
+//
+//! Initializes the energy accounting
+//!
+//! settings_init() and clock_init() must be called first. The log is loaded
+//! from the EEPROM, or cleared if there is none.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void energy_init(void)
+{
+	if (!settings_load(SETTINGS_BLOCK_ENERGY, ENERGY_VERSION, &_log, sizeof(_log)))
+	{
+		_log.hours = 0;
+		_log.reserved = 0;
+		_log.total_mwh = 0;
+		for (uint32_t i = 0; i < ENERGY_NUM_BUCKETS; i++)
+			_log.buckets[i] = 0;
+	}
+	
+	for (uint32_t i = 0; i < LED_NUM_LEDS; i++)
+	{
+		_duty[i] = 0;
+		_led_power[i] = 0;
+	}
+	
+	_power = 0;
+	_energy = 0;
+	_last_us = clock_local_get();
+	_flush_ms = clock_local_ms_get() + ENERGY_FLUSH_MS;
+	_hour_ms = clock_local_ms_get() + ENERGY_HOUR_MS;
+}
+
+//*****************************************************************************
+//
+//! Records the duty cycle an LED is driven at
+//!
+//! This function is called by the LED driver for every output it writes. It
+//! returns at once if the duty did not change. It may be called with the
+//! interrupts masked, which it leaves masked.
+//!
+//! \param led_type specifies the LED
+//! \param duty is the duty cycle from 0 to LED_MAX_DUTY
+//!
+//! \return None.
+//
+//*****************************************************************************
+void energy_duty_set(uint32_t led_type, uint32_t duty)
+{
+	uint32_t power;
+	bool masked;
+	
+	if (led_type >= LED_NUM_LEDS)
+		return;
+	
+	// Full duty is kept as the largest stored duty, 1/65536 short of it
+	if (duty > UINT16_MAX)
+		duty = UINT16_MAX;
+	if (_duty[led_type] == duty)
+		return;
+	
+	power = (duty * thermal_channel_mw_get(led_type)) >> 16;
+	
+	masked = IntMasterDisable();
+	_duty[led_type] = duty;
+	if (power != _led_power[led_type])
+	{
+		energy_fold();
+		_power += power - _led_power[led_type];
+		_led_power[led_type] = power;
+	}
+	if (!masked)
+		IntMasterEnable();
+}
+
+//*****************************************************************************
+//
+//! Folds in the energy since the last change and closes the hour when it
+//! ends
+//!
+//! This function is called from the main loop.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void energy_process(void)
+{
+	uint32_t now = clock_local_ms_get();
+	bool masked;
+	
+	if (CLOCK_BEFORE(now, _flush_ms))
+		return;
+	_flush_ms = now + ENERGY_FLUSH_MS;
+	
+	masked = IntMasterDisable();
+	energy_fold();
+	energy_power_refresh();
+	if (!masked)
+		IntMasterEnable();
+	
+	if (!CLOCK_BEFORE(now, _hour_ms))
+	{
+		_hour_ms += ENERGY_HOUR_MS;
+		energy_hour_close();
+	}
+}
+
+//*****************************************************************************
+//
+//! Gets the energy log
+//!
+//! \param log is set to the log of the completed hours
+//!
+//! \return None.
+//
+//*****************************************************************************
+void energy_log_get(struct energy_log *log)
+{
+	*log = _log;
+}
+
+//*****************************************************************************
+//
+//! Gets the energy used so far in this hour
+//!
+//! \return the energy in mWh
+//
+//*****************************************************************************
+uint32_t energy_hour_mwh_get(void)
+{
+	uint64_t energy;
+	bool masked;
+	
+	masked = IntMasterDisable();
+	energy_fold();
+	energy = _energy;
+	if (!masked)
+		IntMasterEnable();
+	
+	return energy / ENERGY_MWUS_PER_MWH;
+}
+
+//*****************************************************************************
+//
+//! Gets the power the LEDs draw at their present duty cycles
+//!
+//! \return the power in mW
+//
+//*****************************************************************************
+uint32_t energy_power_get(void)
+{
+	return _power;
+}
+
+//*****************************************************************************
+//
+//! Adds the energy at the present power since the last fold. Interrupts must
+//! be masked.
+//
+//*****************************************************************************
+static void energy_fold(void)
+{
+	uint32_t now = clock_local_get();
+	
+	_energy += (uint64_t)_power * (now - _last_us);
+	_last_us = now;
+}
+
+//*****************************************************************************
+//
+//! Recomputes the power of each LED from its duty, after the power of a
+//! channel changed. Interrupts must be masked.
+//
+//*****************************************************************************
+static void energy_power_refresh(void)
+{
+	_power = 0;
+	for (uint32_t i = 0; i < LED_NUM_LEDS; i++)
+	{
+		_led_power[i] = (_duty[i] * thermal_channel_mw_get(i)) >> 16;
+		_power += _led_power[i];
+	}
+}
+
+//*****************************************************************************
+//
+//! Moves the energy of the hour into its bucket and saves the log
+//
+//*****************************************************************************
+static void energy_hour_close(void)
+{
+	uint32_t mwh;
+	bool masked;
+	
+	masked = IntMasterDisable();
+	energy_fold();
+	mwh = _energy / ENERGY_MWUS_PER_MWH;
+	_energy -= mwh * ENERGY_MWUS_PER_MWH;
+	if (!masked)
+		IntMasterEnable();
+	
+	_log.buckets[_log.hours % ENERGY_NUM_BUCKETS] = mwh;
+	_log.total_mwh += mwh;
+	_log.hours++;
+	
+	if (!settings_save(SETTINGS_BLOCK_ENERGY, ENERGY_VERSION, &_log, sizeof(_log)))
+		log_msg(LOG_SUB_SYSTEM_SETTINGS, LOG_LEVEL_ERROR, "Unable to save energy log");
+}
@@ -0,0 +1,64 @@
+//*****************************************************************************
+//
+// energy.h - Headers for the energy accounting
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ENERGY_NUM_BUCKETS 24 // Hours of energy kept in the EEPROM
+
+//*****************************************************************************
+//
+// Energy used by the lamp, saved to the EEPROM at the end of each hour it
+// runs. The energy of operating hour h is in buckets[h % ENERGY_NUM_BUCKETS],
+// for the last ENERGY_NUM_BUCKETS hours before hours.
+//
+//*****************************************************************************
+struct energy_log
+{
+	uint32_t hours;                       // Operating hours completed
+	uint32_t reserved;
+	uint64_t total_mwh;                   // Energy of all completed hours
+	uint32_t buckets[ENERGY_NUM_BUCKETS]; // Energy of each hour, mWh
+};
+
+//*****************************************************************************
+//
+// Public function prototypes.
+//
+//*****************************************************************************
+void energy_init(void);
+void energy_duty_set(uint32_t led_type, uint32_t duty);
+void energy_process(void);
+void energy_log_get(struct energy_log *log);
+uint32_t energy_hour_mwh_get(void);
+uint32_t energy_power_get(void);
+
+#endif
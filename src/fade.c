@@ -0,0 +1,213 @@
+//*****************************************************************************
+//
+// fade.c - Base layer fades timed on the lamp bus clock
+//
+// The regular fade moves each LED one step per timer period, so its length
+// depends on the distance to cover and on the local oscillator. The fades of
+// this module are set by a start time on the bus clock and a duration
+// instead. Every lamp of a room computes the brightness from the bus time at
+// each fade step, so they start, move and end together.
+//
+// The clock alarm is set at the start and at the end of the fade, and runs
+// a fade step right away, so both do not wait for the next step period.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "inc/hw_memmap.h"
+#include "inc/hw_ints.h"
+#include "driverlib/interrupt.h"
+
+#include "fade.h"
+#include "clock.h"
+#include "led.h"
+#include "log.h"
+
+//
+// Fade states
+//
+#define FADE_IDLE    0
+#define FADE_PENDING 1 // Waiting for the start time
+#define FADE_RUNNING 2
+
+//*****************************************************************************
+//
+// Internal variables
+//
+//*****************************************************************************
+static uint8_t _from[LED_NUM_LEDS];
+static uint8_t _to[LED_NUM_LEDS];
+static uint8_t _select[LED_NUM_LEDS]; // Non-zero for the LEDs that are fading
+static uint32_t _start;        // Bus time of the start, in us
+static uint32_t _duration;     // Length of the fade, in us
+static volatile uint32_t _state;
+
+//*****************************************************************************
+//
+// Prototypes for private functions
+//
+//*****************************************************************************
+static void fade_alarm(void);
+
+//*****************************************************************************
+//
+//! Starts a fade of the base layer at a bus time
+//!
+//! \param targets is the brightness to reach, indexed by LED
+//! \param select is non-zero for the LEDs that fade, indexed by LED
+//! \param start_us is the bus time of the start. A fade is started right
+//! away if the clock is not in sync with the bus.
+//! \param duration_ms is the length of the fade
+//!
+//! The fade starts from the brightness shown at the start time, so it also
+//! takes over from a previous fade. A fade that is running or pending is
+//! replaced.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void fade_start(const uint8_t *targets, const uint8_t *select, uint32_t start_us, uint32_t duration_ms)
+{
+	if (!clock_synced())
+	{
+		log_msg(LOG_SUB_SYSTEM_LAMPBUS, LOG_LEVEL_WARNING, "Fade started without bus time");
+		start_us = clock_sync_get();
+	}
+	
+	IntDisable(INT_TIMER1A);
+	
+	for (uint32_t i = 0; i < LED_NUM_LEDS; i++)
+	{
+		_select[i] = select[i];
+		if (select[i])
+			_to[i] = targets[i];
+	}
+	_start = start_us;
+	_duration = duration_ms * 1000;
+	_state = FADE_PENDING;
+	clock_alarm_set(_start, fade_alarm);
+	
+	IntEnable(INT_TIMER1A);
+}
+
+//*****************************************************************************
+//
+//! Stops the fade, leaving the LEDs at the brightness shown
+//!
+//! \return None.
+//
+//*****************************************************************************
+void fade_stop(void)
+{
+	clock_alarm_cancel();
+	_state = FADE_IDLE;
+}
+
+//*****************************************************************************
+//
+//! Gets whether a fade is running or waiting for its start time
+//!
+//! \return true if a fade is running or pending, false otherwise
+//
+//*****************************************************************************
+bool fade_active(void)
+{
+	return _state != FADE_IDLE;
+}
+
+//*****************************************************************************
+//
+//! Advances the fade to the bus time. Called from the fade step interrupt.
+//!
+//! \param led_mask gets the bit of each LED written set, as 1 << led_type
+//!
+//! \return true if the fade wrote the base layer, false if it is waiting for
+//! its start time or is idle
+//
+//*****************************************************************************
+bool fade_tick(uint32_t *led_mask)
+{
+	uint32_t now, elapsed, progress;
+	
+	if (_state == FADE_IDLE)
+		return false;
+	
+	now = clock_sync_get();
+	
+	if (_state == FADE_PENDING)
+	{
+		// The clock may have been corrected since the alarm was set
+		if (CLOCK_BEFORE(now, _start))
+		{
+			clock_alarm_set(_start, fade_alarm);
+			return false;
+		}
+		
+		for (uint32_t i = 0; i < LED_NUM_LEDS; i++)
+		{
+			if (_select[i])
+				_from[i] = led_layer_brightness_get(LED_LAYER_BASE, i);
+		}
+		_state = FADE_RUNNING;
+		clock_alarm_set(_start + _duration, fade_alarm);
+	}
+	
+	elapsed = now - _start;
+	if (elapsed >= _duration)
+	{
+		// Write the targets in this step rather than stepping towards them
+		_state = FADE_IDLE;
+		progress = 1 << 16;
+	}
+	else
+	{
+		progress = ((uint64_t)elapsed << 16) / _duration;
+	}
+	
+	for (uint32_t i = 0; i < LED_NUM_LEDS; i++)
+	{
+		if (_select[i])
+		{
+			int32_t change = ((int32_t)_to[i] - _from[i]) * (int32_t)progress;
+			
+			led_layer_brightness_set(LED_LAYER_BASE, i, _from[i] + (change >> 16));
+			*led_mask |= 1u << i;
+		}
+	}
+	
+	return true;
+}
+
+//*****************************************************************************
+//
+//! Alarm raised at the start and at the end of the fade
+//
+//*****************************************************************************
+static void fade_alarm(void)
+{
+	led_update_hw_now();
+}
@@ -47,6 +47,15 @@
 //*****************************************************************************
 #define I2C_MODULE_BASE_ADDRESS I2C0_BASE // Base address of the I2C peripheral
 
+//*****************************************************************************
+//
+// Set while a transfer is in progress. Interrupt handlers that use the bus
+// check it so they do not start a transfer in the middle of one started by
+// the code they interrupted.
+//
+//*****************************************************************************
+static volatile bool _transfer_active;
+
 //*****************************************************************************
 //
 //! Initializes the I2C module
@@ -100,7 +109,8 @@ void i2c_init(void)
 	//
 	// Initialize Master and Slave
 	//
-	I2CMasterInitExpClk(I2C_MODULE_BASE_ADDRESS, SysCtlClockGet(), false);
+	I2CMasterInitExpClk(I2C_MODULE_BASE_ADDRESS, SysCtlClockGet(), 
+		I2C_BUS_SPEED == I2C_BUS_SPEED_FAST);
 	
 	initialized = true;
 }
@@ -153,7 +163,7 @@ uint32_t wait_for_free_master(uint32_t base)
 //! \b I2C_MASTER_ERR_ARB_LOST, or \b I2C_MASTER_ERR_MAX_ATTEMPTS
 // 
 //*****************************************************************************
-uint32_t i2c_register_read(uint8_t addr, uint8_t reg, uint8_t data[], uint32_t num_bytes)
+static uint32_t i2c_transfer_read(uint8_t addr, uint8_t reg, uint8_t data[], uint32_t num_bytes)
 {
 	uint32_t status = 0;
 	
@@ -227,7 +237,7 @@ uint32_t i2c_register_read(uint8_t addr, uint8_t reg, uint8_t data[], uint32_t n
 //! \b I2C_MASTER_ERR_ARB_LOST, or \b I2C_MASTER_ERR_MAX_ATTEMPTS
 // 
 //*****************************************************************************
-uint32_t i2c_register_write(uint8_t addr, uint8_t reg, uint8_t data[], uint32_t num_bytes)
+static uint32_t i2c_transfer_write(uint8_t addr, uint8_t reg, uint8_t data[], uint32_t num_bytes)
 {
 	uint32_t status;
 	
@@ -256,7 +266,7 @@ uint32_t i2c_register_write(uint8_t addr, uint8_t reg, uint8_t data[], uint32_t
 		{
 			// Write last byte
 			I2CMasterControl(I2C_MODULE_BASE_ADDRESS, I2C_MASTER_CMD_BURST_SEND_FINISH);
-		}
+		}else
 		{
 			// Write intermediate byte
 			I2CMasterControl(I2C_MODULE_BASE_ADDRESS, I2C_MASTER_CMD_BURST_SEND_CONT);
@@ -277,6 +287,59 @@ uint32_t i2c_register_write(uint8_t addr, uint8_t reg, uint8_t data[], uint32_t
 	return status;
 }
 
+//*****************************************************************************
+//
+//! Reads a specified number of bytes from a given register value. See
+//! i2c_transfer_read() for the parameters.
+//! 
+//! \return I2C transaction status
+// 
+//*****************************************************************************
+uint32_t i2c_register_read(uint8_t addr, uint8_t reg, uint8_t data[], uint32_t num_bytes)
+{
+	bool was_active = _transfer_active;
+	uint32_t status;
+	
+	_transfer_active = true;
+	status = i2c_transfer_read(addr, reg, data, num_bytes);
+	_transfer_active = was_active;
+	
+	return status;
+}
+
+//*****************************************************************************
+//
+//! Writes a specified number of bytes from a given register value. See
+//! i2c_transfer_write() for the parameters.
+//! 
+//! \return I2C transaction status
+// 
+//*****************************************************************************
+uint32_t i2c_register_write(uint8_t addr, uint8_t reg, uint8_t data[], uint32_t num_bytes)
+{
+	bool was_active = _transfer_active;
+	uint32_t status;
+	
+	_transfer_active = true;
+	status = i2c_transfer_write(addr, reg, data, num_bytes);
+	_transfer_active = was_active;
+	
+	return status;
+}
+
+//*****************************************************************************
+//
+//! Gets whether a transfer is in progress. An interrupt handler that finds a
+//! transfer in progress must not use the bus until a later interrupt.
+//! 
+//! \return true if a transfer is in progress, false otherwise
+// 
+//*****************************************************************************
+bool i2c_busy(void)
+{
+	return _transfer_active;
+}
+
 //*****************************************************************************
 //
 //! Writes a specified bit to a single register
@@ -35,6 +35,10 @@
 #define MAX_BUSY_POLL_ATTEMPTS      5000
 #define I2C_MASTER_ERR_MAX_ATTEMPTS 0x00000001
 
+#define I2C_BUS_SPEED_STANDARD      100000
+#define I2C_BUS_SPEED_FAST          400000
+#define I2C_BUS_SPEED               I2C_BUS_SPEED_FAST // Bus clock in Hz
+
 //*****************************************************************************
 //
 // Public function prototypes.
@@ -44,5 +48,6 @@ void i2c_init(void);
 uint32_t i2c_register_write(uint8_t addr, uint8_t reg, uint8_t data[], uint32_t num_bytes);
 uint32_t i2c_register_read(uint8_t addr, uint8_t reg, uint8_t data[], uint32_t num_bytes);
 uint32_t i2c_register_write_bit(uint8_t addr, uint8_t reg, uint8_t bit_mask, bool set_bit);
+bool i2c_busy(void);
 
 #endif
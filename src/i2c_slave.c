@@ -0,0 +1,329 @@
+//*****************************************************************************
+//
+// i2c_slave.c - Register interface for a host MCU on I2C1
+//
+// The lamp answers as an I2C slave on I2C1 (PA6/PA7) with the register map
+// of i2c_slave.h. The interrupt handler never reads the LED state. It serves
+// reads from a snapshot of the whole map, built by i2c_slave_process() in
+// the main loop. There are two snapshots: the handler picks the newest one at
+// each START, and the main loop only rebuilds the one the handler is not
+// reading. A bulk read therefore sees the values of a single moment and the
+// fade interrupt is never held off.
+//
+// Writes are collected by the handler and handed over at the STOP, so the
+// LEDs written by one bulk write are applied together.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "inc/hw_types.h"
+#include "inc/hw_memmap.h"
+#include "inc/hw_ints.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/pin_map.h"
+#include "driverlib/gpio.h"
+#include "driverlib/i2c.h"
+#include "driverlib/interrupt.h"
+
+#include "i2c_slave.h"
+#include "led.h"
+#include "dmx.h"
+#include "lampbus.h"
+#include "clock.h"
+
+//*****************************************************************************
+//
+// Module Configuration Defines
+//
+//*****************************************************************************
+#define I2C_SLAVE_BASE        I2C1_BASE
+#define I2C_SLAVE_REFRESH_US  10000 // Time between snapshots
+
+//
+// Registers that can be written, bit n for register n
+//
+#define I2C_SLAVE_WRITABLE    ((1ull << I2C_SLAVE_REG_PROFILE) | \
+	(1ull << I2C_SLAVE_REG_INTERVAL) | (1ull << I2C_SLAVE_REG_STEP) | \
+	(1ull << I2C_SLAVE_REG_SENSITIVITY) | \
+	(((1ull << I2C_SLAVE_MAX_LEDS) - 1) << I2C_SLAVE_REG_TARGET))
+
+//*****************************************************************************
+//
+// Internal variables
+//
+//*****************************************************************************
+static uint8_t _snapshot[2][I2C_SLAVE_NUM_REGS];
+static volatile uint32_t _front;       // Newest snapshot
+static volatile uint32_t _read_buffer; // Snapshot picked by the handler
+static volatile bool _busy;            // Transaction between START and STOP
+static uint32_t _pointer;              // Register pointer
+static uint32_t _refresh_time;         // Local time of the last snapshot
+
+// Bytes written during the current transaction
+static uint8_t _rx_values[I2C_SLAVE_NUM_REGS];
+static uint64_t _rx_mask;
+
+// Bytes written by finished transactions, waiting for the main loop
+static uint8_t _write_values[I2C_SLAVE_NUM_REGS];
+static uint64_t _write_mask;
+
+static volatile uint32_t _transactions;
+
+//*****************************************************************************
+//
+// Prototypes for private functions
+//
+//*****************************************************************************
+static void i2c_slave_snapshot(uint8_t *regs);
+static void i2c_slave_u32_put(uint8_t *regs, uint32_t value);
+
+//*****************************************************************************
+//
+//! I2C1 interrupt handler. Serves one byte per data interrupt.
+//
+//*****************************************************************************
+void I2C1_Handler(void)
+{
+	uint32_t status, action, data;
+
+	status = I2CSlaveIntStatusEx(I2C_SLAVE_BASE, true);
+	I2CSlaveIntClearEx(I2C_SLAVE_BASE, status);
+
+	if (status & I2C_SLAVE_INT_START)
+	{
+		// Also taken on a repeated START, so a read after setting the
+		// pointer gets the newest snapshot
+		_read_buffer = _front;
+		_busy = true;
+	}
+
+	if (status & I2C_SLAVE_INT_DATA)
+	{
+		action = I2CSlaveStatus(I2C_SLAVE_BASE);
+
+		if (action == I2C_SLAVE_ACT_RREQ_FBR)
+		{
+			_pointer = I2CSlaveDataGet(I2C_SLAVE_BASE) % I2C_SLAVE_NUM_REGS;
+		}
+		else if (action == I2C_SLAVE_ACT_RREQ)
+		{
+			data = I2CSlaveDataGet(I2C_SLAVE_BASE);
+			if (I2C_SLAVE_WRITABLE & (1ull << _pointer))
+			{
+				_rx_values[_pointer] = data;
+				_rx_mask |= 1ull << _pointer;
+			}
+			_pointer = (_pointer + 1) % I2C_SLAVE_NUM_REGS;
+		}
+		else if (action == I2C_SLAVE_ACT_TREQ)
+		{
+			I2CSlaveDataPut(I2C_SLAVE_BASE, _snapshot[_read_buffer][_pointer]);
+			_pointer = (_pointer + 1) % I2C_SLAVE_NUM_REGS;
+		}
+	}
+
+	if (status & I2C_SLAVE_INT_STOP)
+	{
+		// Hand the writes of the transaction over to the main loop
+		for (uint32_t reg = 0; _rx_mask != 0; reg++, _rx_mask >>= 1)
+		{
+			if (_rx_mask & 1)
+			{
+				_write_values[reg] = _rx_values[reg];
+				_write_mask |= 1ull << reg;
+			}
+		}
+
+		_busy = false;
+		_transactions++;
+	}
+}
+
+//*****************************************************************************
+//
+//! Initializes I2C1 as a slave
+//!
+//! \return None.
+//
+//*****************************************************************************
+void i2c_slave_init(void)
+{
+	//***************************************************************************
+	//
+	// Initialize module variables
+	//
+	//***************************************************************************
+	i2c_slave_snapshot(_snapshot[0]);
+	_front = 0;
+	_read_buffer = 0;
+	_busy = false;
+	_pointer = 0;
+	_rx_mask = 0;
+	_write_mask = 0;
+	_transactions = 0;
+	_refresh_time = clock_local_get();
+
+	//***************************************************************************
+	//
+	// Initialize I2C1 in slave mode
+	//
+	//***************************************************************************
+	SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOA);
+	while (!SysCtlPeripheralReady(SYSCTL_PERIPH_GPIOA)){};
+	SysCtlPeripheralEnable(SYSCTL_PERIPH_I2C1);
+	while (!SysCtlPeripheralReady(SYSCTL_PERIPH_I2C1)){};
+
+	GPIOPinConfigure(GPIO_PA6_I2C1SCL);
+	GPIOPinConfigure(GPIO_PA7_I2C1SDA);
+	GPIOPinTypeI2CSCL(GPIO_PORTA_BASE, GPIO_PIN_6);
+	GPIOPinTypeI2C(GPIO_PORTA_BASE, GPIO_PIN_7);
+
+	I2CSlaveEnable(I2C_SLAVE_BASE);
+	I2CSlaveInit(I2C_SLAVE_BASE, I2C_SLAVE_ADDRESS);
+	I2CSlaveIntClearEx(I2C_SLAVE_BASE, I2C_SLAVE_INT_DATA | I2C_SLAVE_INT_START | I2C_SLAVE_INT_STOP);
+	I2CSlaveIntEnableEx(I2C_SLAVE_BASE, I2C_SLAVE_INT_DATA | I2C_SLAVE_INT_START | I2C_SLAVE_INT_STOP);
+	IntEnable(INT_I2C1);
+}
+
+//*****************************************************************************
+//
+//! Applies the register writes and refreshes the snapshot
+//!
+//! This function is called from the main loop.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void i2c_slave_process(void)
+{
+	uint8_t values[I2C_SLAVE_NUM_REGS];
+	uint64_t mask;
+	uint32_t back, now;
+
+	IntDisable(INT_I2C1);
+	mask = _write_mask;
+	_write_mask = 0;
+	if (mask)
+		memcpy(values, _write_values, sizeof(values));
+	IntEnable(INT_I2C1);
+
+	if (mask)
+	{
+		led_update_begin();
+		for (uint32_t i = 0; i < I2C_SLAVE_MAX_LEDS && i < led_num_leds_get(); i++)
+		{
+			if (mask & (1ull << (I2C_SLAVE_REG_TARGET + i)))
+				led_sw_brightness_set(i, values[I2C_SLAVE_REG_TARGET + i]);
+		}
+		led_update_end();
+
+		if (mask & (1ull << I2C_SLAVE_REG_INTERVAL) && values[I2C_SLAVE_REG_INTERVAL] != 0)
+			led_time_interval_set(values[I2C_SLAVE_REG_INTERVAL]);
+		if (mask & (1ull << I2C_SLAVE_REG_STEP) && values[I2C_SLAVE_REG_STEP] != 0)
+			led_brightness_step_set(values[I2C_SLAVE_REG_STEP]);
+		if (mask & (1ull << I2C_SLAVE_REG_SENSITIVITY))
+			led_lux_sensitivity_set(values[I2C_SLAVE_REG_SENSITIVITY]);
+		if (mask & (1ull << I2C_SLAVE_REG_PROFILE))
+			led_profile_load(values[I2C_SLAVE_REG_PROFILE]);
+	}
+
+	// Show the writes in the next read, otherwise refresh periodically
+	now = clock_local_get();
+	if (!mask && now - _refresh_time < I2C_SLAVE_REFRESH_US)
+		return;
+
+	// Wait for the transaction reading the other snapshot to end
+	back = _front ^ 1;
+	if (_busy && _read_buffer == back)
+		return;
+
+	i2c_slave_snapshot(_snapshot[back]);
+	_front = back;
+	_refresh_time = now;
+}
+
+//*****************************************************************************
+//
+//! Builds a snapshot of the register map
+//!
+//! \param regs is the snapshot to fill
+//
+//*****************************************************************************
+static void i2c_slave_snapshot(uint8_t *regs)
+{
+	struct lampbus_stats stats;
+	struct lux_cache_sample lux;
+	bool lux_fresh;
+	uint32_t num_leds = led_num_leds_get();
+
+	memset(regs, 0, I2C_SLAVE_NUM_REGS);
+	lampbus_stats_get(&stats);
+	lux_fresh = led_lux_sample_get(&lux) == LUX_CACHE_FRESH;
+
+	regs[I2C_SLAVE_REG_ID] = I2C_SLAVE_ID;
+	regs[I2C_SLAVE_REG_VERSION] = I2C_SLAVE_VERSION;
+	regs[I2C_SLAVE_REG_NUM_LEDS] = num_leds;
+	regs[I2C_SLAVE_REG_STATUS] = (led_sw_enable_get() ? I2C_SLAVE_STATUS_ENABLE : 0) |
+		(dmx_enable_get() ? I2C_SLAVE_STATUS_DMX : 0) |
+		(clock_synced() ? I2C_SLAVE_STATUS_SYNCED : 0) |
+		(lux_fresh ? 0 : I2C_SLAVE_STATUS_LUX_STALE);
+	regs[I2C_SLAVE_REG_PROFILE] = led_profile_index_get();
+	regs[I2C_SLAVE_REG_INTERVAL] = led_time_interval_get();
+	regs[I2C_SLAVE_REG_STEP] = led_brightness_step_get();
+	regs[I2C_SLAVE_REG_SENSITIVITY] = led_lux_sensitivity_get();
+	i2c_slave_u32_put(&regs[I2C_SLAVE_REG_LUX], lux.lux);
+	regs[I2C_SLAVE_REG_BUS_ADDRESS] = lampbus_address_get();
+	regs[I2C_SLAVE_REG_BUS_GROUPS] = lampbus_groups_get();
+
+	for (uint32_t i = 0; i < I2C_SLAVE_MAX_LEDS && i < num_leds; i++)
+	{
+		regs[I2C_SLAVE_REG_TARGET + i] = led_layer_brightness_get(LED_LAYER_BASE, i);
+		regs[I2C_SLAVE_REG_CURRENT + i] = led_hw_brightness_get(i);
+	}
+
+	i2c_slave_u32_put(&regs[I2C_SLAVE_REG_DMX_FRAMES], dmx_frame_count_get());
+	i2c_slave_u32_put(&regs[I2C_SLAVE_REG_BUS_FRAMES], stats.accepted);
+	i2c_slave_u32_put(&regs[I2C_SLAVE_REG_BUS_ERRORS], stats.crc_errors);
+	i2c_slave_u32_put(&regs[I2C_SLAVE_REG_I2C_COUNT], _transactions);
+}
+
+//*****************************************************************************
+//
+//! Stores a 32 bit register, little endian
+//!
+//! \param regs is the first byte of the register
+//! \param value is the value to store
+//
+//*****************************************************************************
+static void i2c_slave_u32_put(uint8_t *regs, uint32_t value)
+{
+	regs[0] = value;
+	regs[1] = value >> 8;
+	regs[2] = value >> 16;
+	regs[3] = value >> 24;
+}
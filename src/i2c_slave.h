@@ -0,0 +1,81 @@
+//*****************************************************************************
+//
+// i2c_slave.h - Headers for the I2C slave register interface
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#ifndef I2C_SLAVE_H
+#define I2C_SLAVE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define I2C_SLAVE_ADDRESS      0x2C // 7 bit address of the lamp
+#define I2C_SLAVE_MAX_LEDS     16   // LEDs in the target and current blocks
+
+//*****************************************************************************
+//
+// Register map. The first byte written after the address sets the register
+// pointer. It then increments with each byte read or written, wrapping at
+// I2C_SLAVE_NUM_REGS. Multi-byte registers are little endian. Writes to
+// read only registers are ignored.
+//
+//*****************************************************************************
+#define I2C_SLAVE_REG_ID          0x00 // R  I2C_SLAVE_ID
+#define I2C_SLAVE_REG_VERSION     0x01 // R  Register map version
+#define I2C_SLAVE_REG_NUM_LEDS    0x02 // R  Number of LEDs
+#define I2C_SLAVE_REG_STATUS      0x03 // R  I2C_SLAVE_STATUS bits
+#define I2C_SLAVE_REG_PROFILE     0x04 // RW Profile index. Writing loads it.
+#define I2C_SLAVE_REG_INTERVAL    0x05 // RW Fade step interval, in ms
+#define I2C_SLAVE_REG_STEP        0x06 // RW Fade brightness step
+#define I2C_SLAVE_REG_SENSITIVITY 0x07 // RW Lux sensitivity
+#define I2C_SLAVE_REG_LUX         0x08 // R  Last lux sample (4 bytes)
+#define I2C_SLAVE_REG_BUS_ADDRESS 0x0C // R  Lamp bus address
+#define I2C_SLAVE_REG_BUS_GROUPS  0x0D // R  Lamp bus groups
+#define I2C_SLAVE_REG_TARGET      0x10 // RW Target brightness of each LED
+#define I2C_SLAVE_REG_CURRENT     0x20 // R  Brightness each LED is driven at
+#define I2C_SLAVE_REG_DMX_FRAMES  0x30 // R  DMX512 frames applied (4 bytes)
+#define I2C_SLAVE_REG_BUS_FRAMES  0x34 // R  Lamp bus frames accepted (4 bytes)
+#define I2C_SLAVE_REG_BUS_ERRORS  0x38 // R  Lamp bus CRC errors (4 bytes)
+#define I2C_SLAVE_REG_I2C_COUNT   0x3C // R  I2C transactions served (4 bytes)
+#define I2C_SLAVE_NUM_REGS        0x40
+
+#define I2C_SLAVE_ID              0x4C
+#define I2C_SLAVE_VERSION         1
+
+#define I2C_SLAVE_STATUS_ENABLE    0x01 // LEDs enabled
+#define I2C_SLAVE_STATUS_DMX       0x02 // DMX512 input mode
+#define I2C_SLAVE_STATUS_SYNCED    0x04 // Clock follows the lamp bus time
+#define I2C_SLAVE_STATUS_LUX_STALE 0x08 // Lux sample missing or stale
+
+//*****************************************************************************
+//
+// Public function prototypes.
+//
+//*****************************************************************************
+void i2c_slave_init(void);
+void i2c_slave_process(void);
+
+#endif
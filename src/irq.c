@@ -0,0 +1,256 @@
+//*****************************************************************************
+//
+// irq.c - Interrupt priority map and jitter monitor
+//
+// Every interrupt starts at the same priority, so a handler that blocks,
+// such as the lux sensor read on the I2C bus, delays every other one. The
+// map below gives each handler a level once all modules are initialized.
+// Handlers that time the light come first, then the buttons, then the
+// communication links, then the sensor and finally the console.
+//
+// The jitter monitor measures how late the periodic handlers run. Each
+// handler records the time it starts. The time from the previous start
+// minus the timer period is how much later than its deadline the handler
+// started, compared with the previous one. The period is read back from the
+// timer, so the rounding of the load value does not show as lateness.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "inc/hw_ints.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/timer.h"
+
+#include "irq.h"
+#include "timer_ext.h"
+
+//*****************************************************************************
+//
+// Priority map. Modules enable their own interrupts, the map only sets the
+// level of each.
+//
+//*****************************************************************************
+struct irq_priority
+{
+	uint32_t interrupt;
+	uint8_t level;
+};
+
+static const struct irq_priority IRQ_PRIORITY_MAP[] =
+{
+	// Timed fade start and end alarms, and the bus clock
+	{INT_WTIMER0A, 0},
+	
+	// Fade steps, the only handler writing the LED outputs, and DMX512,
+	// which must re-arm its capture before the next frame starts
+	{INT_TIMER1A,  1},
+	{INT_UART1,    1},
+	{INT_SSI0,     1},
+	{INT_UDMAERR,  1},
+	
+	// Buttons
+	{INT_TIMER0A,  2},
+	
+	// Lamp bus and I2C slave links
+	{INT_UART3,    3},
+	{INT_I2C1,     3},
+	
+	// Lux sensor read, blocks on the I2C bus, the dimmer knob, the thermal
+	// limiter and the daily schedule
+	{INT_TIMER1B,  4},
+	{INT_ADC0SS3,  4},
+	{INT_TIMER3A,  4},
+	{INT_HIBERNATE, 4},
+	
+	// Console
+	{INT_UART0,    5},
+	
+	// LED layer composite. The handlers above only change layers, the
+	// composite runs once they have all returned.
+	{FAULT_PENDSV, 7},
+};
+
+#define IRQ_PRIORITY_MAP_SIZE (sizeof(IRQ_PRIORITY_MAP) / sizeof(IRQ_PRIORITY_MAP[0]))
+
+//*****************************************************************************
+//
+// Jitter monitor state
+//
+//*****************************************************************************
+static const char * const IRQ_JITTER_NAMES[IRQ_NUM_JITTER] =
+{
+	"Fade",
+	"Button",
+	"Lux",
+};
+
+struct irq_jitter_timer
+{
+	uint32_t base;
+	uint32_t timer;
+	uint32_t timeout; // Timeout interrupt flag of the timer
+};
+
+static struct irq_jitter _jitter[IRQ_NUM_JITTER];
+static struct irq_jitter_timer _timers[IRQ_NUM_JITTER];
+static uint32_t _ticks_per_us;
+
+//*****************************************************************************
+//
+//! Applies the interrupt priority map
+//!
+//! \return None.
+//
+//*****************************************************************************
+void irq_init(void)
+{
+	IntPriorityGroupingSet(IRQ_PREEMPT_BITS);
+	
+	for (uint32_t i = 0; i < IRQ_PRIORITY_MAP_SIZE; i++)
+		IntPrioritySet(IRQ_PRIORITY_MAP[i].interrupt, IRQ_PRIORITY(IRQ_PRIORITY_MAP[i].level));
+}
+
+//*****************************************************************************
+//
+//! Sets the timer of a periodic handler
+//!
+//! \param source is the handler, as one of the IRQ_JITTER defines
+//! \param base is the base address of the timer peripheral
+//! \param timer is the half of the timer, as \b TIMER_A or \b TIMER_B. The
+//! timer must count down.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void irq_jitter_timer_set(uint32_t source, uint32_t base, uint32_t timer)
+{
+	if (source >= IRQ_NUM_JITTER)
+		return;
+	
+	_ticks_per_us = SysCtlClockGet() / 1000000;
+	_timers[source].base = base;
+	_timers[source].timer = timer;
+	_timers[source].timeout = timer == TIMER_B ? TIMER_TIMB_TIMEOUT : TIMER_TIMA_TIMEOUT;
+}
+
+//*****************************************************************************
+//
+//! Records the start of a periodic handler
+//!
+//! \param source is the handler, as one of the IRQ_JITTER defines
+//!
+//! This function is called first thing in the handler, before the timeout
+//! interrupt is cleared. The lateness is read from the count of the timer
+//! since its timeout. A handler started without a timeout, such as one
+//! triggered by software, is counted apart.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void irq_jitter_record(uint32_t source)
+{
+	struct irq_jitter *jitter = &_jitter[source];
+	const struct irq_jitter_timer *timer = &_timers[source];
+	uint32_t late, bucket;
+	
+	if (timer->base == 0)
+		return;
+	
+	late = timer_elapsed_ticks_get(timer->base, timer->timer);
+	if (!(TimerIntStatus(timer->base, false) & timer->timeout))
+	{
+		jitter->triggered++;
+		return;
+	}
+	
+	late /= _ticks_per_us;
+	for (bucket = 0; bucket < IRQ_JITTER_BUCKETS - 1 && (late >> bucket) != 0; bucket++);
+	
+	jitter->buckets[bucket]++;
+	jitter->count++;
+	if (late > jitter->max_us)
+		jitter->max_us = late;
+}
+
+//*****************************************************************************
+//
+//! Gets the jitter histogram of a periodic handler
+//!
+//! \param source is the handler, as one of the IRQ_JITTER defines
+//! \param jitter is set to the histogram
+//!
+//! \return None.
+//
+//*****************************************************************************
+void irq_jitter_get(uint32_t source, struct irq_jitter *jitter)
+{
+	if (source >= IRQ_NUM_JITTER)
+		return;
+	
+	IntMasterDisable();
+	*jitter = _jitter[source];
+	IntMasterEnable();
+}
+
+//*****************************************************************************
+//
+//! Clears the jitter histograms
+//!
+//! \return None.
+//
+//*****************************************************************************
+void irq_jitter_clear(void)
+{
+	IntMasterDisable();
+	for (uint32_t source = 0; source < IRQ_NUM_JITTER; source++)
+	{
+		_jitter[source].count = 0;
+		_jitter[source].max_us = 0;
+		_jitter[source].triggered = 0;
+		for (uint32_t i = 0; i < IRQ_JITTER_BUCKETS; i++)
+			_jitter[source].buckets[i] = 0;
+	}
+	IntMasterEnable();
+}
+
+//*****************************************************************************
+//
+//! Gets the name of a periodic handler
+//!
+//! \param source is the handler, as one of the IRQ_JITTER defines
+//!
+//! \return the name
+//
+//*****************************************************************************
+const char *irq_jitter_name_get(uint32_t source)
+{
+	if (source >= IRQ_NUM_JITTER)
+		return "";
+	
+	return IRQ_JITTER_NAMES[source];
+}
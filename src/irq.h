@@ -0,0 +1,83 @@
+//*****************************************************************************
+//
+// irq.h - Headers for the interrupt priority map and jitter monitor
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#ifndef IRQ_H
+#define IRQ_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//*****************************************************************************
+//
+// The TM4C123 implements 3 priority bits, held in the top bits of the 
+// priority byte. IRQ_PREEMPT_BITS of them select the preemption level and
+// the rest only order pending interrupts of the same level. With fewer 
+// preemption bits, interrupts sharing the upper bits no longer nest.
+//
+//*****************************************************************************
+#define IRQ_PREEMPT_BITS  3 // 0 to 3
+
+#define IRQ_PRIORITY(level) ((level) << 5) // Level 0 (highest) to 7 (lowest)
+
+//
+// Periodic handlers watched by the jitter monitor
+//
+#define IRQ_JITTER_FADE    0 // TIMER1A fade step
+#define IRQ_JITTER_BUTTON  1 // TIMER0A button poll
+#define IRQ_JITTER_LUX     2 // TIMER1B lux sensor read
+#define IRQ_NUM_JITTER     3
+
+//
+// Bucket 0 counts handlers on time, bucket n handlers late by 2^(n-1) to
+// 2^n - 1 us. The last bucket also counts anything later. The lateness is
+// the time the timer counted since its timeout, read as the handler starts.
+//
+#define IRQ_JITTER_BUCKETS 16
+
+struct irq_jitter
+{
+	uint32_t count;     // Handlers measured
+	uint32_t max_us;    // Latest handler
+	uint32_t triggered; // Handlers not started by a timeout, such as ones
+	                    // 	triggered by software
+	uint32_t buckets[IRQ_JITTER_BUCKETS];
+};
+
+//*****************************************************************************
+//
+// Public function prototypes.
+//
+//*****************************************************************************
+void irq_init(void);
+void irq_jitter_timer_set(uint32_t source, uint32_t base, uint32_t timer);
+void irq_jitter_record(uint32_t source);
+void irq_jitter_get(uint32_t source, struct irq_jitter *jitter);
+void irq_jitter_clear(void);
+const char *irq_jitter_name_get(uint32_t source);
+
+#endif
@@ -0,0 +1,678 @@
+//*****************************************************************************
+//
+// lampbus.c - RS-485 multi-drop lamp bus
+//
+// Many lamps share one RS-485 pair on UART3 (PC6/PC7). The transceiver driver
+// is enabled by PC5 while a lamp replies; its receiver is expected to be
+// disabled at the same time so a lamp does not hear its own replies.
+//
+// The start of every frame is stamped with the local time, see clock.c. The
+// bytes are only read when the FIFO is half full or the line goes idle, so
+// the time is worked back from the number of bytes read after it.
+//
+// Every frame carries a destination: a lamp address, the broadcast address,
+// or a group mask. The frame is parsed one byte at a time in the receive
+// interrupt and the destination is checked as soon as the header is in.
+// Frames for other lamps are skipped by counting down their remaining bytes,
+// so they are never copied nor checked. Only frames for this lamp are stored
+// in a small queue. They are applied by lampbus_process() from the main loop
+// and unicast frames are acknowledged.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "inc/hw_types.h"
+#include "inc/hw_memmap.h"
+#include "inc/hw_ints.h"
+#include "inc/hw_uart.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/pin_map.h"
+#include "driverlib/gpio.h"
+#include "driverlib/uart.h"
+#include "driverlib/interrupt.h"
+
+#include "lampbus.h"
+#include "clock.h"
+#include "fade.h"
+#include "led.h"
+#include "cct.h"
+#include "log.h"
+#include "settings.h"
+
+//*****************************************************************************
+//
+// Module Configuration Defines
+//
+//*****************************************************************************
+#define LAMPBUS_UART_BASE   UART3_BASE      // UART connected to the transceiver
+#define LAMPBUS_BAUD_RATE   115200
+#define LAMPBUS_BYTE_NS     (10 * 1000000000ull / LAMPBUS_BAUD_RATE) // Time of
+                                            //  a byte with start and stop bits
+#define LAMPBUS_TIMEOUT_US  (32 * 1000000 / LAMPBUS_BAUD_RATE) // Idle time
+                                            //  before the receive timeout
+#define LAMPBUS_DE_PORT     GPIO_PORTC_BASE // Transceiver driver enable
+#define LAMPBUS_DE_PIN      GPIO_PIN_5
+#define LAMPBUS_QUEUE_SIZE  4               // Frames waiting to be applied.
+                                            //  Must be a power of 2.
+#define LAMPBUS_VERSION     1               // Version of the saved settings
+
+//
+// Receive states, one per field of the frame
+//
+#define LAMPBUS_RX_SOF      0
+#define LAMPBUS_RX_LEN      1
+#define LAMPBUS_RX_DST      2
+#define LAMPBUS_RX_GROUPS   3
+#define LAMPBUS_RX_SEQ      4
+#define LAMPBUS_RX_CMD      5
+#define LAMPBUS_RX_PAYLOAD  6
+#define LAMPBUS_RX_CRC      7
+#define LAMPBUS_RX_SKIP     8 // Counting down a frame for another lamp
+
+//*****************************************************************************
+//
+// Frames accepted by the receive interrupt
+//
+//*****************************************************************************
+struct lampbus_frame
+{
+	uint32_t time;     // Local time of the start of frame, in us
+	uint8_t dst;
+	uint8_t seq;
+	uint8_t cmd;
+	uint8_t length;
+	uint8_t payload[LAMPBUS_MAX_PAYLOAD];
+};
+
+//*****************************************************************************
+//
+// Address of the lamp, saved in the settings
+//
+//*****************************************************************************
+struct lampbus_settings
+{
+	uint8_t address;
+	uint8_t groups;
+	uint8_t reserved[2];
+};
+
+//*****************************************************************************
+//
+// CRC-8 table, polynomial x^8 + x^2 + x + 1 (0x07)
+//
+//*****************************************************************************
+static const uint8_t _crc_table[256] =
+{
+	0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+	0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65, 0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D,
+	0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+	0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85, 0xA8, 0xAF, 0xA6, 0xA1, 0xB4, 0xB3, 0xBA, 0xBD,
+	0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2, 0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA,
+	0xB7, 0xB0, 0xB9, 0xBE, 0xAB, 0xAC, 0xA5, 0xA2, 0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+	0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32, 0x1F, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0D, 0x0A,
+	0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42, 0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A,
+	0x89, 0x8E, 0x87, 0x80, 0x95, 0x92, 0x9B, 0x9C, 0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+	0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC, 0xC1, 0xC6, 0xCF, 0xC8, 0xDD, 0xDA, 0xD3, 0xD4,
+	0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C, 0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44,
+	0x19, 0x1E, 0x17, 0x10, 0x05, 0x02, 0x0B, 0x0C, 0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+	0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B, 0x76, 0x71, 0x78, 0x7F, 0x6A, 0x6D, 0x64, 0x63,
+	0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B, 0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13,
+	0xAE, 0xA9, 0xA0, 0xA7, 0xB2, 0xB5, 0xBC, 0xBB, 0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+	0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB, 0xE6, 0xE1, 0xE8, 0xEF, 0xFA, 0xFD, 0xF4, 0xF3,
+};
+
+//*****************************************************************************
+//
+// Internal variables
+//
+//*****************************************************************************
+static struct lampbus_settings _settings;
+
+static struct lampbus_frame _queue[LAMPBUS_QUEUE_SIZE];
+static volatile uint32_t _queue_head; // Written by the receive interrupt
+static volatile uint32_t _queue_tail; // Written by lampbus_process()
+
+static uint32_t _rx_state;
+static uint32_t _rx_count;            // Payload bytes received, or bytes
+                                      //  left to skip
+static uint8_t _rx_length;
+static uint8_t _rx_dst;
+static uint8_t _rx_crc;
+static uint32_t _rx_time;
+static struct lampbus_frame *_rx_frame;
+
+static struct lampbus_stats _stats;
+
+//*****************************************************************************
+//
+// Prototypes for private functions
+//
+//*****************************************************************************
+static void lampbus_rx_byte(uint8_t byte);
+static bool lampbus_rx_match(uint8_t dst, uint8_t groups);
+static uint8_t lampbus_frame_apply(const struct lampbus_frame *frame);
+static void lampbus_reply(const struct lampbus_frame *frame, uint8_t status);
+static uint8_t lampbus_crc8(const uint8_t *data, uint32_t length);
+static uint32_t lampbus_u32_get(const uint8_t *data);
+
+//*****************************************************************************
+//
+//! UART3 interrupt handler. Raised when the receive FIFO is half full, when
+//! the line goes idle with bytes left in the FIFO, on receive errors, and at
+//! the end of a reply.
+//
+//*****************************************************************************
+void UART3_Handler(void)
+{
+	uint32_t status, now, num_bytes, delay_us;
+	int32_t data[16];
+
+	now = clock_local_get();
+	status = UARTIntStatus(LAMPBUS_UART_BASE, true);
+	UARTIntClear(LAMPBUS_UART_BASE, status);
+
+	if (status & UART_INT_TX)
+	{
+		// Reply fully shifted out. Release the bus.
+		UARTIntDisable(LAMPBUS_UART_BASE, UART_INT_TX);
+		GPIOPinWrite(LAMPBUS_DE_PORT, LAMPBUS_DE_PIN, 0);
+	}
+
+	// A timeout is raised a fixed time after the last byte
+	delay_us = (status & UART_INT_RX) ? 0 : LAMPBUS_TIMEOUT_US;
+
+	while (UARTCharsAvail(LAMPBUS_UART_BASE))
+	{
+		// Read the FIFO first to know how long ago each byte ended
+		num_bytes = 0;
+		while (num_bytes < 16 && UARTCharsAvail(LAMPBUS_UART_BASE))
+			data[num_bytes++] = UARTCharGetNonBlocking(LAMPBUS_UART_BASE);
+
+		for (uint32_t i = 0; i < num_bytes; i++)
+		{
+			if (data[i] & (UART_DR_FE | UART_DR_OE | UART_DR_BE))
+			{
+				// Drop the frame in progress and wait for the next one
+				_rx_state = LAMPBUS_RX_SOF;
+				continue;
+			}
+
+			if (_rx_state == LAMPBUS_RX_SOF && (data[i] & 0xFF) == LAMPBUS_SOF)
+				_rx_time = now - delay_us - ((num_bytes - i) * LAMPBUS_BYTE_NS) / 1000;
+
+			lampbus_rx_byte(data[i] & 0xFF);
+		}
+
+		// Bytes left in the FIFO arrived while these were handled
+		now = clock_local_get();
+		delay_us = 0;
+	}
+
+	if (status & (UART_INT_FE | UART_INT_OE))
+		UARTRxErrorClear(LAMPBUS_UART_BASE);
+}
+
+//*****************************************************************************
+//
+//! Initializes the lamp bus
+//!
+//! This function configures UART3 and the driver enable pin, loads the
+//! address of the lamp from the settings and starts receiving. settings_init()
+//! must be called first.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void lampbus_init(void)
+{
+	//***************************************************************************
+	//
+	// Initialize module variables
+	//
+	//***************************************************************************
+	_settings.address = LAMPBUS_ADDR_HOST;
+	_settings.groups = 0;
+	if (settings_load(SETTINGS_BLOCK_LAMPBUS, LAMPBUS_VERSION, &_settings, sizeof(_settings)))
+		log_msg_value(LOG_SUB_SYSTEM_LAMPBUS, LOG_LEVEL_DEBUG, "Loaded address", _settings.address);
+
+	_queue_head = 0;
+	_queue_tail = 0;
+	_rx_state = LAMPBUS_RX_SOF;
+
+	//***************************************************************************
+	//
+	// Initialize UART3 and the driver enable pin
+	//
+	//***************************************************************************
+	SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOC);
+	while (!SysCtlPeripheralReady(SYSCTL_PERIPH_GPIOC)){};
+	SysCtlPeripheralEnable(SYSCTL_PERIPH_UART3);
+	while (!SysCtlPeripheralReady(SYSCTL_PERIPH_UART3)){};
+
+	GPIOPinTypeGPIOOutput(LAMPBUS_DE_PORT, LAMPBUS_DE_PIN);
+	GPIOPinWrite(LAMPBUS_DE_PORT, LAMPBUS_DE_PIN, 0);
+
+	GPIOPinConfigure(GPIO_PC6_U3RX);
+	GPIOPinConfigure(GPIO_PC7_U3TX);
+	GPIOPinTypeUART(GPIO_PORTC_BASE, GPIO_PIN_6 | GPIO_PIN_7);
+
+	UARTConfigSetExpClk(LAMPBUS_UART_BASE, SysCtlClockGet(), LAMPBUS_BAUD_RATE,
+		UART_CONFIG_WLEN_8 | UART_CONFIG_STOP_ONE | UART_CONFIG_PAR_NONE);
+	UARTFIFOEnable(LAMPBUS_UART_BASE);
+	UARTFIFOLevelSet(LAMPBUS_UART_BASE, UART_FIFO_TX4_8, UART_FIFO_RX4_8);
+	UARTTxIntModeSet(LAMPBUS_UART_BASE, UART_TXINT_MODE_EOT);
+
+	UARTIntClear(LAMPBUS_UART_BASE, UART_INT_RX | UART_INT_RT | UART_INT_FE |
+		UART_INT_OE | UART_INT_TX);
+	UARTIntEnable(LAMPBUS_UART_BASE, UART_INT_RX | UART_INT_RT | UART_INT_FE |
+		UART_INT_OE);
+	IntEnable(INT_UART3);
+	UARTEnable(LAMPBUS_UART_BASE);
+}
+
+//*****************************************************************************
+//
+//! Sets and saves the address and groups of the lamp
+//!
+//! \param address is the lamp address, from LAMPBUS_ADDR_MIN to
+//! LAMPBUS_ADDR_MAX, or LAMPBUS_ADDR_HOST to only accept broadcast and group
+//! frames
+//! \param groups is the mask of the groups the lamp belongs to
+//!
+//! \return true if the address was set and saved, false otherwise
+//
+//*****************************************************************************
+bool lampbus_address_set(uint32_t address, uint32_t groups)
+{
+	if ((address != LAMPBUS_ADDR_HOST && (address < LAMPBUS_ADDR_MIN ||
+		address > LAMPBUS_ADDR_MAX)) || groups > 0xFF)
+		return false;
+
+	// The receive interrupt filters on these
+	IntDisable(INT_UART3);
+	_settings.address = address;
+	_settings.groups = groups;
+	IntEnable(INT_UART3);
+
+	log_msg_value(LOG_SUB_SYSTEM_LAMPBUS, LOG_LEVEL_DEBUG, "Setting address", address);
+	log_msg_value(LOG_SUB_SYSTEM_LAMPBUS, LOG_LEVEL_DEBUG, "Setting groups", groups);
+
+	return settings_save(SETTINGS_BLOCK_LAMPBUS, LAMPBUS_VERSION, &_settings, sizeof(_settings));
+}
+
+//*****************************************************************************
+//
+//! Gets the lamp address
+//!
+//! \return The lamp address, or LAMPBUS_ADDR_HOST if none is assigned
+//
+//*****************************************************************************
+uint32_t lampbus_address_get(void)
+{
+	return _settings.address;
+}
+
+//*****************************************************************************
+//
+//! Gets the groups of the lamp
+//!
+//! \return The mask of the groups the lamp belongs to
+//
+//*****************************************************************************
+uint32_t lampbus_groups_get(void)
+{
+	return _settings.groups;
+}
+
+//*****************************************************************************
+//
+//! Applies the frames received for this lamp
+//!
+//! This function is called from the main loop. Unicast frames are
+//! acknowledged with a reply carrying the status of the command.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void lampbus_process(void)
+{
+	while (_queue_tail != _queue_head)
+	{
+		struct lampbus_frame *frame = &_queue[_queue_tail % LAMPBUS_QUEUE_SIZE];
+		uint8_t status = lampbus_frame_apply(frame);
+
+		if (frame->dst != LAMPBUS_ADDR_BROADCAST && frame->dst != LAMPBUS_ADDR_GROUP)
+			lampbus_reply(frame, status);
+
+		_queue_tail++;
+	}
+}
+
+//*****************************************************************************
+//
+//! Gets the bus counters
+//!
+//! \param stats is set to the counters
+//!
+//! \return None.
+//
+//*****************************************************************************
+void lampbus_stats_get(struct lampbus_stats *stats)
+{
+	IntDisable(INT_UART3);
+	*stats = _stats;
+	IntEnable(INT_UART3);
+}
+
+//*****************************************************************************
+//
+//! Runs one received byte through the frame parser
+//!
+//! \param byte is the received byte
+//!
+//! The destination is checked once GROUPS is received. The CRC is only
+//! computed for frames that pass, starting from the header bytes kept in the
+//! parser state.
+//
+//*****************************************************************************
+static void lampbus_rx_byte(uint8_t byte)
+{
+	switch (_rx_state)
+	{
+		case LAMPBUS_RX_SOF:
+			if (byte == LAMPBUS_SOF)
+				_rx_state = LAMPBUS_RX_LEN;
+			break;
+
+		case LAMPBUS_RX_LEN:
+			// A length out of range means we are out of step with the bus
+			_rx_length = byte;
+			_rx_state = byte <= LAMPBUS_MAX_PAYLOAD ? LAMPBUS_RX_DST : LAMPBUS_RX_SOF;
+			break;
+
+		case LAMPBUS_RX_DST:
+			_rx_dst = byte;
+			_rx_state = LAMPBUS_RX_GROUPS;
+			break;
+
+		case LAMPBUS_RX_GROUPS:
+			if (!lampbus_rx_match(_rx_dst, byte))
+			{
+				_stats.ignored++;
+			}
+			else if (_queue_head - _queue_tail >= LAMPBUS_QUEUE_SIZE)
+			{
+				_stats.overflows++;
+			}
+			else
+			{
+				_rx_frame = &_queue[_queue_head % LAMPBUS_QUEUE_SIZE];
+				_rx_frame->time = _rx_time;
+				_rx_frame->dst = _rx_dst;
+				_rx_frame->length = _rx_length;
+				_rx_crc = _crc_table[_crc_table[_crc_table[_rx_length] ^ _rx_dst] ^ byte];
+				_rx_state = LAMPBUS_RX_SEQ;
+				break;
+			}
+
+			// Skip the sequence number, command, payload and CRC
+			_rx_count = _rx_length + 3;
+			_rx_state = LAMPBUS_RX_SKIP;
+			break;
+
+		case LAMPBUS_RX_SEQ:
+			_rx_frame->seq = byte;
+			_rx_crc = _crc_table[_rx_crc ^ byte];
+			_rx_state = LAMPBUS_RX_CMD;
+			break;
+
+		case LAMPBUS_RX_CMD:
+			_rx_frame->cmd = byte;
+			_rx_crc = _crc_table[_rx_crc ^ byte];
+			_rx_count = 0;
+			_rx_state = _rx_length ? LAMPBUS_RX_PAYLOAD : LAMPBUS_RX_CRC;
+			break;
+
+		case LAMPBUS_RX_PAYLOAD:
+			_rx_frame->payload[_rx_count++] = byte;
+			_rx_crc = _crc_table[_rx_crc ^ byte];
+			if (_rx_count == _rx_length)
+				_rx_state = LAMPBUS_RX_CRC;
+			break;
+
+		case LAMPBUS_RX_CRC:
+			if (byte == _rx_crc)
+			{
+				_queue_head++;
+				_stats.accepted++;
+			}
+			else
+			{
+				_stats.crc_errors++;
+			}
+			_rx_state = LAMPBUS_RX_SOF;
+			break;
+
+		case LAMPBUS_RX_SKIP:
+			if (--_rx_count == 0)
+				_rx_state = LAMPBUS_RX_SOF;
+			break;
+	}
+}
+
+//*****************************************************************************
+//
+//! Checks whether a frame is addressed to this lamp
+//!
+//! \param dst is the destination of the frame
+//! \param groups is the group mask of the frame
+//!
+//! \return true if the frame is for this lamp
+//
+//*****************************************************************************
+static bool lampbus_rx_match(uint8_t dst, uint8_t groups)
+{
+	if (dst == LAMPBUS_ADDR_BROADCAST)
+		return true;
+
+	if (dst == LAMPBUS_ADDR_GROUP)
+		return (groups & _settings.groups) != 0;
+
+	// Replies to the host are never for a lamp, even one without an address
+	return dst != LAMPBUS_ADDR_HOST && dst == _settings.address;
+}
+
+//*****************************************************************************
+//
+//! Applies the command of a received frame
+//!
+//! \param frame is the received frame
+//!
+//! \return The status of the command, as one of the LAMPBUS_STATUS defines
+//
+//*****************************************************************************
+static uint8_t lampbus_frame_apply(const struct lampbus_frame *frame)
+{
+	const uint8_t *payload = frame->payload;
+	uint8_t targets[LED_NUM_LEDS];
+	uint8_t select[LED_NUM_LEDS];
+
+	switch (frame->cmd)
+	{
+		case LAMPBUS_CMD_PING:
+			return LAMPBUS_STATUS_OK;
+
+		case LAMPBUS_CMD_ENABLE:
+			if (frame->length != 1)
+				return LAMPBUS_STATUS_BAD_PAYLOAD;
+			led_sw_enable_set(payload[0] != 0);
+			return LAMPBUS_STATUS_OK;
+
+		case LAMPBUS_CMD_BRIGHTNESS:
+			if (frame->length == 0 || frame->length % 2 != 0)
+				return LAMPBUS_STATUS_BAD_PAYLOAD;
+			for (uint32_t i = 0; i < frame->length; i += 2)
+			{
+				if (payload[i] >= led_num_leds_get())
+					return LAMPBUS_STATUS_BAD_PAYLOAD;
+			}
+			led_update_begin();
+			for (uint32_t i = 0; i < frame->length; i += 2)
+				led_sw_brightness_set(payload[i], payload[i + 1]);
+			led_update_end();
+			return LAMPBUS_STATUS_OK;
+
+		case LAMPBUS_CMD_PROFILE:
+			if (frame->length != 1)
+				return LAMPBUS_STATUS_BAD_PAYLOAD;
+			led_profile_load(payload[0]);
+			return LAMPBUS_STATUS_OK;
+
+		case LAMPBUS_CMD_CCT:
+			if (frame->length != 3)
+				return LAMPBUS_STATUS_BAD_PAYLOAD;
+			cct_set(payload[0] | ((uint32_t)payload[1] << 8), payload[2]);
+			return LAMPBUS_STATUS_OK;
+
+		case LAMPBUS_CMD_DIMMER:
+			if (frame->length != 1)
+				return LAMPBUS_STATUS_BAD_PAYLOAD;
+			led_master_dimmer_set(payload[0]);
+			return LAMPBUS_STATUS_OK;
+
+		case LAMPBUS_CMD_GROUPS:
+			// Only a lamp addressed on its own can be moved between groups
+			if (frame->dst != _settings.address)
+				return LAMPBUS_STATUS_BAD_COMMAND;
+			if (frame->length != 1)
+				return LAMPBUS_STATUS_BAD_PAYLOAD;
+			lampbus_address_set(_settings.address, payload[0]);
+			return LAMPBUS_STATUS_OK;
+
+		case LAMPBUS_CMD_SYNC:
+			if (frame->length != 4)
+				return LAMPBUS_STATUS_BAD_PAYLOAD;
+			clock_beacon(lampbus_u32_get(payload), frame->time);
+			return LAMPBUS_STATUS_OK;
+
+		case LAMPBUS_CMD_FADE_AT:
+			if (frame->length <= 6 || frame->length % 2 != 0)
+				return LAMPBUS_STATUS_BAD_PAYLOAD;
+			memset(select, 0, sizeof(select));
+			for (uint32_t i = 6; i < frame->length; i += 2)
+			{
+				if (payload[i] >= LED_NUM_LEDS)
+					return LAMPBUS_STATUS_BAD_PAYLOAD;
+				targets[payload[i]] = payload[i + 1];
+				select[payload[i]] = 1;
+			}
+			fade_start(targets, select, lampbus_u32_get(payload), payload[4] | (payload[5] << 8));
+			return LAMPBUS_STATUS_OK;
+
+		case LAMPBUS_CMD_PROFILE_AT:
+			if (frame->length != 7)
+				return LAMPBUS_STATUS_BAD_PAYLOAD;
+			memset(select, 0, sizeof(select));
+			if (!led_profile_targets_get(payload[6], targets, select))
+				return LAMPBUS_STATUS_BAD_PAYLOAD;
+			fade_start(targets, select, lampbus_u32_get(payload), payload[4] | (payload[5] << 8));
+			return LAMPBUS_STATUS_OK;
+
+		default:
+			log_msg_value(LOG_SUB_SYSTEM_LAMPBUS, LOG_LEVEL_WARNING, "Unknown command", frame->cmd);
+			return LAMPBUS_STATUS_BAD_COMMAND;
+	}
+}
+
+//*****************************************************************************
+//
+//! Sends the reply to a unicast frame
+//!
+//! \param frame is the frame being acknowledged
+//! \param status is the status of the command
+//!
+//! The reply fits in the transmit FIFO, so this function does not wait for
+//! it to be sent. The driver is released by the end of transmission
+//! interrupt.
+//
+//*****************************************************************************
+static void lampbus_reply(const struct lampbus_frame *frame, uint8_t status)
+{
+	uint8_t reply[LAMPBUS_HEADER_SIZE + 2];
+
+	reply[0] = LAMPBUS_SOF;
+	reply[1] = 1;
+	reply[2] = LAMPBUS_ADDR_HOST;
+	reply[3] = 0;
+	reply[4] = frame->seq;
+	reply[5] = frame->cmd | LAMPBUS_CMD_REPLY;
+	reply[6] = status;
+	reply[7] = lampbus_crc8(&reply[1], sizeof(reply) - 2);
+
+	GPIOPinWrite(LAMPBUS_DE_PORT, LAMPBUS_DE_PIN, LAMPBUS_DE_PIN);
+	for (uint32_t i = 0; i < sizeof(reply); i++)
+		UARTCharPut(LAMPBUS_UART_BASE, reply[i]);
+
+	UARTIntClear(LAMPBUS_UART_BASE, UART_INT_TX);
+	UARTIntEnable(LAMPBUS_UART_BASE, UART_INT_TX);
+}
+
+//*****************************************************************************
+//
+//! Computes the CRC-8 of a block of bytes
+//!
+//! \param data is the data
+//! \param length is the number of bytes
+//!
+//! \return The CRC
+//
+//*****************************************************************************
+static uint8_t lampbus_crc8(const uint8_t *data, uint32_t length)
+{
+	uint8_t crc = 0;
+
+	for (uint32_t i = 0; i < length; i++)
+		crc = _crc_table[crc ^ data[i]];
+
+	return crc;
+}
+
+//*****************************************************************************
+//
+//! Reads a little endian 32 bit field of a payload
+//!
+//! \param data is the first byte of the field
+//!
+//! \return The value of the field
+//
+//*****************************************************************************
+static uint32_t lampbus_u32_get(const uint8_t *data)
+{
+	return data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) |
+		((uint32_t)data[3] << 24);
+}
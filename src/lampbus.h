@@ -0,0 +1,108 @@
+//*****************************************************************************
+//
+// lampbus.h - Headers for the RS-485 multi-drop lamp bus
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#ifndef LAMPBUS_H
+#define LAMPBUS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//
+// Frame layout. The CRC-8 covers every byte after the start of frame.
+//
+//   SOF | LEN | DST | GROUPS | SEQ | CMD | PAYLOAD (LEN bytes) | CRC
+//
+#define LAMPBUS_SOF           0x7E // Start of frame
+#define LAMPBUS_HEADER_SIZE   6    // Bytes before the payload
+#define LAMPBUS_MAX_PAYLOAD   32   // Largest payload accepted, in bytes
+
+//
+// Multi-byte fields are little endian. Start times are bus times in us, see
+// clock.h.
+//
+
+//
+// Destination addresses
+//
+#define LAMPBUS_ADDR_HOST      0x00 // Host controller. Lamps reply to it.
+#define LAMPBUS_ADDR_MIN       0x01 // First lamp address
+#define LAMPBUS_ADDR_MAX       0xFC // Last lamp address
+#define LAMPBUS_ADDR_GROUP     0xFE // Lamps in any group set in GROUPS
+#define LAMPBUS_ADDR_BROADCAST 0xFF // All lamps
+
+//
+// Commands. Replies from the lamps set LAMPBUS_CMD_REPLY in the command.
+//
+#define LAMPBUS_CMD_PING       0x00 // No payload
+#define LAMPBUS_CMD_ENABLE     0x01 // enable
+#define LAMPBUS_CMD_BRIGHTNESS 0x02 // Pairs of led_type, brightness
+#define LAMPBUS_CMD_PROFILE    0x03 // index
+#define LAMPBUS_CMD_CCT        0x04 // kelvin (little endian, 2 bytes), intensity
+#define LAMPBUS_CMD_DIMMER     0x05 // level
+#define LAMPBUS_CMD_GROUPS     0x06 // groups. Saved to the settings.
+#define LAMPBUS_CMD_SYNC       0x07 // Bus time in us at the start of the frame
+                                    //  (4 bytes)
+#define LAMPBUS_CMD_FADE_AT    0x08 // start (4 bytes), duration_ms (2 bytes),
+                                    //  then pairs of led_type, brightness
+#define LAMPBUS_CMD_PROFILE_AT 0x09 // start (4 bytes), duration_ms (2 bytes),
+                                    //  index
+#define LAMPBUS_CMD_REPLY      0x80
+
+//
+// Status carried in the payload of a reply
+//
+#define LAMPBUS_STATUS_OK          0
+#define LAMPBUS_STATUS_BAD_COMMAND 1
+#define LAMPBUS_STATUS_BAD_PAYLOAD 2
+
+//*****************************************************************************
+//
+// Bus counters, kept by the receive interrupt
+//
+//*****************************************************************************
+struct lampbus_stats
+{
+	uint32_t accepted;  // Frames addressed to this lamp with a valid CRC
+	uint32_t ignored;   // Frames addressed to other lamps
+	uint32_t crc_errors;
+	uint32_t overflows; // Accepted frames dropped because the queue was full
+};
+
+//*****************************************************************************
+//
+// Public function prototypes.
+//
+//*****************************************************************************
+void lampbus_init(void);
+bool lampbus_address_set(uint32_t address, uint32_t groups);
+uint32_t lampbus_address_get(void);
+uint32_t lampbus_groups_get(void);
+void lampbus_process(void);
+void lampbus_stats_get(struct lampbus_stats *stats);
+
+#endif
@@ -55,6 +55,20 @@
 #include "tsl2591.h"
 #include "common_aux.h"
 #include "timer_ext.h"
+#include "blend.h"
+#include "timeline.h"
+#include "cct.h"
+#include "calib.h"
+#include "color.h"
+#include "pca9685.h"
+#include "fade.h"
+#include "irq.h"
+#include "lux_sampler.h"
+#include "lux_curve.h"
+#include "lux_cache.h"
+#include "ease.h"
+#include "energy.h"
+#include "clock.h"
 #include "led.h"
 
 //*****************************************************************************
@@ -68,49 +82,114 @@
 																								// 	higher brightness levels
 
 #define LED_MAX_BRIGHTNESS_LEVEL     255        // Maximum brightness level
+#define LED_PWM_PERIOD               (LED_MAX_BRIGHTNESS_LEVEL * \
+	LED_MAX_BRIGHTNESS_LEVEL / LED_BRIGHTNESS_EXP_POINT) // Pulsewidth at the
+                                                // 	maximum brightness level
 #define LED_TIMER_PRESCALE           255        // Prescale value for the timers
 #define LED_TIMER_MAX_LOAD_VALUE     UINT16_MAX // Maximum load value for the timers
 #define LED_LUX_CHANGE_HYSTERESIS    30         // Maximum change in lux required to trigger
                                                 // 	an LED brightness change
-#define LED_LUX_UPDATE_RATE          1000       // Frequency to read new lux sensor value, in ms
-                                                // 	Max value 1000 (for 16 bit timer)
+#define LED_DEFAULT_MAX_LUX          200        // Lux above which the lux sensor no longer
+                                                // 	dims the LEDs, for the sensitivity line
+#define LED_LUX_SAVE_DELAY_MS        2000       // Time the sensitivity line must stay
+                                                // 	unchanged before it is saved, in ms
+#define LED_LUX_STALE_INTERVALS      2          // Longest sampling intervals after
+                                                // 	which a lux sample is stale
+#define LED_LUX_TICK_MS              50         // Time between lux sampler steps, in ms
+#define LED_LUX_TICKS(ms)            (((ms) + LED_LUX_TICK_MS - 1) / LED_LUX_TICK_MS) // Ticks
+                                                // 	covering a time in ms
 #define LED_STEP_TIME_INTERVAL       10         // Time between a single LED brightness step
                                                 // 	A higher value will yield slower fade effect
                                                 // 	Max value 1000 (for 16 bit timer)
 																								
 //*****************************************************************************
 //
-// The led_list array provides a list containing the various LEDs. The array 
-// is an array of led_info which provdies the led name, type, pwm base 
-// register, pwm out value, pwm pin bit, and pwn gen number. The last four of 
-// these values are defines defined in the "driverlib/pwm.h" file. 
+// LED_CHANNEL_LIST defines the LEDs. Each entry provides the led name, 
+// driver, pwm base register, pwm out value, pwm pin bit, and pwn gen number.
+// The last four of these values are defines defined in the "driverlib/pwm.h"
+// file. The order of the entries gives the LED index, which must match the
+// LED type defines in led.h.
+//
+// LEDs with the LED_DRIVER_PCA9685 driver are outputs of the PCA9685 PWM
+// expanders on the I2C bus. Their pwm_out value is the expander channel and
+// the other PWM values are unused. They are only built when
+// LED_PCA9685_CHANNELS in led.h is set.
+//
+// The list is expanded at compile time into LED_CONFIG, a constant table kept
+// in flash, and into LED_NUM_LEDS. The state that changes on every fade step
+// is kept apart in packed arrays of one byte per LED, so the fade loop only
+// walks contiguous words.
 //
 //*****************************************************************************
-struct led_info
+#define LED_DRIVER_PWM     0 // PWM module of the MCU
+#define LED_DRIVER_PCA9685 1 // PCA9685 I2C PWM expander
+
+#if LED_PCA9685_CHANNELS == 8
+#define LED_PCA9685_LIST(X) \
+	X(x0, LED_DRIVER_PCA9685, 0,         0,         0,             0) \
+	X(x1, LED_DRIVER_PCA9685, 0,         1,         0,             0) \
+	X(x2, LED_DRIVER_PCA9685, 0,         2,         0,             0) \
+	X(x3, LED_DRIVER_PCA9685, 0,         3,         0,             0) \
+	X(x4, LED_DRIVER_PCA9685, 0,         4,         0,             0) \
+	X(x5, LED_DRIVER_PCA9685, 0,         5,         0,             0) \
+	X(x6, LED_DRIVER_PCA9685, 0,         6,         0,             0) \
+	X(x7, LED_DRIVER_PCA9685, 0,         7,         0,             0)
+#else
+#define LED_PCA9685_LIST(X)
+#endif
+
+#define LED_CHANNEL_LIST(X) \
+	X(r,  LED_DRIVER_PWM,     PWM1_BASE, PWM_OUT_5, PWM_OUT_5_BIT, PWM_GEN_2) \
+	X(b,  LED_DRIVER_PWM,     PWM1_BASE, PWM_OUT_6, PWM_OUT_6_BIT, PWM_GEN_3) \
+	X(g,  LED_DRIVER_PWM,     PWM1_BASE, PWM_OUT_7, PWM_OUT_7_BIT, PWM_GEN_3) \
+	LED_PCA9685_LIST(X)
+
+struct led_config
 {
 	const char *name;
-	const uint32_t pwm_base_register;
-	const uint32_t pwm_out;
-	const uint32_t pwm_out_bit;
-	const uint32_t pwm_gen;
-	uint32_t current_brightness;
-	uint32_t previous_brightness;
-	uint32_t desired_brightness;
+	uint32_t driver;
+	uint32_t pwm_base_register;
+	uint32_t pwm_out;
+	uint32_t pwm_out_bit;
+	uint32_t pwm_gen;
+};
+
+#define LED_CHANNEL_INDEX(name, driver, base, out, out_bit, gen) LED_INDEX_##name,
+#define LED_CHANNEL_CONFIG(name, driver, base, out, out_bit, gen) \
+	{ #name, driver, base, out, out_bit, gen },
+
+enum
+{
+	LED_CHANNEL_LIST(LED_CHANNEL_INDEX)
+	LED_NUM_CHANNELS
 };
 
-static struct led_info LED_LIST[] = 
+// The build fails if LED_NUM_LEDS in led.h does not match LED_CHANNEL_LIST
+typedef char led_num_leds_check[LED_NUM_CHANNELS == LED_NUM_LEDS ? 1 : -1];
+
+static const struct led_config LED_CONFIG[LED_NUM_LEDS] = 
 {
-	{ "r", PWM1_BASE, PWM_OUT_5, PWM_OUT_5_BIT , PWM_GEN_2, 0, 0, 0},
-	{ "b", PWM1_BASE, PWM_OUT_6, PWM_OUT_6_BIT , PWM_GEN_3, 0, 0, 0},
-	{ "g", PWM1_BASE, PWM_OUT_7, PWM_OUT_7_BIT , PWM_GEN_3, 0, 0, 0},
-	{ "", 0,0,0,0,0,0, 0} // Terminal entry
+	LED_CHANNEL_LIST(LED_CHANNEL_CONFIG)
 };
 
+#define LED_NUM_WORDS                ((LED_NUM_LEDS + 3) / 4) // Words holding one 
+                                                // 	byte per LED
+
+//*****************************************************************************
+//
+// Brightness currently output on each LED and brightness saved while the
+// LEDs are disabled, one byte per LED. Read with LED_LAYER_VALUE().
+//
+//*****************************************************************************
+static uint32_t _current[LED_NUM_WORDS];
+static uint32_t _previous[LED_NUM_WORDS];
+
 //*****************************************************************************
 //
 // led_profile_list is an array of the led_profile struct that defines various 
 // led brightness settings. led_profile contains the names and brightnesses of 
-// two leds. 
+// two leds. A profile with a non-zero kelvin value is instead a color 
+// temperature and intensity, converted by the CCT engine.
 //
 // Note: There should be no more than 254 led profiles. Anymore will cause an
 //       overflow error
@@ -122,15 +201,21 @@ struct led_profile
 	uint8_t led1_brightness;
 	uint8_t led2_type;
 	uint8_t led2_brightness;
+	uint16_t kelvin;
+	uint8_t intensity;
 };
 
 static const struct led_profile led_profile_list[] = 
 {
-	{LED_ONBOARD_BLUE, 100 , LED_ONBOARD_GREEN, 255 },
-	{LED_ONBOARD_BLUE, 0, LED_ONBOARD_GREEN, 255 },
-	{LED_ONBOARD_BLUE, 0, LED_ONBOARD_GREEN, 100 },
+	{LED_ONBOARD_BLUE, 100 , LED_ONBOARD_GREEN, 255, 0, 0 },
+	{LED_ONBOARD_BLUE, 0, LED_ONBOARD_GREEN, 255, 0, 0 },
+	{LED_ONBOARD_BLUE, 0, LED_ONBOARD_GREEN, 100, 0, 0 },
+	{0, 0, 0, 0, 2700, 255 },
+	{0, 0, 0, 0, 4000, 255 },
+	{0, 0, 0, 0, 6500, 255 },
+	{0, 0, 0, 0, 2200, 60 },
 };
-static uint8_t num_profiles = 3;
+static uint8_t num_profiles = 7;
 
 //*****************************************************************************
 //
@@ -140,12 +225,24 @@ static uint8_t num_profiles = 3;
 static uint8_t _current_profile_index;
 static uint8_t _brightness_interval;
 static uint8_t _time_internval;
-static uint32_t _num_leds;
 static uint32_t _lux_sensor_sensitivity;
 static uint32_t _max_lux;
-static float _brightness_scale;
+static uint32_t _lux_applied; // Lux the lux layer was last set for
+static bool _lux_curve_dirty;   // Sensitivity line not saved yet
+static uint32_t _lux_save_ms;   // Time to save the sensitivity line at
 static bool lux_sensor_found;
 
+//*****************************************************************************
+//
+// Lux sampler state, used by TIMER1B
+//
+//*****************************************************************************
+static uint32_t _lux_ticks;       // TIMER1B ticks since boot
+static uint32_t _lux_countdown;   // Ticks until the next sampler step
+static uint32_t _lux_start_tick;  // Tick the last sample started on
+static uint32_t _lux_atime;       // Integration time of the last sample
+static bool _lux_integrating;
+
 //*****************************************************************************
 //
 // Software enable for the LEDs. 
@@ -153,6 +250,99 @@ static bool lux_sensor_found;
 //*****************************************************************************
 static bool _sw_enable;
 
+//*****************************************************************************
+//
+// The brightness of the LEDs is composited from a fixed stack of layers. From
+// the bottom to the top these are:
+//
+// LED_LAYER_BASE    - Brightness set by profiles and commands
+// LED_LAYER_LUX     - Scale set by the lux sensor
+// LED_LAYER_EFFECT  - Effects drawn over the current scene
+// LED_LAYER_OVERLAY - Transient overlays such as notifications
+// LED_LAYER_MASTER  - Master dimmer
+// LED_LAYER_LIMIT   - Scale set by the thermal power limiter
+//
+// Each layer holds one byte per LED and is blended on top of the result of
+// the layers below it using its blend mode and opacity. The result of every
+// layer is kept in _layer_stage, so a change to a layer only recomputes that
+// layer and the layers above it. The result of the top layer goes through
+// the color calibration into _output, the brightness that TIMER1A fades the
+// LEDs toward once it is published.
+//
+// The layers are written from the main loop and from handlers at several
+// levels, so the composite only runs in PendSV, below every other handler.
+// A change made from a handler is therefore complete before it is
+// composited. Changes to several values that must show together are placed
+// between led_update_begin() and led_update_end(). _writers counts the open
+// sets, which nest since handlers do, and PendSV leaves the layers alone
+// while one is open. Each commit increments _layers_gen, so a composite that
+// a handler interrupted with a new commit is redone rather than published.
+//
+//*****************************************************************************
+struct led_layer
+{
+	uint32_t mode;
+	uint32_t opacity;
+	bool enable;
+	uint32_t values[LED_NUM_WORDS];
+};
+
+static struct led_layer _layers[LED_NUM_LAYERS];
+static uint32_t _layer_stage[LED_NUM_LAYERS][LED_NUM_WORDS];
+static volatile uint32_t _dirty_layer;  // Lowest layer changed since the last
+                                        //  composite
+static uint32_t _output[LED_NUM_WORDS];
+static volatile uint32_t _writers;      // Open sets of layer changes
+static volatile uint32_t _layers_gen;   // Number of commits
+static volatile bool _immediate;        // Jump to the next targets without the
+                                        //  fade effect
+
+#define LED_LAYER_VALUE(words, led_type) (((uint8_t *)(words))[led_type])
+
+//*****************************************************************************
+//
+// The composited brightness is handed to TIMER1A through two target sets.
+// led_targets_publish() copies _output into the set TIMER1A is not using and
+// then makes it the front set. Each set has a sequence number that is 0
+// while the set is written. TIMER1A copies the front set when its sequence
+// number is new, and keeps its previous targets for the step if the number
+// changed during the copy. Neither side waits for or masks the other.
+//
+// Only PendSV publishes, so the LEDs set by a profile start fading in the
+// same step, even if TIMER1A runs while the profile is being set. A set
+// marked immediate is applied by TIMER1A without the fade effect.
+//
+//*****************************************************************************
+struct led_targets
+{
+	uint32_t seq;
+	bool immediate;
+	uint32_t values[LED_NUM_WORDS];
+};
+
+static volatile struct led_targets _targets[2];
+static volatile uint32_t _targets_front;  // Set published last
+static volatile uint32_t _targets_count;  // Sequence number of the last publish
+static uint32_t _fade_targets[LED_NUM_WORDS]; // Targets used by TIMER1A
+static uint32_t _fade_seq;
+
+//*****************************************************************************
+//
+// Fade segment of each LED, used by TIMER1A. The byte of an LED in _easing
+// is set while its segment is still moving, so a word of LEDs at rest reads
+// 0. Read with LED_LAYER_VALUE().
+//
+//*****************************************************************************
+static struct ease_segment _ease[LED_NUM_LEDS];
+static uint32_t _easing[LED_NUM_WORDS];
+
+//
+// LEDs written by the animations in the previous step of TIMER1A, one bit
+// per LED. The animation masks need a bit for every LED.
+//
+static uint32_t _animated;
+typedef char led_animated_check[LED_NUM_LEDS <= 32 ? 1 : -1];
+
 
 //*****************************************************************************
 //
@@ -160,6 +350,15 @@ static bool _sw_enable;
 //
 //*****************************************************************************
 void led_hw_brightness_set(uint32_t led_type, uint32_t brightness);
+static void led_layer_dirty(uint32_t layer);
+static void led_composite_update(void);
+static void led_targets_publish(bool immediate);
+static bool led_targets_fetch(void);
+static void led_lux_apply(uint32_t new_lux);
+static void led_lux_sensor_lost(void);
+static void led_lux_linear_update(void);
+static void led_lux_linear_load(void);
+static uint32_t led_pulsewidth_get(uint32_t brightness);
 
 //*****************************************************************************
 //
@@ -175,32 +374,117 @@ void led_hw_brightness_set(uint32_t led_type, uint32_t brightness);
 // timer once all the LED's have reached the goal brightness.
 //
 // The time between each brightness step is defined by LED_STEP_TIME_INTERVAL.
+// Each LED follows an eased segment that takes as many steps as moving by
+// the brightness step each time. A target that changes during a fade
+// starts a new segment from the current rate of change, so the LED does not
+// reverse or restart abruptly.
+//
+// While a timeline sequence or a hue fade is running, the handler also 
+// advances it. The animated values are written to the LEDs directly since
+// the sequence or hue fade already provides the fade. They are composited
+// by PendSV once the handler returns, so they reach the LEDs on the
+// following step. Only the LEDs written by an animation in this step or the
+// previous one jump; the others keep easing. Immediate targets are written
+// directly to every LED.
 // 
 //*****************************************************************************
 void TIMER1A_Handler(void)
 {
+	irq_jitter_record(IRQ_JITTER_FADE);
+	
 	// Clear interrupt
 	TimerIntClear(TIMER1_BASE, TIMER_TIMA_TIMEOUT);
 	
 	bool no_change = true;
-	uint32_t current_brightness, desired_brightness_w_scale;
+	bool animating = false;
+	bool ticked = false;
+	uint32_t animated = 0;
+	uint32_t jump;
+	uint32_t current_brightness, composite_brightness;
+	
+	if (timeline_active())
+	{
+		animating = timeline_tick(_time_internval, &animated);
+		ticked = true;
+	}
+	if (color_fade_active())
+	{
+		animating = color_fade_tick(_time_internval, &animated) || animating;
+		ticked = true;
+	}
+	if (fade_active())
+	{
+		animating = fade_tick(&animated) || animating;
+		ticked = true;
+	}
 	
-	// Loop through each of the LEDs and increase brightness by a single step if necessary
-	for (uint32_t i = 0; i < _num_leds; i++)
+	// Publish the layers changed by the animations, including their last step
+	if (ticked)
+		led_update_hw_start();
+	
+	// The targets fetched hold the values animated in the previous step
+	jump = led_targets_fetch() ? 0xFFFFFFFF : _animated | animated;
+	_animated = animated;
+	
+	// Loop through the LEDs four at a time, skipping words of LEDs that have
+	// all reached their goal brightness and come to rest
+	for (uint32_t word = 0; word < LED_NUM_WORDS; word++)
 	{
-		current_brightness = LED_LIST[i].current_brightness;
-		desired_brightness_w_scale = LED_LIST[i].desired_brightness * _brightness_scale;
+		if (_current[word] == _fade_targets[word] && _easing[word] == 0)
+			continue;
 		
-		if (current_brightness > desired_brightness_w_scale)
-		{
-			led_hw_brightness_set(i, current_brightness - _brightness_interval);
-			no_change = false;
-		}else if (current_brightness < desired_brightness_w_scale)
+		no_change = false;
+		
+		// Move each LED one step along its segment where necessary
+		for (uint32_t i = word * 4; i < word * 4 + 4 && i < LED_NUM_LEDS; i++)
 		{
-			led_hw_brightness_set(i, current_brightness + _brightness_interval);
-			no_change = false;
+			struct ease_segment *segment = &_ease[i];
+			
+			current_brightness = LED_LAYER_VALUE(_current, i);
+			composite_brightness = LED_LAYER_VALUE(_fade_targets, i);
+			
+			if (jump & (1u << i))
+			{
+				ease_stop(segment);
+				LED_LAYER_VALUE(_easing, i) = 0;
+				if (current_brightness != composite_brightness)
+					led_hw_brightness_set(i, composite_brightness);
+				continue;
+			}
+			
+			// Start a segment for a new target, or after the LED was set
+			// by something else
+			if (segment->ticks == 0 || segment->target != composite_brightness ||
+				segment->output != current_brightness)
+				ease_retarget(segment, current_brightness, composite_brightness, _brightness_interval);
+			
+			if (segment->ticks == 0)
+			{
+				LED_LAYER_VALUE(_easing, i) = 0;
+				continue;
+			}
+			
+			composite_brightness = ease_step(segment, LED_MAX_BRIGHTNESS_LEVEL);
+			if (composite_brightness != current_brightness)
+				led_hw_brightness_set(i, composite_brightness);
+			if (segment->ticks == 0)
+				LED_LAYER_VALUE(_easing, i) = 0;
+			else
+				LED_LAYER_VALUE(_easing, i) = 1;
 		}
 	}
+	
+	// Keep the timer running while a sequence or a fade is running, even if
+	// its output did not change in this step
+	if (animating)
+		no_change = false;
+	
+#if LED_PCA9685_CHANNELS != 0
+	// Send the expander outputs changed by this step. Retry on the next step
+	// if the bus was busy.
+	if (!pca9685_flush())
+		no_change = false;
+#endif
 
 	// Disable timer if no LED was changed, indicating completion
 	if (no_change)
@@ -211,56 +495,184 @@ void TIMER1A_Handler(void)
 
 //*****************************************************************************
 //
-// TIMER1AB is used to continuously read new lux values. The handler will
-// automatically enable TIMER1A to begin updating the LED brightness if a large
-// enough change in lux is detected (set by the define 
-// LED_LUX_CHANGE_HYSTERESIS). 
+// PendSV composites the layers and publishes the result to TIMER1A. It is
+// pended by led_update_hw_start() and runs below every other handler.
+//
+// Nothing is done while a set of changes is open, led_update_end() pends
+// PendSV again. If a handler commits new changes during the composite, the
+// result is dropped. PendSV was pended again by the commit and redoes the
+// composite from the base layer.
+//
+//*****************************************************************************
+void PendSV_Handler(void)
+{
+	uint32_t gen;
+	bool immediate;
+	
+	if (_writers != 0)
+		return;
+	
+	gen = _layers_gen;
+	immediate = _immediate;
+	_immediate = false;
+	
+	led_composite_update();
+	
+	if (_layers_gen != gen)
+	{
+		led_layer_dirty(LED_LAYER_BASE);
+		if (immediate)
+			_immediate = true;
+		return;
+	}
+	
+	led_targets_publish(immediate);
+	TimerEnable(TIMER1_BASE, TIMER_A);
+	if (immediate)
+		IntTrigger(INT_TIMER1A);
+}
+
+//*****************************************************************************
+//
+// TIMER1B is used to continuously read new lux values. It ticks every
+// LED_LUX_TICK_MS. A sample starts an integration cycle of the sensor and
+// reads the result on a later tick, so the handler never waits for the
+// sensor. The interval between samples and the integration time are set by
+// the lux sampler from the variation of the readings. 
 //
-// The polling rate is defined by LED_LUX_UPDATE_RATE.
+// The handler will automatically enable TIMER1A to begin updating the LED
+// brightness if a large enough change in lux is detected (set by the define 
+// LED_LUX_CHANGE_HYSTERESIS). 
 // 
 //*****************************************************************************
 void TIMER1B_Handler(void)	
 {
-	static uint32_t current_lux = UINT32_MAX;
+	struct tsl2591_sample sample;
+	uint32_t status, interval, elapsed;
+	bool valid;
+	
+	irq_jitter_record(IRQ_JITTER_LUX);
 	
 	// Clear interrupt
 	TimerIntClear(TIMER1_BASE, TIMER_TIMB_TIMEOUT);
 	
-	if (!timer_status_enable(TIMER1_BASE, TIMER_A) && led_sw_enable_get())
+	_lux_ticks++;
+	if (--_lux_countdown != 0)
+		return;
+	
+	if (!_lux_integrating)
 	{
-
-		uint32_t new_lux;
-
-		// Verify valid transaction with lux sensor
-		if (tsl2591_lux_get(&new_lux) != 0)
+		// Do not start a sample while fading or disabled, try again next tick
+		if (timer_status_enable(TIMER1_BASE, TIMER_A) || !led_sw_enable_get())
 		{
-			log_msg(LOG_SUB_SYSTEM_LED, LOG_LEVEL_CRITICAL, "Lost connection with lux sensor");
-			_brightness_scale = 1.0F;
-			lux_sensor_found = false;
-			TimerDisable(TIMER1_BASE, TIMER_B);
+			_lux_countdown = 1;
 			return;
 		}
 		
-		// Limit maxiumum lux value. Neccessary for proper calculation of brightness scale
-		if (new_lux > _max_lux)
-			new_lux = _max_lux;
-	
-		// Do not update lux if new lux does not exceed hysteresis
-		if (current_lux > new_lux && current_lux - new_lux < LED_LUX_CHANGE_HYSTERESIS)
-			return;
-		if (current_lux < new_lux && new_lux - current_lux < LED_LUX_CHANGE_HYSTERESIS)
+		_lux_atime = lux_sampler_integration_get();
+		status = tsl2591_integratation_time_set(_lux_atime);
+		if (status == 0)
+			status = tsl2591_lux_start();
+		if (status != 0)
+		{
+			led_lux_sensor_lost();
 			return;
-
-		// Calculate new brightness scale
-		_brightness_scale = 1 - (((float)(_lux_sensor_sensitivity) / LED_MAX_LUX_SENSITIVITY) * ((float)(_max_lux - new_lux) / _max_lux)); 
-	
-		current_lux = new_lux;
+		}
 		
-		// Start timer that updates LED brightness
-		led_update_hw_start();	
+		_lux_integrating = true;
+		_lux_start_tick = _lux_ticks;
+		_lux_countdown = LED_LUX_TICKS(TSL2591_ATIME_MS(_lux_atime)) + 1;
+		return;
+	}
+	
+	// Verify valid transaction with lux sensor, wait a tick more if the
+	// integration cycle is not complete
+	if (tsl2591_als_valid(&valid) != 0)
+	{
+		led_lux_sensor_lost();
+		return;
+	}
+	if (!valid)
+	{
+		_lux_countdown = 1;
+		return;
+	}
+	
+	_lux_integrating = false;
+	status = tsl2591_sample_read(&sample);
+	if (status == TSL2591_ERR_OVERFLOW)
+	{
+		// Saturated at the shortest integration time, the light is brighter
+		// than any level the lamp follows
+		if (_lux_atime == TSL2591_CONTROL_ATIME_100)
+		{
+			sample.lux = lux_curve_max_lux_get();
+			lux_cache_publish(&sample, true);
+		}
+		interval = lux_sampler_overflow();
+	}
+	else if (status != 0)
+	{
+		led_lux_sensor_lost();
+		return;
+	}
+	else
+	{
+		lux_cache_publish(&sample, false);
+		interval = lux_sampler_update(sample.lux);
 	}
+	
+	// Time the next sample from the start of this one
+	elapsed = _lux_ticks - _lux_start_tick;
+	_lux_countdown = LED_LUX_TICKS(interval) > elapsed ? LED_LUX_TICKS(interval) - elapsed : 1;
+	
+	if (status == 0 || _lux_atime == TSL2591_CONTROL_ATIME_100)
+		led_lux_apply(sample.lux);
+}
+
+//*****************************************************************************
+//
+//! Updates the lux layer for a new lux reading
+//!
+//! \param new_lux is the reading
+//
+//*****************************************************************************
+static void led_lux_apply(uint32_t new_lux)
+{
+	// The scale does not change above the last breakpoint of the curve
+	if (new_lux > lux_curve_max_lux_get())
+		new_lux = lux_curve_max_lux_get();
+
+	// Do not update lux if new lux does not exceed hysteresis
+	if (_lux_applied > new_lux && _lux_applied - new_lux < LED_LUX_CHANGE_HYSTERESIS)
+		return;
+	if (_lux_applied < new_lux && new_lux - _lux_applied < LED_LUX_CHANGE_HYSTERESIS)
+		return;
+
+	// Look up the new brightness scale on the response curve
+	led_layer_opacity_set(LED_LAYER_LUX, lux_curve_scale_get(new_lux));
+
+	_lux_applied = new_lux;
+	
+	// Start timer that updates LED brightness
+	led_update_hw_start();	
 }
 
+//*****************************************************************************
+//
+//! Stops reading the lux sensor after it stopped answering and removes the
+//! lux scale
+//
+//*****************************************************************************
+static void led_lux_sensor_lost(void)
+{
+	log_msg(LOG_SUB_SYSTEM_LED, LOG_LEVEL_CRITICAL, "Lost connection with lux sensor");
+	led_layer_opacity_set(LED_LAYER_LUX, LED_OPACITY_MAX);
+	led_update_hw_start();
+	lux_sensor_found = false;
+	_lux_integrating = false;
+	TimerDisable(TIMER1_BASE, TIMER_B);
+}
 
 //*****************************************************************************
 //
@@ -344,9 +756,10 @@ void led_init(void)
 	TimerLoadSet(TIMER1_BASE, TIMER_A, ms_to_clockticks(LED_TIMER_PRESCALE , 
 		LED_STEP_TIME_INTERVAL, LED_TIMER_MAX_LOAD_VALUE)); 
 	TimerLoadSet(TIMER1_BASE, TIMER_B, ms_to_clockticks(LED_TIMER_PRESCALE , 
-		LED_LUX_UPDATE_RATE, LED_TIMER_MAX_LOAD_VALUE));
+		LED_LUX_TICK_MS, LED_TIMER_MAX_LOAD_VALUE));
 		
 	TimerIntEnable(TIMER1_BASE, TIMER_TIMA_TIMEOUT | TIMER_TIMB_TIMEOUT);
+	irq_jitter_timer_set(IRQ_JITTER_FADE, TIMER1_BASE, TIMER_A);
 	IntEnable(INT_TIMER1A);
 	IntEnable(INT_TIMER1B);
 
@@ -356,6 +769,9 @@ void led_init(void)
 	//
 	//***************************************************************************
 	tsl2591_init();
+#if LED_PCA9685_CHANNELS != 0
+	pca9685_init();
+#endif
 	
 	// Detect presense of lux sensor
 	if (tsl2591_id_get(&lux_sensor_id) == 0 && lux_sensor_id == TSL2591_DEVICE_ID)
@@ -366,7 +782,6 @@ void led_init(void)
 	{
 		lux_sensor_found = false;
 		log_msg(LOG_SUB_SYSTEM_LED, LOG_LEVEL_CRITICAL, "Unable to connect to lux");
-		_brightness_scale = 1.0F;
 	}
 	
 	//***************************************************************************
@@ -376,42 +791,64 @@ void led_init(void)
 	//***************************************************************************
 	led_time_interval_set(5);
 	led_brightness_step_set(1);
-	_num_leds = led_num_leds_get();
 	_current_profile_index = 0;
-	_lux_sensor_sensitivity = 0;
-	_max_lux = 200;
+	_lux_applied = UINT32_MAX;
 	_sw_enable = true;
 	
+	// Every layer starts transparent except the base layer
+	for (uint32_t layer = 0; layer < LED_NUM_LAYERS; layer++)
+	{
+		_layers[layer].mode = LED_BLEND_MIX;
+		_layers[layer].opacity = LED_OPACITY_MAX;
+		_layers[layer].enable = false;
+		for (uint32_t i = 0; i < LED_NUM_WORDS; i++)
+			_layers[layer].values[i] = 0;
+	}
+	_layers[LED_LAYER_BASE].enable = true;
+	_layers[LED_LAYER_LUX].mode = LED_BLEND_SCALE;
+	_layers[LED_LAYER_LUX].enable = true;
+	_layers[LED_LAYER_MASTER].mode = LED_BLEND_SCALE;
+	_layers[LED_LAYER_MASTER].enable = true;
+	_layers[LED_LAYER_LIMIT].mode = LED_BLEND_SCALE;
+	_layers[LED_LAYER_LIMIT].enable = true;
+	_dirty_layer = LED_LAYER_BASE;
+	_writers = 0;
+	_layers_gen = 0;
+	_immediate = false;
+	
 	// Synchronize sw and hw brightness
-	for (uint32_t i = 0; i < _num_leds; i++)
+	for (uint32_t i = 0; i < LED_NUM_LEDS; i++)
 	{
 		led_sw_brightness_set(i, 0);
 		led_hw_brightness_set(i, 0);
 	}
 	
+	lux_sampler_init();
+	lux_curve_init();
+	led_lux_linear_load();
+	_lux_curve_dirty = false;
+	_lux_ticks = 0;
+	_lux_countdown = 1;
+	_lux_integrating = false;
+	
 	if (lux_sensor_found)
 	{
 		// Enable timer for reading the lux sensor 
+		irq_jitter_timer_set(IRQ_JITTER_LUX, TIMER1_BASE, TIMER_B);
 		TimerEnable(TIMER1_BASE, TIMER_B);
 	}
 }
 
 //*****************************************************************************
 //
-//! Gets the number of LEDs defined in LED_LIST
+//! Gets the number of LEDs defined in LED_CHANNEL_LIST
 //! 
-//! \return Number of LEDs in LED_LIST
+//! \return Number of LEDs in LED_CHANNEL_LIST
 // 
 //*****************************************************************************
 uint32_t led_num_leds_get(void)
 {
-	uint32_t num_leds = 0;
-	
-	// Determine number of LEDs in LED_LIST. Only run once
-	while (LED_LIST[num_leds].pwm_base_register != 0)
-		num_leds++;
-	
-	return num_leds;
+	return LED_NUM_LEDS;
 }
 
 //*****************************************************************************
@@ -425,7 +862,7 @@ bool led_output_state_get(uint32_t led_type)
 {
 	// Direct register access is required as TI did not provide a function
 	// in its library to read the output state of the PWM
-	if (HWREG(PWM1_BASE + PWM_O_ENABLE) & LED_LIST[led_type].pwm_out_bit)
+	if (HWREG(PWM1_BASE + PWM_O_ENABLE) & LED_CONFIG[led_type].pwm_out_bit)
 		return true;
 	else
 		return false;
@@ -440,7 +877,7 @@ bool led_output_state_get(uint32_t led_type)
 //*****************************************************************************
 void led_output_state_set(uint32_t led_type, bool enable)
 {
-	PWMOutputState(LED_LIST[led_type].pwm_base_register, LED_LIST[led_type].pwm_out_bit, 
+	PWMOutputState(LED_CONFIG[led_type].pwm_base_register, LED_CONFIG[led_type].pwm_out_bit, 
 		enable);
 }
 
@@ -457,7 +894,18 @@ void led_output_state_set(uint32_t led_type, bool enable)
 //*****************************************************************************
 void led_hw_brightness_set(uint32_t led_type, uint32_t brightness)
 {	
-	uint32_t new_pulsewidth = 0;
+	uint32_t new_pulsewidth = led_pulsewidth_get(brightness);
+	
+	energy_duty_set(led_type, new_pulsewidth * LED_MAX_DUTY / LED_PWM_PERIOD);
+	
+	// Expander outputs are sent by pca9685_flush()
+	if (LED_CONFIG[led_type].driver == LED_DRIVER_PCA9685)
+	{
+		pca9685_duty_set(LED_CONFIG[led_type].pwm_out, 
+			new_pulsewidth * PCA9685_DUTY_MAX / LED_PWM_PERIOD);
+		LED_LAYER_VALUE(_current, led_type) = brightness;
+		return;
+	}
 	
 	// Disable output if settings brightness to 0
 	if (brightness == 0)
@@ -470,21 +918,30 @@ void led_hw_brightness_set(uint32_t led_type, uint32_t brightness)
 		led_output_state_set(led_type, true);
 	}
 	 
+	PWMPulseWidthSet(LED_CONFIG[led_type].pwm_base_register, 
+		LED_CONFIG[led_type].pwm_out, new_pulsewidth);
+	
+	LED_LAYER_VALUE(_current, led_type) = brightness;
+}
+
+//*****************************************************************************
+//
+//! Converts a brightness level to a PWM pulsewidth
+//! 
+//! \param brightness is the brightness level
+//!
+//! \return the pulsewidth, from 0 to LED_PWM_PERIOD
+// 
+//*****************************************************************************
+static uint32_t led_pulsewidth_get(uint32_t brightness)
+{
 	// Exponentially increase PWM pulsewidth after LED_BRIGHTNESS_EXP_POINT is 
 	// reached. This compensates for the fact that the LED brightness is less
 	// sensetive to higher PWM duty cycles
 	if (brightness >= LED_BRIGHTNESS_EXP_POINT)
-	{
-		new_pulsewidth = brightness * brightness / LED_BRIGHTNESS_EXP_POINT;
-	}else
-	{
-		new_pulsewidth = brightness;
-	}
-	
-	PWMPulseWidthSet(LED_LIST[led_type].pwm_base_register, 
-		LED_LIST[led_type].pwm_out, new_pulsewidth);
-	
-	LED_LIST[led_type].current_brightness = brightness;
+		return brightness * brightness / LED_BRIGHTNESS_EXP_POINT;
+	else
+		return brightness;
 }
 
 //*****************************************************************************
@@ -500,7 +957,37 @@ void led_hw_brightness_set(uint32_t led_type, uint32_t brightness)
 //*****************************************************************************
 void led_sw_brightness_set(uint32_t led_type, uint32_t brightness)
 {	
-	LED_LIST[led_type].desired_brightness = brightness;
+	led_layer_brightness_set(LED_LAYER_BASE, led_type, brightness);
+}
+
+//*****************************************************************************
+//
+//! Sets the software and hardware brightness of the selected led without
+//! the fade effect
+//!
+//! \param led_type specifies the LED to set the brightness of
+//! \param brightness is the brightness to set the LED to
+//!
+//! This function is used by inputs that refresh the LEDs continuously, such
+//! as DMX512. The layers above the base layer are still applied. If the LEDs
+//! are disabled, the brightness is saved and applied once they are enabled.
+//!
+//! As with led_sw_brightness_set(), led_update_hw_start() must be called to
+//! apply the change. TIMER1A then sets every LED to its target in one step.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void led_sw_brightness_immediate_set(uint32_t led_type, uint32_t brightness)
+{
+	if (!_sw_enable)
+	{
+		LED_LAYER_VALUE(_previous, led_type) = brightness;
+		return;
+	}
+
+	led_sw_brightness_set(led_type, brightness);
+	_immediate = true;
 }
 
 //*****************************************************************************
@@ -566,6 +1053,47 @@ uint8_t led_brightness_step_get(void)
 	return _brightness_interval;
 }
 
+//*****************************************************************************
+//
+//! Gets the base layer brightness a profile sets
+//!
+//! \param index is the profile index in led_profile_list
+//! \param targets is set to the brightness of the LEDs set by the profile,
+//! indexed by LED. It must hold LED_NUM_LEDS entries.
+//! \param select is set to 1 for each LED set by the profile, indexed by
+//! LED. The entries of the other LEDs are left unchanged.
+//!
+//! This function is used to fade to a profile with a timed fade.
+//!
+//! \return true if the profile was found, false if the index is out of range
+//
+//*****************************************************************************
+bool led_profile_targets_get(uint8_t index, uint8_t *targets, uint8_t *select)
+{
+	const struct led_profile *profile;
+	uint32_t warm, cool;
+	
+	if (index >= num_profiles)
+		return false;
+	
+	profile = &led_profile_list[index];
+	if (profile->kelvin != 0)
+	{
+		cct_brightness_get(profile->kelvin, profile->intensity, &warm, &cool);
+		targets[CCT_WARM_LED] = warm;
+		targets[CCT_COOL_LED] = cool;
+		select[CCT_WARM_LED] = 1;
+		select[CCT_COOL_LED] = 1;
+		return true;
+	}
+	
+	targets[profile->led1_type] = profile->led1_brightness;
+	targets[profile->led2_type] = profile->led2_brightness;
+	select[profile->led1_type] = 1;
+	select[profile->led2_type] = 1;
+	return true;
+}
+
 //*****************************************************************************
 //
 //! Loads profile from led_profile_list using given index
@@ -588,13 +1116,21 @@ void led_profile_load(uint8_t index)
 			return;
 		
 		// Set SW brightness
-		led_sw_brightness_set(led_profile_list[index].led1_type, 
-			led_profile_list[index].led1_brightness);
-		led_sw_brightness_set(led_profile_list[index].led2_type, 
-			led_profile_list[index].led2_brightness);
+		led_update_begin();
+		if (led_profile_list[index].kelvin != 0)
+		{
+			cct_set(led_profile_list[index].kelvin, led_profile_list[index].intensity);
+		}
+		else
+		{
+			led_sw_brightness_set(led_profile_list[index].led1_type, 
+				led_profile_list[index].led1_brightness);
+			led_sw_brightness_set(led_profile_list[index].led2_type, 
+				led_profile_list[index].led2_brightness);
+		}
 		
 		// Update HW
-		led_update_hw_start();
+		led_update_end();
 		_current_profile_index = index;
 	}
 
@@ -639,27 +1175,34 @@ void led_sw_enable_set(bool enable)
 	if (enable == _sw_enable)
 		return;
 	
+	led_update_begin();
 	if (enable)
 	{
 		// Load previously saved brightness
-		for (uint32_t i = 0; i < _num_leds; i++)
+		for (uint32_t i = 0; i < LED_NUM_LEDS; i++)
 		{
-			led_sw_brightness_set(i, LED_LIST[i].previous_brightness);
+			led_sw_brightness_set(i, LED_LAYER_VALUE(_previous, i));
 		}
 	}
 	else
 	{
+		// A playing sequence or fade would keep lighting the LEDs
+		if (timeline_active())
+			timeline_stop();
+		color_fade_stop();
+		fade_stop();
+		
 		// Save current brightness and set new brightness to 0
-		for (uint32_t i = 0; i < _num_leds; i++)
+		for (uint32_t i = 0; i < LED_NUM_LEDS; i++)
 		{
-			LED_LIST[i].previous_brightness = LED_LIST[i].desired_brightness;
+			LED_LAYER_VALUE(_previous, i) = LED_LAYER_VALUE(_layers[LED_LAYER_BASE].values, i);
 			led_sw_brightness_set(i, 0);
 		}
 	}
 	
 	// Update HW
-	led_update_hw_start();
 	_sw_enable = enable;
+	led_update_end();
 }
 
 //*****************************************************************************
@@ -702,6 +1245,11 @@ void led_sw_enable_toggle(void)
 //! The maximum sensitivy value is determined by the define 
 //! LED_MAX_LUX_SENSITIVITY
 //!
+//! The response curve is replaced by a straight line from the sensitivity at
+//! 0 lux to full brightness at the maximum lux. The line is saved by
+//! led_process() once it stops changing, so it also replaces an uploaded curve
+//! over a reset.
+//!
 //! \return None. 
 // 
 //*****************************************************************************
@@ -709,25 +1257,678 @@ void led_lux_sensitivity_set(uint32_t sensitivity)
 {
 	if (sensitivity > LED_MAX_LUX_SENSITIVITY)
 		sensitivity = LED_MAX_LUX_SENSITIVITY;
-	else
-		_lux_sensor_sensitivity = sensitivity;
+	_lux_sensor_sensitivity = sensitivity;
+	led_lux_linear_update();
 	
 	log_msg_value(LOG_SUB_SYSTEM_LED, LOG_LEVEL_DEBUG, "Setting sensitivity",sensitivity);
 }
 
 //*****************************************************************************
 //
-//! Enables the timer responsible for fading the LEDs in/out.
+//! Sets the lux at which the lux sensor stops dimming the LEDs
 //! 
-//! \param None.
+//! \param max is the lux, from 1 to LUX_CURVE_MAX_LUX
 //!
-//! This function should be called after changing the software brightness value
-//! using the led_sw_brightness_set() function. 
+//! The response curve is replaced by a straight line from the sensitivity at
+//! 0 lux to full brightness at the maximum lux. The line is saved by
+//! led_process() once it stops changing, so it also replaces an uploaded curve
+//! over a reset.
 //!
 //! \return None. 
 // 
 //*****************************************************************************
-void led_update_hw_start(void)
+void led_max_lux_set(uint32_t max)
 {
-	TimerEnable(TIMER1_BASE, TIMER_A);
+	if (max == 0)
+		max = 1;
+	if (max > LUX_CURVE_MAX_LUX)
+		max = LUX_CURVE_MAX_LUX;
+	_max_lux = max;
+	led_lux_linear_update();
+	
+	log_msg_value(LOG_SUB_SYSTEM_LED, LOG_LEVEL_DEBUG, "Setting max lux", max);
+}
+
+//*****************************************************************************
+//
+//! Sets the response curve from the ambient light to the lux layer scale
+//! 
+//! \param points are the breakpoints, in increasing order of lux
+//! \param num_points is the number of breakpoints, from 2 to
+//! LUX_CURVE_MAX_POINTS
+//!
+//! The curve is applied with the next lux sample. Use lux_curve_save() to
+//! keep it over a reset. The sensitivity and the maximum lux are taken from
+//! the scale at 0 lux and the last breakpoint.
+//!
+//! \return true if the curve was set, false if the breakpoints are invalid
+// 
+//*****************************************************************************
+bool led_lux_curve_set(const struct lux_curve_point *points, uint32_t num_points)
+{
+	bool set;
+	
+	IntDisable(INT_TIMER1B);
+	set = lux_curve_set(points, num_points);
+	if (set)
+	{
+		_lux_applied = UINT32_MAX;
+		if (!_lux_integrating)
+			_lux_countdown = 1;
+	}
+	IntEnable(INT_TIMER1B);
+	
+	if (set)
+		led_lux_linear_load();
+	
+	return set;
+}
+
+//*****************************************************************************
+//
+//! Replaces the response curve by the line given by the sensitivity and the
+//! maximum lux, and schedules saving it. Keeping an uploaded curve in the
+//! settings while the line is used would bring the uploaded curve back after a
+//! reset.
+//
+//*****************************************************************************
+static void led_lux_linear_update(void)
+{
+	struct lux_curve_point points[2];
+	
+	points[0].lux = 0;
+	points[0].scale = LED_OPACITY_MAX - 
+		(LED_OPACITY_MAX * _lux_sensor_sensitivity) / LED_MAX_LUX_SENSITIVITY;
+	points[1].lux = _max_lux;
+	points[1].scale = LED_OPACITY_MAX;
+	if (led_lux_curve_set(points, 2))
+	{
+		_lux_curve_dirty = true;
+		_lux_save_ms = clock_local_ms_get() + LED_LUX_SAVE_DELAY_MS;
+	}
+}
+
+//*****************************************************************************
+//
+//! Sets the sensitivity and the maximum lux from the response curve. Rounding
+//! the sensitivity up gives back the value the line was built from.
+//
+//*****************************************************************************
+static void led_lux_linear_load(void)
+{
+	uint32_t scale = lux_curve_scale_get(0);
+	
+	_lux_sensor_sensitivity = ((LED_OPACITY_MAX - scale) * LED_MAX_LUX_SENSITIVITY + 
+		LED_OPACITY_MAX - 1) / LED_OPACITY_MAX;
+	_max_lux = lux_curve_max_lux_get();
+	if (_max_lux == 0)
+		_max_lux = 1;
+}
+
+//*****************************************************************************
+//
+//! Saves the sensitivity line once it has stopped changing
+//!
+//! This function is called from the main loop.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void led_process(void)
+{
+	if (!_lux_curve_dirty || CLOCK_BEFORE(clock_local_ms_get(), _lux_save_ms))
+		return;
+	
+	_lux_curve_dirty = false;
+	if (!lux_curve_save())
+		log_msg(LOG_SUB_SYSTEM_LED, LOG_LEVEL_WARNING, "Unable to save lux curve");
+}
+
+//*****************************************************************************
+//
+//! Enables the timer responsible for fading the LEDs in/out.
+//! 
+//! \param None.
+//!
+//! This function should be called after changing the software brightness value
+//! using the led_sw_brightness_set() function. The layers are composited in
+//! PendSV, once every handler running has returned and no set of changes is
+//! open.
+//!
+//! \return None. 
+// 
+//*****************************************************************************
+void led_update_hw_start(void)
+{
+	_layers_gen++;
+	IntPendSet(FAULT_PENDSV);
+}
+
+//*****************************************************************************
+//
+//! Opens a set of layer changes that must reach the LEDs together
+//!
+//! Nothing is composited until led_update_end() closes the set. Sets may be
+//! opened from the main loop and from interrupt handlers, and may nest.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void led_update_begin(void)
+{
+	_writers++;
+}
+
+//*****************************************************************************
+//
+//! Closes a set of layer changes and starts fading the LEDs to the result
+//!
+//! \return None.
+//
+//*****************************************************************************
+void led_update_end(void)
+{
+	_writers--;
+	led_update_hw_start();
+}
+
+//*****************************************************************************
+//
+//! Runs a fade step right away and times the following steps from it
+//!
+//! This function is used to start and end a timed fade on time. It may be
+//! called from an interrupt handler. The step itself runs in the TIMER1A
+//! interrupt, so it is held off by the sections that disable it.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void led_update_hw_now(void)
+{
+	TimerLoadSet(TIMER1_BASE, TIMER_A, ms_to_clockticks(LED_TIMER_PRESCALE , 
+		_time_internval, LED_TIMER_MAX_LOAD_VALUE));
+	TimerEnable(TIMER1_BASE, TIMER_A);
+	IntTrigger(INT_TIMER1A);
+}
+
+//*****************************************************************************
+//
+//! Sets the brightness of an LED in a layer
+//! 
+//! \param layer is the layer to modify, as one of the LED_LAYER defines
+//! \param led_type specifies the LED to set the brightness of
+//! \param brightness is the brightness to set the LED to
+//!
+//! As with led_sw_brightness_set(), led_update_hw_start() must be called to 
+//! apply the change. 
+//!
+//! \return None.
+// 
+//*****************************************************************************
+void led_layer_brightness_set(uint32_t layer, uint32_t led_type, uint32_t brightness)
+{
+	if (layer >= LED_NUM_LAYERS || led_type >= LED_NUM_LEDS)
+		return;
+	
+	if (brightness > LED_MAX_BRIGHTNESS_LEVEL)
+		brightness = LED_MAX_BRIGHTNESS_LEVEL;
+	
+	LED_LAYER_VALUE(_layers[layer].values, led_type) = brightness;
+	led_layer_dirty(layer);
+}
+
+//*****************************************************************************
+//
+//! Gets the brightness of an LED in a layer
+//! 
+//! \param layer is the layer to read, as one of the LED_LAYER defines
+//! \param led_type specifies the LED to get the brightness of
+//!
+//! \return the brightness of the LED in the layer
+// 
+//*****************************************************************************
+uint32_t led_layer_brightness_get(uint32_t layer, uint32_t led_type)
+{
+	if (layer >= LED_NUM_LAYERS || led_type >= LED_NUM_LEDS)
+		return 0;
+	
+	return LED_LAYER_VALUE(_layers[layer].values, led_type);
+}
+
+//*****************************************************************************
+//
+//! Gets the brightness an LED is driven at, part way through a fade
+//! 
+//! \param led_type specifies the LED to get the brightness of
+//!
+//! \return the brightness of the LED
+// 
+//*****************************************************************************
+uint32_t led_hw_brightness_get(uint32_t led_type)
+{
+	if (led_type >= LED_NUM_LEDS)
+		return 0;
+	
+	return LED_LAYER_VALUE(_current, led_type);
+}
+
+//*****************************************************************************
+//
+//! Gets the PWM duty cycle an LED is driven at, part way through a fade
+//! 
+//! \param led_type specifies the LED to get the duty cycle of
+//!
+//! \return the duty cycle from 0 to LED_MAX_DUTY
+// 
+//*****************************************************************************
+uint32_t led_duty_get(uint32_t led_type)
+{
+	if (led_type >= LED_NUM_LEDS)
+		return 0;
+	
+	return led_pulsewidth_get(LED_LAYER_VALUE(_current, led_type)) * LED_MAX_DUTY / LED_PWM_PERIOD;
+}
+
+//*****************************************************************************
+//
+//! Gets the index of the last profile loaded
+//!
+//! \return the index of the profile in led_profile_list
+// 
+//*****************************************************************************
+uint8_t led_profile_index_get(void)
+{
+	return _current_profile_index;
+}
+
+//*****************************************************************************
+//
+//! Gets the last lux reading of the lux sensor
+//!
+//! \return the lux reading, or 0 if the sensor was not read yet
+// 
+//*****************************************************************************
+uint32_t led_lux_get(void)
+{
+	struct lux_cache_sample sample;
+	
+	lux_cache_get(&sample, UINT32_MAX);
+	return sample.lux;
+}
+
+//*****************************************************************************
+//
+//! Gets the latest sample of the lux sensor without reading the sensor
+//!
+//! \param sample is set to the sample
+//!
+//! The sampler reads the sensor at least once per longest sampling interval
+//! unless the LEDs are fading or disabled. A sample older than
+//! LED_LUX_STALE_INTERVALS of those intervals is stale.
+//!
+//! \return LUX_CACHE_FRESH, LUX_CACHE_STALE or LUX_CACHE_EMPTY
+// 
+//*****************************************************************************
+uint32_t led_lux_sample_get(struct lux_cache_sample *sample)
+{
+	uint32_t min_ms, max_ms;
+	
+	lux_sampler_bounds_get(&min_ms, &max_ms);
+	return lux_cache_get(sample, LED_LUX_STALE_INTERVALS * max_ms);
+}
+
+//*****************************************************************************
+//
+//! Asks the lux sampler to read the sensor on its next tick
+//!
+//! The sample is published once the integration cycle completes, see
+//! lux_cache_count_get().
+//!
+//! \return None.
+// 
+//*****************************************************************************
+void led_lux_sample_request(void)
+{
+	IntDisable(INT_TIMER1B);
+	if (!_lux_integrating)
+		_lux_countdown = 1;
+	IntEnable(INT_TIMER1B);
+}
+
+//*****************************************************************************
+//
+//! Gets the lux sensor sensitivity
+//!
+//! \return the sensitivity from 0 to LED_MAX_LUX_SENSITIVITY
+// 
+//*****************************************************************************
+uint32_t led_lux_sensitivity_get(void)
+{
+	return _lux_sensor_sensitivity;
+}
+
+//*****************************************************************************
+//
+//! Sets the bounds of the lux sampling interval
+//!
+//! \param min_ms is the interval after a change in light
+//! \param max_ms is the longest interval in stable light
+//!
+//! A new sample is started on the next TIMER1B tick.
+//!
+//! \return true if the bounds were set, false if they are out of range
+// 
+//*****************************************************************************
+bool led_lux_rate_set(uint32_t min_ms, uint32_t max_ms)
+{
+	bool set;
+	
+	IntDisable(INT_TIMER1B);
+	set = lux_sampler_bounds_set(min_ms, max_ms);
+	if (set && !_lux_integrating)
+		_lux_countdown = 1;
+	IntEnable(INT_TIMER1B);
+	
+	return set;
+}
+
+//*****************************************************************************
+//
+//! Gets the lux sampling counters
+//!
+//! \param stats is set to the counters
+//!
+//! \return None.
+// 
+//*****************************************************************************
+void led_lux_rate_stats_get(struct lux_sampler_stats *stats)
+{
+	IntDisable(INT_TIMER1B);
+	lux_sampler_stats_get(stats);
+	IntEnable(INT_TIMER1B);
+}
+
+//*****************************************************************************
+//
+//! Sets the opacity of a layer
+//! 
+//! \param layer is the layer to modify, as one of the LED_LAYER defines
+//! \param opacity is the opacity from 0 to LED_OPACITY_MAX. For layers using
+//! LED_BLEND_SCALE, it is the scale applied to the layers below.
+//!
+//! \return None.
+// 
+//*****************************************************************************
+void led_layer_opacity_set(uint32_t layer, uint32_t opacity)
+{
+	if (layer >= LED_NUM_LAYERS)
+		return;
+	
+	if (opacity > LED_OPACITY_MAX)
+		opacity = LED_OPACITY_MAX;
+	
+	if (_layers[layer].opacity == opacity)
+		return;
+	
+	_layers[layer].opacity = opacity;
+	led_layer_dirty(layer);
+}
+
+//*****************************************************************************
+//
+//! Gets the opacity of a layer
+//! 
+//! \param layer is the layer to read, as one of the LED_LAYER defines
+//!
+//! \return the opacity from 0 to LED_OPACITY_MAX
+// 
+//*****************************************************************************
+uint32_t led_layer_opacity_get(uint32_t layer)
+{
+	if (layer >= LED_NUM_LAYERS)
+		return 0;
+	
+	return _layers[layer].opacity;
+}
+
+//*****************************************************************************
+//
+//! Sets the blend mode of a layer
+//! 
+//! \param layer is the layer to modify, as one of the LED_LAYER defines
+//! \param mode is the blend mode, as one of \b LED_BLEND_MIX, 
+//! \b LED_BLEND_ADD or \b LED_BLEND_SCALE
+//!
+//! \return None.
+// 
+//*****************************************************************************
+void led_layer_mode_set(uint32_t layer, uint32_t mode)
+{
+	if (layer >= LED_NUM_LAYERS || mode > LED_BLEND_SCALE)
+		return;
+	
+	_layers[layer].mode = mode;
+	led_layer_dirty(layer);
+}
+
+//*****************************************************************************
+//
+//! Enables or disables a layer. A disabled layer leaves the layers below it 
+//! unchanged.
+//! 
+//! \param layer is the layer to modify, as one of the LED_LAYER defines
+//! \param enable selects whether to enable/disable the layer
+//!
+//! \return None.
+// 
+//*****************************************************************************
+void led_layer_enable_set(uint32_t layer, bool enable)
+{
+	if (layer >= LED_NUM_LAYERS || _layers[layer].enable == enable)
+		return;
+	
+	_layers[layer].enable = enable;
+	led_layer_dirty(layer);
+}
+
+//*****************************************************************************
+//
+//! Sets the master dimmer and starts fading the LEDs to the new brightness
+//! 
+//! \param level is the dimmer level from 0 (off) to LED_MAX_BRIGHTNESS_LEVEL
+//! (no dimming)
+//!
+//! \return None.
+// 
+//*****************************************************************************
+void led_master_dimmer_set(uint32_t level)
+{
+	if (level > LED_MAX_BRIGHTNESS_LEVEL)
+		level = LED_MAX_BRIGHTNESS_LEVEL;
+	
+	// Map 0-255 onto 0-256 so the maximum level does not dim
+	led_layer_opacity_set(LED_LAYER_MASTER, level + (level >> 7));
+	led_update_hw_start();
+}
+
+//*****************************************************************************
+//
+//! Recomputes the LED outputs after the color calibration changed and starts
+//! fading the LEDs to them
+//! 
+//! \return None.
+// 
+//*****************************************************************************
+void led_output_update(void)
+{
+	led_layer_dirty(LED_NUM_LAYERS - 1);
+	led_update_hw_start();
+}
+
+//*****************************************************************************
+//
+//! Converts a light output to the brightness level giving that output
+//! 
+//! \param light is the light output from 0 to LED_MAX_LIGHT
+//!
+//! This is the inverse of the brightness curve in led_hw_brightness_set(). It
+//! is used to compute tables where light must add up, such as the color
+//! temperature mix, and is not meant to be called on every update.
+//!
+//! \return the brightness level in 1/256 steps
+// 
+//*****************************************************************************
+uint32_t led_brightness_from_light(uint32_t light)
+{
+	float pulsewidth, brightness;
+	
+	if (light > LED_MAX_LIGHT)
+		light = LED_MAX_LIGHT;
+	
+	pulsewidth = (float)light * LED_MAX_BRIGHTNESS_LEVEL * LED_MAX_BRIGHTNESS_LEVEL / 
+		LED_BRIGHTNESS_EXP_POINT / LED_MAX_LIGHT;
+	
+	if (pulsewidth >= LED_BRIGHTNESS_EXP_POINT)
+		brightness = sqrtf(pulsewidth * LED_BRIGHTNESS_EXP_POINT);
+	else
+		brightness = pulsewidth;
+	
+	return (uint32_t)(brightness * 256.0f + 0.5f);
+}
+
+//*****************************************************************************
+//
+//! Marks a layer as changed so the next composite recomputes it and the 
+//! layers above it
+//! 
+//! \param layer is the changed layer
+//!
+//! Layers are changed from several levels, so the mark is set with the
+//! interrupts masked to keep a lower mark set by a handler.
+//
+//*****************************************************************************
+static void led_layer_dirty(uint32_t layer)
+{
+	bool masked = IntMasterDisable();
+	
+	if (layer < _dirty_layer)
+		_dirty_layer = layer;
+	
+	if (!masked)
+		IntMasterEnable();
+}
+
+//*****************************************************************************
+//
+//! Recomputes the layers changed since the last composite. The calibrated
+//! result of the top layer is the brightness the fade effect moves the LEDs
+//! toward.
+//
+//*****************************************************************************
+static void led_composite_update(void)
+{
+	static const uint32_t transparent[LED_NUM_WORDS];
+	uint32_t first = _dirty_layer;
+	
+	if (first >= LED_NUM_LAYERS)
+		return;
+	
+	// Layers changed from here on are recomputed by the next composite
+	_dirty_layer = LED_NUM_LAYERS;
+	
+	for (uint32_t layer = first; layer < LED_NUM_LAYERS; layer++)
+	{
+		const struct led_layer *info = &_layers[layer];
+		const uint32_t *below = layer > 0 ? _layer_stage[layer - 1] : transparent;
+		uint32_t *stage = _layer_stage[layer];
+		
+		if (!info->enable)
+		{
+			for (uint32_t i = 0; i < LED_NUM_WORDS; i++)
+				stage[i] = below[i];
+			continue;
+		}
+		
+		switch (info->mode)
+		{
+			case LED_BLEND_MIX:
+				blend_crossfade(stage, below, info->values, LED_NUM_WORDS, info->opacity);
+				break;
+			case LED_BLEND_ADD:
+				for (uint32_t i = 0; i < LED_NUM_WORDS; i++)
+					stage[i] = below[i];
+				blend_add(stage, info->values, LED_NUM_WORDS, info->opacity);
+				break;
+			case LED_BLEND_SCALE:
+				blend_scale(stage, below, LED_NUM_WORDS, info->opacity);
+				break;
+			default:
+				break;
+		}
+	}
+	
+	calib_apply((const uint8_t *)_layer_stage[LED_NUM_LAYERS - 1], (uint8_t *)_output, LED_NUM_LEDS);
+}
+
+//*****************************************************************************
+//
+//! Publishes the composited brightness as the targets of the fade effect
+//!
+//! \param immediate selects whether TIMER1A jumps to the targets rather than
+//! fading to them
+//!
+//! This function is only called from PendSV, so publishes never interrupt
+//! each other.
+//
+//*****************************************************************************
+static void led_targets_publish(bool immediate)
+{
+	uint32_t seq, set;
+	
+	// Skip 0, it marks a set being written
+	seq = _targets_count + 1;
+	if (seq == 0)
+		seq = 1;
+	_targets_count = seq;
+	
+	set = _targets_front ^ 1;
+	_targets[set].seq = 0;
+	_targets[set].immediate = immediate;
+	for (uint32_t i = 0; i < LED_NUM_WORDS; i++)
+		_targets[set].values[i] = _output[i];
+	_targets[set].seq = seq;
+	_targets_front = set;
+}
+
+//*****************************************************************************
+//
+//! Copies the published targets for TIMER1A, if they are new and complete
+//!
+//! \return true if new targets were copied and must be applied without the
+//! fade effect
+//
+//*****************************************************************************
+static bool led_targets_fetch(void)
+{
+	uint32_t values[LED_NUM_WORDS];
+	uint32_t set = _targets_front;
+	uint32_t seq = _targets[set].seq;
+	bool immediate;
+	
+	if (seq == 0 || seq == _fade_seq)
+		return false;
+	
+	immediate = _targets[set].immediate;
+	for (uint32_t i = 0; i < LED_NUM_WORDS; i++)
+		values[i] = _targets[set].values[i];
+	
+	// The set was written during the copy, keep the previous targets
+	if (_targets[set].seq != seq)
+		return false;
+	
+	for (uint32_t i = 0; i < LED_NUM_WORDS; i++)
+		_fade_targets[i] = values[i];
+	_fade_seq = seq;
+	
+	return immediate;
 }
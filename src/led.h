@@ -32,6 +32,9 @@
 	
 #include <stdint.h>
 #include <stdbool.h>
+#include "lux_sampler.h"
+#include "lux_curve.h"
+#include "lux_cache.h"
 
 //
 // The value of the LED macros that define
@@ -43,7 +46,35 @@
 #define LED_ONBOARD_BLUE  0x01
 #define LED_ONBOARD_GREEN 0x02
 
+#define LED_PCA9685_CHANNELS 0 // PCA9685 expander outputs used as LEDs x0
+                               //  to x7 after the onboard LEDs, 0 or 8
+
+// LEDs in LED_CHANNEL_LIST of led.c, for the per LED arrays of other modules
+#define LED_NUM_LEDS      (3 + LED_PCA9685_CHANNELS)
+
 #define LED_MAX_LUX_SENSITIVITY 255
+#define LED_MAX_LIGHT           65535 // Light output of an LED at full brightness
+#define LED_MAX_DUTY            65536 // Duty cycle of an LED driven at 100%
+
+//
+// Layers composited to obtain the LED brightness, from bottom to top
+//
+#define LED_LAYER_BASE    0 // Brightness set by profiles and commands
+#define LED_LAYER_LUX     1 // Scale set by the lux sensor
+#define LED_LAYER_EFFECT  2 // Effects drawn over the current scene
+#define LED_LAYER_OVERLAY 3 // Transient overlays such as notifications
+#define LED_LAYER_MASTER  4 // Master dimmer
+#define LED_LAYER_LIMIT   5 // Scale set by the thermal power limiter
+#define LED_NUM_LAYERS    6
+
+//
+// Layer blend modes
+//
+#define LED_BLEND_MIX     0 // Crossfade from the layers below by the opacity
+#define LED_BLEND_ADD     1 // Add the layer scaled by the opacity
+#define LED_BLEND_SCALE   2 // Scale the layers below by the opacity
+
+#define LED_OPACITY_MAX   256
 
 //*****************************************************************************
 //
@@ -52,16 +83,43 @@
 //*****************************************************************************
 void led_init(void);
 void led_sw_brightness_set(uint32_t led_type, uint32_t brightness);
+void led_sw_brightness_immediate_set(uint32_t led_type, uint32_t brightness);
+uint32_t led_num_leds_get(void);
 void led_sw_enable_set(bool enable);
 void led_sw_enable_toggle(void);
 bool led_sw_enable_get(void);
 void led_update_hw_start(void);
+void led_update_hw_now(void);
+void led_update_begin(void);
+void led_update_end(void);
 void led_time_interval_set(uint32_t interval);
 uint8_t led_time_interval_get(void);
 void led_brightness_step_set(uint8_t interval);
+uint8_t led_brightness_step_get(void);
 void led_profile_load(uint8_t index);
 void led_profile_load_next(void);
+bool led_profile_targets_get(uint8_t index, uint8_t *targets, uint8_t *select);
 void led_lux_sensitivity_set(uint32_t sensitivity);
 void led_max_lux_set(uint32_t max);
+void led_layer_brightness_set(uint32_t layer, uint32_t led_type, uint32_t brightness);
+uint32_t led_layer_brightness_get(uint32_t layer, uint32_t led_type);
+uint32_t led_hw_brightness_get(uint32_t led_type);
+uint32_t led_duty_get(uint32_t led_type);
+uint8_t led_profile_index_get(void);
+uint32_t led_lux_get(void);
+uint32_t led_lux_sample_get(struct lux_cache_sample *sample);
+void led_lux_sample_request(void);
+uint32_t led_lux_sensitivity_get(void);
+bool led_lux_rate_set(uint32_t min_ms, uint32_t max_ms);
+void led_lux_rate_stats_get(struct lux_sampler_stats *stats);
+bool led_lux_curve_set(const struct lux_curve_point *points, uint32_t num_points);
+void led_layer_opacity_set(uint32_t layer, uint32_t opacity);
+uint32_t led_layer_opacity_get(uint32_t layer);
+void led_layer_mode_set(uint32_t layer, uint32_t mode);
+void led_layer_enable_set(uint32_t layer, bool enable);
+void led_master_dimmer_set(uint32_t level);
+uint32_t led_brightness_from_light(uint32_t light);
+void led_output_update(void);
+void led_process(void);
 
 #endif
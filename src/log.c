@@ -40,7 +40,7 @@
 //*****************************************************************************
 #define LOG_OUTPUT_BUFFER_SIZE 64  // Maximum amount of characters that the 
                                    // log can output via UART
-#define LOG_NUM_SUB_SYSTEMS    5   // Number of subsystems
+#define LOG_NUM_SUB_SYSTEMS    9   // Number of subsystems
 
 
 //*****************************************************************************
@@ -129,6 +129,14 @@ char *log_sub_system_to_string(enum e_log_sub_system sys)
 			return "SENSOR_LUX";
 		case LOG_SUB_SYSTEM_I2C0:
 			return "I2C0";
+		case LOG_SUB_SYSTEM_DMX:
+			return "DMX";
+		case LOG_SUB_SYSTEM_TIMELINE:
+			return "TIMELINE";
+		case LOG_SUB_SYSTEM_SETTINGS:
+			return "SETTINGS";
+		case LOG_SUB_SYSTEM_LAMPBUS:
+			return "LAMPBUS";
 		default:
 			return "UNDEFINED";
 	}
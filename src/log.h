@@ -39,7 +39,11 @@ enum e_log_sub_system {
 	LOG_SUB_SYSTEM_BUTTON,
 	LOG_SUB_SYSTEM_SENSOR_LUX,
 	LOG_SUB_SYSTEM_CMD,
-	LOG_SUB_SYSTEM_I2C0
+	LOG_SUB_SYSTEM_I2C0,
+	LOG_SUB_SYSTEM_DMX,
+	LOG_SUB_SYSTEM_TIMELINE,
+	LOG_SUB_SYSTEM_SETTINGS,
+	LOG_SUB_SYSTEM_LAMPBUS
 };
 
 //*****************************************************************************
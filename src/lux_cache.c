@@ -0,0 +1,141 @@
+//*****************************************************************************
+//
+// lux_cache.c - Published samples of the lux sensor
+//
+// Only TIMER1B drives the lux sensor. Every sample it reads is published
+// here with the time it was read, and every other module reads the latest
+// sample instead of the sensor, so a reader never starts an integration or
+// shares I2C0 with the sampler.
+//
+// The sample is guarded by a sequence count, odd while a sample is written.
+// A reader copies the sample and copies it again if the count changed, since
+// TIMER1B published in the meantime. The sampler never waits for readers.
+// A reader that runs at a higher priority than TIMER1B cannot wait for the
+// publish it interrupted, so it gets LUX_CACHE_BUSY instead.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "clock.h"
+#include "tsl2591.h"
+#include "lux_cache.h"
+
+//*****************************************************************************
+//
+// Internal variables
+//
+//*****************************************************************************
+static volatile uint32_t _seq;  // Twice the samples published, odd while
+                                // 	one is written
+static volatile struct lux_cache_sample _sample;
+
+//*****************************************************************************
+//
+//! Publishes a sample read from the sensor
+//!
+//! \param sample is the sample
+//! \param overflow is true if a channel saturated. The lux of the sample is
+//! then the lower bound set by the caller.
+//!
+//! Only the owner of the sensor may publish, from a single context.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void lux_cache_publish(const struct tsl2591_sample *sample, bool overflow)
+{
+	uint32_t time_ms = clock_local_ms_get();
+	
+	_seq++;
+	_sample.time_ms = time_ms;
+	_sample.lux = sample->lux;
+	_sample.ch0 = sample->ch0;
+	_sample.ch1 = sample->ch1;
+	_sample.gain = sample->gain;
+	_sample.atime = sample->atime;
+	_sample.overflow = overflow;
+	_seq++;
+}
+
+//*****************************************************************************
+//
+//! Gets the latest sample
+//!
+//! \param sample is set to the latest sample, or cleared if there is none
+//! \param max_age_ms is the age above which the sample is stale
+//!
+//! \return LUX_CACHE_FRESH, LUX_CACHE_STALE, LUX_CACHE_EMPTY or
+//! LUX_CACHE_BUSY
+//
+//*****************************************************************************
+uint32_t lux_cache_get(struct lux_cache_sample *sample, uint32_t max_age_ms)
+{
+	uint32_t seq;
+	
+	do
+	{
+		seq = _seq;
+		if (seq & 1)
+		{
+			sample->time_ms = 0;
+			sample->lux = 0;
+			sample->ch0 = 0;
+			sample->ch1 = 0;
+			sample->gain = 0;
+			sample->atime = 0;
+			sample->overflow = 0;
+			sample->reserved = 0;
+			return LUX_CACHE_BUSY;
+		}
+		
+		sample->time_ms = _sample.time_ms;
+		sample->lux = _sample.lux;
+		sample->ch0 = _sample.ch0;
+		sample->ch1 = _sample.ch1;
+		sample->gain = _sample.gain;
+		sample->atime = _sample.atime;
+		sample->overflow = _sample.overflow;
+		sample->reserved = 0;
+	} while (_seq != seq);
+	
+	if (seq == 0)
+		return LUX_CACHE_EMPTY;
+	
+	return clock_local_ms_get() - sample->time_ms > max_age_ms ? LUX_CACHE_STALE : LUX_CACHE_FRESH;
+}
+
+//*****************************************************************************
+//
+//! Gets the number of samples published. It changes when a new sample is
+//! published.
+//!
+//! \return the number of samples
+//
+//*****************************************************************************
+uint32_t lux_cache_count_get(void)
+{
+	return _seq >> 1;
+}
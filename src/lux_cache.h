@@ -0,0 +1,70 @@
+//*****************************************************************************
+//
+// lux_cache.h - Headers for the published samples of the lux sensor
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#ifndef LUX_CACHE_H
+#define LUX_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tsl2591.h"
+
+//
+// Results of lux_cache_get()
+//
+#define LUX_CACHE_FRESH 0 // The sample is within the age asked for
+#define LUX_CACHE_STALE 1 // The sample is older than the age asked for
+#define LUX_CACHE_EMPTY 2 // No sample was published yet
+#define LUX_CACHE_BUSY  3 // A sample is being published, try again later
+
+//*****************************************************************************
+//
+// A published sample of the lux sensor
+//
+//*****************************************************************************
+struct lux_cache_sample
+{
+	uint32_t time_ms;  // Local time the sample was read, in ms
+	uint32_t lux;
+	uint16_t ch0;      // Full spectrum channel
+	uint16_t ch1;      // Infrared channel
+	uint8_t gain;      // TSL2591_CONTROL_GAIN value
+	uint8_t atime;     // TSL2591_CONTROL_ATIME value
+	uint8_t overflow;  // Set if a channel saturated, lux is then a lower bound
+	uint8_t reserved;
+};
+
+//*****************************************************************************
+//
+// Public function prototypes.
+//
+//*****************************************************************************
+void lux_cache_publish(const struct tsl2591_sample *sample, bool overflow);
+uint32_t lux_cache_get(struct lux_cache_sample *sample, uint32_t max_age_ms);
+uint32_t lux_cache_count_get(void);
+
+#endif
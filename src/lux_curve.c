@@ -0,0 +1,267 @@
+//*****************************************************************************
+//
+// lux_curve.c - Ambient light response curve
+//
+// Maps the ambient light to the scale of the lux layer with a piecewise
+// linear curve of up to LUX_CURVE_MAX_POINTS breakpoints. The curve is kept
+// in the SETTINGS_BLOCK_LUX_CURVE block.
+//
+// The range between the first and last breakpoint is split into
+// LUX_CURVE_BINS bins of a power of two lux each. When a curve is set, the
+// segment at the start of each bin is stored in an index, along with the
+// slope of each segment in 1/65536 steps. A lookup shifts the lux to find
+// its bin, reads the segment and interpolates with one multiply, so it takes
+// the same time for any curve. A bin that holds more than one breakpoint
+// steps forward over them, which only happens for breakpoints closer than
+// the bin width.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "log.h"
+#include "settings.h"
+#include "lux_curve.h"
+
+//*****************************************************************************
+//
+// Module Configuration Defines
+//
+//*****************************************************************************
+#define LUX_CURVE_VERSION         1     // Version of struct lux_curve_data
+#define LUX_CURVE_BINS            64    // Bins of the segment index
+#define LUX_CURVE_SLOPE_ONE       65536 // Slope of one scale step per lux
+#define LUX_CURVE_DEFAULT_MAX_LUX 200   // Last breakpoint of the default curve
+
+//*****************************************************************************
+//
+// The curve as saved in the settings
+//
+//*****************************************************************************
+struct lux_curve_data
+{
+	uint32_t num_points;
+	struct lux_curve_point points[LUX_CURVE_MAX_POINTS];
+};
+
+static struct lux_curve_data _curve __attribute__ ((aligned(4)));
+
+//
+// Segment index and slopes, rebuilt when the curve is set
+//
+static uint8_t _index[LUX_CURVE_BINS];
+static uint32_t _shift;
+static int32_t _slope[LUX_CURVE_MAX_POINTS - 1];
+
+//*****************************************************************************
+//
+// Prototypes for private functions
+//
+//*****************************************************************************
+static bool lux_curve_valid(const struct lux_curve_point *points, uint32_t num_points);
+static void lux_curve_index_update(void);
+
+//*****************************************************************************
+//
+//! Initializes the curve from the settings
+//!
+//! settings_init() must be called first. A flat curve, which leaves the
+//! brightness as is, is used if no curve was saved.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void lux_curve_init(void)
+{
+	if (settings_load(SETTINGS_BLOCK_LUX_CURVE, LUX_CURVE_VERSION, &_curve, sizeof(_curve)) &&
+		lux_curve_valid(_curve.points, _curve.num_points))
+	{
+		lux_curve_index_update();
+		log_msg_value(LOG_SUB_SYSTEM_SENSOR_LUX, LOG_LEVEL_DEBUG, "Loaded lux curve points", _curve.num_points);
+		return;
+	}
+	
+	_curve.num_points = 2;
+	_curve.points[0].lux = 0;
+	_curve.points[0].scale = LUX_CURVE_MAX_SCALE;
+	_curve.points[1].lux = LUX_CURVE_DEFAULT_MAX_LUX;
+	_curve.points[1].scale = LUX_CURVE_MAX_SCALE;
+	lux_curve_index_update();
+}
+
+//*****************************************************************************
+//
+//! Sets the curve
+//!
+//! \param points are the breakpoints, in increasing order of lux
+//! \param num_points is the number of breakpoints, from 2 to
+//! LUX_CURVE_MAX_POINTS
+//!
+//! The curve is used right away but only kept over a reset once saved with
+//! lux_curve_save(). It must not be set while lux_curve_scale_get() runs.
+//!
+//! \return true if the curve was set, false if the breakpoints are invalid
+//
+//*****************************************************************************
+bool lux_curve_set(const struct lux_curve_point *points, uint32_t num_points)
+{
+	if (!lux_curve_valid(points, num_points))
+		return false;
+	
+	_curve.num_points = num_points;
+	for (uint32_t i = 0; i < num_points; i++)
+		_curve.points[i] = points[i];
+	lux_curve_index_update();
+	
+	return true;
+}
+
+//*****************************************************************************
+//
+//! Gets the curve
+//!
+//! \param points is set to the breakpoints. It must hold
+//! LUX_CURVE_MAX_POINTS breakpoints.
+//!
+//! \return the number of breakpoints
+//
+//*****************************************************************************
+uint32_t lux_curve_points_get(struct lux_curve_point *points)
+{
+	for (uint32_t i = 0; i < _curve.num_points; i++)
+		points[i] = _curve.points[i];
+	
+	return _curve.num_points;
+}
+
+//*****************************************************************************
+//
+//! Gets the lux of the last breakpoint. The scale does not change above it.
+//!
+//! \return the lux of the last breakpoint
+//
+//*****************************************************************************
+uint32_t lux_curve_max_lux_get(void)
+{
+	return _curve.points[_curve.num_points - 1].lux;
+}
+
+//*****************************************************************************
+//
+//! Gets the scale of the brightness for an ambient light
+//!
+//! \param lux is the ambient light
+//!
+//! \return the scale from 0 to LUX_CURVE_MAX_SCALE
+//
+//*****************************************************************************
+uint32_t lux_curve_scale_get(uint32_t lux)
+{
+	const struct lux_curve_point *points = _curve.points;
+	uint32_t last = _curve.num_points - 1;
+	uint32_t segment;
+	
+	if (lux <= points[0].lux)
+		return points[0].scale;
+	if (lux >= points[last].lux)
+		return points[last].scale;
+	
+	segment = _index[(lux - points[0].lux) >> _shift];
+	while (lux >= points[segment + 1].lux)
+		segment++;
+	
+	return points[segment].scale + 
+		((int32_t)(lux - points[segment].lux) * _slope[segment]) / LUX_CURVE_SLOPE_ONE;
+}
+
+//*****************************************************************************
+//
+//! Saves the curve to the settings
+//!
+//! \return true if the curve was saved, false otherwise
+//
+//*****************************************************************************
+bool lux_curve_save(void)
+{
+	return settings_save(SETTINGS_BLOCK_LUX_CURVE, LUX_CURVE_VERSION, &_curve, sizeof(_curve));
+}
+
+//*****************************************************************************
+//
+//! Checks a set of breakpoints
+//!
+//! \param points are the breakpoints
+//! \param num_points is the number of breakpoints
+//!
+//! \return true if the breakpoints are in increasing order of lux and the
+//! scales are in range, false otherwise
+//
+//*****************************************************************************
+static bool lux_curve_valid(const struct lux_curve_point *points, uint32_t num_points)
+{
+	if (num_points < 2 || num_points > LUX_CURVE_MAX_POINTS)
+		return false;
+	
+	for (uint32_t i = 0; i < num_points; i++)
+	{
+		if (points[i].scale > LUX_CURVE_MAX_SCALE)
+			return false;
+		if (i > 0 && points[i].lux <= points[i - 1].lux)
+			return false;
+	}
+	
+	return true;
+}
+
+//*****************************************************************************
+//
+//! Rebuilds the segment index and slopes of the curve
+//
+//*****************************************************************************
+static void lux_curve_index_update(void)
+{
+	const struct lux_curve_point *points = _curve.points;
+	uint32_t last = _curve.num_points - 1;
+	uint32_t range = points[last].lux - points[0].lux;
+	uint32_t segment = 0;
+	
+	for (uint32_t i = 0; i < last; i++)
+		_slope[i] = (((int32_t)points[i + 1].scale - (int32_t)points[i].scale) * LUX_CURVE_SLOPE_ONE) /
+			(int32_t)(points[i + 1].lux - points[i].lux);
+	
+	// Smallest power of two bin width that covers the range
+	_shift = 0;
+	while ((range >> _shift) >= LUX_CURVE_BINS)
+		_shift++;
+	
+	for (uint32_t bin = 0; bin < LUX_CURVE_BINS; bin++)
+	{
+		uint32_t start = points[0].lux + (bin << _shift);
+		
+		while (segment < last - 1 && points[segment + 1].lux <= start)
+			segment++;
+		_index[bin] = segment;
+	}
+}
@@ -0,0 +1,64 @@
+//*****************************************************************************
+//
+// lux_curve.h - Headers for the ambient light response curve
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#ifndef LUX_CURVE_H
+#define LUX_CURVE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LUX_CURVE_MAX_POINTS 32    // Maximum number of breakpoints
+#define LUX_CURVE_MAX_LUX    65535 // Largest lux of a breakpoint
+#define LUX_CURVE_MAX_SCALE  256   // Scale that leaves the brightness as is
+
+//*****************************************************************************
+//
+// A breakpoint of the response curve. The brightness is scaled by
+// scale / LUX_CURVE_MAX_SCALE at lux. Between breakpoints the scale is
+// interpolated, below the first and above the last it is held.
+//
+//*****************************************************************************
+struct lux_curve_point
+{
+	uint16_t lux;
+	uint16_t scale;
+};
+
+//*****************************************************************************
+//
+// Public function prototypes.
+//
+//*****************************************************************************
+void lux_curve_init(void);
+bool lux_curve_set(const struct lux_curve_point *points, uint32_t num_points);
+uint32_t lux_curve_points_get(struct lux_curve_point *points);
+uint32_t lux_curve_max_lux_get(void);
+uint32_t lux_curve_scale_get(uint32_t lux);
+bool lux_curve_save(void);
+
+#endif
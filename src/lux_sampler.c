@@ -0,0 +1,271 @@
+//*****************************************************************************
+//
+// lux_sampler.c - Adaptive lux sampling rate
+//
+// Decides when the lux sensor is read next and for how long it integrates.
+// The sampler keeps a running mean and variance of the readings. A reading
+// further from the mean than the noise allows is a change in light: the
+// interval drops to its lower bound so the lamp follows the change quickly.
+// Every reading within the noise doubles the interval, up to its upper
+// bound, so a lamp in stable light reads the sensor less often. The upper
+// bound is also the longest time a change in light can go unseen, so it
+// trades the number of samples against the response to a light switch.
+//
+// Longer intervals also use longer integration times, up to half the
+// interval, which lowers the noise in dim light. A saturated sensor
+// shortens the longest integration time allowed until the light changes.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "lux_sampler.h"
+#include "tsl2591.h"
+
+//*****************************************************************************
+//
+// Module Configuration Defines
+//
+//*****************************************************************************
+#define LUX_SAMPLER_MIN_CHANGE   5.0f  // Smallest change in lux detected
+#define LUX_SAMPLER_CHANGE_RATIO 0.1f  // Smallest change detected, relative
+                                       // 	to the mean
+#define LUX_SAMPLER_NOISE_SIGMAS 3.0f  // Change detected, in standard 
+                                       // 	deviations of the readings
+#define LUX_SAMPLER_WEIGHT       0.125f // Weight of a reading in the mean and
+                                       // 	variance
+
+//*****************************************************************************
+//
+// Internal variables
+//
+//*****************************************************************************
+static uint32_t _min_ms;
+static uint32_t _max_ms;
+static uint32_t _interval_ms;
+static uint32_t _atime;      // Integration time of the next sample
+static uint32_t _atime_max;  // Longest integration time that did not saturate
+static bool _first;
+static float _mean;
+static float _variance;
+static struct lux_sampler_stats _stats;
+
+//*****************************************************************************
+//
+// Prototypes for private functions
+//
+//*****************************************************************************
+static void lux_sampler_interval_set(uint32_t interval_ms);
+
+//*****************************************************************************
+//
+//! Initializes the sampler with the default bounds
+//!
+//! \return None.
+//
+//*****************************************************************************
+void lux_sampler_init(void)
+{
+	_min_ms = LUX_SAMPLER_DEFAULT_MIN_MS;
+	_max_ms = LUX_SAMPLER_DEFAULT_MAX_MS;
+	_atime_max = TSL2591_CONTROL_ATIME_600;
+	_first = true;
+	_mean = 0.0f;
+	_variance = 0.0f;
+	_stats.samples = 0;
+	_stats.changes = 0;
+	_stats.overflows = 0;
+	_stats.elapsed_ms = 0;
+	lux_sampler_interval_set(_min_ms);
+}
+
+//*****************************************************************************
+//
+//! Sets the bounds of the sampling interval
+//!
+//! \param min_ms is the interval after a change in light
+//! \param max_ms is the longest interval in stable light
+//!
+//! The next sample is taken after min_ms.
+//!
+//! \return true if the bounds were set, false if they are out of range
+//
+//*****************************************************************************
+bool lux_sampler_bounds_set(uint32_t min_ms, uint32_t max_ms)
+{
+	if (min_ms < LUX_SAMPLER_MIN_INTERVAL_MS || max_ms > LUX_SAMPLER_MAX_INTERVAL_MS ||
+		min_ms > max_ms)
+		return false;
+	
+	_min_ms = min_ms;
+	_max_ms = max_ms;
+	lux_sampler_interval_set(_min_ms);
+	
+	return true;
+}
+
+//*****************************************************************************
+//
+//! Gets the bounds of the sampling interval
+//!
+//! \param min_ms is set to the interval after a change in light
+//! \param max_ms is set to the longest interval in stable light
+//!
+//! \return None.
+//
+//*****************************************************************************
+void lux_sampler_bounds_get(uint32_t *min_ms, uint32_t *max_ms)
+{
+	*min_ms = _min_ms;
+	*max_ms = _max_ms;
+}
+
+//*****************************************************************************
+//
+//! Adds a reading and computes the time to the next sample
+//!
+//! \param lux is the reading
+//!
+//! \return the time from the start of this sample to the start of the next
+//! one, in ms
+//
+//*****************************************************************************
+uint32_t lux_sampler_update(uint32_t lux)
+{
+	float change, threshold, noise;
+	
+	_stats.samples++;
+	_stats.elapsed_ms += _interval_ms;
+	
+	if (_first)
+	{
+		_first = false;
+		_mean = lux;
+		lux_sampler_interval_set(_min_ms);
+		return _interval_ms;
+	}
+	
+	change = (float)lux - _mean;
+	threshold = LUX_SAMPLER_CHANGE_RATIO * _mean;
+	if (threshold < LUX_SAMPLER_MIN_CHANGE)
+		threshold = LUX_SAMPLER_MIN_CHANGE;
+	noise = LUX_SAMPLER_NOISE_SIGMAS * sqrtf(_variance);
+	if (threshold < noise)
+		threshold = noise;
+	
+	if (fabsf(change) > threshold)
+	{
+		// Follow the new light level from its first reading
+		_stats.changes++;
+		_mean = lux;
+		_atime_max = TSL2591_CONTROL_ATIME_600;
+		lux_sampler_interval_set(_min_ms);
+	}
+	else
+	{
+		_mean += LUX_SAMPLER_WEIGHT * change;
+		_variance += LUX_SAMPLER_WEIGHT * (change * change - _variance);
+		lux_sampler_interval_set(_interval_ms < _max_ms / 2 ? _interval_ms * 2 : _max_ms);
+	}
+	
+	return _interval_ms;
+}
+
+//*****************************************************************************
+//
+//! Reports a sample lost to a saturated sensor and computes the time to the
+//! next sample
+//!
+//! \return the time from the start of this sample to the start of the next
+//! one, in ms
+//
+//*****************************************************************************
+uint32_t lux_sampler_overflow(void)
+{
+	_stats.overflows++;
+	_stats.elapsed_ms += _interval_ms;
+	
+	if (_atime > TSL2591_CONTROL_ATIME_100)
+		_atime_max = _atime - 1;
+	
+	lux_sampler_interval_set(_min_ms);
+	return _interval_ms;
+}
+
+//*****************************************************************************
+//
+//! Gets the time from the start of the last sample to the start of the next
+//!
+//! \return the interval in ms
+//
+//*****************************************************************************
+uint32_t lux_sampler_interval_get(void)
+{
+	return _interval_ms;
+}
+
+//*****************************************************************************
+//
+//! Gets the integration time of the next sample
+//!
+//! \return the integration time, as one of the TSL2591_CONTROL_ATIME defines
+//
+//*****************************************************************************
+uint32_t lux_sampler_integration_get(void)
+{
+	return _atime;
+}
+
+//*****************************************************************************
+//
+//! Gets the sampling counters
+//!
+//! \param stats is set to the counters
+//!
+//! \return None.
+//
+//*****************************************************************************
+void lux_sampler_stats_get(struct lux_sampler_stats *stats)
+{
+	*stats = _stats;
+}
+
+//*****************************************************************************
+//
+//! Sets the interval and the longest integration time that fits in half of it
+//!
+//! \param interval_ms is the interval
+//
+//*****************************************************************************
+static void lux_sampler_interval_set(uint32_t interval_ms)
+{
+	_interval_ms = interval_ms;
+	
+	_atime = TSL2591_CONTROL_ATIME_100;
+	while (_atime < _atime_max && TSL2591_ATIME_MS(_atime + 1) <= interval_ms / 2)
+		_atime++;
+}
@@ -0,0 +1,65 @@
+//*****************************************************************************
+//
+// lux_sampler.h - Headers for the adaptive lux sampling rate
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#ifndef LUX_SAMPLER_H
+#define LUX_SAMPLER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LUX_SAMPLER_MIN_INTERVAL_MS     200    // Lowest bound, fits the
+                                               // 	shortest integration time
+#define LUX_SAMPLER_MAX_INTERVAL_MS     600000 // Highest bound
+#define LUX_SAMPLER_DEFAULT_MIN_MS      250    // Interval after a change
+#define LUX_SAMPLER_DEFAULT_MAX_MS      1000   // Interval in stable light, keeps
+                                               // 	the response to a sudden
+                                               // 	change within a second
+
+struct lux_sampler_stats
+{
+	uint32_t samples;    // Samples taken
+	uint32_t changes;    // Samples that detected a change in light
+	uint32_t overflows;  // Samples lost to a saturated sensor
+	uint32_t elapsed_ms; // Time covered by the samples
+};
+
+//*****************************************************************************
+//
+// Public function prototypes.
+//
+//*****************************************************************************
+void lux_sampler_init(void);
+bool lux_sampler_bounds_set(uint32_t min_ms, uint32_t max_ms);
+void lux_sampler_bounds_get(uint32_t *min_ms, uint32_t *max_ms);
+uint32_t lux_sampler_update(uint32_t lux);
+uint32_t lux_sampler_overflow(void);
+uint32_t lux_sampler_interval_get(void);
+uint32_t lux_sampler_integration_get(void);
+void lux_sampler_stats_get(struct lux_sampler_stats *stats);
+
+#endif
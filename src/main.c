@@ -52,6 +52,20 @@
 #include "tsl2591.h"
 #include "console.h"
 #include "timer_ext.h"
+#include "dmx.h"
+#include "pixel.h"
+#include "cct.h"
+#include "settings.h"
+#include "calib.h"
+#include "lampbus.h"
+#include "clock.h"
+#include "i2c_slave.h"
+#include "telemetry.h"
+#include "irq.h"
+#include "dimmer.h"
+#include "thermal.h"
+#include "energy.h"
+#include "schedule.h"
 
 int main(void)
 {
@@ -61,13 +75,30 @@ int main(void)
 	// Initialize various sub systems
 	console_init();
 	log_init();
+	settings_init();
+	clock_init();
+	calib_init();
+	energy_init();
 	led_init();
+	cct_init();
+	schedule_init();
 	button_init();
+	dmx_init();
+	pixel_init();
+	lampbus_init();
+	i2c_slave_init();
+	dimmer_init();
+	thermal_init();
+	irq_init();
 	
 	// Set logging level
 	log_output_level_set(LOG_SUB_SYSTEM_BUTTON, LOG_LEVEL_NONE);
 	log_output_level_set(LOG_SUB_SYSTEM_SENSOR_LUX, LOG_LEVEL_NONE);
 	log_output_level_set(LOG_SUB_SYSTEM_LED, LOG_LEVEL_NONE);
+	log_output_level_set(LOG_SUB_SYSTEM_DMX, LOG_LEVEL_NONE);
+	log_output_level_set(LOG_SUB_SYSTEM_TIMELINE, LOG_LEVEL_NONE);
+	log_output_level_set(LOG_SUB_SYSTEM_SETTINGS, LOG_LEVEL_NONE);
+	log_output_level_set(LOG_SUB_SYSTEM_LAMPBUS, LOG_LEVEL_NONE);
 	
 	// Load LED profile
 	led_profile_load(0);
@@ -78,6 +109,13 @@ int main(void)
 	char buffer[UART_RX_BUFFER_SIZE];
 	while (1)
 	{
+		lampbus_process();
+		led_process();
+		i2c_slave_process();
+		telemetry_process();
+		energy_process();
+		schedule_process();
+		
 		if (UARTPeek('\r') != -1)
 		{
 			UARTgets(buffer, UART_RX_BUFFER_SIZE);
@@ -0,0 +1,458 @@
+//*****************************************************************************
+//
+// pca9685.c - Driver for PCA9685 16 channel I2C PWM expanders
+//
+// The chips share the I2C bus with the lux sensor and are addressed from
+// PCA9685_BASE_ADDRESS upward. Channel n is output n % 16 of chip n / 16.
+//
+// Duty cycles are written to a shadow copy and sent to the chips by
+// pca9685_flush(), which the LED fade timer calls once per step. Each chip
+// keeps the range of channels changed since the last flush and gets a
+// single auto-increment burst covering only that range, so one fade step
+// costs one transfer per chip that changed. Writes that set every channel
+// in use to the same duty cycle go to the ALL_CALL address instead, which
+// updates all chips with one transfer. Channels never written are not wired
+// to an LED, so the broadcast may change them.
+//
+// Bus time is estimated from the bytes sent at the configured bus speed, so
+// the maximum fade step rate for a number of channels is known.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "log.h"
+#include "i2c_ext.h"
+#include "pca9685.h"
+
+//*****************************************************************************
+//
+// Defines used to configure the PCA9685 driver
+//
+//*****************************************************************************
+#define PCA9685_BASE_ADDRESS      0x40 // Address of the first chip
+#define PCA9685_ALL_CALL_ADDRESS  0x70 // Address all chips respond to
+#define PCA9685_PRESCALE          5    // 25 MHz / (4096 * (5 + 1)), about 1 kHz
+
+//
+// Registers and bits
+//
+#define PCA9685_REG_MODE1         0x00
+#define PCA9685_REG_MODE2         0x01
+#define PCA9685_REG_LED0_ON_L     0x06
+#define PCA9685_REG_ALL_LED_ON_L  0xFA
+#define PCA9685_REG_PRE_SCALE     0xFE
+
+#define PCA9685_MODE1_SLEEP       0x10
+#define PCA9685_MODE1_AI          0x20 // Register auto-increment
+#define PCA9685_MODE1_ALLCALL     0x01
+#define PCA9685_MODE2_OUTDRV      0x04 // Totem pole outputs
+#define PCA9685_FULL              0x10 // Full on/off bit of LEDn_ON_H/OFF_H
+
+#define PCA9685_BYTES_PER_CHANNEL 4    // ON_L, ON_H, OFF_L, OFF_H
+
+//
+// I2C bits sent per transfer besides the data: the address and register
+// bytes with their acknowledge bits, and the start and stop conditions
+//
+#define PCA9685_TRANSFER_OVERHEAD (2 * 9 + 2)
+
+//
+// Longest bus time of a flush. pca9685_flush() runs in the LED fade timer at
+// the priority of the DMX receiver, whose FIFO interrupt leaves 8 bytes or
+// 352 us of slack at 250 kbit/s. Changes beyond it are sent on later steps.
+//
+#define PCA9685_FLUSH_MAX_US      350
+#define PCA9685_FLUSH_MAX_BITS    (PCA9685_FLUSH_MAX_US * (I2C_BUS_SPEED / 1000) / 1000)
+
+//*****************************************************************************
+//
+// Shadow of the duty cycles and outputs changed since the last flush, per
+// chip. Bit n of dirty is set while output n has not been sent. Bit n of used
+// is set once output n has been written, which marks it as wired to an LED.
+// A flush that runs out of bus time resumes from cursor, so every output is
+// sent even if the first ones change on every step.
+//
+//*****************************************************************************
+struct pca9685_chip
+{
+	bool present;
+	uint8_t cursor;
+	uint16_t dirty;
+	uint16_t used;
+	uint16_t duty[PCA9685_CHANNELS_PER_CHIP];
+};
+
+static struct pca9685_chip _chips[PCA9685_MAX_CHIPS];
+static uint32_t _num_chips;
+static uint32_t _flush_chip;    // Chip the next flush starts from
+static uint32_t _bus_time;      // Bus time of the last flush, in us
+static uint32_t _max_bus_time;  // Longest flush, in us
+
+//*****************************************************************************
+//
+// Prototypes for private functions
+//
+//*****************************************************************************
+static void pca9685_encode(uint32_t duty, uint8_t data[PCA9685_BYTES_PER_CHANNEL]);
+static bool pca9685_uniform(uint32_t *duty);
+
+//*****************************************************************************
+//
+//! Initializes the PCA9685 chips on the I2C bus
+//!
+//! This function probes each chip address, sets the PWM frequency and turns
+//! every output off. Channels of chips that do not respond are ignored.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void pca9685_init(void)
+{
+	uint8_t data[1];
+	
+	i2c_init();
+	
+	_num_chips = 0;
+	for (uint32_t i = 0; i < PCA9685_MAX_CHIPS; i++)
+	{
+		uint8_t address = PCA9685_BASE_ADDRESS + i;
+		struct pca9685_chip *chip = &_chips[i];
+		
+		chip->cursor = 0;
+		chip->dirty = 0;
+		chip->used = 0;
+		for (uint32_t channel = 0; channel < PCA9685_CHANNELS_PER_CHIP; channel++)
+			chip->duty[channel] = 0;
+		
+		// The prescaler can only be written while the oscillator is asleep
+		data[0] = PCA9685_MODE1_SLEEP | PCA9685_MODE1_AI | PCA9685_MODE1_ALLCALL;
+		chip->present = i2c_register_write(address, PCA9685_REG_MODE1, data, 1) == 0;
+		if (!chip->present)
+			continue;
+		
+		data[0] = PCA9685_PRESCALE;
+		i2c_register_write(address, PCA9685_REG_PRE_SCALE, data, 1);
+		data[0] = PCA9685_MODE1_AI | PCA9685_MODE1_ALLCALL;
+		i2c_register_write(address, PCA9685_REG_MODE1, data, 1);
+		data[0] = PCA9685_MODE2_OUTDRV;
+		i2c_register_write(address, PCA9685_REG_MODE2, data, 1);
+		
+		_num_chips++;
+	}
+	
+	log_msg_value(LOG_SUB_SYSTEM_I2C0, LOG_LEVEL_DEBUG, "PCA9685 chips found", _num_chips);
+	
+	if (_num_chips != 0)
+		pca9685_all_set(0);
+	
+	_flush_chip = 0;
+	_bus_time = 0;
+	_max_bus_time = 0;
+}
+
+//*****************************************************************************
+//
+//! Gets the number of chips that responded during initialization
+//!
+//! \return the number of chips found
+//
+//*****************************************************************************
+uint32_t pca9685_num_chips_get(void)
+{
+	return _num_chips;
+}
+
+//*****************************************************************************
+//
+//! Sets the duty cycle of a channel. The change is sent by pca9685_flush().
+//!
+//! \param channel is the channel across all chips
+//! \param duty is the duty cycle from 0 to PCA9685_DUTY_MAX
+//!
+//! \return None.
+//
+//*****************************************************************************
+void pca9685_duty_set(uint32_t channel, uint32_t duty)
+{
+	struct pca9685_chip *chip;
+	uint32_t output;
+	
+	if (channel >= PCA9685_MAX_CHANNELS)
+		return;
+	
+	if (duty > PCA9685_DUTY_MAX)
+		duty = PCA9685_DUTY_MAX;
+	
+	chip = &_chips[channel / PCA9685_CHANNELS_PER_CHIP];
+	output = channel % PCA9685_CHANNELS_PER_CHIP;
+	chip->used |= 1u << output;
+	if (chip->duty[output] == duty)
+		return;
+	
+	chip->duty[output] = duty;
+	chip->dirty |= 1u << output;
+}
+
+//*****************************************************************************
+//
+//! Sets every channel of every chip to the same duty cycle with a single
+//! transfer to the ALL_CALL address
+//!
+//! \param duty is the duty cycle from 0 to PCA9685_DUTY_MAX
+//!
+//! \return None.
+//
+//*****************************************************************************
+void pca9685_all_set(uint32_t duty)
+{
+	uint8_t data[PCA9685_BYTES_PER_CHANNEL];
+	
+	if (duty > PCA9685_DUTY_MAX)
+		duty = PCA9685_DUTY_MAX;
+	
+	pca9685_encode(duty, data);
+	if (i2c_register_write(PCA9685_ALL_CALL_ADDRESS, PCA9685_REG_ALL_LED_ON_L, 
+		data, PCA9685_BYTES_PER_CHANNEL) != 0)
+		return;
+	
+	for (uint32_t i = 0; i < PCA9685_MAX_CHIPS; i++)
+	{
+		for (uint32_t channel = 0; channel < PCA9685_CHANNELS_PER_CHIP; channel++)
+			_chips[i].duty[channel] = duty;
+		_chips[i].dirty = 0;
+	}
+}
+
+//*****************************************************************************
+//
+//! Sends the duty cycles changed since the last flush to the chips
+//!
+//! If the bus is in use by the code this call interrupted, nothing is sent
+//! and the changes are kept for the next flush. A flush uses at most
+//! PCA9685_FLUSH_MAX_US of bus time. Each transfer sends one run of outputs
+//! of a chip, and the outputs left over are sent by the next flush.
+//!
+//! \return true if every change was sent, false if some are still pending
+//
+//*****************************************************************************
+bool pca9685_flush(void)
+{
+	uint8_t data[PCA9685_CHANNELS_PER_CHIP * PCA9685_BYTES_PER_CHANNEL];
+	uint32_t bits = 0;
+	uint32_t duty;
+	
+	bool sent = true;
+	
+	if (_num_chips == 0)
+		return true;
+	if (i2c_busy())
+		return false;
+	
+	// Every channel in use changed to the same duty cycle, one broadcast
+	// covers it
+	if (pca9685_uniform(&duty))
+	{
+		pca9685_all_set(duty);
+		bits = PCA9685_TRANSFER_OVERHEAD + PCA9685_BYTES_PER_CHANNEL * 9;
+	}
+	
+	// Visit each chip once from where the last flush stopped. A chip with
+	// outputs left after a transfer is visited again while bus time remains.
+	for (uint32_t n = 0; n < PCA9685_MAX_CHIPS; )
+	{
+		struct pca9685_chip *chip = &_chips[_flush_chip];
+		uint32_t max_channels, first, last, num_bytes;
+		
+		if (!chip->present || chip->dirty == 0)
+		{
+			_flush_chip = (_flush_chip + 1) % PCA9685_MAX_CHIPS;
+			n++;
+			continue;
+		}
+		
+		if (bits + PCA9685_TRANSFER_OVERHEAD + PCA9685_BYTES_PER_CHANNEL * 9 > PCA9685_FLUSH_MAX_BITS)
+		{
+			sent = false;
+			break;
+		}
+		max_channels = (PCA9685_FLUSH_MAX_BITS - bits - PCA9685_TRANSFER_OVERHEAD) / 
+			(PCA9685_BYTES_PER_CHANNEL * 9);
+		
+		// Send the run of outputs from the first dirty one at or after the
+		// cursor to the last dirty one that fits in the bus time
+		first = chip->cursor;
+		while (!(chip->dirty & (1u << first)))
+			first = (first + 1) % PCA9685_CHANNELS_PER_CHIP;
+		last = first;
+		for (uint32_t channel = first + 1; channel < PCA9685_CHANNELS_PER_CHIP && 
+			channel < first + max_channels; channel++)
+		{
+			if (chip->dirty & (1u << channel))
+				last = channel;
+		}
+		
+		num_bytes = 0;
+		for (uint32_t channel = first; channel <= last; channel++)
+		{
+			pca9685_encode(chip->duty[channel], &data[num_bytes]);
+			num_bytes += PCA9685_BYTES_PER_CHANNEL;
+		}
+		bits += PCA9685_TRANSFER_OVERHEAD + num_bytes * 9;
+		
+		// Keep the outputs dirty if the transfer failed, so they are retried
+		if (i2c_register_write(PCA9685_BASE_ADDRESS + _flush_chip, PCA9685_REG_LED0_ON_L + 
+			first * PCA9685_BYTES_PER_CHANNEL, data, num_bytes) != 0)
+		{
+			sent = false;
+			_flush_chip = (_flush_chip + 1) % PCA9685_MAX_CHIPS;
+			n++;
+			continue;
+		}
+		
+		chip->dirty &= ~(((2u << last) - 1) & ~((1u << first) - 1));
+		chip->cursor = (last + 1) % PCA9685_CHANNELS_PER_CHIP;
+	}
+	
+	_bus_time = bits * 1000000 / I2C_BUS_SPEED;
+	if (_bus_time > _max_bus_time)
+		_max_bus_time = _bus_time;
+	
+	return sent;
+}
+
+//*****************************************************************************
+//
+//! Gets the bus time of the last flush
+//!
+//! \return the bus time in us
+//
+//*****************************************************************************
+uint32_t pca9685_bus_time_get(void)
+{
+	return _bus_time;
+}
+
+//*****************************************************************************
+//
+//! Gets the longest bus time of a flush since initialization
+//!
+//! \return the bus time in us
+//
+//*****************************************************************************
+uint32_t pca9685_max_bus_time_get(void)
+{
+	return _max_bus_time;
+}
+
+//*****************************************************************************
+//
+//! Estimates the bus time of a flush that changes a number of channels
+//!
+//! \param num_channels is the number of channels changed, starting from
+//! channel 0
+//!
+//! A flush sends at most PCA9685_FLUSH_MAX_US of it per fade step, so it
+//! gives the fastest rate at which that number of channels is refreshed.
+//!
+//! \return the bus time in us
+//
+//*****************************************************************************
+uint32_t pca9685_bus_time_estimate(uint32_t num_channels)
+{
+	uint32_t bits = 0;
+	
+	while (num_channels != 0)
+	{
+		uint32_t chip_channels = num_channels < PCA9685_CHANNELS_PER_CHIP ? 
+			num_channels : PCA9685_CHANNELS_PER_CHIP;
+		
+		bits += PCA9685_TRANSFER_OVERHEAD + chip_channels * PCA9685_BYTES_PER_CHANNEL * 9;
+		num_channels -= chip_channels;
+	}
+	
+	return bits * 1000000 / I2C_BUS_SPEED;
+}
+
+//*****************************************************************************
+//
+//! Encodes a duty cycle into the ON and OFF registers of a channel. Every 
+//! channel turns on at the start of the PWM period.
+//!
+//! \param duty is the duty cycle from 0 to PCA9685_DUTY_MAX
+//! \param data is set to the LEDn_ON_L, ON_H, OFF_L and OFF_H values
+//
+//*****************************************************************************
+static void pca9685_encode(uint32_t duty, uint8_t data[PCA9685_BYTES_PER_CHANNEL])
+{
+	data[0] = 0;
+	data[1] = duty >= PCA9685_DUTY_MAX ? PCA9685_FULL : 0;
+	data[2] = duty & 0xFF;
+	data[3] = ((duty >> 8) & 0x0F) | (duty == 0 ? PCA9685_FULL : 0);
+}
+
+//*****************************************************************************
+//
+//! Checks whether every channel in use is dirty and set to the same duty
+//! cycle, so a single broadcast can replace the per chip transfers. Channels
+//! that were never written are ignored.
+//!
+//! \return true if a broadcast covers all pending changes, and sets duty to
+//! the duty cycle to broadcast
+//
+//*****************************************************************************
+static bool pca9685_uniform(uint32_t *duty)
+{
+	bool found = false;
+	
+	for (uint32_t i = 0; i < PCA9685_MAX_CHIPS; i++)
+	{
+		const struct pca9685_chip *chip = &_chips[i];
+		
+		if (!chip->present || chip->used == 0)
+			continue;
+		
+		for (uint32_t channel = 0; channel < PCA9685_CHANNELS_PER_CHIP; channel++)
+		{
+			if (!(chip->used & (1u << channel)))
+				continue;
+			
+			if (!(chip->dirty & (1u << channel)))
+				return false;
+			
+			if (!found)
+			{
+				*duty = chip->duty[channel];
+				found = true;
+			}
+			else if (chip->duty[channel] != *duty)
+			{
+				return false;
+			}
+		}
+	}
+	
+	return found;
+}
@@ -0,0 +1,54 @@
+//*****************************************************************************
+//
+// pca9685.h - Headers for the PCA9685 I2C PWM expander driver
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#ifndef PCA9685_H
+#define PCA9685_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define PCA9685_MAX_CHIPS         4    // Maximum number of chips on the bus
+#define PCA9685_CHANNELS_PER_CHIP 16
+#define PCA9685_MAX_CHANNELS      (PCA9685_MAX_CHIPS * PCA9685_CHANNELS_PER_CHIP)
+#define PCA9685_DUTY_MAX          4096 // Duty cycle of a channel fully on
+
+//*****************************************************************************
+//
+// Public function prototypes.
+//
+//*****************************************************************************
+void pca9685_init(void);
+uint32_t pca9685_num_chips_get(void);
+void pca9685_duty_set(uint32_t channel, uint32_t duty);
+void pca9685_all_set(uint32_t duty);
+bool pca9685_flush(void);
+uint32_t pca9685_bus_time_get(void);
+uint32_t pca9685_max_bus_time_get(void);
+uint32_t pca9685_bus_time_estimate(uint32_t num_channels);
+
+#endif
@@ -0,0 +1,497 @@
+//*****************************************************************************
+//
+// pixel.c - Output backend for WS2812-class addressable LED strips
+//
+// WS2812-class pixels use a single wire protocol where each data bit is a
+// 1.25us period with a short (0) or long (1) high time. This module generates
+// the waveform with SSI0 (PA5) by encoding every data bit as a five bit SSI
+// symbol, 11000 for a 0 and 11100 for a 1. At an SSI bit rate of 4 MHz, which
+// the 16 MHz system clock gives exactly, this is a 1.25us data bit with a
+// 0.5us or 0.75us high time.
+//
+// A data byte is 40 SSI bits, sent as five 8 bit SSI frames. The encoding is
+// two lookups in a 16 entry table of nibble symbols. Pixel colors are kept in a frame buffer of one
+// 32 bit word per pixel. pixel_show() encodes the frame buffer into the back
+// half of a double buffer while the uDMA streams the front half to the SSI.
+// The CPU is only involved in the encoding and in one interrupt per frame.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "inc/hw_types.h"
+#include "inc/hw_memmap.h"
+#include "inc/hw_ints.h"
+#include "inc/hw_ssi.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/pin_map.h"
+#include "driverlib/gpio.h"
+#include "driverlib/ssi.h"
+#include "driverlib/udma.h"
+#include "driverlib/interrupt.h"
+
+#include "pixel.h"
+#include "udma_ext.h"
+
+//*****************************************************************************
+//
+// Module Configuration Defines
+//
+//*****************************************************************************
+#define PIXEL_SSI_BASE          SSI0_BASE        // SSI used to drive the strip
+#define PIXEL_SSI_BIT_RATE      4000000          // SSI bit rate, a 16 MHz clock
+                                                 //  divided by 4. 5 SSI bits per
+                                                 //  pixel data bit give 1.25us
+#define PIXEL_SSI_DATA_WIDTH    8                // SSI frame size in bits
+#define PIXEL_FRAMES_PER_BYTE   5                // SSI frames per pixel data byte
+#define PIXEL_UDMA_CHANNEL      UDMA_CH11_SSI0TX // uDMA channel of the SSI TX
+#define PIXEL_UDMA_MAX_ITEMS    1024             // Maximum items per uDMA task
+#define PIXEL_RESET_FRAMES      150              // Low time after each frame,
+                                                 //  150 frames is 300us
+#define PIXEL_DEFAULT_NUM_PIXELS 60              // Number of pixels at boot
+#define PIXEL_ENCODE_BUDGET     60               // Encoding budget in CPU
+                                                 //  cycles per pixel. 300
+                                                 //  pixels at 60 fps use about
+                                                 //  6.8% of the 16 MHz CPU
+
+#define PIXEL_DATA_FRAMES(n)    ((n) * PIXEL_CHANNELS * PIXEL_FRAMES_PER_BYTE)
+#define PIXEL_ENCODED_SIZE      (PIXEL_DATA_FRAMES(PIXEL_MAX_PIXELS) + PIXEL_RESET_FRAMES)
+#define PIXEL_MAX_TASKS         ((PIXEL_ENCODED_SIZE + PIXEL_UDMA_MAX_ITEMS - 1) / PIXEL_UDMA_MAX_ITEMS)
+
+//
+// Data watchpoint and trace unit registers used to count CPU cycles
+//
+#define PIXEL_DEMCR             0xE000EDFC
+#define PIXEL_DEMCR_TRCENA      0x01000000
+#define PIXEL_DWT_CTRL          0xE0001000
+#define PIXEL_DWT_CTRL_CYCCNTENA 0x00000001
+#define PIXEL_DWT_CYCCNT        0xE0001004
+
+//*****************************************************************************
+//
+// SSI symbols for each nibble of pixel data, most significant bit first.
+// A 0 bit is encoded as 11000 (500ns high) and a 1 bit as 11100 (750ns high).
+//
+//*****************************************************************************
+static const uint32_t _nibble_symbols[16] =
+{
+	0xC6318, 0xC631C, 0xC6398, 0xC639C, 0xC7318, 0xC731C, 0xC7398, 0xC739C,
+	0xE6318, 0xE631C, 0xE6398, 0xE639C, 0xE7318, 0xE731C, 0xE7398, 0xE739C
+};
+
+//*****************************************************************************
+//
+// Internal variables
+//
+//*****************************************************************************
+static uint32_t _pixels[PIXEL_MAX_PIXELS];               // Frame buffer
+static uint8_t _encoded[2][PIXEL_ENCODED_SIZE];          // Encoded double buffer
+static tDMAControlTable _tasks[2][PIXEL_MAX_TASKS];      // uDMA task list per
+                                                         //  encoded buffer
+static uint32_t _num_tasks;                              // Tasks per frame
+static uint32_t _num_pixels;                             // Pixels on the strip
+static volatile bool _streaming;                         // uDMA is streaming
+static volatile bool _pending;                           // A frame is waiting
+static volatile uint32_t _stream_buffer;                 // Buffer being streamed
+static uint32_t _encode_cycles;                          // Last encode time
+static uint32_t _budget_overruns;                        // Encodes over budget
+
+//*****************************************************************************
+//
+// Prototypes for private functions
+//
+//*****************************************************************************
+static void pixel_stream_start(uint32_t buffer);
+static void pixel_tasks_build(void);
+static uint8_t *pixel_byte_encode(uint8_t *dst, uint32_t value);
+
+//*****************************************************************************
+//
+//! SSI0 interrupt handler. The uDMA raises it once the whole frame has been
+//! handed to the SSI. If another frame was encoded in the meantime it is
+//! started right away.
+//
+//*****************************************************************************
+void SSI0_Handler(void)
+{
+	SSIIntClear(PIXEL_SSI_BASE, SSIIntStatus(PIXEL_SSI_BASE, true));
+
+	if (uDMAChannelIsEnabled(PIXEL_UDMA_CHANNEL))
+		return;
+
+	if (_pending)
+	{
+		_pending = false;
+		pixel_stream_start(_stream_buffer ^ 1);
+	}
+	else
+	{
+		_streaming = false;
+	}
+}
+
+//*****************************************************************************
+//
+//! Initializes the addressable LED strip output
+//!
+//! This function configures SSI0 on PA5 and the uDMA channel used to stream
+//! the encoded frames. The strip is cleared.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void pixel_init(void)
+{
+	//***************************************************************************
+	//
+	// Initialize SSI0 used to generate the waveform
+	//
+	//***************************************************************************
+	SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOA);
+	while (!SysCtlPeripheralReady(SYSCTL_PERIPH_GPIOA)){};
+	SysCtlPeripheralEnable(SYSCTL_PERIPH_SSI0);
+	while (!SysCtlPeripheralReady(SYSCTL_PERIPH_SSI0)){};
+
+	GPIOPinConfigure(GPIO_PA5_SSI0TX);
+	GPIOPinTypeSSI(GPIO_PORTA_BASE, GPIO_PIN_5);
+
+	// Mode 1 (SPH = 1) sends frames back to back without a gap
+	SSIConfigSetExpClk(PIXEL_SSI_BASE, SysCtlClockGet(), SSI_FRF_MOTO_MODE_1,
+		SSI_MODE_MASTER, PIXEL_SSI_BIT_RATE, PIXEL_SSI_DATA_WIDTH);
+	SSIEnable(PIXEL_SSI_BASE);
+	SSIDMAEnable(PIXEL_SSI_BASE, SSI_DMA_TX);
+
+	//***************************************************************************
+	//
+	// Initialize uDMA channel used to stream the frames
+	//
+	//***************************************************************************
+	udma_init();
+
+	uDMAChannelAssign(PIXEL_UDMA_CHANNEL);
+	uDMAChannelAttributeDisable(PIXEL_UDMA_CHANNEL, UDMA_ATTR_ALTSELECT |
+		UDMA_ATTR_USEBURST | UDMA_ATTR_HIGH_PRIORITY | UDMA_ATTR_REQMASK);
+
+	IntEnable(INT_SSI0);
+
+	//***************************************************************************
+	//
+	// Enable the cycle counter used to measure the encoding time
+	//
+	//***************************************************************************
+	HWREG(PIXEL_DEMCR) |= PIXEL_DEMCR_TRCENA;
+	HWREG(PIXEL_DWT_CTRL) |= PIXEL_DWT_CTRL_CYCCNTENA;
+
+	//***************************************************************************
+	//
+	// Initialize module variables
+	//
+	//***************************************************************************
+	_streaming = false;
+	_pending = false;
+	_stream_buffer = 0;
+	_encode_cycles = 0;
+	_budget_overruns = 0;
+
+	// The reset frames at the end of each buffer are never overwritten
+	for (uint32_t i = 0; i < PIXEL_ENCODED_SIZE; i++)
+	{
+		_encoded[0][i] = 0;
+		_encoded[1][i] = 0;
+	}
+
+	pixel_num_pixels_set(PIXEL_DEFAULT_NUM_PIXELS);
+	pixel_fill(0);
+	pixel_show();
+}
+
+//*****************************************************************************
+//
+//! Sets the number of pixels on the strip
+//!
+//! \param num_pixels is the number of pixels, limited to PIXEL_MAX_PIXELS
+//!
+//! This function waits for the frame being streamed to complete.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void pixel_num_pixels_set(uint32_t num_pixels)
+{
+	if (num_pixels > PIXEL_MAX_PIXELS)
+		num_pixels = PIXEL_MAX_PIXELS;
+
+	// The task lists are in use while streaming
+	while (_streaming){};
+
+	// Clear the reset frames following the new last pixel
+	for (uint32_t i = PIXEL_DATA_FRAMES(num_pixels);
+		i < PIXEL_DATA_FRAMES(num_pixels) + PIXEL_RESET_FRAMES; i++)
+	{
+		_encoded[0][i] = 0;
+		_encoded[1][i] = 0;
+	}
+
+	_num_pixels = num_pixels;
+	pixel_tasks_build();
+}
+
+//*****************************************************************************
+//
+//! Gets the number of pixels on the strip
+//!
+//! \return Number of pixels
+//
+//*****************************************************************************
+uint32_t pixel_num_pixels_get(void)
+{
+	return _num_pixels;
+}
+
+//*****************************************************************************
+//
+//! Gets the frame buffer
+//!
+//! The frame buffer holds one word per pixel, packed with PIXEL_PACK(). It
+//! can be modified directly, for example by the blend kernels, before calling
+//! pixel_show().
+//!
+//! \return Pointer to the first pixel
+//
+//*****************************************************************************
+uint32_t *pixel_buffer_get(void)
+{
+	return _pixels;
+}
+
+//*****************************************************************************
+//
+//! Sets the color of a single pixel in the frame buffer
+//!
+//! \param index is the pixel to set
+//! \param color is the color, packed with PIXEL_PACK()
+//!
+//! \return None.
+//
+//*****************************************************************************
+void pixel_set(uint32_t index, uint32_t color)
+{
+	if (index >= _num_pixels)
+		return;
+
+	_pixels[index] = color;
+}
+
+//*****************************************************************************
+//
+//! Sets all pixels in the frame buffer to the same color
+//!
+//! \param color is the color, packed with PIXEL_PACK()
+//!
+//! \return None.
+//
+//*****************************************************************************
+void pixel_fill(uint32_t color)
+{
+	for (uint32_t i = 0; i < _num_pixels; i++)
+		_pixels[i] = color;
+}
+
+//*****************************************************************************
+//
+//! Encodes the frame buffer and sends it to the strip
+//!
+//! The frame buffer is encoded into the buffer that is not being streamed.
+//! If a frame is still being streamed, the new frame is started as soon as
+//! it completes. Calling this function again before then replaces the
+//! waiting frame.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void pixel_show(void)
+{
+	uint32_t buffer, start, cycles;
+	const uint32_t *src = _pixels;
+	uint8_t *dst;
+
+	// Keep the interrupt from starting the buffer while it is encoded
+	IntDisable(INT_SSI0);
+	_pending = false;
+	buffer = _streaming ? _stream_buffer ^ 1 : _stream_buffer;
+	IntEnable(INT_SSI0);
+
+	dst = _encoded[buffer];
+	start = HWREG(PIXEL_DWT_CYCCNT);
+
+	// WS2812 pixels expect green, red, blue (and white) order
+	for (uint32_t i = 0; i < _num_pixels; i++)
+	{
+		uint32_t color = *src++;
+
+		dst = pixel_byte_encode(dst, (color >> PIXEL_SHIFT_G) & 0xFF);
+		dst = pixel_byte_encode(dst, (color >> PIXEL_SHIFT_R) & 0xFF);
+		dst = pixel_byte_encode(dst, (color >> PIXEL_SHIFT_B) & 0xFF);
+#if PIXEL_CHANNELS == 4
+		dst = pixel_byte_encode(dst, (color >> PIXEL_SHIFT_W) & 0xFF);
+#endif
+	}
+
+	cycles = HWREG(PIXEL_DWT_CYCCNT) - start;
+	_encode_cycles = cycles;
+	if (cycles > _num_pixels * PIXEL_ENCODE_BUDGET)
+		_budget_overruns++;
+
+	IntDisable(INT_SSI0);
+	if (_streaming)
+	{
+		_pending = true;
+	}
+	else
+	{
+		pixel_stream_start(buffer);
+	}
+	IntEnable(INT_SSI0);
+}
+
+//*****************************************************************************
+//
+//! Determines if a frame is being sent to the strip
+//!
+//! \return true if a frame is being streamed, false otherwise
+//
+//*****************************************************************************
+bool pixel_busy(void)
+{
+	return _streaming;
+}
+
+//*****************************************************************************
+//
+//! Gets the number of CPU cycles used to encode the last frame
+//!
+//! \return Number of CPU cycles
+//
+//*****************************************************************************
+uint32_t pixel_encode_cycles_get(void)
+{
+	return _encode_cycles;
+}
+
+//*****************************************************************************
+//
+//! Gets the number of frames that were encoded over the per pixel budget
+//! PIXEL_ENCODE_BUDGET
+//!
+//! \return Number of frames over budget
+//
+//*****************************************************************************
+uint32_t pixel_budget_overrun_count_get(void)
+{
+	return _budget_overruns;
+}
+
+//*****************************************************************************
+//
+//! Starts streaming an encoded buffer to the SSI
+//!
+//! \param buffer is the encoded buffer to stream
+//
+//*****************************************************************************
+static void pixel_stream_start(uint32_t buffer)
+{
+	_stream_buffer = buffer;
+	_streaming = true;
+
+	uDMAChannelScatterGatherSet(PIXEL_UDMA_CHANNEL, _num_tasks, _tasks[buffer], 1);
+	uDMAChannelEnable(PIXEL_UDMA_CHANNEL);
+}
+
+//*****************************************************************************
+//
+//! Builds the uDMA task lists used to stream each encoded buffer. A single
+//! uDMA transfer is limited to PIXEL_UDMA_MAX_ITEMS items, so longer strips
+//! are split into several tasks that the uDMA runs one after another.
+//
+//*****************************************************************************
+static void pixel_tasks_build(void)
+{
+	uint32_t length = PIXEL_DATA_FRAMES(_num_pixels) + PIXEL_RESET_FRAMES;
+
+	_num_tasks = (length + PIXEL_UDMA_MAX_ITEMS - 1) / PIXEL_UDMA_MAX_ITEMS;
+
+	for (uint32_t buffer = 0; buffer < 2; buffer++)
+	{
+		for (uint32_t task = 0; task < _num_tasks; task++)
+		{
+			uint32_t offset = task * PIXEL_UDMA_MAX_ITEMS;
+			uint32_t count = length - offset;
+
+			if (count > PIXEL_UDMA_MAX_ITEMS)
+				count = PIXEL_UDMA_MAX_ITEMS;
+
+			// The last task must be a basic transfer to end the sequence
+			if (task == _num_tasks - 1)
+			{
+				_tasks[buffer][task] = (tDMAControlTable)uDMATaskStructEntry(count,
+					UDMA_SIZE_8, &_encoded[buffer][offset], UDMA_SRC_INC_8,
+					(void *)(PIXEL_SSI_BASE + SSI_O_DR), UDMA_DST_INC_NONE, UDMA_ARB_4,
+					UDMA_MODE_BASIC);
+			}
+			else
+			{
+				_tasks[buffer][task] = (tDMAControlTable)uDMATaskStructEntry(count,
+					UDMA_SIZE_8, &_encoded[buffer][offset], UDMA_SRC_INC_8,
+					(void *)(PIXEL_SSI_BASE + SSI_O_DR), UDMA_DST_INC_NONE, UDMA_ARB_4,
+					UDMA_MODE_PER_SCATTER_GATHER);
+			}
+		}
+	}
+}
+
+//*****************************************************************************
+//
+//! Encodes a byte of pixel data into the SSI frames sent for it
+//!
+//! \param dst is the first of the PIXEL_FRAMES_PER_BYTE frames to write
+//! \param value is the byte to encode
+//!
+//! \return Pointer to the frame following the encoded byte
+//
+//*****************************************************************************
+static uint8_t *pixel_byte_encode(uint8_t *dst, uint32_t value)
+{
+	uint32_t high = _nibble_symbols[value >> 4];
+	uint32_t low = _nibble_symbols[value & 0x0F];
+
+	dst[0] = high >> 12;
+	dst[1] = high >> 4;
+	dst[2] = (high << 4) | (low >> 16);
+	dst[3] = low >> 8;
+	dst[4] = low;
+
+	return dst + PIXEL_FRAMES_PER_BYTE;
+}
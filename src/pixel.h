@@ -0,0 +1,66 @@
+//*****************************************************************************
+//
+// pixel.h - Headers for using the addressable LED strip functions
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#ifndef PIXEL_H
+#define PIXEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define PIXEL_MAX_PIXELS   300 // Maximum number of pixels on the strip
+#define PIXEL_CHANNELS     3   // Color channels per pixel, 3 for RGB strips
+                               //  or 4 for RGBW strips
+
+//
+// Each pixel is stored as one 32 bit word with one byte per channel
+//
+#define PIXEL_SHIFT_R 0
+#define PIXEL_SHIFT_G 8
+#define PIXEL_SHIFT_B 16
+#define PIXEL_SHIFT_W 24
+#define PIXEL_PACK(r, g, b, w) (((uint32_t)(r) << PIXEL_SHIFT_R) | \
+	((uint32_t)(g) << PIXEL_SHIFT_G) | ((uint32_t)(b) << PIXEL_SHIFT_B) | \
+	((uint32_t)(w) << PIXEL_SHIFT_W))
+
+//*****************************************************************************
+//
+// Public function prototypes.
+//
+//*****************************************************************************
+void pixel_init(void);
+void pixel_num_pixels_set(uint32_t num_pixels);
+uint32_t pixel_num_pixels_get(void);
+uint32_t *pixel_buffer_get(void);
+void pixel_set(uint32_t index, uint32_t color);
+void pixel_fill(uint32_t color);
+void pixel_show(void);
+bool pixel_busy(void);
+uint32_t pixel_encode_cycles_get(void);
+uint32_t pixel_budget_overrun_count_get(void);
+
+#endif
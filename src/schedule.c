@@ -0,0 +1,512 @@
+//*****************************************************************************
+//
+// schedule.c - Daily circadian schedule kept on the Hibernate RTC
+//
+// The schedule fades the lamp through the day, warm in the morning and
+// evening and cool at midday, without a host. Wall time is kept by the RTC
+// of the Hibernate module, which runs from its own crystal and keeps going
+// over a reset. The RTC counts the seconds of the local day.
+//
+// Only the breakpoints are kept. The target of a minute is found by a binary
+// search for the breakpoints around it and a straight line between them.
+// When a target is applied, the minutes until it next changes are counted
+// along that line, up to the next breakpoint. The RTC match interrupt is set
+// to that minute, so the schedule is only evaluated when the target changes,
+// not polled. The interrupt only flags the change. The target is applied by
+// schedule_process() from the main loop, so the LEDs are not set from the
+// Hibernate handler.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "inc/hw_memmap.h"
+#include "inc/hw_ints.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/hibernate.h"
+#include "driverlib/interrupt.h"
+
+#include "schedule.h"
+#include "cct.h"
+#include "log.h"
+#include "settings.h"
+
+//*****************************************************************************
+//
+// Module Configuration Defines
+//
+//*****************************************************************************
+#define SCHEDULE_VERSION         1     // Version of struct schedule_data
+#define SCHEDULE_SECONDS_PER_DAY 86400
+
+//*****************************************************************************
+//
+// Saved schedule
+//
+//*****************************************************************************
+struct schedule_data
+{
+	uint16_t num_points;
+	uint16_t enable;
+	struct schedule_point points[SCHEDULE_MAX_POINTS];
+};
+
+static struct schedule_data _schedule __attribute__ ((aligned(4)));
+
+//
+// Schedule used when none was saved
+//
+static const struct schedule_point SCHEDULE_DEFAULT[] =
+{
+	{ 6 * 60,      2200, 0,   0},
+	{ 7 * 60,      3000, 180, 0},
+	{12 * 60,      6500, 255, 0},
+	{17 * 60,      4500, 230, 0},
+	{20 * 60,      2700, 150, 0},
+	{22 * 60 + 30, 2200, 40,  0},
+	{23 * 60 + 30, 2200, 0,   0},
+};
+
+#define SCHEDULE_DEFAULT_POINTS (sizeof(SCHEDULE_DEFAULT) / sizeof(SCHEDULE_DEFAULT[0]))
+
+//*****************************************************************************
+//
+// Internal variables
+//
+//*****************************************************************************
+static bool _resync;                   // Apply the next target even if it did
+                                       // 	not change
+static uint32_t _applied_kelvin;       // Target applied last
+static uint32_t _applied_intensity;
+static volatile bool _due;             // Set by the RTC match
+static uint32_t _update_count;
+
+//*****************************************************************************
+//
+// Prototypes for private functions
+//
+//*****************************************************************************
+static bool schedule_valid(const struct schedule_point *points, uint32_t num_points);
+static void schedule_segment_get(uint32_t minute, const struct schedule_point **from,
+	const struct schedule_point **to);
+static void schedule_line_get(const struct schedule_point *from, const struct schedule_point *to,
+	uint32_t minute, uint32_t *kelvin, uint32_t *intensity);
+static void schedule_update(void);
+
+//*****************************************************************************
+//
+//! Hibernate interrupt handler. The RTC match is set to the next minute the
+//! target changes. The target is applied by schedule_process().
+//
+//*****************************************************************************
+void HIB_Handler(void)
+{
+	HibernateIntClear(HibernateIntStatus(true));
+	
+	_due = true;
+}
+
+//*****************************************************************************
+//
+//! Initializes the schedule and the RTC
+//!
+//! settings_init() and cct_init() must be called first. The RTC is only
+//! reset if the Hibernate module was not already running. If the saved
+//! schedule is enabled, it is applied once interrupts are enabled.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void schedule_init(void)
+{
+	//***************************************************************************
+	//
+	// Initialize the Hibernate module RTC
+	//
+	//***************************************************************************
+	SysCtlPeripheralEnable(SYSCTL_PERIPH_HIBERNATE);
+	while (!SysCtlPeripheralReady(SYSCTL_PERIPH_HIBERNATE)){};
+	
+	HibernateEnableExpClk(SysCtlClockGet());
+	if (!HibernateIsActive())
+	{
+		HibernateClockConfig(HIBERNATE_OSC_LOWDRIVE);
+		HibernateRTCSet(0);
+	}
+	HibernateRTCEnable();
+	HibernateIntClear(HibernateIntStatus(false));
+	HibernateIntEnable(HIBERNATE_INT_RTC_MATCH_0);
+	
+	//***************************************************************************
+	//
+	// Load the schedule
+	//
+	//***************************************************************************
+	if (!settings_load(SETTINGS_BLOCK_SCHEDULE, SCHEDULE_VERSION, &_schedule, sizeof(_schedule)) ||
+		!schedule_valid(_schedule.points, _schedule.num_points))
+	{
+		_schedule.num_points = SCHEDULE_DEFAULT_POINTS;
+		_schedule.enable = false;
+		for (uint32_t i = 0; i < SCHEDULE_DEFAULT_POINTS; i++)
+			_schedule.points[i] = SCHEDULE_DEFAULT[i];
+	}
+	
+	_update_count = 0;
+	_resync = true;
+	
+	// Apply the first target from the main loop, after the boot profile
+	_due = true;
+	if (_schedule.enable)
+		IntEnable(INT_HIBERNATE);
+}
+
+//*****************************************************************************
+//
+//! Applies the target of the schedule once the RTC match flagged a change
+//!
+//! This function is called from the main loop.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void schedule_process(void)
+{
+	if (!_due)
+		return;
+	_due = false;
+	
+	if (_schedule.enable)
+		schedule_update();
+}
+
+//*****************************************************************************
+//
+//! Sets the breakpoints of the schedule
+//!
+//! \param points are the breakpoints, in increasing order of minute
+//! \param num_points is the number of breakpoints, from 1 to
+//! SCHEDULE_MAX_POINTS
+//!
+//! The schedule is used right away but only kept over a reset once saved
+//! with schedule_save().
+//!
+//! \return true if the schedule was set, false if the breakpoints are invalid
+//
+//*****************************************************************************
+bool schedule_set(const struct schedule_point *points, uint32_t num_points)
+{
+	if (!schedule_valid(points, num_points))
+		return false;
+	
+	IntDisable(INT_HIBERNATE);
+	_schedule.num_points = num_points;
+	for (uint32_t i = 0; i < num_points; i++)
+		_schedule.points[i] = points[i];
+	
+	_resync = true;
+	if (_schedule.enable)
+	{
+		schedule_update();
+		IntEnable(INT_HIBERNATE);
+	}
+	
+	log_msg_value(LOG_SUB_SYSTEM_LED, LOG_LEVEL_DEBUG, "Schedule points", num_points);
+	
+	return true;
+}
+
+//*****************************************************************************
+//
+//! Gets the breakpoints of the schedule
+//!
+//! \param points is set to the breakpoints. It must hold
+//! SCHEDULE_MAX_POINTS.
+//!
+//! \return the number of breakpoints
+//
+//*****************************************************************************
+uint32_t schedule_points_get(struct schedule_point *points)
+{
+	for (uint32_t i = 0; i < _schedule.num_points; i++)
+		points[i] = _schedule.points[i];
+	
+	return _schedule.num_points;
+}
+
+//*****************************************************************************
+//
+//! Saves the schedule and whether it is enabled
+//!
+//! \return true if the schedule was saved
+//
+//*****************************************************************************
+bool schedule_save(void)
+{
+	return settings_save(SETTINGS_BLOCK_SCHEDULE, SCHEDULE_VERSION, &_schedule, sizeof(_schedule));
+}
+
+//*****************************************************************************
+//
+//! Enables or disables the schedule. An enabled schedule is applied right
+//! away.
+//!
+//! \param enable is true to let the schedule set the color temperature and
+//! intensity
+//!
+//! \return None.
+//
+//*****************************************************************************
+void schedule_enable_set(bool enable)
+{
+	IntDisable(INT_HIBERNATE);
+	_schedule.enable = enable;
+	
+	if (enable)
+	{
+		_resync = true;
+		schedule_update();
+		IntEnable(INT_HIBERNATE);
+	}
+	
+	log_msg_value(LOG_SUB_SYSTEM_LED, LOG_LEVEL_DEBUG, "Schedule enable", enable);
+}
+
+//*****************************************************************************
+//
+//! Gets whether the schedule is enabled
+//!
+//! \return true if the schedule is enabled
+//
+//*****************************************************************************
+bool schedule_enable_get(void)
+{
+	return _schedule.enable;
+}
+
+//*****************************************************************************
+//
+//! Sets the wall time
+//!
+//! \param seconds is the time of day in seconds since midnight
+//!
+//! \return None.
+//
+//*****************************************************************************
+void schedule_time_set(uint32_t seconds)
+{
+	IntDisable(INT_HIBERNATE);
+	HibernateRTCSet(seconds % SCHEDULE_SECONDS_PER_DAY);
+	
+	// The next change moved with the time
+	if (_schedule.enable)
+	{
+		schedule_update();
+		IntEnable(INT_HIBERNATE);
+	}
+}
+
+//*****************************************************************************
+//
+//! Gets the wall time
+//!
+//! \return the time of day in seconds since midnight
+//
+//*****************************************************************************
+uint32_t schedule_time_get(void)
+{
+	return HibernateRTCGet() % SCHEDULE_SECONDS_PER_DAY;
+}
+
+//*****************************************************************************
+//
+//! Gets the target of the schedule for a minute of the day
+//!
+//! \param minute is the minute of the day
+//! \param kelvin is set to the color temperature
+//! \param intensity is set to the intensity
+//!
+//! \return None.
+//
+//*****************************************************************************
+void schedule_target_get(uint32_t minute, uint32_t *kelvin, uint32_t *intensity)
+{
+	const struct schedule_point *from, *to;
+	
+	minute %= SCHEDULE_MINUTES_PER_DAY;
+	schedule_segment_get(minute, &from, &to);
+	schedule_line_get(from, to, minute, kelvin, intensity);
+}
+
+//*****************************************************************************
+//
+//! Gets the number of times the schedule set a new target
+//!
+//! \return the number of targets set
+//
+//*****************************************************************************
+uint32_t schedule_update_count_get(void)
+{
+	return _update_count;
+}
+
+//*****************************************************************************
+//
+//! Checks the breakpoints of a schedule
+//!
+//! \param points are the breakpoints
+//! \param num_points is the number of breakpoints
+//!
+//! \return true if the minutes increase and all values are in range
+//
+//*****************************************************************************
+static bool schedule_valid(const struct schedule_point *points, uint32_t num_points)
+{
+	if (num_points == 0 || num_points > SCHEDULE_MAX_POINTS)
+		return false;
+	
+	for (uint32_t i = 0; i < num_points; i++)
+	{
+		if (points[i].minute >= SCHEDULE_MINUTES_PER_DAY ||
+			points[i].kelvin < CCT_MIN_KELVIN || points[i].kelvin > CCT_MAX_KELVIN)
+			return false;
+		if (i > 0 && points[i].minute <= points[i - 1].minute)
+			return false;
+	}
+	
+	return true;
+}
+
+//*****************************************************************************
+//
+//! Finds the breakpoints around a minute of the day
+//!
+//! \param minute is the minute of the day
+//! \param from is set to the last breakpoint at or before the minute. Before
+//! the first breakpoint, it is the last breakpoint of the previous day.
+//! \param to is set to the breakpoint after it, the first one of the next day
+//! after the last breakpoint
+//
+//*****************************************************************************
+static void schedule_segment_get(uint32_t minute, const struct schedule_point **from,
+	const struct schedule_point **to)
+{
+	const struct schedule_point *points = _schedule.points;
+	uint32_t num_points = _schedule.num_points;
+	uint32_t low = 0;
+	uint32_t high = num_points;
+	
+	// First breakpoint after the minute
+	while (low < high)
+	{
+		uint32_t middle = (low + high) / 2;
+		
+		if (points[middle].minute <= minute)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	
+	*from = &points[low > 0 ? low - 1 : num_points - 1];
+	*to = &points[low < num_points ? low : 0];
+}
+
+//*****************************************************************************
+//
+//! Gets the target of a minute on the line between two breakpoints
+//!
+//! \param from is the breakpoint at or before the minute
+//! \param to is the breakpoint after it
+//! \param minute is the minute of the day
+//! \param kelvin is set to the color temperature
+//! \param intensity is set to the intensity
+//
+//*****************************************************************************
+static void schedule_line_get(const struct schedule_point *from, const struct schedule_point *to,
+	uint32_t minute, uint32_t *kelvin, uint32_t *intensity)
+{
+	int32_t span, offset;
+	
+	// Minutes wrap around midnight. A single breakpoint spans the day.
+	span = ((int32_t)to->minute - from->minute + SCHEDULE_MINUTES_PER_DAY - 1) % 
+		SCHEDULE_MINUTES_PER_DAY + 1;
+	offset = ((int32_t)minute - from->minute + SCHEDULE_MINUTES_PER_DAY) % 
+		SCHEDULE_MINUTES_PER_DAY;
+	
+	*kelvin = from->kelvin + ((int32_t)to->kelvin - from->kelvin) * offset / span;
+	*intensity = from->intensity + ((int32_t)to->intensity - from->intensity) * offset / span;
+}
+
+//*****************************************************************************
+//
+//! Applies the target of the present minute and sets the RTC match to the
+//! minute it changes
+//!
+//! The minutes are counted along the line up to the next breakpoint, where
+//! the line changes. A flat line is skipped at once.
+//
+//*****************************************************************************
+static void schedule_update(void)
+{
+	const struct schedule_point *from, *to;
+	uint32_t now = HibernateRTCGet();
+	uint32_t minute = (now % SCHEDULE_SECONDS_PER_DAY) / 60;
+	uint32_t kelvin, intensity, left, run;
+	
+	schedule_segment_get(minute, &from, &to);
+	schedule_line_get(from, to, minute, &kelvin, &intensity);
+	
+	// Minutes until the next breakpoint, a full day for a single one
+	left = ((int32_t)to->minute - (int32_t)minute + SCHEDULE_MINUTES_PER_DAY - 1) % 
+		SCHEDULE_MINUTES_PER_DAY + 1;
+	
+	run = 1;
+	if (from->kelvin == to->kelvin && from->intensity == to->intensity)
+	{
+		run = left;
+	}
+	else
+	{
+		for (; run < left; run++)
+		{
+			uint32_t next_kelvin, next_intensity;
+			
+			schedule_line_get(from, to, (minute + run) % SCHEDULE_MINUTES_PER_DAY, 
+				&next_kelvin, &next_intensity);
+			if (next_kelvin != kelvin || next_intensity != intensity)
+				break;
+		}
+	}
+	
+	HibernateRTCMatchSet(0, now - now % 60 + run * 60);
+	
+	if (!_resync && kelvin == _applied_kelvin && intensity == _applied_intensity)
+		return;
+	
+	_resync = false;
+	_applied_kelvin = kelvin;
+	_applied_intensity = intensity;
+	_update_count++;
+	cct_set(kelvin, intensity);
+}
@@ -0,0 +1,70 @@
+//*****************************************************************************
+//
+// schedule.h - Headers for the daily circadian schedule
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SCHEDULE_MAX_POINTS      16   // Breakpoints of a daily schedule
+#define SCHEDULE_MINUTES_PER_DAY 1440
+
+//*****************************************************************************
+//
+// A breakpoint of the daily schedule. The lamp fades in a straight line from
+// each breakpoint to the next, and from the last one to the first one of the
+// next day.
+//
+//*****************************************************************************
+struct schedule_point
+{
+	uint16_t minute;    // Minute of the day, from 0 to 1439
+	uint16_t kelvin;    // Color temperature
+	uint8_t intensity;  // Intensity from 0 to CCT_MAX_INTENSITY
+	uint8_t reserved;
+};
+
+//*****************************************************************************
+//
+// Public function prototypes.
+//
+//*****************************************************************************
+void schedule_init(void);
+void schedule_process(void);
+bool schedule_set(const struct schedule_point *points, uint32_t num_points);
+uint32_t schedule_points_get(struct schedule_point *points);
+bool schedule_save(void);
+void schedule_enable_set(bool enable);
+bool schedule_enable_get(void);
+void schedule_time_set(uint32_t seconds);
+uint32_t schedule_time_get(void);
+void schedule_target_get(uint32_t minute, uint32_t *kelvin, uint32_t *intensity);
+uint32_t schedule_update_count_get(void);
+
+#endif
@@ -0,0 +1,270 @@
+//*****************************************************************************
+//
+// settings.c - Settings store in the internal EEPROM
+//
+// Settings are kept in fixed blocks of the EEPROM. Each block starts with a
+// header holding the version and size of the data and a checksum. A block is
+// only loaded if all three match, so a module falls back to its defaults
+// when the EEPROM is blank, corrupted or was written by another firmware
+// version.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "inc/hw_memmap.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/eeprom.h"
+#include "log.h"
+#include "settings.h"
+
+//*****************************************************************************
+//
+// Defines used to configure the settings store
+//
+//*****************************************************************************
+#define SETTINGS_MAX_BLOCK_SIZE 132 // Largest block data size, in bytes
+
+//
+// Gives the data size of a block. The build fails if the size is above
+// SETTINGS_MAX_BLOCK_SIZE, the scratch buffer of settings_load().
+//
+#define SETTINGS_BLOCK_SIZE(size) \
+	((size) + 0 * sizeof(char[(size) <= SETTINGS_MAX_BLOCK_SIZE ? 1 : -1]))
+
+//*****************************************************************************
+//
+// Location and maximum data size of each block in the EEPROM, in bytes. The
+// header is stored before the data. Addresses and sizes must be multiples of
+// 4 bytes. settings_init() refuses to use the EEPROM if two blocks overlap.
+//
+//*****************************************************************************
+struct settings_block
+{
+	uint32_t address;
+	uint32_t max_size;
+};
+
+static const struct settings_block _block_list[SETTINGS_NUM_BLOCKS] =
+{
+	{0x000, SETTINGS_BLOCK_SIZE(120)}, // SETTINGS_BLOCK_CALIBRATION
+	{0x080, SETTINGS_BLOCK_SIZE(24)},  // SETTINGS_BLOCK_LAMPBUS
+	{0x0A0, SETTINGS_BLOCK_SIZE(132)}, // SETTINGS_BLOCK_LUX_CURVE
+	{0x130, SETTINGS_BLOCK_SIZE(112)}, // SETTINGS_BLOCK_ENERGY
+	{0x1A8, SETTINGS_BLOCK_SIZE(100)}, // SETTINGS_BLOCK_SCHEDULE
+	{0x214, SETTINGS_BLOCK_SIZE(4)},   // SETTINGS_BLOCK_DIMMER
+	{0x220, SETTINGS_BLOCK_SIZE(16)},  // SETTINGS_BLOCK_CCT
+};
+
+struct settings_header
+{
+	uint16_t version;
+	uint16_t size;
+	uint32_t checksum;
+};
+
+static bool _eeprom_ready;
+
+//*****************************************************************************
+//
+// Prototypes for private functions
+//
+//*****************************************************************************
+static bool settings_layout_check(void);
+static uint32_t settings_checksum(const uint32_t *data, uint32_t size);
+
+//*****************************************************************************
+//
+//! Initializes the EEPROM used to store the settings
+//!
+//! This function must be called before any settings are loaded or saved. If
+//! the EEPROM can not be initialized, or the block layout is invalid, loads
+//! fail and modules keep their defaults.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void settings_init(void)
+{
+	SysCtlPeripheralEnable(SYSCTL_PERIPH_EEPROM0);
+	while (!SysCtlPeripheralReady(SYSCTL_PERIPH_EEPROM0)){}
+	
+	// Recovers from a write interrupted by a power loss
+	_eeprom_ready = EEPROMInit() == EEPROM_INIT_OK;
+	
+	if (!_eeprom_ready)
+		log_msg(LOG_SUB_SYSTEM_SETTINGS, LOG_LEVEL_CRITICAL, "Unable to initialize EEPROM");
+	else if (!settings_layout_check())
+		_eeprom_ready = false;
+}
+
+//*****************************************************************************
+//
+//! Loads a block of settings
+//!
+//! \param block is the block to load, as one of the SETTINGS_BLOCK defines
+//! \param version is the version of the data expected by the caller
+//! \param data is the buffer to load into. It must be word aligned.
+//! \param size is the size of data in bytes. It must be a multiple of 4.
+//!
+//! \return true if the block was loaded, false if it is missing or does not
+//! match the version and size. data is left unchanged on failure.
+//
+//*****************************************************************************
+bool settings_load(uint32_t block, uint32_t version, void *data, uint32_t size)
+{
+	struct settings_header header;
+	uint32_t buffer[SETTINGS_MAX_BLOCK_SIZE / 4];
+	
+	if (!_eeprom_ready || block >= SETTINGS_NUM_BLOCKS || size % 4 != 0 ||
+		size > _block_list[block].max_size)
+		return false;
+	
+	EEPROMRead((uint32_t *)&header, _block_list[block].address, sizeof(header));
+	if (header.version != version || header.size != size)
+	{
+		log_msg_value(LOG_SUB_SYSTEM_SETTINGS, LOG_LEVEL_WARNING, "No saved block", block);
+		return false;
+	}
+	
+	// Read into a scratch buffer so a corrupted block does not overwrite data
+	EEPROMRead(buffer, _block_list[block].address + sizeof(header), size);
+	if (header.checksum != settings_checksum(buffer, size))
+	{
+		log_msg_value(LOG_SUB_SYSTEM_SETTINGS, LOG_LEVEL_ERROR, "Bad checksum in block", block);
+		return false;
+	}
+	
+	for (uint32_t i = 0; i < size / 4; i++)
+		((uint32_t *)data)[i] = buffer[i];
+	
+	return true;
+}
+
+//*****************************************************************************
+//
+//! Saves a block of settings
+//!
+//! \param block is the block to save, as one of the SETTINGS_BLOCK defines
+//! \param version is the version of the data
+//! \param data is the data to save. It must be word aligned.
+//! \param size is the size of data in bytes. It must be a multiple of 4.
+//!
+//! The data is written before the header, so a block is not valid until it
+//! is completely written.
+//!
+//! \return true if the block was saved, false otherwise
+//
+//*****************************************************************************
+bool settings_save(uint32_t block, uint32_t version, const void *data, uint32_t size)
+{
+	struct settings_header header;
+	
+	if (!_eeprom_ready || block >= SETTINGS_NUM_BLOCKS || size % 4 != 0 ||
+		size > _block_list[block].max_size)
+		return false;
+	
+	// Invalidate the block while the data is written
+	header.version = 0;
+	header.size = 0;
+	header.checksum = 0;
+	if (EEPROMProgram((uint32_t *)&header, _block_list[block].address, sizeof(header)) != 0)
+		return false;
+	
+	if (EEPROMProgram((uint32_t *)data, _block_list[block].address + sizeof(header), size) != 0)
+		return false;
+	
+	header.version = version;
+	header.size = size;
+	header.checksum = settings_checksum(data, size);
+	if (EEPROMProgram((uint32_t *)&header, _block_list[block].address, sizeof(header)) != 0)
+	{
+		log_msg_value(LOG_SUB_SYSTEM_SETTINGS, LOG_LEVEL_ERROR, "Unable to save block", block);
+		return false;
+	}
+	
+	return true;
+}
+
+//*****************************************************************************
+//
+//! Checks that the blocks fit in the EEPROM and do not overlap
+//!
+//! Each block spans its header and its maximum data size.
+//!
+//! \return true if the layout is valid, false otherwise
+//
+//*****************************************************************************
+static bool settings_layout_check(void)
+{
+	uint32_t eeprom_size = EEPROMSizeGet();
+	
+	for (uint32_t i = 0; i < SETTINGS_NUM_BLOCKS; i++)
+	{
+		uint32_t start = _block_list[i].address;
+		uint32_t end = start + sizeof(struct settings_header) + _block_list[i].max_size;
+		
+		if (start % 4 != 0 || _block_list[i].max_size % 4 != 0 || end > eeprom_size)
+		{
+			log_msg_value(LOG_SUB_SYSTEM_SETTINGS, LOG_LEVEL_CRITICAL, "Invalid block", i);
+			return false;
+		}
+		
+		for (uint32_t j = i + 1; j < SETTINGS_NUM_BLOCKS; j++)
+		{
+			uint32_t other_start = _block_list[j].address;
+			uint32_t other_end = other_start + sizeof(struct settings_header) + _block_list[j].max_size;
+			
+			if (start < other_end && other_start < end)
+			{
+				log_msg_value(LOG_SUB_SYSTEM_SETTINGS, LOG_LEVEL_CRITICAL, "Overlapping block", j);
+				return false;
+			}
+		}
+	}
+	
+	return true;
+}
+
+//*****************************************************************************
+//
+//! Computes the checksum of a block of data
+//!
+//! \param data is the data, as words
+//! \param size is the size of the data in bytes
+//!
+//! \return the checksum
+//
+//*****************************************************************************
+static uint32_t settings_checksum(const uint32_t *data, uint32_t size)
+{
+	uint32_t checksum = 0x5A5A5A5A;
+	
+	// Rotate before adding each word so swapped words change the checksum
+	for (uint32_t i = 0; i < size / 4; i++)
+		checksum = ((checksum << 5) | (checksum >> 27)) + data[i];
+	
+	return checksum;
+}
@@ -0,0 +1,56 @@
+//*****************************************************************************
+//
+// settings.h - Headers for the EEPROM backed settings store
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//
+// Blocks of settings. Each block is saved and loaded as a whole.
+//
+#define SETTINGS_BLOCK_CALIBRATION 0 // Color calibration of the LEDs
+#define SETTINGS_BLOCK_LAMPBUS     1 // Lamp bus address and groups
+#define SETTINGS_BLOCK_LUX_CURVE   2 // Ambient light response curve
+#define SETTINGS_BLOCK_ENERGY      3 // Hourly energy log
+#define SETTINGS_BLOCK_SCHEDULE    4 // Daily circadian schedule
+#define SETTINGS_BLOCK_DIMMER      5 // Dimmer knob enable
+#define SETTINGS_BLOCK_CCT         6 // Warm and cool LED group calibration
+#define SETTINGS_NUM_BLOCKS        7
+
+//*****************************************************************************
+//
+// Public function prototypes.
+//
+//*****************************************************************************
+void settings_init(void);
+bool settings_load(uint32_t block, uint32_t version, void *data, uint32_t size);
+bool settings_save(uint32_t block, uint32_t version, const void *data, uint32_t size);
+
+#endif
@@ -0,0 +1,336 @@
+//*****************************************************************************
+//
+// telemetry.c - Binary telemetry stream on the console UART
+//
+// While streaming, the main loop samples the lamp state every period and
+// sends it as a frame described in telemetry.h. Most fields do not change
+// from one sample to the next, so a delta frame only carries the fields that
+// did. A lamp at rest costs seven bytes per frame: the four byte header, the
+// mask, the time step and the CRC. At 100 Hz that is 700 bytes per second,
+// about a sixteenth of what the console carries at 115200 baud. A fade of every LED
+// still fits at that rate.
+//
+// Frames are only queued when the UART transmit buffer has room for the
+// whole frame, so the stream never blocks the main loop.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "utils/uartstdio.h"
+
+#include "telemetry.h"
+#include "led.h"
+#include "dmx.h"
+#include "lampbus.h"
+#include "pixel.h"
+#include "clock.h"
+
+//*****************************************************************************
+//
+// Module Configuration Defines
+//
+//*****************************************************************************
+#define TELEMETRY_MAX_LEDS     ((TELEMETRY_MAX_FIELDS - TELEMETRY_FIELD_LEDS) / 2)
+#define TELEMETRY_MAX_PAYLOAD  (7 + TELEMETRY_MAX_FIELDS * 5) // Mask and a 5 
+                                                // 	byte varint per field
+#define TELEMETRY_MAX_FRAME    (TELEMETRY_HEADER_SIZE + TELEMETRY_MAX_PAYLOAD + 1)
+
+//*****************************************************************************
+//
+// Internal variables
+//
+//*****************************************************************************
+static bool _active;
+static uint32_t _period_us;
+static uint32_t _next_time;  // Local time of the next sample
+static uint8_t _seq;
+static uint32_t _key_count;  // Frames left until the next key frame
+
+static uint32_t _previous[TELEMETRY_MAX_FIELDS]; // Values of the last frame sent
+static uint32_t _num_fields;
+
+static uint32_t _sent;
+static uint32_t _dropped;
+
+//*****************************************************************************
+//
+// Prototypes for private functions
+//
+//*****************************************************************************
+static uint32_t telemetry_sample(uint32_t *values);
+static uint32_t telemetry_varint_put(uint8_t *buffer, uint64_t value);
+static uint8_t telemetry_crc8(const uint8_t *data, uint32_t length);
+
+//*****************************************************************************
+//
+//! Starts streaming telemetry frames
+//!
+//! \param period_ms is the time between samples. It is raised to
+//! TELEMETRY_MIN_PERIOD_MS.
+//!
+//! The first frame is a key frame.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void telemetry_start(uint32_t period_ms)
+{
+	if (period_ms < TELEMETRY_MIN_PERIOD_MS)
+		period_ms = TELEMETRY_MIN_PERIOD_MS;
+
+	_period_us = period_ms * 1000;
+	_next_time = clock_local_get();
+	_seq = 0;
+	_key_count = 0;
+	_sent = 0;
+	_dropped = 0;
+	_active = true;
+}
+
+//*****************************************************************************
+//
+//! Stops streaming telemetry frames
+//!
+//! \return None.
+//
+//*****************************************************************************
+void telemetry_stop(void)
+{
+	_active = false;
+}
+
+//*****************************************************************************
+//
+//! Checks if telemetry frames are streamed
+//!
+//! \return true if streaming
+//
+//*****************************************************************************
+bool telemetry_active(void)
+{
+	return _active;
+}
+
+//*****************************************************************************
+//
+//! Sends a frame when a sample is due
+//!
+//! This function is called from the main loop.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void telemetry_process(void)
+{
+	uint8_t frame[TELEMETRY_MAX_FRAME];
+	uint32_t values[TELEMETRY_MAX_FIELDS];
+	uint32_t num_fields, length, now;
+	uint64_t mask = 0;
+	bool key;
+
+	if (!_active)
+		return;
+
+	now = clock_local_get();
+	if (CLOCK_BEFORE(now, _next_time))
+		return;
+
+	// Keep to the period, unless the loop fell a whole period behind
+	_next_time += _period_us;
+	if (!CLOCK_BEFORE(now, _next_time))
+		_next_time = now + _period_us;
+
+	num_fields = telemetry_sample(values);
+	key = _key_count == 0 || num_fields != _num_fields;
+
+	length = TELEMETRY_HEADER_SIZE;
+	if (key)
+	{
+		length += telemetry_varint_put(&frame[length], num_fields);
+		for (uint32_t i = 0; i < num_fields; i++)
+			length += telemetry_varint_put(&frame[length], values[i]);
+	}
+	else
+	{
+		for (uint32_t i = 0; i < num_fields; i++)
+		{
+			if (values[i] != _previous[i])
+				mask |= 1ull << i;
+		}
+
+		length += telemetry_varint_put(&frame[length], mask);
+
+		for (uint32_t i = 0; i < num_fields; i++)
+		{
+			if (mask & (1ull << i))
+			{
+				int32_t change = values[i] - _previous[i];
+				length += telemetry_varint_put(&frame[length], 
+					((uint32_t)change << 1) ^ (uint32_t)(change >> 31));
+			}
+		}
+	}
+
+	frame[0] = TELEMETRY_SOF;
+	frame[1] = length - TELEMETRY_HEADER_SIZE;
+	frame[2] = key ? TELEMETRY_TYPE_KEY : TELEMETRY_TYPE_DELTA;
+	frame[3] = _seq++;
+	frame[length] = telemetry_crc8(&frame[1], length - 1);
+	length++;
+
+	// Drop the sample rather than wait for the UART
+	if (UARTTxBytesFree() < (int)length)
+	{
+		_dropped++;
+		return;
+	}
+
+	UARTwrite((const char *)frame, length);
+	_sent++;
+
+	for (uint32_t i = 0; i < num_fields; i++)
+		_previous[i] = values[i];
+	_num_fields = num_fields;
+	_key_count = key ? TELEMETRY_KEY_PERIOD - 1 : _key_count - 1;
+}
+
+//*****************************************************************************
+//
+//! Gets the number of frames sent since streaming started
+//!
+//! \return the number of frames
+//
+//*****************************************************************************
+uint32_t telemetry_sent_count_get(void)
+{
+	return _sent;
+}
+
+//*****************************************************************************
+//
+//! Gets the number of samples dropped for lack of UART buffer space
+//!
+//! \return the number of samples
+//
+//*****************************************************************************
+uint32_t telemetry_dropped_count_get(void)
+{
+	return _dropped;
+}
+
+//*****************************************************************************
+//
+//! Samples the lamp state
+//!
+//! \param values is set to the value of each field
+//!
+//! \return the number of fields
+//
+//*****************************************************************************
+static uint32_t telemetry_sample(uint32_t *values)
+{
+	struct lampbus_stats stats;
+	struct lux_cache_sample lux;
+	bool lux_fresh;
+	uint32_t num_leds = led_num_leds_get();
+
+	if (num_leds > TELEMETRY_MAX_LEDS)
+		num_leds = TELEMETRY_MAX_LEDS;
+
+	lampbus_stats_get(&stats);
+	lux_fresh = led_lux_sample_get(&lux) == LUX_CACHE_FRESH;
+
+	values[TELEMETRY_FIELD_TIME] = clock_local_ms_get();
+	values[TELEMETRY_FIELD_FLAGS] = (led_sw_enable_get() ? TELEMETRY_FLAG_ENABLE : 0) |
+		(dmx_enable_get() ? TELEMETRY_FLAG_DMX : 0) |
+		(clock_synced() ? TELEMETRY_FLAG_SYNCED : 0) |
+		(lux_fresh ? 0 : TELEMETRY_FLAG_LUX_STALE);
+	values[TELEMETRY_FIELD_LUX] = lux.lux;
+	values[TELEMETRY_FIELD_LUX_SCALE] = led_layer_opacity_get(LED_LAYER_LUX);
+	values[TELEMETRY_FIELD_DIMMER] = led_layer_opacity_get(LED_LAYER_MASTER);
+	values[TELEMETRY_FIELD_PROFILE] = led_profile_index_get();
+	values[TELEMETRY_FIELD_DMX_FRAMES] = dmx_frame_count_get();
+	values[TELEMETRY_FIELD_BUS_FRAMES] = stats.accepted;
+	values[TELEMETRY_FIELD_BUS_ERRORS] = stats.crc_errors;
+	values[TELEMETRY_FIELD_OVERRUNS] = pixel_budget_overrun_count_get();
+
+	for (uint32_t i = 0; i < num_leds; i++)
+	{
+		values[TELEMETRY_FIELD_LEDS + 2 * i] = led_hw_brightness_get(i);
+		values[TELEMETRY_FIELD_LEDS + 2 * i + 1] = led_layer_brightness_get(LED_LAYER_BASE, i);
+	}
+
+	return TELEMETRY_FIELD_LEDS + 2 * num_leds;
+}
+
+//*****************************************************************************
+//
+//! Stores a varint
+//!
+//! \param buffer is where the varint is stored
+//! \param value is the value to store
+//!
+//! \return the number of bytes stored
+//
+//*****************************************************************************
+static uint32_t telemetry_varint_put(uint8_t *buffer, uint64_t value)
+{
+	uint32_t length = 0;
+
+	while (value >= 0x80)
+	{
+		buffer[length++] = (value & 0x7F) | 0x80;
+		value >>= 7;
+	}
+	buffer[length++] = value;
+
+	return length;
+}
+
+//*****************************************************************************
+//
+//! Computes the CRC-8 of a frame
+//!
+//! \param data points to the bytes
+//! \param length is the number of bytes
+//!
+//! \return the CRC
+//
+//*****************************************************************************
+static uint8_t telemetry_crc8(const uint8_t *data, uint32_t length)
+{
+	uint8_t crc = 0;
+
+	while (length--)
+	{
+		crc ^= *data++;
+		for (uint32_t bit = 0; bit < 8; bit++)
+			crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+	}
+
+	return crc;
+}
@@ -0,0 +1,97 @@
+//*****************************************************************************
+//
+// telemetry.h - Headers for the binary telemetry stream
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//*****************************************************************************
+//
+// Frames are sent on the console UART between the text output:
+//
+//   SOF | LEN | TYPE | SEQ | PAYLOAD (LEN bytes) | CRC
+//
+// The CRC-8 (polynomial 0x07) covers every byte after the start of frame.
+// SEQ counts samples, so a gap shows samples dropped for lack of UART buffer
+// space. A dropped sample is never used as a reference, so the next delta
+// frame still applies to the last frame received.
+//
+// A key frame holds the number of fields followed by the value of every
+// field. A delta frame holds a mask with bit n set for each field n that
+// changed, followed by the change of each of those fields from the previous
+// frame. Values and masks are varints: 7 bits per byte, least significant
+// first, with the top bit set on every byte but the last. Changes are
+// zigzag encoded first, so small negative changes stay small.
+//
+//*****************************************************************************
+#define TELEMETRY_SOF          0xA5
+#define TELEMETRY_HEADER_SIZE  4 // SOF, LEN, TYPE and SEQ
+
+#define TELEMETRY_TYPE_KEY     0
+#define TELEMETRY_TYPE_DELTA   1
+
+#define TELEMETRY_KEY_PERIOD   100 // Frames between key frames
+#define TELEMETRY_MIN_PERIOD_MS 5  // Shortest sample period
+
+//
+// Fields in the order they are sent. Each LED adds its current and target
+// brightness after the fixed fields.
+//
+#define TELEMETRY_FIELD_TIME        0 // Local time in ms
+#define TELEMETRY_FIELD_FLAGS       1 // TELEMETRY_FLAG bits
+#define TELEMETRY_FIELD_LUX         2 // Last lux sample
+#define TELEMETRY_FIELD_LUX_SCALE   3 // Brightness scale of the lux layer
+#define TELEMETRY_FIELD_DIMMER      4 // Brightness scale of the master dimmer
+#define TELEMETRY_FIELD_PROFILE     5 // Profile index
+#define TELEMETRY_FIELD_DMX_FRAMES  6 // DMX512 frames received
+#define TELEMETRY_FIELD_BUS_FRAMES  7 // Lamp bus frames accepted
+#define TELEMETRY_FIELD_BUS_ERRORS  8 // Lamp bus CRC errors
+#define TELEMETRY_FIELD_OVERRUNS    9 // Pixel strip budget overruns
+#define TELEMETRY_FIELD_LEDS        10 // Current, then target of LED 0, ...
+#define TELEMETRY_MAX_FIELDS        48 // Keeps LEN below 256
+
+#define TELEMETRY_FLAG_ENABLE    0x01 // LEDs enabled
+#define TELEMETRY_FLAG_DMX       0x02 // DMX512 input enabled
+#define TELEMETRY_FLAG_SYNCED    0x04 // Lamp bus clock synced
+#define TELEMETRY_FLAG_LUX_STALE 0x08 // Lux sample missing or stale
+
+//*****************************************************************************
+//
+// Public function prototypes.
+//
+//*****************************************************************************
+void telemetry_start(uint32_t period_ms);
+void telemetry_stop(void);
+bool telemetry_active(void);
+void telemetry_process(void);
+uint32_t telemetry_sent_count_get(void);
+uint32_t telemetry_dropped_count_get(void);
+
+#endif
@@ -0,0 +1,443 @@
+//*****************************************************************************
+//
+// thermal.c - Thermal derating and total power limiter
+//
+// TIMER3A samples the temperature sensor inside the die through ADC1 at
+// THERMAL_SAMPLE_HZ. Each sample also estimates the power drawn by the LEDs
+// from the duty cycle they are driven at and the power of each channel at
+// full duty. The derating curve gives the power budget for the temperature.
+//
+// The limiter scales all LEDs by the same factor through the limit layer, so
+// the scale goes through the composite and the fades like any other layer
+// and the mix of the LEDs is kept. Over budget, the scale is cut in
+// proportion to the excess. Under budget, it rises by THERMAL_SCALE_STEP
+// only if the power at the higher scale would still fit. The duty follows the
+// square of the brightness near full brightness, so the check uses the square.
+// The fades take a moment to reach a new scale, so the limiter waits
+// THERMAL_SETTLE_SAMPLES after a change before it acts again.
+//
+// The timers share one ADC trigger line on this part, and TIMER2A already
+// triggers ADC0 for the dimmer knob. TIMER3A starts the conversions from
+// software instead and reads each one on the next interrupt.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "inc/hw_memmap.h"
+#include "inc/hw_ints.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/adc.h"
+#include "driverlib/timer.h"
+#include "driverlib/interrupt.h"
+
+#include "thermal.h"
+#include "led.h"
+#include "log.h"
+
+//*****************************************************************************
+//
+// Module Configuration Defines
+//
+//*****************************************************************************
+#define THERMAL_ADC_BASE       ADC1_BASE   // ADC sampling the sensor
+#define THERMAL_SEQUENCER      3           // Single step sequencer
+#define THERMAL_TIMER_BASE     TIMER3_BASE // Timer starting the conversions
+#define THERMAL_OVERSAMPLE     64          // Conversions averaged per sample
+#define THERMAL_SAMPLE_HZ      2           // Samples per second
+#define THERMAL_FILTER_SHIFT   2           // Weight of a new sample, 1/4
+#define THERMAL_SCALE_STEP     8           // Rise of the scale per sample
+#define THERMAL_MIN_SCALE      16          // Lowest scale, 1/16
+#define THERMAL_SETTLE_SAMPLES 2           // Samples to wait after a change
+
+//
+// Defaults of the derating curve and the channel power
+//
+#define THERMAL_DEFAULT_KNEE_C     60   // Full budget up to 60 C
+#define THERMAL_DEFAULT_MAX_C      85   // Lowest budget from 85 C
+#define THERMAL_DEFAULT_CHANNEL_MW 1000 // Power of a channel at full duty
+#define THERMAL_DEFAULT_MIN_MW     4000 // Budget at and above the max
+
+//
+// Sensor transfer function, in tenths of a degree for a 12 bit code with
+// 4 fraction bits: 147.5 - 247.5 * code / 4096
+//
+#define THERMAL_TEMP_OFFSET      1475
+#define THERMAL_TEMP_SPAN        2475
+#define THERMAL_CODE_FRACTION    4
+#define THERMAL_CODE_RANGE       (4096 << THERMAL_CODE_FRACTION)
+
+//*****************************************************************************
+//
+// Internal variables
+//
+//*****************************************************************************
+static struct thermal_curve _curve;
+static uint16_t _channel_mw[LED_NUM_LEDS]; // Power of each LED at full duty
+static int32_t _code;                          // Filtered ADC code, 4 fraction bits
+static volatile int32_t _temp;                 // Temperature in tenths of a degree
+static volatile uint32_t _budget;              // Budget at that temperature, mW
+static volatile uint32_t _power;               // Estimated power, mW
+static volatile uint32_t _scale;               // Limit layer scale
+static uint32_t _hold;                         // Samples left before acting again
+static volatile uint32_t _sample_count;
+
+//*****************************************************************************
+//
+// Prototypes for private functions
+//
+//*****************************************************************************
+static uint32_t thermal_budget_calc(int32_t temp);
+static uint32_t thermal_power_calc(void);
+static void thermal_limit_update(void);
+
+//*****************************************************************************
+//
+//! TIMER3A interrupt handler. Reads the conversion started by the previous
+//! interrupt, updates the limiter and starts the next conversion.
+//
+//*****************************************************************************
+void TIMER3A_Handler(void)
+{
+	uint32_t code;
+	
+	TimerIntClear(THERMAL_TIMER_BASE, TIMER_TIMA_TIMEOUT);
+	
+	if (ADCIntStatus(THERMAL_ADC_BASE, THERMAL_SEQUENCER, false))
+	{
+		ADCIntClear(THERMAL_ADC_BASE, THERMAL_SEQUENCER);
+		ADCSequenceDataGet(THERMAL_ADC_BASE, THERMAL_SEQUENCER, &code);
+		
+		// Start the filter at the first sample
+		if (_sample_count == 0)
+			_code = code << THERMAL_CODE_FRACTION;
+		else
+			_code += ((int32_t)(code << THERMAL_CODE_FRACTION) - _code) >> THERMAL_FILTER_SHIFT;
+		
+		_temp = THERMAL_TEMP_OFFSET - (THERMAL_TEMP_SPAN * _code) / THERMAL_CODE_RANGE;
+		_sample_count++;
+		
+		thermal_limit_update();
+	}
+	
+	ADCProcessorTrigger(THERMAL_ADC_BASE, THERMAL_SEQUENCER);
+}
+
+//*****************************************************************************
+//
+//! Initializes the thermal derating
+//!
+//! This function configures ADC1 on the temperature sensor and TIMER3A, and
+//! starts sampling with the default derating curve. The LEDs are not limited
+//! until the first sample is in.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void thermal_init(void)
+{
+	//***************************************************************************
+	//
+	// Initialize ADC1 used to sample the temperature sensor
+	//
+	//***************************************************************************
+	SysCtlPeripheralEnable(SYSCTL_PERIPH_ADC1);
+	while (!SysCtlPeripheralReady(SYSCTL_PERIPH_ADC1)){};
+	
+	ADCHardwareOversampleConfigure(THERMAL_ADC_BASE, THERMAL_OVERSAMPLE);
+	ADCSequenceDisable(THERMAL_ADC_BASE, THERMAL_SEQUENCER);
+	ADCSequenceConfigure(THERMAL_ADC_BASE, THERMAL_SEQUENCER, ADC_TRIGGER_PROCESSOR, 0);
+	ADCSequenceStepConfigure(THERMAL_ADC_BASE, THERMAL_SEQUENCER, 0, 
+		ADC_CTL_TS | ADC_CTL_IE | ADC_CTL_END);
+	
+	//***************************************************************************
+	//
+	// Initialize TIMER3A used to pace the samples
+	//
+	//***************************************************************************
+	SysCtlPeripheralEnable(SYSCTL_PERIPH_TIMER3);
+	while (!SysCtlPeripheralReady(SYSCTL_PERIPH_TIMER3)){};
+	
+	TimerConfigure(THERMAL_TIMER_BASE, TIMER_CFG_PERIODIC);
+	TimerLoadSet(THERMAL_TIMER_BASE, TIMER_A, SysCtlClockGet() / THERMAL_SAMPLE_HZ - 1);
+	TimerIntEnable(THERMAL_TIMER_BASE, TIMER_TIMA_TIMEOUT);
+	
+	//***************************************************************************
+	//
+	// Initialize module variables
+	//
+	//***************************************************************************
+	for (uint32_t i = 0; i < LED_NUM_LEDS; i++)
+		_channel_mw[i] = THERMAL_DEFAULT_CHANNEL_MW;
+	
+	_curve.knee_c = THERMAL_DEFAULT_KNEE_C;
+	_curve.max_c = THERMAL_DEFAULT_MAX_C;
+	_curve.full_mw = THERMAL_DEFAULT_CHANNEL_MW * LED_NUM_LEDS;
+	_curve.min_mw = THERMAL_DEFAULT_MIN_MW;
+	
+	_code = 0;
+	_temp = 0;
+	_budget = _curve.full_mw;
+	_power = 0;
+	_scale = LED_OPACITY_MAX;
+	_hold = 0;
+	_sample_count = 0;
+	
+	ADCSequenceEnable(THERMAL_ADC_BASE, THERMAL_SEQUENCER);
+	ADCProcessorTrigger(THERMAL_ADC_BASE, THERMAL_SEQUENCER);
+	IntEnable(INT_TIMER3A);
+	TimerEnable(THERMAL_TIMER_BASE, TIMER_A);
+}
+
+//*****************************************************************************
+//
+//! Sets the derating curve
+//!
+//! \param curve is the new curve. The knee must be below the max, the max at
+//! most THERMAL_MAX_CELSIUS, and the lowest budget at most the full budget.
+//!
+//! \return true if the curve was set, false if it is invalid
+//
+//*****************************************************************************
+bool thermal_curve_set(const struct thermal_curve *curve)
+{
+	if (curve->knee_c >= curve->max_c || curve->max_c > THERMAL_MAX_CELSIUS ||
+		curve->min_mw > curve->full_mw)
+		return false;
+	
+	IntDisable(INT_TIMER3A);
+	_curve = *curve;
+	IntEnable(INT_TIMER3A);
+	
+	log_msg_value(LOG_SUB_SYSTEM_LED, LOG_LEVEL_DEBUG, "Derating knee", curve->knee_c);
+	log_msg_value(LOG_SUB_SYSTEM_LED, LOG_LEVEL_DEBUG, "Derating max", curve->max_c);
+	
+	return true;
+}
+
+//*****************************************************************************
+//
+//! Gets the derating curve
+//!
+//! \param curve is set to the curve in use
+//!
+//! \return None.
+//
+//*****************************************************************************
+void thermal_curve_get(struct thermal_curve *curve)
+{
+	IntDisable(INT_TIMER3A);
+	*curve = _curve;
+	IntEnable(INT_TIMER3A);
+}
+
+//*****************************************************************************
+//
+//! Sets the power an LED draws at full duty
+//!
+//! \param led_type specifies the LED
+//! \param mw is the power in mW, up to 65535
+//!
+//! \return true if the power was set, false if a value is invalid
+//
+//*****************************************************************************
+bool thermal_channel_mw_set(uint32_t led_type, uint32_t mw)
+{
+	if (led_type >= LED_NUM_LEDS || mw > UINT16_MAX)
+		return false;
+	
+	_channel_mw[led_type] = mw;
+	return true;
+}
+
+//*****************************************************************************
+//
+//! Gets the power an LED draws at full duty
+//!
+//! \param led_type specifies the LED
+//!
+//! \return the power in mW
+//
+//*****************************************************************************
+uint32_t thermal_channel_mw_get(uint32_t led_type)
+{
+	if (led_type >= LED_NUM_LEDS)
+		return 0;
+	
+	return _channel_mw[led_type];
+}
+
+//*****************************************************************************
+//
+//! Gets the filtered die temperature
+//!
+//! \return the temperature in tenths of a degree Celsius
+//
+//*****************************************************************************
+int32_t thermal_temp_get(void)
+{
+	return _temp;
+}
+
+//*****************************************************************************
+//
+//! Gets the power budget at the die temperature
+//!
+//! \return the budget in mW
+//
+//*****************************************************************************
+uint32_t thermal_budget_get(void)
+{
+	return _budget;
+}
+
+//*****************************************************************************
+//
+//! Gets the power estimated at the last sample
+//!
+//! \return the power in mW
+//
+//*****************************************************************************
+uint32_t thermal_power_get(void)
+{
+	return _power;
+}
+
+//*****************************************************************************
+//
+//! Gets the scale the limiter applies to all LEDs
+//!
+//! \return the scale from THERMAL_MIN_SCALE to LED_OPACITY_MAX
+//
+//*****************************************************************************
+uint32_t thermal_scale_get(void)
+{
+	return _scale;
+}
+
+//*****************************************************************************
+//
+//! Gets the number of temperature samples taken
+//!
+//! \return the number of samples
+//
+//*****************************************************************************
+uint32_t thermal_sample_count_get(void)
+{
+	return _sample_count;
+}
+
+//*****************************************************************************
+//
+//! Gets the power budget for a temperature from the derating curve
+//!
+//! \param temp is the temperature in tenths of a degree
+//!
+//! \return the budget in mW
+//
+//*****************************************************************************
+static uint32_t thermal_budget_calc(int32_t temp)
+{
+	int32_t knee = _curve.knee_c * 10;
+	int32_t max = _curve.max_c * 10;
+	
+	if (temp <= knee)
+		return _curve.full_mw;
+	if (temp >= max)
+		return _curve.min_mw;
+	
+	return _curve.full_mw - (uint32_t)(((uint64_t)(_curve.full_mw - _curve.min_mw) * 
+		(uint32_t)(temp - knee)) / (uint32_t)(max - knee));
+}
+
+//*****************************************************************************
+//
+//! Estimates the power drawn by the LEDs from the duty cycle they are driven
+//! at, part way through the fades
+//!
+//! \return the power in mW
+//
+//*****************************************************************************
+static uint32_t thermal_power_calc(void)
+{
+	uint32_t power = 0;
+	
+	for (uint32_t i = 0; i < LED_NUM_LEDS; i++)
+		power += (led_duty_get(i) * _channel_mw[i]) >> 16;
+	
+	return power;
+}
+
+//*****************************************************************************
+//
+//! Moves the limit layer scale toward the largest one that keeps the
+//! estimated power within the budget
+//
+//*****************************************************************************
+static void thermal_limit_update(void)
+{
+	uint32_t budget, power, scale;
+	
+	budget = thermal_budget_calc(_temp);
+	power = thermal_power_calc();
+	_budget = budget;
+	_power = power;
+	
+	if (_hold > 0)
+	{
+		_hold--;
+		return;
+	}
+	
+	scale = _scale;
+	if (power > budget)
+	{
+		scale = (uint32_t)(((uint64_t)scale * budget) / power);
+		if (scale < THERMAL_MIN_SCALE)
+			scale = THERMAL_MIN_SCALE;
+	}
+	else if (scale < LED_OPACITY_MAX)
+	{
+		uint32_t next = scale + THERMAL_SCALE_STEP;
+		
+		if (next > LED_OPACITY_MAX)
+			next = LED_OPACITY_MAX;
+		
+		// Near full brightness the power follows the square of the scale
+		if ((uint64_t)power * next * next <= (uint64_t)budget * scale * scale)
+			scale = next;
+	}
+	
+	if (scale == _scale)
+		return;
+	
+	if (_scale == LED_OPACITY_MAX)
+		log_msg_value(LOG_SUB_SYSTEM_LED, LOG_LEVEL_WARNING, "Thermal limit at temp", _temp);
+	
+	_scale = scale;
+	_hold = THERMAL_SETTLE_SAMPLES;
+	led_layer_opacity_set(LED_LAYER_LIMIT, scale);
+	led_update_hw_start();
+}
@@ -0,0 +1,68 @@
+//*****************************************************************************
+//
+// thermal.h - Headers for the thermal derating and power limiter
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#ifndef THERMAL_H
+#define THERMAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define THERMAL_MAX_CELSIUS 150 // Highest temperature of the derating curve
+
+//*****************************************************************************
+//
+// The derating curve gives the power budget for the die temperature. The
+// full budget applies up to knee_c. Above it the budget falls in a straight
+// line to min_mw at max_c, and stays there above max_c.
+//
+//*****************************************************************************
+struct thermal_curve
+{
+	int32_t knee_c;
+	int32_t max_c;
+	uint32_t full_mw;
+	uint32_t min_mw;
+};
+
+//*****************************************************************************
+//
+// Public function prototypes.
+//
+//*****************************************************************************
+void thermal_init(void);
+bool thermal_curve_set(const struct thermal_curve *curve);
+void thermal_curve_get(struct thermal_curve *curve);
+bool thermal_channel_mw_set(uint32_t led_type, uint32_t mw);
+uint32_t thermal_channel_mw_get(uint32_t led_type);
+int32_t thermal_temp_get(void);
+uint32_t thermal_budget_get(void);
+uint32_t thermal_power_get(void);
+uint32_t thermal_scale_get(void);
+uint32_t thermal_sample_count_get(void);
+
+#endif
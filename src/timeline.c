@@ -0,0 +1,471 @@
+//*****************************************************************************
+//
+// timeline.c - Keyframe animation timeline for scripted light sequences
+//
+// A sequence is a list of keys. Each key fades one LED to a target value over
+// a duration using an easing curve. At load time the keys are grouped by LED
+// into tracks. The keys of a track run one after another. All tracks run in
+// parallel. Values are written into one of the LED layers, so a sequence can
+// be played as the scene, as an effect or as an overlay.
+//
+// timeline_tick() is called from the LED fade timer. It only walks the list
+// of tracks that are still running, so the time per tick is proportional to
+// the number of animated LEDs. Progress through a key is kept in fixed point:
+// the per-ms rate is computed with a single divide when a key starts, and the
+// easing curves are 33 point lookup tables with linear interpolation between
+// the points.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "inc/hw_ints.h"
+#include "driverlib/interrupt.h"
+#include "log.h"
+#include "led.h"
+#include "timeline.h"
+
+//*****************************************************************************
+//
+// Defines used to configure the timeline
+//
+//*****************************************************************************
+#define TIMELINE_MAX_TRACKS     16     // Maximum number of animated LEDs
+#define TIMELINE_PROGRESS_MAX   0xFFFF // Progress through a key when complete
+#define TIMELINE_EASE_POINTS    33     // Points in each easing table
+#define TIMELINE_EASE_SHIFT     11     // Progress bits between two table points
+
+//*****************************************************************************
+//
+// Easing tables. Each maps progress through a key, sampled at 32 equal steps,
+// to the fraction of the change applied, both from 0 to TIMELINE_PROGRESS_MAX.
+// Linear and step easing are computed directly.
+//
+//*****************************************************************************
+static const uint16_t _ease_in[TIMELINE_EASE_POINTS] =
+{
+	0, 2, 16, 54, 128, 250, 432, 686, 1024, 1458, 2000, 2662, 3456, 4394, 5488,
+	6750, 8192, 9826, 11664, 13718, 16000, 18522, 21296, 24334, 27648, 31250,
+	35151, 39365, 43903, 48777, 53999, 59581, 65535
+};
+
+static const uint16_t _ease_out[TIMELINE_EASE_POINTS] =
+{
+	0, 5954, 11536, 16758, 21632, 26170, 30384, 34285, 37887, 41201, 44239,
+	47013, 49535, 51817, 53871, 55709, 57343, 58785, 60047, 61141, 62079, 62873,
+	63535, 64077, 64511, 64849, 65103, 65285, 65407, 65481, 65519, 65533, 65535
+};
+
+static const uint16_t _ease_in_out[TIMELINE_EASE_POINTS] =
+{
+	0, 188, 736, 1620, 2816, 4300, 6048, 8036, 10240, 12636, 15200, 17908,
+	20736, 23660, 26656, 29700, 32768, 35835, 38879, 41875, 44799, 47627, 50335,
+	52899, 55295, 57499, 59487, 61235, 62719, 63915, 64799, 65347, 65535
+};
+
+//*****************************************************************************
+//
+// Built in sequences. The LED types follow LED_LIST in led.c.
+//
+//*****************************************************************************
+static const struct timeline_key _sunrise_keys[] =
+{
+	// Start from black
+	{0, LED_ONBOARD_RED, 0, TIMELINE_EASE_STEP, 0},
+	{0, LED_ONBOARD_GREEN, 0, TIMELINE_EASE_STEP, 0},
+	{0, LED_ONBOARD_BLUE, 0, TIMELINE_EASE_STEP, 0},
+
+	// Deep red rising over the full 30 minutes
+	{900000, LED_ONBOARD_RED, 180, TIMELINE_EASE_IN, 0},
+	{900000, LED_ONBOARD_RED, 255, TIMELINE_EASE_OUT, 0},
+
+	// Green follows after 10 minutes, turning the red to orange and yellow
+	{600000, LED_ONBOARD_GREEN, 0, TIMELINE_EASE_STEP, 0},
+	{1200000, LED_ONBOARD_GREEN, 200, TIMELINE_EASE_IN_OUT, 0},
+
+	// Blue rises in the last 10 minutes to finish at daylight white
+	{1200000, LED_ONBOARD_BLUE, 0, TIMELINE_EASE_STEP, 0},
+	{600000, LED_ONBOARD_BLUE, 150, TIMELINE_EASE_IN, 0},
+};
+
+static const struct timeline_key _pulse_keys[] =
+{
+	{600, LED_ONBOARD_RED, 255, TIMELINE_EASE_IN_OUT, 0},
+	{600, LED_ONBOARD_RED, 0, TIMELINE_EASE_IN_OUT, 0},
+};
+
+static const struct timeline_key _chase_keys[] =
+{
+	// Each LED lights for 600 ms of a 1200 ms cycle, 400 ms after the last
+	{200, LED_ONBOARD_RED, 255, TIMELINE_EASE_OUT, 0},
+	{400, LED_ONBOARD_RED, 0, TIMELINE_EASE_LINEAR, 0},
+	{600, LED_ONBOARD_RED, 0, TIMELINE_EASE_STEP, 0},
+
+	{400, LED_ONBOARD_GREEN, 0, TIMELINE_EASE_STEP, 0},
+	{200, LED_ONBOARD_GREEN, 255, TIMELINE_EASE_OUT, 0},
+	{400, LED_ONBOARD_GREEN, 0, TIMELINE_EASE_LINEAR, 0},
+	{200, LED_ONBOARD_GREEN, 0, TIMELINE_EASE_STEP, 0},
+
+	{200, LED_ONBOARD_BLUE, 0, TIMELINE_EASE_LINEAR, 0},
+	{600, LED_ONBOARD_BLUE, 0, TIMELINE_EASE_STEP, 0},
+	{200, LED_ONBOARD_BLUE, 255, TIMELINE_EASE_OUT, 0},
+	{200, LED_ONBOARD_BLUE, 128, TIMELINE_EASE_LINEAR, 0},
+};
+
+struct timeline_sequence
+{
+	const struct timeline_key *keys;
+	uint32_t num_keys;
+	uint32_t layer;
+	uint32_t mode;
+	bool loop;
+};
+
+static const struct timeline_sequence _sequence_list[TIMELINE_NUM_SEQUENCES] =
+{
+	{_sunrise_keys, sizeof(_sunrise_keys) / sizeof(_sunrise_keys[0]),
+		LED_LAYER_BASE, LED_BLEND_MIX, false},
+	{_pulse_keys, sizeof(_pulse_keys) / sizeof(_pulse_keys[0]),
+		LED_LAYER_EFFECT, LED_BLEND_ADD, true},
+	{_chase_keys, sizeof(_chase_keys) / sizeof(_chase_keys[0]),
+		LED_LAYER_EFFECT, LED_BLEND_MIX, true},
+};
+
+//*****************************************************************************
+//
+// A track holds the keys of one LED. The keys of every track are stored one
+// after another in _keys, starting at first.
+//
+//*****************************************************************************
+struct timeline_track
+{
+	uint32_t elapsed;   // Time into the current key, in ms
+	uint32_t rate;      // Progress per ms of the current key, in 1/65536 steps
+	uint16_t first;     // Index of the first key of the track in _keys
+	uint16_t num_keys;  // Number of keys in the track
+	uint16_t cursor;    // Index of the current key, from first
+	uint8_t led_type;
+	uint8_t start;      // Value at the start of the current key
+};
+
+static struct timeline_key _keys[TIMELINE_MAX_KEYS];
+static struct timeline_track _tracks[TIMELINE_MAX_TRACKS];
+static uint8_t _active[TIMELINE_MAX_TRACKS]; // Tracks still running
+static uint32_t _num_active;
+static uint32_t _layer;
+static bool _loop;
+
+//*****************************************************************************
+//
+// Prototypes for private functions
+//
+//*****************************************************************************
+static void timeline_key_start(struct timeline_track *track);
+static uint32_t timeline_ease(uint32_t easing, uint32_t progress);
+static uint32_t timeline_value(const struct timeline_track *track);
+
+//*****************************************************************************
+//
+//! Loads a sequence and starts playing it
+//!
+//! \param keys is the list of keys. The keys are copied, so the list may be
+//! discarded after the call.
+//! \param num_keys is the number of keys, at most TIMELINE_MAX_KEYS
+//! \param layer is the LED layer the sequence writes to, as one of the
+//! LED_LAYER defines. The layer is enabled.
+//! \param loop selects whether each LED restarts its keys once done
+//!
+//! The first key of each LED starts from the current value of that LED in
+//! the layer. Any sequence already playing is replaced.
+//!
+//! \return true if the sequence was loaded, false if it is invalid
+//
+//*****************************************************************************
+bool timeline_load(const struct timeline_key *keys, uint32_t num_keys, uint32_t layer, bool loop)
+{
+	uint32_t num_leds = led_num_leds_get();
+	uint32_t num_tracks = 0;
+	uint32_t count = 0;
+
+	if (num_keys == 0 || num_keys > TIMELINE_MAX_KEYS || layer >= LED_NUM_LAYERS)
+		return false;
+
+	for (uint32_t i = 0; i < num_keys; i++)
+	{
+		if (keys[i].led_type >= num_leds || keys[i].led_type >= TIMELINE_MAX_TRACKS ||
+			keys[i].easing >= TIMELINE_NUM_EASINGS)
+		{
+			log_msg_value(LOG_SUB_SYSTEM_TIMELINE, LOG_LEVEL_ERROR, "Invalid key", i);
+			return false;
+		}
+	}
+
+	IntDisable(INT_TIMER1A);
+
+	// Group the keys by LED, keeping their order within each LED
+	for (uint32_t led_type = 0; led_type < num_leds && led_type < TIMELINE_MAX_TRACKS; led_type++)
+	{
+		struct timeline_track *track = &_tracks[num_tracks];
+
+		track->first = count;
+		for (uint32_t i = 0; i < num_keys; i++)
+		{
+			if (keys[i].led_type == led_type)
+				_keys[count++] = keys[i];
+		}
+		track->num_keys = count - track->first;
+		if (track->num_keys == 0)
+			continue;
+
+		track->led_type = led_type;
+		track->cursor = 0;
+		track->elapsed = 0;
+		track->start = led_layer_brightness_get(layer, led_type);
+		timeline_key_start(track);
+		_active[num_tracks] = num_tracks;
+		num_tracks++;
+	}
+
+	_num_active = num_tracks;
+	_layer = layer;
+	_loop = loop;
+
+	IntEnable(INT_TIMER1A);
+
+	log_msg_value(LOG_SUB_SYSTEM_TIMELINE, LOG_LEVEL_DEBUG, "Loaded tracks", num_tracks);
+
+	led_layer_enable_set(layer, true);
+	led_update_hw_start();
+
+	return true;
+}
+
+//*****************************************************************************
+//
+//! Plays one of the built in sequences
+//!
+//! \param sequence is the sequence to play, as one of the
+//! TIMELINE_SEQUENCE defines
+//!
+//! \return true if the sequence was started, false otherwise
+//
+//*****************************************************************************
+bool timeline_sequence_play(uint32_t sequence)
+{
+	const struct timeline_sequence *info;
+	bool loaded;
+
+	if (sequence >= TIMELINE_NUM_SEQUENCES)
+		return false;
+
+	info = &_sequence_list[sequence];
+	led_update_begin();
+	led_layer_mode_set(info->layer, info->mode);
+	loaded = timeline_load(info->keys, info->num_keys, info->layer, info->loop);
+	led_update_end();
+
+	return loaded;
+}
+
+//*****************************************************************************
+//
+//! Stops the sequence playing. Unless the sequence writes to the base layer,
+//! its layer is disabled and the LEDs fade back to the scene below it.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void timeline_stop(void)
+{
+	IntDisable(INT_TIMER1A);
+	_num_active = 0;
+	IntEnable(INT_TIMER1A);
+
+	if (_layer != LED_LAYER_BASE)
+		led_layer_enable_set(_layer, false);
+	led_update_hw_start();
+}
+
+//*****************************************************************************
+//
+//! Gets whether a sequence is playing
+//!
+//! \return true if any LED is still animated, false otherwise
+//
+//*****************************************************************************
+bool timeline_active(void)
+{
+	return _num_active != 0;
+}
+
+//*****************************************************************************
+//
+//! Advances the sequence and writes the new values to its layer
+//!
+//! \param elapsed_ms is the time since the last tick
+//! \param led_mask gets the bit of each LED written set, as 1 << led_type
+//!
+//! This function is called from the LED fade timer. The caller commits the
+//! change afterwards, see led_update_hw_start().
+//!
+//! \return true if the sequence is still playing, false otherwise
+//
+//*****************************************************************************
+bool timeline_tick(uint32_t elapsed_ms, uint32_t *led_mask)
+{
+	// Walk backward so finished tracks can be swapped out of the active list
+	for (uint32_t n = _num_active; n > 0; n--)
+	{
+		struct timeline_track *track = &_tracks[_active[n - 1]];
+		bool done = false;
+
+		if (track->elapsed > UINT32_MAX - elapsed_ms)
+			track->elapsed = UINT32_MAX;
+		else
+			track->elapsed += elapsed_ms;
+
+		// Move on to the next key, possibly skipping short keys. A track is
+		// never walked more than once per tick, so a looping track of zero
+		// length keys can not stall the timer.
+		for (uint32_t i = 0; i < track->num_keys; i++)
+		{
+			const struct timeline_key *key = &_keys[track->first + track->cursor];
+
+			if (track->elapsed < key->duration_ms)
+				break;
+
+			track->elapsed -= key->duration_ms;
+			track->start = key->target;
+			track->cursor++;
+
+			if (track->cursor == track->num_keys)
+			{
+				if (!_loop)
+				{
+					done = true;
+					break;
+				}
+				track->cursor = 0;
+			}
+			timeline_key_start(track);
+		}
+
+		// A looping track shorter than a tick stops the walk early. Drop the
+		// time left over so elapsed stays within the current key.
+		if (!done && track->elapsed > _keys[track->first + track->cursor].duration_ms)
+			track->elapsed = _keys[track->first + track->cursor].duration_ms;
+
+		*led_mask |= 1u << track->led_type;
+
+		if (done)
+		{
+			led_layer_brightness_set(_layer, track->led_type, track->start);
+			_active[n - 1] = _active[--_num_active];
+			continue;
+		}
+
+		led_layer_brightness_set(_layer, track->led_type, timeline_value(track));
+	}
+
+	return _num_active != 0;
+}
+
+//*****************************************************************************
+//
+//! Computes the progress rate of the current key of a track
+//!
+//! \param track is the track whose current key starts
+//
+//*****************************************************************************
+static void timeline_key_start(struct timeline_track *track)
+{
+	uint32_t duration = _keys[track->first + track->cursor].duration_ms;
+
+	// Progress per ms in 1/65536 steps. timeline_value() multiplies it by
+	// elapsed in 64 bits.
+	track->rate = duration ? (TIMELINE_PROGRESS_MAX << 16) / duration : 0;
+}
+
+//*****************************************************************************
+//
+//! Applies an easing curve
+//!
+//! \param easing is the easing curve, as one of the TIMELINE_EASE defines
+//! \param progress is the progress through the key from 0 to
+//! TIMELINE_PROGRESS_MAX
+//!
+//! \return the fraction of the change to apply, from 0 to
+//! TIMELINE_PROGRESS_MAX
+//
+//*****************************************************************************
+static uint32_t timeline_ease(uint32_t easing, uint32_t progress)
+{
+	const uint16_t *table;
+	uint32_t index, fraction;
+
+	switch (easing)
+	{
+		case TIMELINE_EASE_IN:
+			table = _ease_in;
+			break;
+		case TIMELINE_EASE_OUT:
+			table = _ease_out;
+			break;
+		case TIMELINE_EASE_IN_OUT:
+			table = _ease_in_out;
+			break;
+		case TIMELINE_EASE_STEP:
+			return progress < TIMELINE_PROGRESS_MAX ? 0 : TIMELINE_PROGRESS_MAX;
+		default:
+			return progress;
+	}
+
+	index = progress >> TIMELINE_EASE_SHIFT;
+	fraction = progress & ((1 << TIMELINE_EASE_SHIFT) - 1);
+
+	return table[index] + (((table[index + 1] - table[index]) * fraction) >> TIMELINE_EASE_SHIFT);
+}
+
+//*****************************************************************************
+//
+//! Computes the value of a track at its current time
+//!
+//! \param track is the track to evaluate
+//!
+//! \return the value of the LED
+//
+//*****************************************************************************
+static uint32_t timeline_value(const struct timeline_track *track)
+{
+	const struct timeline_key *key = &_keys[track->first + track->cursor];
+	uint64_t progress = ((uint64_t)track->elapsed * track->rate) >> 16;
+	int32_t change = (int32_t)key->target - (int32_t)track->start;
+
+	if (progress > TIMELINE_PROGRESS_MAX)
+		progress = TIMELINE_PROGRESS_MAX;
+
+	return track->start + (change * (int32_t)timeline_ease(key->easing, (uint32_t)progress)) /
+		(TIMELINE_PROGRESS_MAX + 1);
+}
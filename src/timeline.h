@@ -0,0 +1,83 @@
+//*****************************************************************************
+//
+// timeline.h - Headers for the keyframe animation timeline
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TIMELINE_MAX_KEYS 64 // Maximum number of keys in a loaded sequence
+
+//
+// Easing curves used to move from the previous value to the key target
+//
+#define TIMELINE_EASE_LINEAR  0 // Constant rate
+#define TIMELINE_EASE_IN      1 // Starts slow, ends fast
+#define TIMELINE_EASE_OUT     2 // Starts fast, ends slow
+#define TIMELINE_EASE_IN_OUT  3 // Starts and ends slow
+#define TIMELINE_EASE_STEP    4 // Holds the previous value, then jumps
+#define TIMELINE_NUM_EASINGS  5
+
+//*****************************************************************************
+//
+// A key moves one LED from its previous value to target over duration_ms
+// using the easing curve. The keys of each LED run one after another, in the
+// order they appear in the sequence. The keys of different LEDs run at the
+// same time.
+//
+//*****************************************************************************
+struct timeline_key
+{
+	uint32_t duration_ms;
+	uint8_t led_type;
+	uint8_t target;
+	uint8_t easing;
+	uint8_t reserved;
+};
+
+//
+// Built in sequences
+//
+#define TIMELINE_SEQUENCE_SUNRISE 0 // 30 minute wake up sunrise
+#define TIMELINE_SEQUENCE_PULSE   1 // Pulsing red alert overlay
+#define TIMELINE_SEQUENCE_CHASE   2 // Red, green and blue chase effect
+#define TIMELINE_NUM_SEQUENCES    3
+
+//*****************************************************************************
+//
+// Public function prototypes.
+//
+//*****************************************************************************
+bool timeline_load(const struct timeline_key *keys, uint32_t num_keys, uint32_t layer, bool loop);
+bool timeline_sequence_play(uint32_t sequence);
+void timeline_stop(void);
+bool timeline_active(void);
+bool timeline_tick(uint32_t elapsed_ms, uint32_t *led_mask);
+
+#endif
@@ -31,6 +31,7 @@
 
 #include "inc/hw_types.h"
 #include "inc/hw_timer.h"
+#include "driverlib/sysctl.h"
 #include "driverlib/timer.h"
 
 
@@ -69,3 +70,55 @@ bool timer_status_enable(uint32_t base, uint32_t timer)
 		return false;
 }
 
+
+//*****************************************************************************
+//
+//! Gets the period of a periodic timer
+//!  
+//! \param base is the base address of the timer peripheral
+//! \param timer specifies if the timer timer a or b, as \b TIMER_A or 
+//! \b TIMER_B
+//!
+//! The period is computed from the load and prescale values the timer runs
+//! with. The prescaler is only used when the timer is split in two 16 bit
+//! timers.
+//! 
+//! \return the period in us
+// 
+//*****************************************************************************
+uint32_t timer_period_us_get(uint32_t base, uint32_t timer)
+{
+	uint64_t ticks = (uint64_t)TimerLoadGet(base, timer) + 1;
+	
+	if (HWREG(base + TIMER_O_CFG) == TIMER_CFG_16_BIT)
+		ticks *= TimerPrescaleGet(base, timer) + 1;
+	
+	return ticks * 1000000 / SysCtlClockGet();
+}
+
+//*****************************************************************************
+//
+//! Gets the time since a periodic down counting timer last timed out
+//!  
+//! \param base is the base address of the timer peripheral
+//! \param timer specifies if the timer timer a or b, as \b TIMER_A or 
+//! \b TIMER_B
+//!
+//! When the timer is split in two 16 bit timers, the prescaler holds the low
+//! bits of the count in bits 23:16 of the value register.
+//! 
+//! \return the time in clock ticks
+// 
+//*****************************************************************************
+uint32_t timer_elapsed_ticks_get(uint32_t base, uint32_t timer)
+{
+	uint32_t load = TimerLoadGet(base, timer);
+	uint32_t value = HWREG(base + (timer == TIMER_B ? TIMER_O_TBV : TIMER_O_TAV));
+	uint32_t prescale;
+	
+	if (HWREG(base + TIMER_O_CFG) != TIMER_CFG_16_BIT)
+		return load - value;
+	
+	prescale = TimerPrescaleGet(base, timer);
+	return (load - (value & 0xFFFF)) * (prescale + 1) + prescale - ((value >> 16) & 0xFF);
+}
@@ -35,5 +35,7 @@
 //
 //*****************************************************************************
 bool timer_status_enable(uint32_t base, uint32_t timer);
+uint32_t timer_period_us_get(uint32_t base, uint32_t timer);
+uint32_t timer_elapsed_ticks_get(uint32_t base, uint32_t timer);
 
 #endif
@@ -125,12 +125,15 @@ uint32_t tsl2591_disable(void)
 
 //*****************************************************************************
 //
-//! Reads the current lux detected by the sensor
+//! Reads the sample measured by the integration cycle started with
+//! tsl2591_lux_start() and powers the sensor down
 //!
-//! \param lux is a pointer to the lux value read by the sensor. Unchanged if
+//! \param sample is set to the raw channels, gain and integration time of
+//!        the cycle, and to the lux unless a channel saturated. Unchanged if
 //!        a I2C transaction error occurs.
 //!  
-//! This function is used to obtain a lux reading from the sensor. It is based
+//! The integration cycle must be complete, see tsl2591_als_valid(). The
+//! calculation is based
 //! on the lux calculation function provided in Adafruit Industries' TSL2591
 //! library written for the Arudino platform. 
 //! Link to GITHUB page: https://github.com/adafruit/Adafruit_TSL2561
@@ -165,16 +168,16 @@ uint32_t tsl2591_disable(void)
 //! 
 //! \return I2C transaction status, as one of \b I2C_MASTER_ERR_NONE, 
 //! \b I2C_MASTER_ERR_ADDR_ACK, \b I2C_MASTER_ERR_DATA_ACK, 
-//! \b I2C_MASTER_ERR_ARB_LOST, or \b I2C_MASTER_ERR_MAX_ATTEMPTS
+//! \b I2C_MASTER_ERR_ARB_LOST, or \b I2C_MASTER_ERR_MAX_ATTEMPTS, or
+//! \b TSL2591_ERR_OVERFLOW if a channel saturated
 // 
 //*****************************************************************************
-uint32_t tsl2591_lux_get(uint32_t *lux)
+uint32_t tsl2591_sample_read(struct tsl2591_sample *sample)
 {
 	uint32_t status = 0;
 	uint16_t ch0, ch1;
 	float atime, again;
 	float cpl;
-	bool completed_int_cycle;
 	
 	ch0 = 0;
 	ch1 = 0;
@@ -223,15 +226,6 @@ uint32_t tsl2591_lux_get(uint32_t *lux)
 			break;
 	}
 	
-	status = tsl2591_enable();
-	RETURN_IF_ERROR(status);
-	// Wait for complete integration cycle
-	do 
-	{
-		status = tsl2591_als_valid(&completed_int_cycle);
-		RETURN_IF_ERROR(status);
-	}while (completed_int_cycle == false);
-	
 	status = tsl2591_disable();
 	RETURN_IF_ERROR(status);
 	
@@ -242,22 +236,100 @@ uint32_t tsl2591_lux_get(uint32_t *lux)
 		
 	ch0 = _bufferRX[0] | (_bufferRX[1] << 8);
 	ch1 = _bufferRX[2] | (_bufferRX[3] << 8);
+	
+	sample->ch0 = ch0;
+	sample->ch1 = ch1;
+	sample->gain = _gain;
+	sample->atime = _integration;
 		
 	// Check for overflow
 	if ((ch0 == 0xFFFF || ch1 == 0xFFFF))
 	{
-		return UINT32_MAX;
+		return TSL2591_ERR_OVERFLOW;
 	}
 	
 	// Calculate lux
 	cpl = (atime * again) / TSL2591_LUX_DF;
-	*lux = ( ((float)ch0 - (float)ch1 )) * (1.0F - ((float)ch1/(float)ch0) ) / cpl;
+	sample->lux = ( ((float)ch0 - (float)ch1 )) * (1.0F - ((float)ch1/(float)ch0) ) / cpl;
+	
+	log_msg_value(LOG_SUB_SYSTEM_SENSOR_LUX, LOG_LEVEL_DEBUG, "Lux Value", sample->lux);
+	
+	return status;
+}
+
+//*****************************************************************************
+//
+//! Reads the lux measured by the integration cycle started with
+//! tsl2591_lux_start() and powers the sensor down
+//!
+//! \param lux is a pointer to the lux value read by the sensor. Unchanged if
+//!        a I2C transaction error occurs or a channel saturated.
+//!  
+//! \return the status of tsl2591_sample_read()
+// 
+//*****************************************************************************
+uint32_t tsl2591_lux_read(uint32_t *lux)
+{
+	struct tsl2591_sample sample;
+	uint32_t status;
 	
-	log_msg_value(LOG_SUB_SYSTEM_SENSOR_LUX, LOG_LEVEL_DEBUG, "Lux Value", *lux);
+	status = tsl2591_sample_read(&sample);
+	if (status == 0)
+		*lux = sample.lux;
 	
 	return status;
 }
 
+//*****************************************************************************
+//
+//! Powers the sensor up to start an integration cycle
+//!
+//! The result is read with tsl2591_lux_read() once the integration time has
+//! passed.
+//! 
+//! \return I2C transaction status, as one of \b I2C_MASTER_ERR_NONE, 
+//! \b I2C_MASTER_ERR_ADDR_ACK, \b I2C_MASTER_ERR_DATA_ACK, 
+//! \b I2C_MASTER_ERR_ARB_LOST, or \b I2C_MASTER_ERR_MAX_ATTEMPTS
+// 
+//*****************************************************************************
+uint32_t tsl2591_lux_start(void)
+{
+	return tsl2591_enable();
+}
+
+//*****************************************************************************
+//
+//! Reads the current lux detected by the sensor
+//!
+//! \param lux is a pointer to the lux value read by the sensor. Unchanged if
+//!        a I2C transaction error occurs.
+//!
+//! This function waits for a whole integration cycle, up to 600 ms.
+//! 
+//! \return I2C transaction status, as one of \b I2C_MASTER_ERR_NONE, 
+//! \b I2C_MASTER_ERR_ADDR_ACK, \b I2C_MASTER_ERR_DATA_ACK, 
+//! \b I2C_MASTER_ERR_ARB_LOST, or \b I2C_MASTER_ERR_MAX_ATTEMPTS, or
+//! \b TSL2591_ERR_OVERFLOW if a channel saturated
+// 
+//*****************************************************************************
+uint32_t tsl2591_lux_get(uint32_t *lux)
+{
+	uint32_t status;
+	bool completed_int_cycle;
+	
+	status = tsl2591_lux_start();
+	RETURN_IF_ERROR(status);
+	
+	// Wait for complete integration cycle
+	do 
+	{
+		status = tsl2591_als_valid(&completed_int_cycle);
+		RETURN_IF_ERROR(status);
+	}while (completed_int_cycle == false);
+	
+	return tsl2591_lux_read(lux);
+}
+
 //*****************************************************************************
 //
 //! Gets the device ID
@@ -345,7 +417,7 @@ uint32_t tsl2591_gain_set(uint32_t gain)
 	
 	// Change CONTROL register value with new gain
 	_gain = gain;
-	_bufferRX[0] |= _gain;
+	_bufferRX[0] = (_bufferRX[0] & ~TSL2591_CONTROL_GAIN_MASK) | _gain;
 	
 	// Write new CONTROL register value
 	status = i2c_register_write(TSL2591_ADDRESS, TSL2591_COMMAND_NORMAL_OPERATION_MASK | TSL2591_REG_CONTROL, _bufferRX, 1);
@@ -378,7 +450,7 @@ uint32_t tsl2591_integratation_time_set(uint32_t integration)
 	
 	// Change CONTROL register value with new integration time
 	_integration = integration;
-	_bufferRX[0] |= integration;
+	_bufferRX[0] = (_bufferRX[0] & ~TSL2591_CONTROL_ATIME_MASK) | integration;
 	
 	// Write new CONTROL register value
 	status = i2c_register_write(TSL2591_ADDRESS, TSL2591_COMMAND_NORMAL_OPERATION_MASK | TSL2591_REG_CONTROL, _bufferRX, 1);
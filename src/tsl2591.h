@@ -85,12 +85,16 @@
 #define TSL2591_CONTROL_GAIN_MEDIUM 0x10 // Medium gain mode
 #define TSL2591_CONTROL_GAIN_HIGH   0x20 // High gain mode
 #define TSL2591_CONTROL_GAIN_MAX    0x30 // Maximum gain mode
+#define TSL2591_CONTROL_GAIN_MASK   0x30 // Gain mode bits
 #define TSL2591_CONTROL_ATIME_100   0x00 // 100ms integration time
 #define TSL2591_CONTROL_ATIME_200   0x01 // 200ms integration time
 #define TSL2591_CONTROL_ATIME_300   0x02 // 300ms integration time
 #define TSL2591_CONTROL_ATIME_400   0x03 // 400ms integration time
 #define TSL2591_CONTROL_ATIME_500   0x04 // 500ms integration time
 #define TSL2591_CONTROL_ATIME_600   0x05 // 600ms integration time
+#define TSL2591_CONTROL_ATIME_MASK  0x07 // Integration time bits
+#define TSL2591_ATIME_MS(atime)     (((atime) + 1) * 100) // Integration time 
+                                                // 	in ms of an ATIME value
 
 //*****************************************************************************
 //
@@ -105,6 +109,22 @@
 #define TSL2591_LUX_DF              408.0F // Lux cooefficient
 #define TSL2591_DEVICE_ID           0x50   // Device ID
 
+#define TSL2591_ERR_OVERFLOW        UINT32_MAX // A channel saturated
+
+//*****************************************************************************
+//
+// A sample read from the sensor
+//
+//*****************************************************************************
+struct tsl2591_sample
+{
+	uint32_t lux;
+	uint16_t ch0;   // Full spectrum channel
+	uint16_t ch1;   // Infrared channel
+	uint8_t gain;   // TSL2591_CONTROL_GAIN value
+	uint8_t atime;  // TSL2591_CONTROL_ATIME value
+};
+
 //*****************************************************************************
 //
 // Public function prototypes.
@@ -113,6 +133,9 @@
 void tsl2591_init(void);
 uint32_t tsl2591_id_get(uint32_t *id);
 uint32_t tsl2591_lux_get(uint32_t *lux);
+uint32_t tsl2591_lux_start(void);
+uint32_t tsl2591_lux_read(uint32_t *lux);
+uint32_t tsl2591_sample_read(struct tsl2591_sample *sample);
 uint32_t tsl2591_gain_set(uint32_t gain);
 uint32_t tsl2591_integratation_time_set(uint32_t time);
 uint32_t tsl2591_als_valid(bool *completed_cycle);
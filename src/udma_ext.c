@@ -0,0 +1,115 @@
+//*****************************************************************************
+//
+// udma_ext.c - Provides the shared uDMA controller setup
+//
+// The uDMA controller has a single channel control table that is shared by
+// every peripheral using DMA. This module owns that table so that each
+// driver only needs to call udma_init() before configuring its own channel.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "inc/hw_types.h"
+#include "inc/hw_memmap.h"
+#include "inc/hw_ints.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/udma.h"
+#include "udma_ext.h"
+
+//*****************************************************************************
+//
+// The channel control table. It holds the primary and alternate control
+// structures of all 32 channels and must be aligned on a 1024 byte boundary.
+//
+//*****************************************************************************
+static tDMAControlTable _control_table[64] __attribute__ ((aligned(1024)));
+
+//*****************************************************************************
+//
+// Number of bus errors reported by the uDMA controller
+//
+//*****************************************************************************
+static volatile uint32_t _error_count;
+
+//*****************************************************************************
+//
+//! The uDMA error interrupt is raised when the controller encounters a bus
+//! error while performing a transfer. The error is cleared and counted so
+//! that it can be inspected from the console.
+//
+//*****************************************************************************
+void UDMAERR_Handler(void)
+{
+	if (uDMAErrorStatusGet())
+	{
+		uDMAErrorStatusClear();
+		_error_count++;
+	}
+}
+
+//*****************************************************************************
+//
+//! Initializes the uDMA controller
+//!
+//! This function enables the uDMA controller and points it at the shared
+//! channel control table. It must be called before any uDMA channel is
+//! configured. Calling it more than once has no effect.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void udma_init(void)
+{
+	static bool initialized = false;
+
+	// Only initialize once
+	if (initialized)
+		return;
+
+	SysCtlPeripheralEnable(SYSCTL_PERIPH_UDMA);
+	while (!SysCtlPeripheralReady(SYSCTL_PERIPH_UDMA)){};
+
+	uDMAEnable();
+	uDMAControlBaseSet(_control_table);
+
+	IntEnable(INT_UDMAERR);
+
+	initialized = true;
+}
+
+//*****************************************************************************
+//
+//! Gets the number of uDMA bus errors since reset
+//!
+//! \return Number of uDMA bus errors
+//
+//*****************************************************************************
+uint32_t udma_error_count_get(void)
+{
+	return _error_count;
+}
@@ -0,0 +1,151 @@
+//*****************************************************************************
+//
+// fleetbench.cpp - Load generator for fleetd
+//
+// Sends brightness commands to every lamp of every link through the fleetd
+// socket, keeping a number of commands in flight per link, and prints the
+// command rate and the latency percentiles seen by the client.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t now_us()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void usage()
+{
+	fprintf(stderr, "usage: fleetbench [-s socket] [-n commands] [-k links] [-l lamps] [-q in flight per link]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	const char *socket_path = "/tmp/fleetd.sock";
+	unsigned num_commands = 10000, num_links = 1, num_lamps = 4, in_flight = 8;
+	struct sockaddr_un address;
+	std::vector<uint64_t> sent_us;
+	std::vector<uint32_t> latencies;
+	std::string in, out;
+	unsigned next = 0, done = 0, errors = 0;
+	uint64_t start;
+	int fd, opt;
+
+	while ((opt = getopt(argc, argv, "s:n:k:l:q:")) != -1)
+	{
+		if (opt == 's')
+			socket_path = optarg;
+		else if (opt == 'n')
+			num_commands = atoi(optarg);
+		else if (opt == 'k')
+			num_links = atoi(optarg);
+		else if (opt == 'l')
+			num_lamps = atoi(optarg);
+		else if (opt == 'q')
+			in_flight = atoi(optarg);
+		else
+			usage();
+	}
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, socket_path, sizeof(address.sun_path) - 1);
+	if (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0)
+	{
+		perror(socket_path);
+		return 1;
+	}
+
+	sent_us.resize(num_commands);
+	start = now_us();
+	while (done < num_commands)
+	{
+		char buffer[65536];
+		ssize_t n;
+		size_t end;
+
+		// Keep in_flight commands per link outstanding, spread over the lamps
+		out.clear();
+		while (next < num_commands && next - done < in_flight * num_links)
+		{
+			unsigned link = next % num_links;
+			unsigned lamp = (next / num_links) % num_lamps + 1;
+
+			out += std::to_string(next) + " bright " + std::to_string(link) + " " +
+				std::to_string(lamp) + " 0 " + std::to_string(next & 0xFF) + "\n";
+			sent_us[next++] = now_us();
+		}
+		if (!out.empty() && write(fd, out.data(), out.size()) != (ssize_t)out.size())
+		{
+			perror("write");
+			return 1;
+		}
+
+		n = read(fd, buffer, sizeof(buffer));
+		if (n <= 0)
+		{
+			fprintf(stderr, "fleetd closed the connection\n");
+			return 1;
+		}
+		in.append(buffer, n);
+
+		while ((end = in.find('\n')) != std::string::npos)
+		{
+			std::string line = in.substr(0, end);
+			unsigned id = strtoul(line.c_str(), nullptr, 10);
+
+			in.erase(0, end + 1);
+			if (id >= num_commands)
+				continue;
+			if (line.find(" ok") == std::string::npos)
+				errors++;
+			latencies.push_back(now_us() - sent_us[id]);
+			done++;
+		}
+	}
+
+	double seconds = (now_us() - start) / 1e6;
+	std::sort(latencies.begin(), latencies.end());
+	printf("links %u lamps %u commands %u errors %u: %.0f commands/s, p50 %u us, p99 %u us\n",
+		num_links, num_lamps, num_commands, errors, num_commands / seconds,
+		latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100]);
+	return 0;
+}
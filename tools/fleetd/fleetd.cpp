@@ -0,0 +1,708 @@
+//*****************************************************************************
+//
+// fleetd.cpp - Host daemon driving many lamp bus links
+//
+// The daemon owns one serial port or pty per lamp bus and multiplexes them
+// and the clients of its Unix socket with epoll. Clients send one command
+// per line, each starting with a request ID that is echoed in the response,
+// so a client can keep many commands in flight.
+//
+// Each link keeps up to a window of unicast frames in flight, matched to
+// their replies by the sequence number of the frame. Further commands wait
+// in the backlog of the link. Frames queued during one pass of the event
+// loop are written with one write per link. A scene change is sent to every
+// link in the same pass with the same start time on the bus clock, and the
+// daemon broadcasts the SYNC beacons that keep the lamp clocks on it.
+//
+// The lamp bus is 2-wire (half-duplex) RS-485 by default: a lamp replying
+// would collide with the next frame, so nothing is sent on a link while a
+// reply is awaited and the window is 1. A 4-wire (full-duplex) bus, given
+// with -f, can use a larger window with -w.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lampbus_host.h"
+
+//*****************************************************************************
+//
+// Daemon Configuration Defines
+//
+//*****************************************************************************
+#define FLEETD_DEFAULT_SOCKET   "/tmp/fleetd.sock"
+#define FLEETD_DEFAULT_WINDOW   1       // Unicast frames in flight per link
+#define FLEETD_TIMEOUT_US       200000  // Time to wait for a reply
+#define FLEETD_BEACON_US        1000000 // Time between SYNC beacons
+#define FLEETD_SCENE_DELAY_MS   50      // Default delay before a scene starts
+#define FLEETD_LATENCY_SAMPLES  4096    // Latencies kept for the percentiles
+#define FLEETD_MAX_EVENTS       64
+
+//*****************************************************************************
+//
+// Time on the host monotonic clock, which is also the bus time sent in the
+// beacons
+//
+//*****************************************************************************
+static uint64_t now_us()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+//*****************************************************************************
+//
+// Latency samples of the last requests, for the percentiles
+//
+//*****************************************************************************
+class Latency
+{
+public:
+	void add(uint32_t us)
+	{
+		if (_samples.size() < FLEETD_LATENCY_SAMPLES)
+			_samples.push_back(us);
+		else
+			_samples[_next++ % FLEETD_LATENCY_SAMPLES] = us;
+	}
+
+	uint32_t percentile(unsigned pct) const
+	{
+		if (_samples.empty())
+			return 0;
+
+		std::vector<uint32_t> sorted(_samples);
+		size_t index = (sorted.size() - 1) * pct / 100;
+		std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+		return sorted[index];
+	}
+
+private:
+	std::vector<uint32_t> _samples;
+	size_t _next = 0;
+};
+
+struct Request
+{
+	int client;
+	std::string id;
+	lampbus::Frame frame;
+};
+
+struct Pending
+{
+	int client;
+	std::string id;
+	uint64_t sent_us;
+};
+
+struct Link
+{
+	std::string path;
+	int fd = -1;
+	std::vector<uint8_t> out;
+	lampbus::Parser parser;
+	std::deque<Request> backlog;
+	std::map<uint8_t, Pending> pending; // By sequence number
+	uint8_t next_seq = 0;
+	bool writable_wait = false;         // Waiting for EPOLLOUT
+	bool beacon_due = false;
+	uint64_t sent = 0;
+	uint64_t replies = 0;
+	uint64_t timeouts = 0;
+	Latency latency;
+};
+
+struct Client
+{
+	int fd;
+	std::string in;
+	std::string out;
+	bool writable_wait = false;
+};
+
+//*****************************************************************************
+//
+// Daemon state
+//
+//*****************************************************************************
+static int _epoll_fd;
+static int _listen_fd;
+static std::vector<Link> _links;
+static std::map<int, Client> _clients;
+static unsigned _window = FLEETD_DEFAULT_WINDOW;
+static bool _full_duplex;
+static uint64_t _last_beacon_us;
+
+// Tags stored in the epoll data to tell the file descriptors apart. The low
+// 32 bits hold the link index or the file descriptor.
+static const uint64_t TAG_LISTEN = 1ull << 32;
+static const uint64_t TAG_LINK = 2ull << 32;
+static const uint64_t TAG_CLIENT = 3ull << 32;
+
+static void epoll_set(int fd, uint64_t data, uint32_t events, int op)
+{
+	struct epoll_event event;
+
+	event.events = events;
+	event.data.u64 = data;
+	if (epoll_ctl(_epoll_fd, op, fd, &event) != 0)
+	{
+		perror("epoll_ctl");
+		exit(1);
+	}
+}
+
+//*****************************************************************************
+//
+// Client output
+//
+//*****************************************************************************
+static void client_flush(Client &client)
+{
+	while (!client.out.empty())
+	{
+		ssize_t n = write(client.fd, client.out.data(), client.out.size());
+
+		if (n < 0)
+		{
+			if (errno == EAGAIN && !client.writable_wait)
+			{
+				client.writable_wait = true;
+				epoll_set(client.fd, TAG_CLIENT | client.fd, EPOLLIN | EPOLLOUT, EPOLL_CTL_MOD);
+			}
+			return;
+		}
+		client.out.erase(0, n);
+	}
+
+	if (client.writable_wait)
+	{
+		client.writable_wait = false;
+		epoll_set(client.fd, TAG_CLIENT | client.fd, EPOLLIN, EPOLL_CTL_MOD);
+	}
+}
+
+static void respond(int fd, const std::string &id, const std::string &text)
+{
+	auto it = _clients.find(fd);
+
+	// The client left before its reply came
+	if (it == _clients.end())
+		return;
+
+	it->second.out += id + " " + text + "\n";
+}
+
+//*****************************************************************************
+//
+// Link I/O
+//
+//*****************************************************************************
+static bool link_open(Link &link)
+{
+	struct termios tio;
+
+	link.fd = open(link.path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (link.fd < 0)
+	{
+		perror(link.path.c_str());
+		return false;
+	}
+
+	// Raw 8N1 at the lamp bus rate. A pty ignores the rate.
+	if (tcgetattr(link.fd, &tio) == 0)
+	{
+		cfmakeraw(&tio);
+		cfsetspeed(&tio, B115200);
+		tcsetattr(link.fd, TCSANOW, &tio);
+	}
+
+	return true;
+}
+
+static void link_flush(size_t index)
+{
+	Link &link = _links[index];
+
+	while (!link.out.empty())
+	{
+		ssize_t n = write(link.fd, link.out.data(), link.out.size());
+
+		if (n < 0)
+		{
+			if (errno == EAGAIN && !link.writable_wait)
+			{
+				link.writable_wait = true;
+				epoll_set(link.fd, TAG_LINK | index, EPOLLIN | EPOLLOUT, EPOLL_CTL_MOD);
+			}
+			return;
+		}
+		link.out.erase(link.out.begin(), link.out.begin() + n);
+	}
+
+	if (link.writable_wait)
+	{
+		link.writable_wait = false;
+		epoll_set(link.fd, TAG_LINK | index, EPOLLIN, EPOLL_CTL_MOD);
+	}
+}
+
+// True if a frame can be sent now without colliding with a reply
+static bool link_quiet(const Link &link)
+{
+	return _full_duplex || link.pending.empty();
+}
+
+// Beacons are only sent once nothing is queued or awaited on the link, so the
+// bus time they carry is the time they are written
+static void link_beacon(Link &link)
+{
+	lampbus::Frame frame;
+
+	if (!link.beacon_due || !link.out.empty() || !link_quiet(link))
+		return;
+
+	frame.cmd = LAMPBUS_CMD_SYNC;
+	frame.seq = link.next_seq++;
+	lampbus::put_le(frame.payload, (uint32_t)now_us(), 4);
+	lampbus::encode(frame, link.out);
+	link.beacon_due = false;
+}
+
+// Moves frames from the backlog to the output while the window has room
+static void link_pump(Link &link)
+{
+	link_beacon(link);
+	while (!link.backlog.empty())
+	{
+		Request &request = link.backlog.front();
+		bool unicast = request.frame.dst != LAMPBUS_ADDR_BROADCAST &&
+			request.frame.dst != LAMPBUS_ADDR_GROUP;
+
+		if (!link_quiet(link))
+			return;
+
+		if (unicast)
+		{
+			if (link.pending.size() >= _window)
+				return;
+
+			// Skip sequence numbers still in flight
+			while (link.pending.count(link.next_seq))
+				link.next_seq++;
+			request.frame.seq = link.next_seq++;
+			link.pending[request.frame.seq] = Pending{request.client, request.id, now_us()};
+		}
+		else
+		{
+			// No reply comes for broadcast and group frames
+			request.frame.seq = link.next_seq++;
+			respond(request.client, request.id, "ok");
+		}
+
+		lampbus::encode(request.frame, link.out);
+		link.sent++;
+		link.backlog.pop_front();
+	}
+}
+
+static void link_read(size_t index)
+{
+	Link &link = _links[index];
+	uint8_t buffer[4096];
+	ssize_t n;
+
+	while ((n = read(link.fd, buffer, sizeof(buffer))) > 0)
+	{
+		link.parser.feed(buffer, n, [&](const lampbus::Frame &frame)
+		{
+			if (frame.dst != LAMPBUS_ADDR_HOST || !(frame.cmd & LAMPBUS_CMD_REPLY))
+				return;
+
+			auto it = link.pending.find(frame.seq);
+			if (it == link.pending.end())
+				return;
+
+			uint32_t latency = now_us() - it->second.sent_us;
+			uint8_t status = frame.payload.empty() ? 0xFF : frame.payload[0];
+
+			link.latency.add(latency);
+			link.replies++;
+			if (status == LAMPBUS_STATUS_OK)
+				respond(it->second.client, it->second.id, "ok " + std::to_string(latency));
+			else
+				respond(it->second.client, it->second.id, "err status " + std::to_string(status));
+			link.pending.erase(it);
+		});
+	}
+}
+
+static void link_timeouts(uint64_t now)
+{
+	for (Link &link : _links)
+	{
+		for (auto it = link.pending.begin(); it != link.pending.end();)
+		{
+			if (now - it->second.sent_us < FLEETD_TIMEOUT_US)
+			{
+				++it;
+				continue;
+			}
+
+			respond(it->second.client, it->second.id, "err timeout");
+			link.timeouts++;
+			it = link.pending.erase(it);
+		}
+	}
+}
+
+// Makes every link send a beacon as soon as it is quiet
+static void link_beacons(uint64_t now)
+{
+	if (now - _last_beacon_us < FLEETD_BEACON_US)
+		return;
+
+	_last_beacon_us = now;
+	for (Link &link : _links)
+		link.beacon_due = true;
+}
+
+//*****************************************************************************
+//
+// Commands
+//
+//*****************************************************************************
+
+// Parses a destination: a lamp address, "all" or "g<mask>"
+static bool parse_dst(const std::string &text, lampbus::Frame &frame)
+{
+	char *end;
+	unsigned long value;
+
+	if (text == "all")
+	{
+		frame.dst = LAMPBUS_ADDR_BROADCAST;
+		return true;
+	}
+
+	if (!text.empty() && text[0] == 'g')
+	{
+		value = strtoul(text.c_str() + 1, &end, 0);
+		if (*end != '\0' || value == 0 || value > 0xFF)
+			return false;
+		frame.dst = LAMPBUS_ADDR_GROUP;
+		frame.groups = value;
+		return true;
+	}
+
+	value = strtoul(text.c_str(), &end, 0);
+	if (text.empty() || *end != '\0' || value < LAMPBUS_ADDR_MIN || value > LAMPBUS_ADDR_MAX)
+		return false;
+	frame.dst = value;
+	return true;
+}
+
+static bool parse_bytes(std::istringstream &in, std::vector<uint8_t> &payload)
+{
+	std::string word;
+
+	while (in >> word)
+	{
+		char *end;
+		unsigned long value = strtoul(word.c_str(), &end, 0);
+
+		if (*end != '\0' || value > 0xFF || payload.size() >= LAMPBUS_MAX_PAYLOAD)
+			return false;
+		payload.push_back(value);
+	}
+	return true;
+}
+
+static const char *command_handle(int client, const std::string &id, std::istringstream &in)
+{
+	std::string command, link_text, dst_text;
+	unsigned long link_index;
+	Request request{client, id, {}};
+
+	in >> command;
+
+	if (command == "stats")
+	{
+		std::string text = "ok";
+
+		for (size_t i = 0; i < _links.size(); i++)
+		{
+			Link &link = _links[i];
+
+			text += " link" + std::to_string(i) + " sent=" + std::to_string(link.sent) +
+				" replies=" + std::to_string(link.replies) + " timeouts=" +
+				std::to_string(link.timeouts) + " crc=" + std::to_string(link.parser.crc_errors) +
+				" p50=" + std::to_string(link.latency.percentile(50)) + " p99=" +
+				std::to_string(link.latency.percentile(99));
+		}
+		respond(client, id, text);
+		return nullptr;
+	}
+
+	if (command == "scene")
+	{
+		unsigned long index, duration_ms, delay_ms = FLEETD_SCENE_DELAY_MS;
+		std::string groups_text;
+
+		if (!(in >> index >> duration_ms) || index > 0xFF || duration_ms > 0xFFFF)
+			return "usage: scene <profile> <duration_ms> [delay_ms] [g<mask>]";
+		in >> delay_ms;
+		if (in >> groups_text)
+		{
+			if (!parse_dst(groups_text, request.frame) || request.frame.dst != LAMPBUS_ADDR_GROUP)
+				return "bad group";
+		}
+
+		// One start time for every link, sent in this pass of the event loop
+		request.frame.cmd = LAMPBUS_CMD_PROFILE_AT;
+		lampbus::put_le(request.frame.payload, (uint32_t)(now_us() + delay_ms * 1000), 4);
+		lampbus::put_le(request.frame.payload, duration_ms, 2);
+		request.frame.payload.push_back(index);
+		for (Link &link : _links)
+		{
+			Request copy = request;
+
+			copy.client = -1;
+			link.backlog.push_back(copy);
+		}
+		respond(client, id, "ok " + std::to_string(_links.size()));
+		return nullptr;
+	}
+
+	if (!(in >> link_text >> dst_text))
+		return "usage: <command> <link> <dst> ...";
+	link_index = strtoul(link_text.c_str(), nullptr, 10);
+	if (link_index >= _links.size())
+		return "bad link";
+	if (!parse_dst(dst_text, request.frame))
+		return "bad destination";
+
+	if (command == "ping")
+	{
+		request.frame.cmd = LAMPBUS_CMD_PING;
+	}
+	else if (command == "bright")
+	{
+		request.frame.cmd = LAMPBUS_CMD_BRIGHTNESS;
+		if (!parse_bytes(in, request.frame.payload) || request.frame.payload.empty() ||
+			request.frame.payload.size() % 2 != 0)
+			return "usage: bright <link> <dst> <led> <brightness> ...";
+	}
+	else if (command == "profile")
+	{
+		request.frame.cmd = LAMPBUS_CMD_PROFILE;
+		if (!parse_bytes(in, request.frame.payload) || request.frame.payload.size() != 1)
+			return "usage: profile <link> <dst> <index>";
+	}
+	else if (command == "send")
+	{
+		unsigned long cmd;
+
+		if (!(in >> cmd) || cmd > 0x7F || !parse_bytes(in, request.frame.payload))
+			return "usage: send <link> <dst> <cmd> [bytes]";
+		request.frame.cmd = cmd;
+	}
+	else
+	{
+		return "unknown command";
+	}
+
+	_links[link_index].backlog.push_back(request);
+	return nullptr;
+}
+
+static void client_read(int fd)
+{
+	Client &client = _clients[fd];
+	char buffer[4096];
+	ssize_t n;
+	size_t end;
+
+	while ((n = read(fd, buffer, sizeof(buffer))) > 0)
+		client.in.append(buffer, n);
+
+	while ((end = client.in.find('\n')) != std::string::npos)
+	{
+		std::istringstream in(client.in.substr(0, end));
+		std::string id;
+		const char *error;
+
+		client.in.erase(0, end + 1);
+		if (!(in >> id))
+			continue;
+
+		error = command_handle(fd, id, in);
+		if (error)
+			respond(fd, id, std::string("err ") + error);
+	}
+
+	if (n == 0)
+	{
+		// Replies still in flight are dropped by respond()
+		epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+		close(fd);
+		_clients.erase(fd);
+	}
+}
+
+static void client_accept()
+{
+	int fd;
+
+	while ((fd = accept4(_listen_fd, nullptr, nullptr, SOCK_NONBLOCK)) >= 0)
+	{
+		_clients[fd] = Client{fd, "", "", false};
+		epoll_set(fd, TAG_CLIENT | fd, EPOLLIN, EPOLL_CTL_ADD);
+	}
+}
+
+static int listen_open(const char *path)
+{
+	struct sockaddr_un address;
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+	unlink(path);
+
+	if (fd < 0 || bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+		listen(fd, 16) != 0)
+	{
+		perror(path);
+		exit(1);
+	}
+	return fd;
+}
+
+static void usage()
+{
+	fprintf(stderr, "usage: fleetd [-s socket] [-f full-duplex [-w window]] link...\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	const char *socket_path = FLEETD_DEFAULT_SOCKET;
+	struct epoll_event events[FLEETD_MAX_EVENTS];
+	int opt;
+
+	while ((opt = getopt(argc, argv, "s:fw:")) != -1)
+	{
+		if (opt == 's')
+			socket_path = optarg;
+		else if (opt == 'f')
+			_full_duplex = true;
+		else if (opt == 'w')
+			_window = std::max(1, atoi(optarg));
+		else
+			usage();
+	}
+	if (!_full_duplex)
+		_window = 1;
+	if (optind >= argc)
+		usage();
+
+	_epoll_fd = epoll_create1(0);
+	_listen_fd = listen_open(socket_path);
+	epoll_set(_listen_fd, TAG_LISTEN, EPOLLIN, EPOLL_CTL_ADD);
+
+	_links.resize(argc - optind);
+	for (size_t i = 0; i < _links.size(); i++)
+	{
+		_links[i].path = argv[optind + i];
+		if (!link_open(_links[i]))
+			return 1;
+		epoll_set(_links[i].fd, TAG_LINK | i, EPOLLIN, EPOLL_CTL_ADD);
+	}
+
+	while (true)
+	{
+		int n = epoll_wait(_epoll_fd, events, FLEETD_MAX_EVENTS, 10);
+		uint64_t now;
+
+		for (int i = 0; i < n; i++)
+		{
+			uint64_t tag = events[i].data.u64 & ~0xFFFFFFFFull;
+			uint32_t value = (uint32_t)events[i].data.u64;
+
+			if (tag == TAG_LISTEN)
+			{
+				client_accept();
+			}
+			else if (tag == TAG_LINK)
+			{
+				if (events[i].events & EPOLLIN)
+					link_read(value);
+				if (events[i].events & EPOLLOUT)
+					link_flush(value);
+			}
+			else if (_clients.count(value))
+			{
+				if (events[i].events & EPOLLOUT)
+					client_flush(_clients[value]);
+				if (events[i].events & (EPOLLIN | EPOLLHUP))
+					client_read(value);
+			}
+		}
+
+		// Everything queued in this pass goes out in one write per link
+		now = now_us();
+		link_timeouts(now);
+		link_beacons(now);
+		for (size_t i = 0; i < _links.size(); i++)
+		{
+			link_pump(_links[i]);
+			link_flush(i);
+		}
+		for (auto &entry : _clients)
+			client_flush(entry.second);
+	}
+}
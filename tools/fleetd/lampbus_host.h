@@ -0,0 +1,164 @@
+//*****************************************************************************
+//
+// lampbus_host.h - Lamp bus framing for the host tools
+//
+// The frame layout and commands come from the firmware header lampbus.h, so
+// the host and the lamps cannot drift apart.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#ifndef LAMPBUS_HOST_H
+#define LAMPBUS_HOST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "lampbus.h"
+
+namespace lampbus
+{
+
+//*****************************************************************************
+//
+// A frame without its start of frame, length and CRC
+//
+//*****************************************************************************
+struct Frame
+{
+	uint8_t dst = LAMPBUS_ADDR_BROADCAST;
+	uint8_t groups = 0;
+	uint8_t seq = 0;
+	uint8_t cmd = LAMPBUS_CMD_PING;
+	std::vector<uint8_t> payload;
+};
+
+//*****************************************************************************
+//
+//! Computes the CRC-8 of the lamp bus, polynomial 0x07
+//
+//*****************************************************************************
+inline uint8_t crc8(const uint8_t *data, size_t length, uint8_t crc = 0)
+{
+	for (size_t i = 0; i < length; i++)
+	{
+		crc ^= data[i];
+		for (int bit = 0; bit < 8; bit++)
+			crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+	}
+	return crc;
+}
+
+//*****************************************************************************
+//
+//! Appends the encoded frame to out
+//
+//*****************************************************************************
+inline void encode(const Frame &frame, std::vector<uint8_t> &out)
+{
+	size_t start = out.size();
+
+	out.push_back(LAMPBUS_SOF);
+	out.push_back((uint8_t)frame.payload.size());
+	out.push_back(frame.dst);
+	out.push_back(frame.groups);
+	out.push_back(frame.seq);
+	out.push_back(frame.cmd);
+	out.insert(out.end(), frame.payload.begin(), frame.payload.end());
+	out.push_back(crc8(&out[start + 1], out.size() - start - 1));
+}
+
+//*****************************************************************************
+//
+//! Appends a little endian field to a payload
+//
+//*****************************************************************************
+inline void put_le(std::vector<uint8_t> &payload, uint32_t value, int num_bytes)
+{
+	for (int i = 0; i < num_bytes; i++)
+		payload.push_back((uint8_t)(value >> (8 * i)));
+}
+
+//*****************************************************************************
+//
+// Byte stream parser. Unlike the lamps, it keeps every frame with a valid
+// CRC, whatever its destination.
+//
+//*****************************************************************************
+class Parser
+{
+public:
+	template <typename Callback>
+	void feed(const uint8_t *data, size_t length, Callback &&on_frame)
+	{
+		for (size_t i = 0; i < length; i++)
+		{
+			uint8_t byte = data[i];
+
+			if (_count == 0)
+			{
+				if (byte == LAMPBUS_SOF)
+					_count = 1;
+				continue;
+			}
+
+			if (_count == 1 && byte > LAMPBUS_MAX_PAYLOAD)
+			{
+				_count = 0;
+				continue;
+			}
+
+			_buffer[_count++] = byte;
+			if (_count < LAMPBUS_HEADER_SIZE + 1u + _buffer[1])
+				continue;
+
+			// _buffer[1] to _buffer[_count - 2] are covered by the CRC
+			_count = 0;
+			if (crc8(&_buffer[1], LAMPBUS_HEADER_SIZE - 1 + _buffer[1]) != byte)
+			{
+				crc_errors++;
+				continue;
+			}
+
+			Frame frame;
+			frame.dst = _buffer[2];
+			frame.groups = _buffer[3];
+			frame.seq = _buffer[4];
+			frame.cmd = _buffer[5];
+			frame.payload.assign(&_buffer[6], &_buffer[6] + _buffer[1]);
+			on_frame(frame);
+		}
+	}
+
+	uint64_t crc_errors = 0;
+
+private:
+	uint8_t _buffer[LAMPBUS_HEADER_SIZE + LAMPBUS_MAX_PAYLOAD + 1];
+	size_t _count = 0;
+};
+
+} // namespace lampbus
+
+#endif
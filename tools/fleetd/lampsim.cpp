@@ -0,0 +1,325 @@
+//*****************************************************************************
+//
+// lampsim.cpp - Simulated lamp buses on ptys, to test fleetd without lamps
+//
+// Each simulated bus is a pty with a number of lamps on it. The lamps filter
+// frames by address and groups like the firmware and acknowledge unicast
+// frames. The bus is modeled at its baud rate: a frame is only received once
+// its bytes would have crossed the line, and the replies of a bus go out one
+// after another, so the measured rates match a real bus of the same speed.
+//
+// By default the bus is 2-wire (half-duplex) like the lamp hardware: a lamp
+// drives the line from the end of its processing delay, sends its reply after
+// the driver turnaround time, and a host frame overlapping a reply collides
+// with it. Both are lost, so the host sees a timeout. With -f the bus is
+// 4-wire (full-duplex) and the replies have a line of their own.
+//
+// The pty paths are printed one per line once the buses are ready.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lampbus_host.h"
+
+#define LAMPSIM_MAX_EVENTS 64
+
+struct Reply
+{
+	uint64_t drive_us; // Time the lamp enables its driver
+	uint64_t due_us;
+	std::vector<uint8_t> bytes;
+};
+
+struct Bus
+{
+	int master = -1;
+	int slave = -1;
+	std::string path;
+	lampbus::Parser parser;
+	uint64_t rx_free_us = 0; // Time the host is done sending
+	uint64_t tx_free_us = 0; // Time the lamps are done replying
+	uint64_t collisions = 0;
+	std::deque<Reply> replies;
+};
+
+static std::vector<Bus> _buses;
+static unsigned _num_lamps = 4;
+static double _byte_us = 10 * 1000000.0 / 115200;
+static unsigned _process_us = 100;
+static unsigned _turnaround_us = 20;
+static bool _full_duplex = false;
+
+static uint64_t now_us()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static bool bus_open(Bus &bus)
+{
+	struct termios tio;
+
+	bus.master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (bus.master < 0 || grantpt(bus.master) != 0 || unlockpt(bus.master) != 0)
+		return false;
+	bus.path = ptsname(bus.master);
+
+	// Keep the slave open so the master does not see a hangup between clients
+	bus.slave = open(bus.path.c_str(), O_RDWR | O_NOCTTY);
+	if (bus.slave < 0 || tcgetattr(bus.slave, &tio) != 0)
+		return false;
+	cfmakeraw(&tio);
+	return tcsetattr(bus.slave, TCSANOW, &tio) == 0;
+}
+
+// Drops the replies driving the line between start and end, returns true if any
+static bool bus_collide(Bus &bus, uint64_t start, uint64_t end)
+{
+	auto overlaps = [&](const Reply &reply)
+	{
+		return reply.drive_us < end && reply.due_us > start;
+	};
+	size_t count = bus.replies.size();
+
+	bus.replies.erase(std::remove_if(bus.replies.begin(), bus.replies.end(), overlaps), bus.replies.end());
+	return bus.replies.size() != count;
+}
+
+// Status a lamp returns for a command, following lampbus_frame_apply()
+static uint8_t lamp_status(const lampbus::Frame &frame)
+{
+	size_t length = frame.payload.size();
+
+	switch (frame.cmd)
+	{
+		case LAMPBUS_CMD_PING:
+			return LAMPBUS_STATUS_OK;
+		case LAMPBUS_CMD_BRIGHTNESS:
+			return length && length % 2 == 0 ? LAMPBUS_STATUS_OK : LAMPBUS_STATUS_BAD_PAYLOAD;
+		case LAMPBUS_CMD_ENABLE:
+		case LAMPBUS_CMD_PROFILE:
+		case LAMPBUS_CMD_DIMMER:
+		case LAMPBUS_CMD_GROUPS:
+			return length == 1 ? LAMPBUS_STATUS_OK : LAMPBUS_STATUS_BAD_PAYLOAD;
+		case LAMPBUS_CMD_CCT:
+			return length == 3 ? LAMPBUS_STATUS_OK : LAMPBUS_STATUS_BAD_PAYLOAD;
+		case LAMPBUS_CMD_SYNC:
+			return length == 4 ? LAMPBUS_STATUS_OK : LAMPBUS_STATUS_BAD_PAYLOAD;
+		case LAMPBUS_CMD_FADE_AT:
+			return length > 6 && length % 2 == 0 ? LAMPBUS_STATUS_OK : LAMPBUS_STATUS_BAD_PAYLOAD;
+		case LAMPBUS_CMD_PROFILE_AT:
+			return length == 7 ? LAMPBUS_STATUS_OK : LAMPBUS_STATUS_BAD_PAYLOAD;
+		default:
+			return LAMPBUS_STATUS_BAD_COMMAND;
+	}
+}
+
+static void bus_read(Bus &bus)
+{
+	uint8_t buffer[4096];
+	ssize_t n;
+
+	while ((n = read(bus.master, buffer, sizeof(buffer))) > 0)
+	{
+		bus.parser.feed(buffer, n, [&](const lampbus::Frame &frame)
+		{
+			size_t length = LAMPBUS_HEADER_SIZE + frame.payload.size() + 1;
+			uint64_t start, received;
+			lampbus::Frame reply;
+			Reply scheduled;
+
+			// The frame ends once all of its bytes crossed the line
+			start = std::max(bus.rx_free_us, now_us());
+			bus.rx_free_us = start + (uint64_t)(length * _byte_us);
+			received = bus.rx_free_us;
+
+			// On a 2-wire bus a frame sent while a lamp drives the line is lost
+			if (!_full_duplex && bus_collide(bus, start, received))
+			{
+				bus.collisions++;
+				return;
+			}
+
+			// Only unicast frames to a lamp of this bus are acknowledged
+			if (frame.dst < LAMPBUS_ADDR_MIN || frame.dst > _num_lamps)
+				return;
+
+			reply.dst = LAMPBUS_ADDR_HOST;
+			reply.seq = frame.seq;
+			reply.cmd = frame.cmd | LAMPBUS_CMD_REPLY;
+			reply.payload.push_back(lamp_status(frame));
+			lampbus::encode(reply, scheduled.bytes);
+
+			scheduled.drive_us = std::max(bus.tx_free_us, received + _process_us);
+			bus.tx_free_us = scheduled.drive_us + (_full_duplex ? 0 : _turnaround_us) +
+				(uint64_t)(scheduled.bytes.size() * _byte_us);
+			scheduled.due_us = bus.tx_free_us;
+			bus.replies.push_back(scheduled);
+		});
+	}
+}
+
+// Prints the collisions of the buses that had new ones, once a second
+static void collisions_report(uint64_t now)
+{
+	static std::vector<uint64_t> reported;
+	static uint64_t last_us;
+
+	if (now - last_us < 1000000)
+		return;
+	last_us = now;
+	reported.resize(_buses.size());
+	for (size_t i = 0; i < _buses.size(); i++)
+	{
+		if (_buses[i].collisions != reported[i])
+		{
+			fprintf(stderr, "%s: %llu collisions\n", _buses[i].path.c_str(),
+				(unsigned long long)_buses[i].collisions);
+			reported[i] = _buses[i].collisions;
+		}
+	}
+}
+
+// Writes the replies that are due and returns the time of the next one
+static uint64_t replies_send(uint64_t now)
+{
+	uint64_t next = UINT64_MAX;
+
+	for (Bus &bus : _buses)
+	{
+		while (!bus.replies.empty() && bus.replies.front().due_us <= now)
+		{
+			const std::vector<uint8_t> &bytes = bus.replies.front().bytes;
+
+			if (write(bus.master, bytes.data(), bytes.size()) < 0)
+				perror("write");
+			bus.replies.pop_front();
+		}
+		if (!bus.replies.empty())
+			next = std::min(next, bus.replies.front().due_us);
+	}
+	return next;
+}
+
+static void usage()
+{
+	fprintf(stderr, "usage: lampsim [-n buses] [-l lamps] [-b baud, 0 for no line time] [-p process_us]\n"
+		"               [-t turnaround_us] [-f full-duplex]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	struct epoll_event events[LAMPSIM_MAX_EVENTS];
+	struct epoll_event event;
+	unsigned num_buses = 1;
+	int epoll_fd, timer_fd, opt;
+
+	while ((opt = getopt(argc, argv, "n:l:b:p:t:f")) != -1)
+	{
+		if (opt == 'n')
+			num_buses = atoi(optarg);
+		else if (opt == 'l')
+			_num_lamps = std::min(atoi(optarg), LAMPBUS_ADDR_MAX);
+		else if (opt == 'b')
+			_byte_us = atoi(optarg) ? 10 * 1000000.0 / atoi(optarg) : 0;
+		else if (opt == 'p')
+			_process_us = atoi(optarg);
+		else if (opt == 't')
+			_turnaround_us = atoi(optarg);
+		else if (opt == 'f')
+			_full_duplex = true;
+		else
+			usage();
+	}
+
+	epoll_fd = epoll_create1(0);
+	timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+	event.events = EPOLLIN;
+	event.data.u64 = UINT64_MAX;
+	epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &event);
+
+	_buses.resize(num_buses);
+	for (size_t i = 0; i < _buses.size(); i++)
+	{
+		if (!bus_open(_buses[i]))
+		{
+			perror("pty");
+			return 1;
+		}
+		event.events = EPOLLIN;
+		event.data.u64 = i;
+		epoll_ctl(epoll_fd, EPOLL_CTL_ADD, _buses[i].master, &event);
+		printf("%s\n", _buses[i].path.c_str());
+	}
+	fflush(stdout);
+
+	while (true)
+	{
+		int n = epoll_wait(epoll_fd, events, LAMPSIM_MAX_EVENTS, 1000);
+		uint64_t next;
+
+		for (int i = 0; i < n; i++)
+		{
+			if (events[i].data.u64 == UINT64_MAX)
+			{
+				uint64_t expirations;
+
+				if (read(timer_fd, &expirations, sizeof(expirations)) < 0)
+					continue;
+			}
+			else
+			{
+				bus_read(_buses[events[i].data.u64]);
+			}
+		}
+
+		collisions_report(now_us());
+		next = replies_send(now_us());
+		if (next != UINT64_MAX)
+		{
+			struct itimerspec spec = {};
+
+			spec.it_value.tv_sec = next / 1000000;
+			spec.it_value.tv_nsec = (next % 1000000) * 1000;
+			timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+		}
+	}
+}
@@ -0,0 +1,142 @@
+//*****************************************************************************
+//
+// blend_test.c - Host test of the packed blend kernels
+//
+// Builds src/blend.c with the portable byte lane helpers and checks every
+// kernel against a per-channel reference. Each channel pair from 0..255 is
+// covered at every weight from 0 to BLEND_WEIGHT_MAX, which includes the
+// edge weights 0, 1, 127, 128 (halving add), 129, 255 and 256.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "../../src/blend.c"
+
+static unsigned _failures;
+
+//*****************************************************************************
+//
+// Per-channel references, following the documentation of each kernel
+//
+//*****************************************************************************
+static uint32_t ref_scale(uint32_t x, uint32_t scale)
+{
+	return (x * scale) >> 8;
+}
+
+static uint32_t ref_crossfade(uint32_t a, uint32_t b, uint32_t weight)
+{
+	return (a * (BLEND_WEIGHT_MAX - weight) + b * weight) >> 8;
+}
+
+static uint32_t ref_add(uint32_t dst, uint32_t src, uint32_t opacity)
+{
+	uint32_t sum = dst + ((src * (opacity > BLEND_WEIGHT_MAX ? BLEND_WEIGHT_MAX : opacity)) >> 8);
+
+	return sum > 0xFF ? 0xFF : sum;
+}
+
+//*****************************************************************************
+//
+// Word holding channel values a, a + 1, a + 2 and a + 3 (mod 256), so each
+// value is seen in every byte lane
+//
+//*****************************************************************************
+static uint32_t lanes(uint32_t a)
+{
+	uint32_t word = 0;
+
+	for (uint32_t lane = 0; lane < 4; lane++)
+		word |= ((a + lane * 0x40) & 0xFF) << (lane * 8);
+	return word;
+}
+
+static void check(const char *kernel, uint32_t weight, uint32_t lane, uint32_t got, uint32_t want)
+{
+	if (got == want)
+		return;
+	if (_failures++ < 10)
+		printf("%s weight %u lane %u: got %u, want %u\n", kernel, weight, lane, got, want);
+}
+
+int main(void)
+{
+	static uint32_t a[256], b[256 * 256], c[256 * 256], dst[256 * 256];
+	static uint8_t table[256];
+
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		a[i] = lanes(i);
+		table[i] = (uint8_t)(255 - i);
+	}
+
+	// Scale, every value at every weight
+	for (uint32_t weight = 0; weight <= BLEND_WEIGHT_MAX + 1; weight++)
+	{
+		uint32_t clamped = weight > BLEND_WEIGHT_MAX ? BLEND_WEIGHT_MAX : weight;
+
+		blend_scale(dst, a, 256, weight);
+		for (uint32_t i = 0; i < 256; i++)
+			for (uint32_t lane = 0; lane < 4; lane++)
+				check("scale", weight, lane, (dst[i] >> (lane * 8)) & 0xFF,
+					ref_scale((a[i] >> (lane * 8)) & 0xFF, clamped));
+	}
+
+	// Crossfade and add, every pair of values at every weight
+	for (uint32_t i = 0; i < 256 * 256; i++)
+	{
+		b[i] = lanes(i >> 8);
+		c[i] = lanes(i & 0xFF);
+	}
+	for (uint32_t weight = 0; weight <= BLEND_WEIGHT_MAX + 1; weight++)
+	{
+		uint32_t clamped = weight > BLEND_WEIGHT_MAX ? BLEND_WEIGHT_MAX : weight;
+
+		blend_crossfade(dst, b, c, 256 * 256, weight);
+		for (uint32_t i = 0; i < 256 * 256; i++)
+			for (uint32_t lane = 0; lane < 4; lane++)
+				check("crossfade", weight, lane, (dst[i] >> (lane * 8)) & 0xFF,
+					ref_crossfade((b[i] >> (lane * 8)) & 0xFF, (c[i] >> (lane * 8)) & 0xFF, clamped));
+
+		for (uint32_t i = 0; i < 256 * 256; i++)
+			dst[i] = b[i];
+		blend_add(dst, c, 256 * 256, weight);
+		for (uint32_t i = 0; i < 256 * 256; i++)
+			for (uint32_t lane = 0; lane < 4; lane++)
+				check("add", weight, lane, (dst[i] >> (lane * 8)) & 0xFF,
+					ref_add((b[i] >> (lane * 8)) & 0xFF, (c[i] >> (lane * 8)) & 0xFF, weight));
+	}
+
+	// Gamma table
+	blend_gamma(dst, a, 256, table);
+	for (uint32_t i = 0; i < 256; i++)
+		for (uint32_t lane = 0; lane < 4; lane++)
+			check("gamma", 0, lane, (dst[i] >> (lane * 8)) & 0xFF, table[(a[i] >> (lane * 8)) & 0xFF]);
+
+	printf("blend_test: %u failures\n", _failures);
+	return _failures != 0;
+}
@@ -0,0 +1,147 @@
+//*****************************************************************************
+//
+// color_test.c - Host test of the integer HSV and HSL conversions
+//
+// Compares color_hsv_to_rgb() and color_hsl_to_rgb() of src/color.c with a
+// floating point reference for every hue, saturation and value or lightness.
+// Every channel must be within 1 LSB of the rounded reference.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <math.h>
+#include <stdio.h>
+
+#include "../../src/color.c"
+
+#define TEST_MAX_ERROR 1
+
+static unsigned _failures;
+
+void IntEnable(uint32_t interrupt) {}
+void IntDisable(uint32_t interrupt) {}
+void led_update_begin(void) {}
+void led_update_end(void) {}
+void led_layer_brightness_set(uint32_t layer, uint32_t led_type, uint32_t brightness) {}
+
+//*****************************************************************************
+//
+// Reference conversions, from the chroma and the position on the hue circle
+//
+//*****************************************************************************
+static void ref_chroma_to_rgb(uint32_t hue, double chroma, double min, double rgb[3])
+{
+	double h = hue * 6.0 / COLOR_HUE_MAX;
+	double x = chroma * (1 - fabs(fmod(h, 2) - 1));
+	double r = 0, g = 0, b = 0;
+
+	switch ((int)h)
+	{
+		case 0: r = chroma; g = x; break;
+		case 1: r = x; g = chroma; break;
+		case 2: g = chroma; b = x; break;
+		case 3: g = x; b = chroma; break;
+		case 4: r = x; b = chroma; break;
+		default: r = chroma; b = x; break;
+	}
+	rgb[0] = (r + min) * COLOR_LEVEL_MAX;
+	rgb[1] = (g + min) * COLOR_LEVEL_MAX;
+	rgb[2] = (b + min) * COLOR_LEVEL_MAX;
+}
+
+static void ref_hsv_to_rgb(uint32_t hue, uint32_t saturation, uint32_t value, double rgb[3])
+{
+	double v = (double)value / COLOR_LEVEL_MAX;
+	double chroma = v * saturation / COLOR_LEVEL_MAX;
+
+	ref_chroma_to_rgb(hue, chroma, v - chroma, rgb);
+}
+
+static void ref_hsl_to_rgb(uint32_t hue, uint32_t saturation, uint32_t lightness, double rgb[3])
+{
+	double l = (double)lightness / COLOR_LEVEL_MAX;
+	double chroma = (1 - fabs(2 * l - 1)) * saturation / COLOR_LEVEL_MAX;
+
+	ref_chroma_to_rgb(hue, chroma, l - chroma / 2, rgb);
+}
+
+// Returns the largest channel error, reporting the first failures
+static double check(const char *model, uint32_t hue, uint32_t saturation, uint32_t level,
+	const uint8_t rgb[3], const double ref[3])
+{
+	double worst = 0;
+
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		double error = fabs(rgb[i] - floor(ref[i] + 0.5));
+
+		if (error > worst)
+			worst = error;
+	}
+
+	if (worst > TEST_MAX_ERROR && _failures++ < 10)
+		printf("%s %u %u %u: got %u %u %u, want %.1f %.1f %.1f\n", model, hue, saturation, level,
+			rgb[0], rgb[1], rgb[2], ref[0], ref[1], ref[2]);
+	return worst;
+}
+
+int main(void)
+{
+	double hsv_worst = 0, hsl_worst = 0;
+	double hsv_sum = 0, hsl_sum = 0;
+	uint32_t count = 0;
+
+	for (uint32_t hue = 0; hue < COLOR_HUE_MAX; hue++)
+	{
+		for (uint32_t saturation = 0; saturation <= COLOR_LEVEL_MAX; saturation++)
+		{
+			for (uint32_t level = 0; level <= COLOR_LEVEL_MAX; level++)
+			{
+				uint8_t rgb[3];
+				double ref[3], error;
+
+				color_hsv_to_rgb(hue, saturation, level, rgb);
+				ref_hsv_to_rgb(hue, saturation, level, ref);
+				error = check("hsv", hue, saturation, level, rgb, ref);
+				hsv_sum += error;
+				if (error > hsv_worst)
+					hsv_worst = error;
+
+				color_hsl_to_rgb(hue, saturation, level, rgb);
+				ref_hsl_to_rgb(hue, saturation, level, ref);
+				error = check("hsl", hue, saturation, level, rgb, ref);
+				hsl_sum += error;
+				if (error > hsl_worst)
+					hsl_worst = error;
+
+				count++;
+			}
+		}
+	}
+
+	printf("hsv: worst %.0f LSB, mean %.3f LSB\n", hsv_worst, hsv_sum / count);
+	printf("hsl: worst %.0f LSB, mean %.3f LSB\n", hsl_worst, hsl_sum / count);
+	printf("color_test: %u failures\n", _failures);
+	return _failures != 0;
+}
@@ -0,0 +1,269 @@
+//*****************************************************************************
+//
+// dmx_test.c - Host test of the DMX512 receiver
+//
+// Builds src/dmx.c against a fake UART1 and uDMA channel and plays a DMX
+// stream into them, as the receiver would see it on the line: slot bytes and
+// breaks. The fake uDMA moves the bytes out of the FIFO four at a time, as
+// with UDMA_ARB_4, and stops on a break, so the interrupt handler also has to
+// drain the bytes of a frame that are left in the FIFO. The LEDs written by the frames are
+// checked after each break.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../../src/dmx.c"
+
+#define TEST_NUM_LEDS  LED_NUM_LEDS
+#define TEST_FIFO_SIZE 16
+#define TEST_BURST     4
+
+//*****************************************************************************
+//
+// Fake UART1 and uDMA channel
+//
+//*****************************************************************************
+static int32_t _fifo[TEST_FIFO_SIZE];     // Received characters with their
+static uint32_t _fifo_count;              //  error flags
+static uint32_t _int_enabled;
+static uint32_t _int_status;
+static bool _dma_rx;                      // UART_DMA_RX enabled
+static bool _dma_enabled;                 // Channel enabled
+static uint8_t *_dma_dst;
+static uint32_t _dma_remaining;
+static uint32_t _overruns;
+
+void SysCtlPeripheralEnable(uint32_t peripheral) {}
+bool SysCtlPeripheralReady(uint32_t peripheral) { return true; }
+uint32_t SysCtlClockGet(void) { return 80000000; }
+void GPIOPinConfigure(uint32_t config) {}
+void GPIOPinTypeUART(uint32_t port, uint8_t pins) {}
+void IntEnable(uint32_t interrupt) {}
+void IntDisable(uint32_t interrupt) {}
+void UARTConfigSetExpClk(uint32_t base, uint32_t clock, uint32_t baud, uint32_t config) {}
+void UARTFIFOEnable(uint32_t base) {}
+void UARTFIFOLevelSet(uint32_t base, uint32_t tx_level, uint32_t rx_level) {}
+void UARTEnable(uint32_t base) {}
+void UARTDisable(uint32_t base) {}
+void UARTIntEnable(uint32_t base, uint32_t flags) { _int_enabled |= flags; }
+void UARTIntDisable(uint32_t base, uint32_t flags) { _int_enabled &= ~flags; }
+uint32_t UARTIntStatus(uint32_t base, bool masked) { return masked ? _int_status & _int_enabled : _int_status; }
+void UARTIntClear(uint32_t base, uint32_t flags) { _int_status &= ~flags; }
+void UARTDMAEnable(uint32_t base, uint32_t flags) { _dma_rx = true; }
+void UARTDMADisable(uint32_t base, uint32_t flags) { _dma_rx = false; }
+bool UARTCharsAvail(uint32_t base) { return _fifo_count != 0; }
+void UARTRxErrorClear(uint32_t base) {}
+void udma_init(void) {}
+void uDMAChannelAssign(uint32_t mapping) {}
+void uDMAChannelAttributeDisable(uint32_t channel, uint32_t attr) {}
+void uDMAChannelControlSet(uint32_t channel, uint32_t control) {}
+void uDMAChannelEnable(uint32_t channel) { _dma_enabled = true; }
+void uDMAChannelDisable(uint32_t channel) { _dma_enabled = false; }
+uint32_t uDMAChannelSizeGet(uint32_t channel) { return _dma_remaining; }
+
+void uDMAChannelTransferSet(uint32_t channel, uint32_t mode, void *src, void *dst, uint32_t size)
+{
+	_dma_dst = dst;
+	_dma_remaining = size;
+}
+
+int32_t UARTCharGetNonBlocking(uint32_t base)
+{
+	int32_t data;
+
+	if (_fifo_count == 0)
+		return -1;
+	data = _fifo[0];
+	memmove(_fifo, _fifo + 1, --_fifo_count * sizeof(_fifo[0]));
+	return data;
+}
+
+// Moves the FIFO to the buffer a burst at a time while the channel runs,
+// stopping at a break
+static void fake_dma_service(void)
+{
+	while (_dma_rx && _dma_enabled && _fifo_count >= TEST_BURST)
+	{
+		for (uint32_t i = 0; i < TEST_BURST; i++)
+			if (_fifo[i] & UART_DR_BE)
+				return;
+
+		*_dma_dst++ = (uint8_t)UARTCharGetNonBlocking(UART1_BASE);
+		if (--_dma_remaining == 0)
+		{
+			// The channel stops and its completion raises the UART interrupt
+			_dma_enabled = false;
+			UART1_Handler();
+		}
+	}
+}
+
+static void fake_rx(int32_t data)
+{
+	if (_fifo_count == TEST_FIFO_SIZE)
+	{
+		_overruns++;
+		return;
+	}
+	_fifo[_fifo_count++] = data;
+	fake_dma_service();
+}
+
+//*****************************************************************************
+//
+// Fake LED module
+//
+//*****************************************************************************
+static uint32_t _leds[TEST_NUM_LEDS];
+static uint32_t _updates;
+
+uint32_t led_num_leds_get(void) { return TEST_NUM_LEDS; }
+void led_sw_brightness_immediate_set(uint32_t led_type, uint32_t brightness) { _leds[led_type] = brightness; }
+void led_update_hw_start(void) { _updates++; }
+void log_msg_value(enum e_log_sub_system sys, enum e_log_level level, char *msg, uint32_t value) {}
+
+//*****************************************************************************
+//
+// Stream
+//
+//*****************************************************************************
+static unsigned _failures;
+
+// Sends the slots of a frame, without its break
+static void stream_slots(const uint8_t *slots, uint32_t length)
+{
+	for (uint32_t i = 0; i < length; i++)
+		fake_rx(slots[i]);
+}
+
+// Sends a break, which ends the frame on the line, and takes its interrupt.
+// Bytes short of a burst are still in the FIFO in front of the break.
+static void stream_break(void)
+{
+	fake_rx(UART_DR_BE);
+	_int_status |= UART_INT_BE;
+	if (UARTIntStatus(UART1_BASE, true))
+		UART1_Handler();
+}
+
+static void check(const char *step, uint32_t frames, const uint32_t *leds)
+{
+	if (dmx_frame_count_get() != frames)
+	{
+		printf("%s: %u frames applied, want %u\n", step, dmx_frame_count_get(), frames);
+		_failures++;
+	}
+	if (_updates != frames)
+	{
+		printf("%s: %u LED updates, want %u\n", step, _updates, frames);
+		_failures++;
+	}
+	for (uint32_t i = 0; i < TEST_NUM_LEDS; i++)
+	{
+		if (_leds[i] != leds[i])
+		{
+			printf("%s: LED %u is %u, want %u\n", step, i, _leds[i], leds[i]);
+			_failures++;
+		}
+	}
+	if (_fifo_count != 0 || _overruns != 0)
+	{
+		printf("%s: %u bytes left in the FIFO, %u overruns\n", step, _fifo_count, _overruns);
+		_failures++;
+	}
+}
+
+int main(void)
+{
+	uint8_t frame[DMX_FRAME_SIZE];
+	uint32_t leds[TEST_NUM_LEDS] = {0};
+
+	dmx_init();
+	dmx_enable_set(true);
+
+	// Enabled in the middle of a frame: its tail is discarded at the break
+	memset(frame, 0x77, sizeof(frame));
+	frame[0] = 0;
+	stream_slots(frame, 101);
+	stream_break();
+	check("partial frame", 0, leds);
+
+	// Full frame: the uDMA completes before the break
+	frame[0] = DMX_START_CODE_NULL;
+	for (uint32_t slot = 1; slot <= DMX_NUM_SLOTS; slot++)
+		frame[slot] = (uint8_t)(slot * 3);
+	stream_slots(frame, DMX_FRAME_SIZE);
+	stream_break();
+	for (uint32_t i = 0; i < TEST_NUM_LEDS; i++)
+		leds[i] = (uint8_t)((i + 1) * 3);
+	check("full frame", 1, leds);
+
+	// Alternate start code (RDM): ignored
+	frame[0] = 0xCC;
+	memset(frame + 1, 0x55, 24);
+	stream_slots(frame, 25);
+	stream_break();
+	check("alternate start code", 1, leds);
+
+	// Short frame: only the LEDs it reaches change, the first two from slot 5.
+	// Its last three bytes are drained from the FIFO by the handler.
+	dmx_start_address_set(5);
+	frame[0] = DMX_START_CODE_NULL;
+	for (uint32_t slot = 1; slot <= 6; slot++)
+		frame[slot] = (uint8_t)(200 + slot);
+	stream_slots(frame, 7);
+	stream_break();
+	for (uint32_t i = 0; i < 2; i++)
+		leds[i] = 200 + i + 5;
+	check("short frame", 2, leds);
+
+	// Empty frame (break after break): nothing to apply
+	stream_break();
+	check("empty frame", 2, leds);
+
+	// Start address near the end of the universe
+	dmx_start_address_set(DMX_NUM_SLOTS - TEST_NUM_LEDS + 1);
+	for (uint32_t slot = 1; slot <= DMX_NUM_SLOTS; slot++)
+		frame[slot] = (uint8_t)(slot ^ 0xA5);
+	stream_slots(frame, DMX_FRAME_SIZE);
+	stream_break();
+	for (uint32_t i = 0; i < TEST_NUM_LEDS; i++)
+		leds[i] = (uint8_t)((DMX_NUM_SLOTS - TEST_NUM_LEDS + 1 + i) ^ 0xA5);
+	check("start address", 3, leds);
+
+	// Re-enabled in the middle of a frame: discarded again
+	dmx_enable_set(false);
+	dmx_enable_set(true);
+	memset(frame, 0x11, sizeof(frame));
+	frame[0] = 0;
+	stream_slots(frame, 302);
+	stream_break();
+	check("re-enabled", 3, leds);
+
+	printf("dmx_test: %u failures\n", _failures);
+	return _failures != 0;
+}
@@ -0,0 +1,92 @@
+//*****************************************************************************
+//
+// lampbus_lamp.c - One lamp of the lamp bus host test
+//
+// Build with -DLAMP=<name> to get a lamp named <name>, see lampbus_lamp.h.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#define LAMP_CAT(a, b)       a##_##b
+#define LAMP_NAME(a, b)      LAMP_CAT(a, b)
+#define LAMP_STR(a)          #a
+#define LAMP_STRING(a)       LAMP_STR(a)
+
+#define UART3_Handler        LAMP_NAME(LAMP, UART3_Handler)
+#define lampbus_init         LAMP_NAME(LAMP, lampbus_init)
+#define lampbus_address_set  LAMP_NAME(LAMP, lampbus_address_set)
+#define lampbus_address_get  LAMP_NAME(LAMP, lampbus_address_get)
+#define lampbus_groups_get   LAMP_NAME(LAMP, lampbus_groups_get)
+#define lampbus_process      LAMP_NAME(LAMP, lampbus_process)
+#define lampbus_stats_get    LAMP_NAME(LAMP, lampbus_stats_get)
+
+#include "../../src/lampbus.c"
+#include "lampbus_lamp.h"
+
+#define LAMP_FIFO_LEVEL 8 // Receive interrupt level, UART_FIFO_RX4_8
+
+static void lamp_setup(uint32_t address, uint32_t groups);
+static void lamp_rx(const int32_t *data, uint32_t length);
+static void lamp_process(void);
+static void lamp_stats_get(struct lampbus_stats *stats);
+
+struct lamp LAMP =
+{
+	LAMP_STRING(LAMP), lamp_setup, lamp_rx, lamp_process, lamp_stats_get,
+	{ {0}, -1, -1, 0 },
+};
+
+static void lamp_setup(uint32_t address, uint32_t groups)
+{
+	lamp_current = &LAMP;
+	lampbus_init();
+	lampbus_address_set(address, groups);
+}
+
+// Takes the receive interrupt each time the FIFO reaches its level, then the
+// receive timeout for the bytes left once the line goes idle
+static void lamp_rx(const int32_t *data, uint32_t length)
+{
+	lamp_current = &LAMP;
+	while (length)
+	{
+		uint32_t count = length < LAMP_FIFO_LEVEL ? length : LAMP_FIFO_LEVEL;
+
+		uart_fake_load(data, count, count == LAMP_FIFO_LEVEL ? UART_INT_RX : UART_INT_RT);
+		UART3_Handler();
+		data += count;
+		length -= count;
+	}
+}
+
+static void lamp_process(void)
+{
+	lamp_current = &LAMP;
+	lampbus_process();
+}
+
+static void lamp_stats_get(struct lampbus_stats *stats)
+{
+	lampbus_stats_get(stats);
+}
@@ -0,0 +1,71 @@
+//*****************************************************************************
+//
+// lampbus_lamp.h - One lamp of the lamp bus host test
+//
+// lampbus_lamp.c is compiled once per lamp with -DLAMP=<name>, so each lamp
+// has its own copy of the state of src/lampbus.c. The lamps share the fakes
+// of lampbus_test.c, which record into the lamp being run.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#ifndef LAMPBUS_LAMP_H
+#define LAMPBUS_LAMP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../../src/lampbus.h"
+
+#define LAMP_NUM_LEDS 16
+
+//*****************************************************************************
+//
+// Commands applied by a lamp, as seen by the fakes
+//
+//*****************************************************************************
+struct lamp_state
+{
+	uint32_t brightness[LAMP_NUM_LEDS];
+	int32_t enable;  // -1 until set
+	int32_t dimmer;  // -1 until set
+	uint32_t applied;
+};
+
+struct lamp
+{
+	const char *name;
+	void (*setup)(uint32_t address, uint32_t groups);
+	void (*rx)(const int32_t *data, uint32_t length);
+	void (*process)(void);
+	void (*stats_get)(struct lampbus_stats *stats);
+	struct lamp_state state;
+};
+
+extern struct lamp *lamp_current;
+
+// Fake UART3 of lampbus_test.c: loads the receive FIFO and the interrupt status
+void uart_fake_load(const int32_t *data, uint32_t length, uint32_t status);
+
+#endif
@@ -0,0 +1,390 @@
+//*****************************************************************************
+//
+// lampbus_test.c - Host test of the lamp bus receiver with several lamps
+//
+// Four copies of src/lampbus.c, built from lampbus_lamp.c, share one byte
+// stream as lamps on the same RS-485 pair. The host frames cover unicast,
+// group and broadcast destinations, frames for lamps that are not there,
+// CRC and break errors, noise between frames and a full queue. The replies
+// of the lamps are put back on the bus, where every lamp must ignore them.
+// Each lamp is checked for the commands it applied and its counters, and the
+// replies for their sequence numbers, status and CRC.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "driverlib/uart.h"
+
+#include "lampbus_lamp.h"
+#include "../../src/cct.h"
+#include "../../src/clock.h"
+#include "../../src/fade.h"
+#include "../../src/led.h"
+#include "../../src/log.h"
+#include "../../src/settings.h"
+
+#define TEST_NUM_LAMPS  4
+#define TEST_MAX_STREAM 4096
+
+extern struct lamp lamp1, lamp2, lamp3, lamp4;
+
+struct lamp *lamp_current;
+
+static struct lamp *_lamps[TEST_NUM_LAMPS] = { &lamp1, &lamp2, &lamp3, &lamp4 };
+static unsigned _failures;
+
+//*****************************************************************************
+//
+// Fake UART3, loaded by the lamp being run
+//
+//*****************************************************************************
+static const int32_t *_fifo;
+static uint32_t _fifo_length;
+static uint32_t _int_status;
+
+static uint8_t _tx[TEST_MAX_STREAM];      // Replies put on the bus
+static uint32_t _tx_length;
+static struct lamp *_tx_lamp[TEST_MAX_STREAM];
+
+void uart_fake_load(const int32_t *data, uint32_t length, uint32_t status)
+{
+	_fifo = data;
+	_fifo_length = length;
+	_int_status = status;
+}
+
+void SysCtlPeripheralEnable(uint32_t peripheral) {}
+bool SysCtlPeripheralReady(uint32_t peripheral) { return true; }
+uint32_t SysCtlClockGet(void) { return 80000000; }
+void GPIOPinConfigure(uint32_t config) {}
+void GPIOPinTypeUART(uint32_t port, uint8_t pins) {}
+void GPIOPinTypeGPIOOutput(uint32_t port, uint8_t pins) {}
+void GPIOPinWrite(uint32_t port, uint8_t pins, uint8_t value) {}
+void IntEnable(uint32_t interrupt) {}
+void IntDisable(uint32_t interrupt) {}
+void UARTConfigSetExpClk(uint32_t base, uint32_t clock, uint32_t baud, uint32_t config) {}
+void UARTFIFOEnable(uint32_t base) {}
+void UARTFIFOLevelSet(uint32_t base, uint32_t tx_level, uint32_t rx_level) {}
+void UARTTxIntModeSet(uint32_t base, uint32_t mode) {}
+void UARTEnable(uint32_t base) {}
+void UARTIntEnable(uint32_t base, uint32_t flags) {}
+void UARTIntDisable(uint32_t base, uint32_t flags) {}
+uint32_t UARTIntStatus(uint32_t base, bool masked) { return _int_status; }
+void UARTIntClear(uint32_t base, uint32_t flags) { _int_status &= ~flags; }
+bool UARTCharsAvail(uint32_t base) { return _fifo_length != 0; }
+void UARTRxErrorClear(uint32_t base) {}
+
+int32_t UARTCharGetNonBlocking(uint32_t base)
+{
+	_fifo_length--;
+	return *_fifo++;
+}
+
+void UARTCharPut(uint32_t base, unsigned char data)
+{
+	_tx_lamp[_tx_length] = lamp_current;
+	_tx[_tx_length++] = data;
+}
+
+//*****************************************************************************
+//
+// Fakes of the modules the lamp bus drives, recording into the current lamp
+//
+//*****************************************************************************
+uint32_t clock_local_get(void) { return 0; }
+void clock_beacon(uint32_t sync_us, uint32_t local_us) { lamp_current->state.applied++; }
+void fade_start(const uint8_t *targets, const uint8_t *select, uint32_t start_us, uint32_t duration_ms) { lamp_current->state.applied++; }
+bool led_profile_targets_get(uint8_t index, uint8_t *targets, uint8_t *select) { return false; }
+void led_profile_load(uint8_t index) { lamp_current->state.applied++; }
+void cct_set(uint32_t kelvin, uint32_t intensity) { lamp_current->state.applied++; }
+uint32_t led_num_leds_get(void) { return LED_NUM_LEDS; }
+void led_update_begin(void) {}
+void led_update_end(void) { lamp_current->state.applied++; }
+bool settings_load(uint32_t block, uint32_t version, void *data, uint32_t size) { return false; }
+bool settings_save(uint32_t block, uint32_t version, const void *data, uint32_t size) { return true; }
+void log_msg_value(enum e_log_sub_system sys, enum e_log_level level, char *msg, uint32_t value) {}
+
+void led_sw_brightness_set(uint32_t led_type, uint32_t brightness)
+{
+	lamp_current->state.brightness[led_type] = brightness;
+}
+
+void led_sw_enable_set(bool enable)
+{
+	lamp_current->state.enable = enable;
+	lamp_current->state.applied++;
+}
+
+void led_master_dimmer_set(uint32_t level)
+{
+	lamp_current->state.dimmer = level;
+	lamp_current->state.applied++;
+}
+
+//*****************************************************************************
+//
+// Host side of the bus
+//
+//*****************************************************************************
+static int32_t _stream[TEST_MAX_STREAM];
+static uint32_t _stream_length;
+static uint8_t _seq;
+
+// CRC-8, polynomial 0x07, computed bit by bit to check the table of the lamps
+static uint8_t crc8(const uint8_t *data, uint32_t length)
+{
+	uint8_t crc = 0;
+
+	for (uint32_t i = 0; i < length; i++)
+	{
+		crc ^= data[i];
+		for (uint32_t bit = 0; bit < 8; bit++)
+			crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+	}
+	return crc;
+}
+
+static void stream_byte(int32_t data)
+{
+	_stream[_stream_length++] = data;
+}
+
+// Queues a host frame on the bus and returns its sequence number
+static uint8_t stream_frame(uint8_t dst, uint8_t groups, uint8_t cmd, const uint8_t *payload,
+	uint8_t length, bool bad_crc)
+{
+	uint8_t frame[LAMPBUS_HEADER_SIZE + LAMPBUS_MAX_PAYLOAD + 1];
+	uint32_t size = LAMPBUS_HEADER_SIZE + length;
+
+	frame[0] = LAMPBUS_SOF;
+	frame[1] = length;
+	frame[2] = dst;
+	frame[3] = groups;
+	frame[4] = _seq;
+	frame[5] = cmd;
+	memcpy(frame + LAMPBUS_HEADER_SIZE, payload, length);
+	frame[size] = crc8(frame + 1, size - 1) ^ (bad_crc ? 0x5A : 0);
+
+	for (uint32_t i = 0; i <= size; i++)
+		stream_byte(frame[i]);
+	return _seq++;
+}
+
+// Every lamp receives the whole stream, in pieces of random size
+static void stream_send(void)
+{
+	for (uint32_t i = 0; i < TEST_NUM_LAMPS; i++)
+	{
+		uint32_t sent = 0;
+
+		while (sent < _stream_length)
+		{
+			uint32_t length = 1 + rand() % 24;
+
+			if (length > _stream_length - sent)
+				length = _stream_length - sent;
+			_lamps[i]->rx(_stream + sent, length);
+			sent += length;
+		}
+	}
+	_stream_length = 0;
+}
+
+// Runs the main loop of every lamp, then puts their replies on the bus
+static void lamps_process(void)
+{
+	for (uint32_t i = 0; i < TEST_NUM_LAMPS; i++)
+		_lamps[i]->process();
+
+	for (uint32_t i = 0; i < _tx_length; i++)
+		stream_byte(_tx[i]);
+	stream_send();
+}
+
+//*****************************************************************************
+//
+// Checks
+//
+//*****************************************************************************
+static void check(bool condition, const char *what, const char *lamp)
+{
+	if (condition)
+		return;
+	printf("%s: %s\n", lamp, what);
+	_failures++;
+}
+
+static void check_stats(const struct lamp *lamp, uint32_t accepted, uint32_t ignored,
+	uint32_t crc_errors, uint32_t overflows)
+{
+	struct lampbus_stats stats;
+
+	lamp->stats_get(&stats);
+	if (stats.accepted == accepted && stats.ignored == ignored &&
+		stats.crc_errors == crc_errors && stats.overflows == overflows)
+		return;
+
+	printf("%s: accepted %u ignored %u crc errors %u overflows %u, want %u %u %u %u\n",
+		lamp->name, stats.accepted, stats.ignored, stats.crc_errors, stats.overflows,
+		accepted, ignored, crc_errors, overflows);
+	_failures++;
+}
+
+// Checks the next reply on the bus and returns its position after it
+static uint32_t check_reply(uint32_t position, const struct lamp *lamp, uint8_t seq, uint8_t cmd,
+	uint8_t status)
+{
+	const uint8_t *reply = _tx + position;
+
+	if (position + LAMPBUS_HEADER_SIZE + 2 > _tx_length)
+	{
+		printf("%s: reply to seq %u missing\n", lamp->name, seq);
+		_failures++;
+		return position;
+	}
+
+	check(_tx_lamp[position] == lamp, "reply sent by another lamp", lamp->name);
+	check(reply[0] == LAMPBUS_SOF && reply[1] == 1 && reply[2] == LAMPBUS_ADDR_HOST &&
+		reply[3] == 0, "bad reply header", lamp->name);
+	check(reply[4] == seq, "bad reply sequence number", lamp->name);
+	check(reply[5] == (cmd | LAMPBUS_CMD_REPLY), "bad reply command", lamp->name);
+	check(reply[6] == status, "bad reply status", lamp->name);
+	check(reply[7] == crc8(reply + 1, LAMPBUS_HEADER_SIZE), "bad reply CRC", lamp->name);
+	return position + LAMPBUS_HEADER_SIZE + 2;
+}
+
+int main(void)
+{
+	uint8_t payload[LAMPBUS_MAX_PAYLOAD];
+	uint32_t brightness[LAMP_NUM_LEDS] = {0};
+	uint8_t seq_ping, seq_bright, seq_full, seq_unknown, seq_queue[5];
+	uint32_t position = 0;
+
+	srand(1);
+
+	// Lamps 1 to 3 have addresses, lamp 4 only belongs to a group
+	lamp1.setup(1, 0x01);
+	lamp2.setup(2, 0x03);
+	lamp3.setup(3, 0x04);
+	lamp4.setup(LAMPBUS_ADDR_HOST, 0x02);
+
+	// Unicast
+	seq_ping = stream_frame(2, 0, LAMPBUS_CMD_PING, NULL, 0, false);
+	payload[0] = 0;
+	payload[1] = 10;
+	payload[2] = 2;
+	payload[3] = 40;
+	seq_bright = stream_frame(1, 0, LAMPBUS_CMD_BRIGHTNESS, payload, 4, false);
+
+	// Group 0x02: lamps 2 and 4. No replies.
+	payload[0] = 77;
+	stream_frame(LAMPBUS_ADDR_GROUP, 0x02, LAMPBUS_CMD_DIMMER, payload, 1, false);
+
+	// Broadcast: every lamp. No replies.
+	payload[0] = 1;
+	stream_frame(LAMPBUS_ADDR_BROADCAST, 0, LAMPBUS_CMD_ENABLE, payload, 1, false);
+
+	// Corrupted frame for lamp 3 and a frame for a lamp that is not on the bus
+	payload[0] = 0;
+	stream_frame(3, 0, LAMPBUS_CMD_ENABLE, payload, 1, true);
+	stream_frame(200, 0, LAMPBUS_CMD_PING, NULL, 0, false);
+
+	// Noise: a start of frame with a length out of range, then stray bytes
+	stream_byte(LAMPBUS_SOF);
+	stream_byte(LAMPBUS_MAX_PAYLOAD + 1);
+	stream_byte(0x12);
+	stream_byte(0x34);
+
+	// A frame for lamp 3 cut by a break, then a full payload for lamp 1
+	stream_byte(LAMPBUS_SOF);
+	stream_byte(1);
+	stream_byte(3);
+	stream_byte(0);
+	stream_byte(UART_DR_BE);
+	for (uint32_t i = 0; i < LAMPBUS_MAX_PAYLOAD; i += 2)
+	{
+		payload[i] = (uint8_t)(i / 2 % LED_NUM_LEDS);
+		payload[i + 1] = (uint8_t)(100 + i);
+	}
+	seq_full = stream_frame(1, 0, LAMPBUS_CMD_BRIGHTNESS, payload, LAMPBUS_MAX_PAYLOAD, false);
+
+	// Unknown command
+	seq_unknown = stream_frame(2, 0, 0x55, NULL, 0, false);
+
+	stream_send();
+
+	check_stats(&lamp1, 3, 6, 0, 0);
+	check_stats(&lamp2, 4, 5, 0, 0);
+	check_stats(&lamp3, 1, 6, 1, 0);
+	check_stats(&lamp4, 2, 7, 0, 0);
+
+	lamps_process();
+
+	// The main loops run lamp by lamp, each replying in frame order. Every
+	// lamp ignores all of the replies.
+	position = check_reply(position, &lamp1, seq_bright, LAMPBUS_CMD_BRIGHTNESS, LAMPBUS_STATUS_OK);
+	position = check_reply(position, &lamp1, seq_full, LAMPBUS_CMD_BRIGHTNESS, LAMPBUS_STATUS_OK);
+	position = check_reply(position, &lamp2, seq_ping, LAMPBUS_CMD_PING, LAMPBUS_STATUS_OK);
+	position = check_reply(position, &lamp2, seq_unknown, 0x55, LAMPBUS_STATUS_BAD_COMMAND);
+	check(position == _tx_length, "unexpected replies", "bus");
+
+	check_stats(&lamp1, 3, 10, 0, 0);
+	check_stats(&lamp2, 4, 9, 0, 0);
+	check_stats(&lamp3, 1, 10, 1, 0);
+	check_stats(&lamp4, 2, 11, 0, 0);
+
+	// Commands applied
+	check(lamp1.state.applied == 3 && lamp1.state.enable == 1 && lamp1.state.dimmer == -1,
+		"bad commands", lamp1.name);
+	for (uint32_t i = 0; i < LAMPBUS_MAX_PAYLOAD; i += 2)
+		brightness[payload[i]] = payload[i + 1];
+	check(memcmp(lamp1.state.brightness, brightness, sizeof(brightness)) == 0, "bad brightness", lamp1.name);
+	check(lamp2.state.applied == 2 && lamp2.state.enable == 1 && lamp2.state.dimmer == 77,
+		"bad commands", lamp2.name);
+	check(lamp3.state.applied == 1 && lamp3.state.enable == 1 && lamp3.state.dimmer == -1,
+		"bad commands", lamp3.name);
+	check(lamp4.state.applied == 2 && lamp4.state.enable == 1 && lamp4.state.dimmer == 77,
+		"bad commands", lamp4.name);
+
+	// Five frames for lamp 3 before its main loop runs: one does not fit
+	_tx_length = 0;
+	for (uint32_t i = 0; i < 5; i++)
+		seq_queue[i] = stream_frame(3, 0, LAMPBUS_CMD_PING, NULL, 0, false);
+	stream_send();
+	check_stats(&lamp3, 5, 10, 1, 1);
+	lamps_process();
+	position = 0;
+	for (uint32_t i = 0; i < 4; i++)
+		position = check_reply(position, &lamp3, seq_queue[i], LAMPBUS_CMD_PING, LAMPBUS_STATUS_OK);
+	check(position == _tx_length, "unexpected replies", "bus");
+	check_stats(&lamp1, 3, 19, 0, 0);
+	check_stats(&lamp3, 5, 14, 1, 1);
+
+	printf("lampbus_test: %u failures\n", _failures);
+	return _failures != 0;
+}
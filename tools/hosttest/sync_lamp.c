@@ -0,0 +1,70 @@
+//*****************************************************************************
+//
+// sync_lamp.c - One lamp of the bus clock simulation
+//
+// Build with -DLAMP=<name> to get a lamp named <name>, see sync_lamp.h.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#define LAMP_CAT(a, b)          a##_##b
+#define LAMP_NAME(a, b)         LAMP_CAT(a, b)
+#define LAMP_STR(a)             #a
+#define LAMP_STRING(a)          LAMP_STR(a)
+
+#define WTIMER0A_Handler        LAMP_NAME(LAMP, WTIMER0A_Handler)
+#define clock_init              LAMP_NAME(LAMP, clock_init)
+#define clock_local_get         LAMP_NAME(LAMP, clock_local_get)
+#define clock_local_ms_get      LAMP_NAME(LAMP, clock_local_ms_get)
+#define clock_sync_get          LAMP_NAME(LAMP, clock_sync_get)
+#define clock_sync_from_local   LAMP_NAME(LAMP, clock_sync_from_local)
+#define clock_synced            LAMP_NAME(LAMP, clock_synced)
+#define clock_beacon            LAMP_NAME(LAMP, clock_beacon)
+#define clock_offset_get        LAMP_NAME(LAMP, clock_offset_get)
+#define clock_rate_ppm_get      LAMP_NAME(LAMP, clock_rate_ppm_get)
+#define clock_alarm_set         LAMP_NAME(LAMP, clock_alarm_set)
+#define clock_alarm_cancel      LAMP_NAME(LAMP, clock_alarm_cancel)
+#define fade_start              LAMP_NAME(LAMP, fade_start)
+#define fade_stop               LAMP_NAME(LAMP, fade_stop)
+#define fade_active             LAMP_NAME(LAMP, fade_active)
+#define fade_tick               LAMP_NAME(LAMP, fade_tick)
+
+#include "../../src/clock.c"
+#include "../../src/fade.c"
+#include "sync_lamp.h"
+
+struct sync_lamp LAMP =
+{
+	.name = LAMP_STRING(LAMP),
+	.init = clock_init,
+	.beacon = clock_beacon,
+	.local_get = clock_local_get,
+	.sync_get = clock_sync_get,
+	.offset_get = clock_offset_get,
+	.rate_ppm_get = clock_rate_ppm_get,
+	.alarm_handler = WTIMER0A_Handler,
+	.fade_start = fade_start,
+	.fade_tick = fade_tick,
+	.fade_active = fade_active,
+};
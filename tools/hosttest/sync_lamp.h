@@ -0,0 +1,77 @@
+//*****************************************************************************
+//
+// sync_lamp.h - One lamp of the bus clock simulation
+//
+// sync_lamp.c is compiled once per lamp with -DLAMP=<name>, so each lamp has
+// its own copy of the state of src/clock.c and src/fade.c. The lamps share
+// the fakes of sync_sim.c, which run on the simulated timer of the lamp being
+// run.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#ifndef SYNC_LAMP_H
+#define SYNC_LAMP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//*****************************************************************************
+//
+// Simulated WTIMER0 and LED step timer of a lamp, kept by sync_sim.c
+//
+//*****************************************************************************
+struct sync_timer
+{
+	double ticks_per_ns;    // Oscillator rate, with its error
+	double phase_ns;        // Time the lamp was started before the bus time 0
+	uint64_t match;         // WTIMER0 match value
+	int64_t match_latency_ns; // Latency of the match interrupt
+	bool match_enabled;
+	bool alarm_pending;     // WTIMER0A triggered by software
+	int64_t trigger_ns;     //  at this bus time
+	uint64_t step_ticks;    // Counter value of the next LED step
+	int64_t fade_start_ns;  // Times the fade started and ended, or -1
+	int64_t fade_end_ns;
+};
+
+struct sync_lamp
+{
+	const char *name;
+	void (*init)(void);
+	void (*beacon)(uint32_t sync_us, uint32_t local_us);
+	uint32_t (*local_get)(void);
+	uint32_t (*sync_get)(void);
+	int32_t (*offset_get)(void);
+	int32_t (*rate_ppm_get)(void);
+	void (*alarm_handler)(void);
+	void (*fade_start)(const uint8_t *targets, const uint8_t *select, uint32_t start_us, uint32_t duration_ms);
+	bool (*fade_tick)(uint32_t *led_mask);
+	bool (*fade_active)(void);
+	struct sync_timer timer;
+};
+
+extern struct sync_lamp *lamp_current;
+
+#endif
@@ -0,0 +1,330 @@
+//*****************************************************************************
+//
+// sync_sim.c - Simulation of the bus clock of several lamps
+//
+// Eight copies of src/clock.c and src/fade.c, built from sync_lamp.c, run on
+// simulated oscillators with errors up to 1% and random start times. The host
+// sends a SYNC beacon each second and each lamp stamps it with 30 to 60 us of
+// interrupt latency. After ten beacons the host sends a FADE_AT to all lamps.
+// The simulation prints the residual beacon offset of the lamps and the
+// times their fade started and ended against the bus time, and fails if the
+// offsets exceed SIM_MAX_OFFSET_US or a fade is off by more than
+// SIM_MAX_FADE_ERROR_US.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "inc/hw_types.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/timer.h"
+
+#include "sync_lamp.h"
+#include "../../src/led.h"
+#include "../../src/log.h"
+
+#define SIM_NUM_LAMPS         8
+#define SIM_CLOCK_HZ          80000000
+#define SIM_MAX_PPM           10000     // Oscillator error, 1%
+#define SIM_MAX_PHASE_NS      5000000000ll // Lamps started up to 5 s apart
+#define SIM_LATENCY_NS        30000     // Interrupt latency of a beacon stamp
+#define SIM_JITTER_NS         30000     //  and its random part
+#define SIM_ALARM_JITTER_NS   2000      // Latency of the alarm interrupt
+#define SIM_TRIGGER_NS        1000      // Latency of a triggered interrupt
+#define SIM_PROCESS_NS        500000    // Beacon to lampbus_process()
+#define SIM_BEACON_NS         1000000000ll
+#define SIM_SETTLE_BEACONS    10        // Beacons before the fade is sent
+#define SIM_NUM_BEACONS       15
+#define SIM_STEP_TICKS        (SIM_CLOCK_HZ / 100) // LED step, 10 ms
+#define SIM_FADE_DELAY_US     50000     // Start of the fade after FADE_AT
+#define SIM_FADE_MS           1000
+#define SIM_MAX_OFFSET_US     100
+#define SIM_MAX_FADE_ERROR_US 1000
+
+extern struct sync_lamp sync1, sync2, sync3, sync4, sync5, sync6, sync7, sync8;
+
+struct sync_lamp *lamp_current;
+
+static struct sync_lamp *_lamps[SIM_NUM_LAMPS] =
+{
+	&sync1, &sync2, &sync3, &sync4, &sync5, &sync6, &sync7, &sync8,
+};
+static int64_t _now_ns;               // Bus time, which is the host time
+static uint32_t _reg;
+
+//*****************************************************************************
+//
+// Simulated timers
+//
+//*****************************************************************************
+static uint64_t sim_ticks(const struct sync_lamp *lamp, int64_t time_ns)
+{
+	return (uint64_t)((time_ns + lamp->timer.phase_ns) * lamp->timer.ticks_per_ns);
+}
+
+// First bus time the counter of a lamp reaches a value
+static int64_t sim_time(const struct sync_lamp *lamp, uint64_t ticks)
+{
+	int64_t time_ns = (int64_t)ceil(ticks / lamp->timer.ticks_per_ns - lamp->timer.phase_ns);
+
+	while (sim_ticks(lamp, time_ns) < ticks)
+		time_ns++;
+	while (sim_ticks(lamp, time_ns - 1) >= ticks)
+		time_ns--;
+	return time_ns;
+}
+
+static int64_t sim_jitter(int64_t range_ns)
+{
+	return (int64_t)(rand() / (RAND_MAX + 1.0) * range_ns);
+}
+
+uint32_t *tiva_host_reg(uint32_t address) { return &_reg; }
+void SysCtlPeripheralEnable(uint32_t peripheral) {}
+bool SysCtlPeripheralReady(uint32_t peripheral) { return true; }
+uint32_t SysCtlClockGet(void) { return SIM_CLOCK_HZ; }
+void IntEnable(uint32_t interrupt) {}
+void IntDisable(uint32_t interrupt) {}
+void TimerConfigure(uint32_t base, uint32_t config) {}
+void TimerEnable(uint32_t base, uint32_t timer) {}
+void TimerLoadSet64(uint32_t base, uint64_t value) {}
+void TimerIntClear(uint32_t base, uint32_t flags) {}
+uint64_t TimerValueGet64(uint32_t base) { return sim_ticks(lamp_current, _now_ns); }
+void TimerIntEnable(uint32_t base, uint32_t flags) { lamp_current->timer.match_enabled = true; }
+void TimerIntDisable(uint32_t base, uint32_t flags) { lamp_current->timer.match_enabled = false; }
+
+void TimerMatchSet64(uint32_t base, uint64_t value)
+{
+	lamp_current->timer.match = value;
+	lamp_current->timer.match_latency_ns = sim_jitter(SIM_ALARM_JITTER_NS);
+}
+
+void IntTrigger(uint32_t interrupt)
+{
+	if (interrupt == INT_WTIMER0A)
+	{
+		lamp_current->timer.alarm_pending = true;
+		lamp_current->timer.trigger_ns = _now_ns + SIM_TRIGGER_NS;
+	}
+}
+
+void log_msg(enum e_log_sub_system sys, enum e_log_level level, char *msg) {}
+void log_msg_value(enum e_log_sub_system sys, enum e_log_level level, char *msg, uint32_t value) {}
+void led_layer_brightness_set(uint32_t layer, uint32_t led_type, uint32_t brightness) {}
+
+//*****************************************************************************
+//
+// LED step of a lamp. The fade reads the base layer once, as it starts.
+//
+//*****************************************************************************
+static void sim_step(struct sync_lamp *lamp)
+{
+	uint32_t animated = 0;
+	
+	lamp_current = lamp;
+	if (lamp->fade_tick(&animated) && !lamp->fade_active() && lamp->timer.fade_end_ns < 0)
+		lamp->timer.fade_end_ns = _now_ns;
+}
+
+uint32_t led_layer_brightness_get(uint32_t layer, uint32_t led_type)
+{
+	if (lamp_current->timer.fade_start_ns < 0)
+		lamp_current->timer.fade_start_ns = _now_ns;
+	return 0;
+}
+
+// Restarts the step timer and runs a step, as the TIMER1A trigger does
+void led_update_hw_now(void)
+{
+	struct sync_lamp *lamp = lamp_current;
+
+	lamp->timer.step_ticks = sim_ticks(lamp, _now_ns) + SIM_STEP_TICKS;
+	sim_step(lamp);
+}
+
+//*****************************************************************************
+//
+// Host
+//
+//*****************************************************************************
+static void sim_beacon(int64_t sent_ns, int32_t *worst_offset)
+{
+	for (uint32_t i = 0; i < SIM_NUM_LAMPS; i++)
+	{
+		struct sync_lamp *lamp = _lamps[i];
+		uint64_t stamp = sim_ticks(lamp, sent_ns + SIM_LATENCY_NS + sim_jitter(SIM_JITTER_NS));
+		int32_t offset;
+
+		lamp_current = lamp;
+		lamp->beacon((uint32_t)(sent_ns / 1000), (uint32_t)(stamp / (SIM_CLOCK_HZ / 1000000)));
+		offset = abs(lamp->offset_get());
+		if (offset > *worst_offset)
+			*worst_offset = offset;
+	}
+}
+
+static void sim_fade(uint32_t start_us)
+{
+	uint8_t targets[LED_NUM_LEDS] = {255};
+	uint8_t select[LED_NUM_LEDS] = {1};
+
+	for (uint32_t i = 0; i < SIM_NUM_LAMPS; i++)
+	{
+		lamp_current = _lamps[i];
+		_lamps[i]->fade_start(targets, select, start_us, SIM_FADE_MS);
+	}
+}
+
+// Runs the lamp timers up to a bus time
+static void sim_run(int64_t until_ns)
+{
+	while (true)
+	{
+		struct sync_lamp *next = NULL;
+		int64_t next_ns = until_ns;
+		bool alarm = false;
+
+		for (uint32_t i = 0; i < SIM_NUM_LAMPS; i++)
+		{
+			struct sync_lamp *lamp = _lamps[i];
+			int64_t step_ns = sim_time(lamp, lamp->timer.step_ticks);
+			int64_t alarm_ns = lamp->timer.alarm_pending ? lamp->timer.trigger_ns :
+				lamp->timer.match_enabled ? sim_time(lamp, lamp->timer.match) + lamp->timer.match_latency_ns : INT64_MAX;
+
+			// A match set in the past is only seen when the counter wraps
+			if (!lamp->timer.alarm_pending && alarm_ns < _now_ns)
+				alarm_ns = INT64_MAX;
+
+			if (alarm_ns <= next_ns)
+			{
+				next = lamp;
+				next_ns = alarm_ns;
+				alarm = true;
+			}
+			if (step_ns < next_ns)
+			{
+				next = lamp;
+				next_ns = step_ns;
+				alarm = false;
+			}
+		}
+
+		if (!next)
+			break;
+
+		_now_ns = next_ns;
+		lamp_current = next;
+		if (alarm)
+		{
+			next->timer.alarm_pending = false;
+			next->alarm_handler();
+		}
+		else
+		{
+			next->timer.step_ticks += SIM_STEP_TICKS;
+			sim_step(next);
+		}
+	}
+	_now_ns = until_ns;
+}
+
+int main(void)
+{
+	int64_t start_ns = 0, min_start = INT64_MAX, max_start = INT64_MIN;
+	int64_t min_end = INT64_MAX, max_end = INT64_MIN;
+	int32_t settled_offset = 0;
+	unsigned failures = 0;
+
+	srand(1);
+	for (uint32_t i = 0; i < SIM_NUM_LAMPS; i++)
+	{
+		struct sync_lamp *lamp = _lamps[i];
+		double ppm = (2.0 * rand() / RAND_MAX - 1) * SIM_MAX_PPM;
+
+		lamp->timer.ticks_per_ns = SIM_CLOCK_HZ / 1e9 * (1 + ppm / 1e6);
+		lamp->timer.phase_ns = (double)sim_jitter(SIM_MAX_PHASE_NS);
+		lamp->timer.fade_start_ns = -1;
+		lamp->timer.fade_end_ns = -1;
+		lamp_current = lamp;
+		lamp->init();
+		lamp->timer.step_ticks = sim_ticks(lamp, 0) + SIM_STEP_TICKS;
+		printf("%s: oscillator %+6.0f ppm\n", lamp->name, ppm);
+	}
+
+	for (uint32_t beacon = 1; beacon <= SIM_NUM_BEACONS; beacon++)
+	{
+		int64_t sent_ns = beacon * SIM_BEACON_NS;
+		int32_t worst_offset = 0;
+
+		sim_run(sent_ns + SIM_PROCESS_NS);
+		sim_beacon(sent_ns, &worst_offset);
+		printf("beacon %2u: worst offset %5d us\n", beacon, worst_offset);
+		if (beacon >= SIM_SETTLE_BEACONS && worst_offset > settled_offset)
+			settled_offset = worst_offset;
+
+		// FADE_AT, sent some time after the beacon
+		if (beacon == SIM_SETTLE_BEACONS)
+		{
+			sim_run(sent_ns + SIM_BEACON_NS / 3);
+			start_ns = _now_ns + SIM_FADE_DELAY_US * 1000ll;
+			sim_fade((uint32_t)(start_ns / 1000));
+		}
+	}
+	sim_run((SIM_NUM_BEACONS + 1) * SIM_BEACON_NS);
+
+	for (uint32_t i = 0; i < SIM_NUM_LAMPS; i++)
+	{
+		const struct sync_timer *timer = &_lamps[i]->timer;
+		int64_t start = timer->fade_start_ns - start_ns;
+		int64_t end = timer->fade_end_ns - start_ns - SIM_FADE_MS * 1000000ll;
+
+		if (timer->fade_start_ns < 0 || timer->fade_end_ns < 0)
+		{
+			printf("%s: fade did not run\n", _lamps[i]->name);
+			failures++;
+			continue;
+		}
+		min_start = start < min_start ? start : min_start;
+		max_start = start > max_start ? start : max_start;
+		min_end = end < min_end ? end : min_end;
+		max_end = end > max_end ? end : max_end;
+	}
+
+	printf("offset after %u beacons: within %d us\n", SIM_SETTLE_BEACONS, settled_offset);
+	printf("fade start: %+.1f..%+.1f us, end: %+.1f..%+.1f us of the bus time\n",
+		min_start / 1000.0, max_start / 1000.0, min_end / 1000.0, max_end / 1000.0);
+
+	if (settled_offset > SIM_MAX_OFFSET_US)
+		failures++;
+	if (llabs(min_start) > SIM_MAX_FADE_ERROR_US * 1000ll || llabs(max_start) > SIM_MAX_FADE_ERROR_US * 1000ll ||
+		llabs(min_end) > SIM_MAX_FADE_ERROR_US * 1000ll || llabs(max_end) > SIM_MAX_FADE_ERROR_US * 1000ll)
+		failures++;
+
+	printf("sync_sim: %u failures\n", failures);
+	return failures != 0;
+}
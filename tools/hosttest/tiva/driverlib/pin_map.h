@@ -0,0 +1 @@
+#include "../tiva_host.h"
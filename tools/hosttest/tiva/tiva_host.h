@@ -0,0 +1,208 @@
+//*****************************************************************************
+//
+// tiva_host.h - TivaWare declarations for the host tests
+//
+// The inc/ and driverlib/ headers of this directory all include this file, so
+// the firmware sources build on the host unchanged. Only the registers and
+// calls used by the tested modules are declared. Each test defines the calls
+// its module makes, usually as fakes of the peripheral.
+//
+// MIT License
+//
+// Copyright (c) 2019 Keisuke Tomizawa
+//
+// 	Permission is hereby granted, free of charge, to any person obtaining a copy
+// 	of this software and associated documentation files (the "Software"), to deal
+// 	in the Software without restriction, including without limitation the rights
+// 	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// 	copies of the Software, and to permit persons to whom the Software is
+// 	furnished to do so, subject to the following conditions:
+//
+// 	The above copyright notice and this permission notice shall be included in all
+// 	copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//*****************************************************************************
+
+#ifndef TIVA_HOST_H
+#define TIVA_HOST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//*****************************************************************************
+//
+// inc/hw_types.h. The registers a module writes directly are given by the
+// test, which defines tiva_host_reg().
+//
+//*****************************************************************************
+#define HWREG(x)                (*tiva_host_reg(x))
+
+uint32_t *tiva_host_reg(uint32_t address);
+
+//*****************************************************************************
+//
+// inc/hw_memmap.h, inc/hw_ints.h
+//
+//*****************************************************************************
+#define GPIO_PORTB_BASE         0x40005000
+#define GPIO_PORTC_BASE         0x40006000
+#define UART1_BASE              0x4000D000
+#define UART3_BASE              0x4000F000
+#define WTIMER0_BASE            0x40036000
+
+#define INT_TIMER1A             37
+#define INT_UART1               22
+#define INT_UART3               75
+#define INT_WTIMER0A            110
+
+//*****************************************************************************
+//
+// inc/hw_uart.h
+//
+//*****************************************************************************
+#define UART_O_DR               0x00000000
+#define UART_DR_OE              0x00000800
+#define UART_DR_BE              0x00000400
+#define UART_DR_FE              0x00000100
+
+//*****************************************************************************
+//
+// inc/hw_timer.h
+//
+//*****************************************************************************
+#define TIMER_O_TAMR            0x00000004
+#define TIMER_TAMR_TAMIE        0x00000020
+
+//*****************************************************************************
+//
+// driverlib/sysctl.h, driverlib/gpio.h, driverlib/pin_map.h
+//
+//*****************************************************************************
+#define SYSCTL_PERIPH_GPIOB     0xF0000801
+#define SYSCTL_PERIPH_GPIOC     0xF0000802
+#define SYSCTL_PERIPH_UART1     0xF0001801
+#define SYSCTL_PERIPH_UART3     0xF0001803
+#define SYSCTL_PERIPH_WTIMER0   0xF0005C00
+
+#define GPIO_PIN_0              0x00000001
+#define GPIO_PIN_5              0x00000020
+#define GPIO_PIN_6              0x00000040
+#define GPIO_PIN_7              0x00000080
+
+#define GPIO_PB0_U1RX           0x00010001
+#define GPIO_PC6_U3RX           0x00021801
+#define GPIO_PC7_U3TX           0x00021C01
+
+void SysCtlPeripheralEnable(uint32_t peripheral);
+bool SysCtlPeripheralReady(uint32_t peripheral);
+uint32_t SysCtlClockGet(void);
+void GPIOPinConfigure(uint32_t config);
+void GPIOPinTypeUART(uint32_t port, uint8_t pins);
+void GPIOPinTypeGPIOOutput(uint32_t port, uint8_t pins);
+void GPIOPinWrite(uint32_t port, uint8_t pins, uint8_t value);
+
+//*****************************************************************************
+//
+// driverlib/interrupt.h
+//
+//*****************************************************************************
+void IntEnable(uint32_t interrupt);
+void IntDisable(uint32_t interrupt);
+void IntTrigger(uint32_t interrupt);
+
+//*****************************************************************************
+//
+// driverlib/uart.h
+//
+//*****************************************************************************
+#define UART_INT_OE             0x400
+#define UART_INT_BE             0x200
+#define UART_INT_FE             0x080
+#define UART_INT_RT             0x040
+#define UART_INT_TX             0x020
+#define UART_INT_RX             0x010
+
+#define UART_CONFIG_WLEN_8      0x00000060
+#define UART_CONFIG_STOP_ONE    0x00000000
+#define UART_CONFIG_STOP_TWO    0x00000008
+#define UART_CONFIG_PAR_NONE    0x00000000
+
+#define UART_FIFO_TX4_8         0x00000002
+#define UART_FIFO_RX4_8         0x00000010
+
+#define UART_DMA_ERR_RXSTOP     0x00000004
+#define UART_DMA_RX             0x00000001
+
+#define UART_TXINT_MODE_EOT     0x00000010
+
+void UARTConfigSetExpClk(uint32_t base, uint32_t clock, uint32_t baud, uint32_t config);
+void UARTFIFOEnable(uint32_t base);
+void UARTFIFOLevelSet(uint32_t base, uint32_t tx_level, uint32_t rx_level);
+void UARTTxIntModeSet(uint32_t base, uint32_t mode);
+void UARTEnable(uint32_t base);
+void UARTDisable(uint32_t base);
+void UARTIntEnable(uint32_t base, uint32_t flags);
+void UARTIntDisable(uint32_t base, uint32_t flags);
+uint32_t UARTIntStatus(uint32_t base, bool masked);
+void UARTIntClear(uint32_t base, uint32_t flags);
+void UARTDMAEnable(uint32_t base, uint32_t flags);
+void UARTDMADisable(uint32_t base, uint32_t flags);
+bool UARTCharsAvail(uint32_t base);
+int32_t UARTCharGetNonBlocking(uint32_t base);
+void UARTCharPut(uint32_t base, unsigned char data);
+void UARTRxErrorClear(uint32_t base);
+
+//*****************************************************************************
+//
+// driverlib/udma.h
+//
+//*****************************************************************************
+#define UDMA_ATTR_USEBURST      0x00000001
+#define UDMA_ATTR_ALTSELECT     0x00000002
+#define UDMA_ATTR_HIGH_PRIORITY 0x00000004
+#define UDMA_ATTR_REQMASK       0x00000008
+
+#define UDMA_DST_INC_8          0x00000000
+#define UDMA_SRC_INC_NONE       0x0C000000
+#define UDMA_SIZE_8             0x00000000
+#define UDMA_ARB_4              0x00008000
+#define UDMA_MODE_BASIC         0x00000001
+
+#define UDMA_PRI_SELECT         0x00000000
+#define UDMA_CH22_UART1RX       0x00000016
+
+void uDMAChannelAssign(uint32_t mapping);
+void uDMAChannelAttributeDisable(uint32_t channel, uint32_t attr);
+void uDMAChannelControlSet(uint32_t channel, uint32_t control);
+void uDMAChannelTransferSet(uint32_t channel, uint32_t mode, void *src, void *dst, uint32_t size);
+void uDMAChannelEnable(uint32_t channel);
+void uDMAChannelDisable(uint32_t channel);
+uint32_t uDMAChannelSizeGet(uint32_t channel);
+
+//*****************************************************************************
+//
+// driverlib/timer.h
+//
+//*****************************************************************************
+#define TIMER_A                 0x000000FF
+#define TIMER_CFG_PERIODIC_UP   0x00000012
+#define TIMER_TIMA_MATCH        0x00000010
+
+void TimerConfigure(uint32_t base, uint32_t config);
+void TimerEnable(uint32_t base, uint32_t timer);
+void TimerLoadSet64(uint32_t base, uint64_t value);
+uint64_t TimerValueGet64(uint32_t base);
+void TimerMatchSet64(uint32_t base, uint64_t value);
+void TimerIntEnable(uint32_t base, uint32_t flags);
+void TimerIntDisable(uint32_t base, uint32_t flags);
+void TimerIntClear(uint32_t base, uint32_t flags);
+
+#endif